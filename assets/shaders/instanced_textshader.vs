@@ -0,0 +1,33 @@
+#version 430 core
+// One instance per glyph. The quad is expanded here, from the glyph's box in the font's glyph table
+layout (location = 0) in vec2 pen;   // <vec2 pos> on the baseline
+layout (location = 1) in uint glyph; // index into glyphs
+layout (location = 2) in vec4 icol;  // <vec4 color>, unpacked from RGBA8
+
+struct Glyph {
+    vec4 uv;   // <u0, v0, u1, v1> in the atlas
+    vec4 quad; // <x offset, y offset, width, height> from the pen position
+};
+
+layout (std430, binding = 0) readonly buffer GlyphTable {
+    Glyph glyphs[];
+};
+
+out vec3 TCol;
+out vec2 TexCoords;
+
+uniform mat4 projection;
+
+// corners of the 2 triangles of a quad, in the order the non-instanced quads are built. x = 1 is the right edge, y = 1
+// the top edge
+const vec2 corners[6] = vec2[](vec2(0, 1), vec2(0, 0), vec2(1, 0), vec2(0, 1), vec2(1, 0), vec2(1, 1));
+
+void main()
+{
+    Glyph g = glyphs[glyph];
+    vec2 corner = corners[gl_VertexID];
+    gl_Position = projection * vec4(pen + g.quad.xy + corner * g.quad.zw, 0.0, 1.0);
+    // the atlas has v0 at the top of the glyph
+    TexCoords = vec2(mix(g.uv.x, g.uv.z, corner.x), mix(g.uv.w, g.uv.y, corner.y));
+    TCol = icol.rgb;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+//
+// Created by 46769 on 2021-02-15.
+//
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fmt/core.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+/// A header-like C++ text of size bytes: declarations, definitions, comments & literals, with the names varied so that
+/// no two lines are the same
+inline std::string make_header_text(std::size_t size, unsigned seed = 1337) {
+    std::mt19937 rng{seed};
+    std::uniform_int_distribution<int> pick{0, 7};
+    std::string text;
+    text.reserve(size + 256);
+    text.append("#include <vector>\n#include <string_view>\n\n");
+    for (auto n = 0u; text.size() < size; ++n) {
+        switch (pick(rng)) {
+            case 0:
+                text.append(fmt::format("/**\n * Documentation of item_{0}, which\n * spans two lines\n */\n", n));
+                break;
+            case 1:
+                text.append(fmt::format("static constexpr std::size_t LIMIT_{0} = 0x{0:x}'{0}ull;\n", n));
+                break;
+            case 2:
+                text.append(fmt::format("void function_{0}(const std::vector<int> &values, int count_{0});\n", n));
+                break;
+            case 3:
+                text.append(fmt::format("    if (value_{0} > {0}) return std::string_view{{\"text {0}\"}};\n", n));
+                break;
+            case 4:
+                text.append(fmt::format("    auto result_{0} = namespace_{0}::compute(argument, '{1}'); // why\n", n,
+                                        static_cast<char>('a' + n % 26)));
+                break;
+            case 5:
+                text.append(fmt::format("struct Type_{0} {{\n    unsigned long member_{0}{{0}};\n}};\n", n));
+                break;
+            case 6:
+                text.append(fmt::format("        for (auto i = 0; i < {0}; ++i) {{ sum += i * 3.5f; }}\n", n));
+                break;
+            default:
+                text.append("\n");
+        }
+    }
+    text.resize(size);
+    return text;
+}
+
+/// Latencies of one stage of something that's repeated, in milliseconds
+class Samples {
+public:
+    explicit Samples(std::string_view name) : name(name) {}
+
+    template<typename Fn>
+    void time(Fn fn) {
+        auto begin = BenchClock::now();
+        fn();
+        add(std::chrono::duration<double, std::milli>(BenchClock::now() - begin).count());
+    }
+    void add(double ms) { samples.push_back(ms); }
+
+    /// p in [0, 1], nearest rank
+    [[nodiscard]] double percentile(double p) const {
+        if (samples.empty()) return 0.0;
+        auto sorted = samples;
+        const auto rank = std::min(static_cast<std::size_t>(p * static_cast<double>(sorted.size())), sorted.size() - 1);
+        std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(rank), sorted.end());
+        return sorted[rank];
+    }
+
+    static void print_header() {
+        fmt::print("    {:<24} {:>10} {:>10} {:>10} {:>10} {:>8}\n", "stage (ms)", "p50", "p90", "p99", "max", "n");
+    }
+    void print() const {
+        fmt::print("    {:<24} {:>10.4f} {:>10.4f} {:>10.4f} {:>10.4f} {:>8}\n", name, percentile(0.5), percentile(0.9),
+                   percentile(0.99), percentile(1.0), samples.size());
+    }
+
+private:
+    std::string name;
+    std::vector<double> samples{};
+};
@@ -0,0 +1,78 @@
+//
+// Created by 46769 on 2021-02-14.
+//
+
+// Throughput of the C++ lexer in ui/syntax_highlighting: tokenizing, and tokenizing + coloring, a large header. And of
+// every grammar of the GrammarRegistry, lexing the same text, which is C++, but as text, about as hard for any of them.
+//  usage: lexer_bench [file | size in MB = 64] [iterations = 10]
+// Without a file, a header-like text is generated; pass one of the large headers of the project to measure on real code
+
+#include "bench_util.hpp"
+#include <algorithm>
+#include <chrono>
+#include <core/strops.hpp>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <ui/grammar.hpp>
+#include <ui/syntax_highlighting.hpp>
+#include <vector>
+
+template<typename Fn>
+static void bench(const char *name, const std::string &text, int iterations, Fn fn) {
+    std::vector<double> times{};
+    std::size_t tokens = 0;
+    for (auto i = 0; i < iterations; ++i) {
+        auto begin = BenchClock::now();
+        tokens = fn();
+        auto end = BenchClock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+    }
+    std::sort(times.begin(), times.end());
+    auto median = times[times.size() / 2];
+    auto mb_per_s = (static_cast<double>(text.size()) / 1e6) / (median / 1e3);
+    fmt::print("{:<24} tokens: {:>10}  best: {:>8.2f}ms  median: {:>8.2f}ms  {:>8.1f} MB/s\n", name, tokens,
+               times.front(), median, mb_per_s);
+}
+
+static std::size_t lex_with(const Grammar &grammar, std::string_view text) {
+    std::vector<Token> tokens{};
+    tokens.reserve(text.size() / 3);
+    LineLexState state{};
+    for (std::size_t line_start = 0; line_start < text.size();) {
+        auto line_end = std::min(text.find('\n', line_start), text.size() - 1) + 1;
+        grammar.lex_line(text.substr(line_start, line_end - line_start), line_start, state, tokens);
+        line_start = line_end;
+    }
+    return tokens.size();
+}
+
+int main(int argc, const char **argv) {
+    std::string text{};
+    std::string source{};
+    if (argc > 1 && std::filesystem::is_regular_file(argv[1])) {
+        std::ifstream f{argv[1]};
+        std::stringstream contents;
+        contents << f.rdbuf();
+        text = contents.str();
+        source = argv[1];
+    } else {
+        auto megabytes = argc > 1 ? std::stoul(argv[1]) : 64ul;
+        text = make_header_text(megabytes * 1024 * 1024);
+        source = "generated header";
+    }
+    auto iterations = argc > 2 ? std::stoi(argv[2]) : 10;
+    fmt::print("{}: {:.1f}MB, {} iterations. Scanners: {}\n", source, static_cast<double>(text.size()) / 1e6,
+               iterations, str::detected_simd_level() == str::SimdLevel::Scalar ? "scalar" : "SSE2");
+
+    bench("tokenize", text, iterations, [&]() { return tokenize(text).size(); });
+    bench("color_format_tokenize", text, iterations, [&]() { return color_format_tokenize(text).size(); });
+    for (auto language : {Language::CPP, Language::C, Language::Python, Language::Rust, Language::JSON,
+                          Language::Config}) {
+        const auto grammar = GrammarRegistry::get_instance().grammar_for(language);
+        bench(fmt::format("grammar {}", grammar->name).c_str(), text, iterations,
+              [&]() { return lex_with(*grammar, text); });
+    }
+}
@@ -0,0 +1,76 @@
+//
+// Created by 46769 on 2021-02-08.
+//
+
+// Micro benchmark of the line begin scanners in core/strops: the naive make_lines_indices vs
+// str::find_line_starts, with every kernel the CPU supports.
+//  usage: line_starts_bench [size in MB = 256] [iterations = 10]
+
+#include <algorithm>
+#include <chrono>
+#include <core/strops.hpp>
+#include <fmt/core.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+/// Something that looks like a log file. Line lengths vary between 0 and 160, 80 on average
+static std::string make_log_text(std::size_t size) {
+    std::mt19937 rng{1337};
+    std::uniform_int_distribution<int> line_length{0, 160};
+    std::uniform_int_distribution<int> printable{' ', '~'};
+    std::string text;
+    text.reserve(size);
+    while (text.size() < size) {
+        auto len = line_length(rng);
+        for (auto i = 0; i < len && text.size() < size; ++i) text.push_back(static_cast<char>(printable(rng)));
+        text.push_back('\n');
+    }
+    text.resize(size);
+    return text;
+}
+
+template<typename Fn>
+static void bench(const char *name, const std::string &text, int iterations, Fn fn) {
+    std::vector<double> times{};
+    std::size_t lines = 0;
+    for (auto i = 0; i < iterations; ++i) {
+        auto begin = BenchClock::now();
+        lines = fn();
+        auto end = BenchClock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+    }
+    std::sort(times.begin(), times.end());
+    auto median = times[times.size() / 2];
+    auto gb_per_s = (static_cast<double>(text.size()) / 1e9) / (times.front() / 1e3);
+    fmt::print("{:<24} lines: {:>10}  best: {:>8.2f}ms  median: {:>8.2f}ms  {:>6.2f} GB/s\n", name, lines,
+               times.front(), median, gb_per_s);
+}
+
+int main(int argc, const char **argv) {
+    auto megabytes = argc > 1 ? std::stoul(argv[1]) : 256ul;
+    auto iterations = argc > 2 ? std::stoi(argv[2]) : 10;
+    auto text = make_log_text(megabytes * 1024 * 1024);
+    auto detected = str::detected_simd_level();
+    fmt::print("{}MB of text, {} iterations. Detected: {}\n", megabytes, iterations, str::simd_level_name(detected));
+
+    bench("make_lines_indices", text, iterations, [&]() {
+        return make_lines_indices(text.data(), text.size()).size();
+    });
+
+    std::vector<str::SimdLevel> levels{str::SimdLevel::Scalar};
+    if (detected == str::SimdLevel::SSE2 || detected == str::SimdLevel::AVX2) levels.push_back(str::SimdLevel::SSE2);
+    if (detected == str::SimdLevel::AVX2) levels.push_back(str::SimdLevel::AVX2);
+    for (auto level : levels) {
+        auto name = fmt::format("find_line_starts {}", str::simd_level_name(level));
+        bench(name.c_str(), text, iterations, [&]() {
+            std::vector<std::size_t> line_begins{0};
+            // same reservation as str::count_newlines & LineIndex::assign makes
+            line_begins.reserve(text.size() / 64);
+            str::find_line_starts(level, text.data(), text.size(), 0, line_begins);
+            return line_begins.size();
+        });
+    }
+}
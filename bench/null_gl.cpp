@@ -0,0 +1,160 @@
+//
+// Created by 46769 on 2021-02-15.
+//
+
+#include "null_gl.hpp"
+#include <algorithm>
+#include <cstring>
+#include <glad/glad.h>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace null_gl {
+
+static Counters counters{};
+static GLuint next_name = 1;
+/// Contents of every buffer, and which buffer is bound to which target
+static std::unordered_map<GLuint, std::vector<std::byte>> buffers{};
+static std::unordered_map<GLenum, GLuint> bound{};
+
+static std::vector<std::byte> &bound_storage(GLenum target, std::size_t at_least) {
+    auto &storage = buffers[bound[target]];
+    if (storage.size() < at_least) storage.resize(at_least);
+    return storage;
+}
+
+static void generate(GLsizei n, GLuint *names) {
+    for (auto i = 0; i < n; i++) names[i] = next_name++;
+}
+
+static void write_success(GLuint, GLenum pname, GLint *params) {
+    // compile & link status are true, and there's never a log to read
+    *params = (pname == GL_COMPILE_STATUS || pname == GL_LINK_STATUS) ? GL_TRUE : 0;
+}
+
+/// Checks the stub against the type glad will call it through
+template<typename Proc, typename Fn>
+static void *proc(Fn fn) {
+    Proc typed = fn;
+    return reinterpret_cast<void *>(typed);
+}
+
+struct Entry {
+    std::string_view name;
+    void *proc;
+};
+
+// clang-format off
+static const Entry entries[]{
+    {"glGetString", proc<PFNGLGETSTRINGPROC>([](GLenum name) -> const GLubyte * {
+        return reinterpret_cast<const GLubyte *>(name == GL_VERSION ? "4.3.0 null" : "null"); })},
+    {"glGetStringi", proc<PFNGLGETSTRINGIPROC>([](GLenum, GLuint) -> const GLubyte * {
+        return reinterpret_cast<const GLubyte *>("GL_ARB_buffer_storage"); })},
+    {"glGetIntegerv", proc<PFNGLGETINTEGERVPROC>([](GLenum pname, GLint *data) {
+        *data = pname == GL_NUM_EXTENSIONS; })},
+
+    {"glGenBuffers", proc<PFNGLGENBUFFERSPROC>(generate)},
+    {"glGenVertexArrays", proc<PFNGLGENVERTEXARRAYSPROC>(generate)},
+    {"glGenTextures", proc<PFNGLGENTEXTURESPROC>(generate)},
+    {"glDeleteBuffers", proc<PFNGLDELETEBUFFERSPROC>([](GLsizei n, const GLuint *names) {
+        for (auto i = 0; i < n; i++) buffers.erase(names[i]); })},
+    {"glDeleteVertexArrays", proc<PFNGLDELETEVERTEXARRAYSPROC>([](GLsizei, const GLuint *) {})},
+    {"glBindBuffer", proc<PFNGLBINDBUFFERPROC>([](GLenum target, GLuint buffer) { bound[target] = buffer; })},
+    {"glBindBufferBase", proc<PFNGLBINDBUFFERBASEPROC>([](GLenum target, GLuint, GLuint buffer) {
+        bound[target] = buffer; })},
+    {"glBindVertexArray", proc<PFNGLBINDVERTEXARRAYPROC>([](GLuint) {})},
+    {"glBufferData", proc<PFNGLBUFFERDATAPROC>([](GLenum target, GLsizeiptr size, const void *data, GLenum) {
+        auto &storage = bound_storage(target, 0);
+        storage.assign(static_cast<std::size_t>(size), std::byte{0});
+        if (data != nullptr) {
+            std::memcpy(storage.data(), data, storage.size());
+            counters.bytes_uploaded += storage.size();
+        } })},
+    {"glBufferSubData", proc<PFNGLBUFFERSUBDATAPROC>([](GLenum target, GLintptr offset, GLsizeiptr size,
+                                                       const void *data) {
+        auto &storage = bound_storage(target, static_cast<std::size_t>(offset + size));
+        std::memcpy(storage.data() + offset, data, static_cast<std::size_t>(size));
+        counters.bytes_uploaded += static_cast<std::size_t>(size); })},
+    {"glMapBufferRange", proc<PFNGLMAPBUFFERRANGEPROC>([](GLenum target, GLintptr offset, GLsizeiptr length,
+                                                         GLbitfield) -> void * {
+        // whatever is mapped for writing is taken to be written
+        counters.bytes_uploaded += static_cast<std::size_t>(length);
+        return bound_storage(target, static_cast<std::size_t>(offset + length)).data() + offset; })},
+    {"glUnmapBuffer", proc<PFNGLUNMAPBUFFERPROC>([](GLenum) -> GLboolean { return GL_TRUE; })},
+    {"glGetBufferParameteriv", proc<PFNGLGETBUFFERPARAMETERIVPROC>([](GLenum target, GLenum, GLint *params) {
+        *params = static_cast<GLint>(bound_storage(target, 0).size()); })},
+    {"glVertexAttribPointer", proc<PFNGLVERTEXATTRIBPOINTERPROC>([](GLuint, GLint, GLenum, GLboolean, GLsizei,
+                                                                   const void *) {})},
+    {"glVertexAttribIPointer", proc<PFNGLVERTEXATTRIBIPOINTERPROC>([](GLuint, GLint, GLenum, GLsizei,
+                                                                     const void *) {})},
+    {"glVertexAttribDivisor", proc<PFNGLVERTEXATTRIBDIVISORPROC>([](GLuint, GLuint) {})},
+    {"glEnableVertexAttribArray", proc<PFNGLENABLEVERTEXATTRIBARRAYPROC>([](GLuint) {})},
+
+    {"glFenceSync", proc<PFNGLFENCESYNCPROC>([](GLenum, GLbitfield) { return reinterpret_cast<GLsync>(1); })},
+    {"glClientWaitSync", proc<PFNGLCLIENTWAITSYNCPROC>([](GLsync, GLbitfield, GLuint64) -> GLenum {
+        return GL_ALREADY_SIGNALED; })},
+    {"glDeleteSync", proc<PFNGLDELETESYNCPROC>([](GLsync) {})},
+
+    {"glCreateShader", proc<PFNGLCREATESHADERPROC>([](GLenum) { return next_name++; })},
+    {"glCreateProgram", proc<PFNGLCREATEPROGRAMPROC>([]() { return next_name++; })},
+    {"glShaderSource", proc<PFNGLSHADERSOURCEPROC>([](GLuint, GLsizei, const GLchar *const *, const GLint *) {})},
+    {"glCompileShader", proc<PFNGLCOMPILESHADERPROC>([](GLuint) {})},
+    {"glAttachShader", proc<PFNGLATTACHSHADERPROC>([](GLuint, GLuint) {})},
+    {"glLinkProgram", proc<PFNGLLINKPROGRAMPROC>([](GLuint) {})},
+    {"glDeleteShader", proc<PFNGLDELETESHADERPROC>([](GLuint) {})},
+    {"glUseProgram", proc<PFNGLUSEPROGRAMPROC>([](GLuint) {})},
+    {"glGetShaderiv", proc<PFNGLGETSHADERIVPROC>(write_success)},
+    {"glGetProgramiv", proc<PFNGLGETPROGRAMIVPROC>(write_success)},
+    {"glGetShaderInfoLog", proc<PFNGLGETSHADERINFOLOGPROC>([](GLuint, GLsizei, GLsizei *length, GLchar *log) {
+        if (length != nullptr) *length = 0;
+        if (log != nullptr) *log = '\0'; })},
+    {"glGetProgramInfoLog", proc<PFNGLGETPROGRAMINFOLOGPROC>([](GLuint, GLsizei, GLsizei *length, GLchar *log) {
+        if (length != nullptr) *length = 0;
+        if (log != nullptr) *log = '\0'; })},
+    {"glGetUniformLocation", proc<PFNGLGETUNIFORMLOCATIONPROC>([](GLuint, const GLchar *) { return GLint{0}; })},
+    {"glUniform1i", proc<PFNGLUNIFORM1IPROC>([](GLint, GLint) {})},
+    {"glUniform1f", proc<PFNGLUNIFORM1FPROC>([](GLint, GLfloat) {})},
+    {"glUniform2f", proc<PFNGLUNIFORM2FPROC>([](GLint, GLfloat, GLfloat) {})},
+    {"glUniform3f", proc<PFNGLUNIFORM3FPROC>([](GLint, GLfloat, GLfloat, GLfloat) {})},
+    {"glUniform4f", proc<PFNGLUNIFORM4FPROC>([](GLint, GLfloat, GLfloat, GLfloat, GLfloat) {})},
+    {"glUniform2fv", proc<PFNGLUNIFORM2FVPROC>([](GLint, GLsizei, const GLfloat *) {})},
+    {"glUniform3fv", proc<PFNGLUNIFORM3FVPROC>([](GLint, GLsizei, const GLfloat *) {})},
+    {"glUniform4fv", proc<PFNGLUNIFORM4FVPROC>([](GLint, GLsizei, const GLfloat *) {})},
+    {"glUniformMatrix4fv", proc<PFNGLUNIFORMMATRIX4FVPROC>([](GLint, GLsizei, GLboolean, const GLfloat *) {})},
+
+    {"glBindTexture", proc<PFNGLBINDTEXTUREPROC>([](GLenum, GLuint) {})},
+    {"glTexImage2D", proc<PFNGLTEXIMAGE2DPROC>([](GLenum, GLint, GLint, GLsizei w, GLsizei h, GLint, GLenum, GLenum,
+                                                 const void *) {
+        counters.bytes_uploaded += static_cast<std::size_t>(w) * static_cast<std::size_t>(h); })},
+    {"glTexParameteri", proc<PFNGLTEXPARAMETERIPROC>([](GLenum, GLenum, GLint) {})},
+    {"glPixelStorei", proc<PFNGLPIXELSTOREIPROC>([](GLenum, GLint) {})},
+    {"glGenerateMipmap", proc<PFNGLGENERATEMIPMAPPROC>([](GLenum) {})},
+
+    {"glEnable", proc<PFNGLENABLEPROC>([](GLenum) {})},
+    {"glDisable", proc<PFNGLDISABLEPROC>([](GLenum) {})},
+    {"glBlendFunc", proc<PFNGLBLENDFUNCPROC>([](GLenum, GLenum) {})},
+    {"glScissor", proc<PFNGLSCISSORPROC>([](GLint, GLint, GLsizei, GLsizei) {})},
+    {"glViewport", proc<PFNGLVIEWPORTPROC>([](GLint, GLint, GLsizei, GLsizei) {})},
+    {"glClearColor", proc<PFNGLCLEARCOLORPROC>([](GLfloat, GLfloat, GLfloat, GLfloat) {})},
+    {"glClear", proc<PFNGLCLEARPROC>([](GLbitfield) {})},
+    {"glDrawArrays", proc<PFNGLDRAWARRAYSPROC>([](GLenum, GLint, GLsizei) { counters.draw_calls++; })},
+    {"glDrawArraysInstancedBaseInstance",
+     proc<PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC>([](GLenum, GLint, GLsizei, GLsizei instances, GLuint) {
+        counters.draw_calls++;
+        counters.instances_drawn += static_cast<std::size_t>(instances); })},
+};
+// clang-format on
+
+/// What the renderer doesn't call, is left unloaded, and calling it crashes, which is how to find what's missing above
+static void *load(const char *name) {
+    auto entry = std::find_if(std::begin(entries), std::end(entries), [name](auto &e) { return e.name == name; });
+    return entry != std::end(entries) ? entry->proc : nullptr;
+}
+
+void install() { gladLoadGLLoader(load); }
+
+Counters take_counters() { return std::exchange(counters, Counters{}); }
+
+}// namespace null_gl
@@ -0,0 +1,29 @@
+//
+// Created by 46769 on 2021-02-15.
+//
+
+#pragma once
+#include <cstddef>
+
+/**
+ * A GL driver that draws nothing, so that benchmarks can run the render path without a display or a GPU. install()
+ * loads glad with it, instead of with the driver of a window's context.
+ *
+ * Buffers live in host memory, so what the renderer uploads, or writes through a mapping, has somewhere to go; and
+ * every byte of it is counted, as is every draw. Shaders always compile, and everything else does nothing.
+ *
+ * There's no glfw context, so glfwExtensionSupported says no to ARB_buffer_storage, and GlyphVAO streams through
+ * glMapBufferRange instead of its persistent mapping.
+ */
+namespace null_gl {
+struct Counters {
+    std::size_t bytes_uploaded{0};
+    std::size_t draw_calls{0};
+    std::size_t instances_drawn{0};
+};
+
+/// Points glad at the null driver. Call it where gladLoadGLLoader would be called
+void install();
+/// What was uploaded & drawn since the last call
+Counters take_counters();
+}// namespace null_gl
@@ -0,0 +1,181 @@
+//
+// Created by 46769 on 2021-02-15.
+//
+
+// Latency of the text pipeline, per stage, without a display: scripts of cursor moves & edits run against buffers of a
+// few sizes, and after every step a frame is drawn the way App draws one, through the null GL driver in null_gl.hpp.
+//  usage: render_bench [steps per script = 400] [file...]
+// Without files, generated headers of 64KB, 1MB & 16MB are used. Run it from a folder with the assets in it (bin/run),
+// for the font & the shaders. The stages are
+//  - edit:      the step of the script, on the buffer
+//  - frame:     View::draw, which builds the displayed lines (create_vertex_data_for_syntax) & streams them out
+//  - tokenize:  color_format_tokenize of the displayed lines; what the frame used to cost, when it lexed on this thread
+//  - highlight: from the end of the frame, until the highlighter has published colors for this version of the buffer
+//  - recolor:   the frame that draws those colors
+
+#include "bench_util.hpp"
+#include "null_gl.hpp"
+#include <condition_variable>
+#include <core/buffer/gap_buffer.hpp>
+#include <core/buffer/std_string_buffer.hpp>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <ui/highlight_worker.hpp>
+#include <ui/managers/font_library.hpp>
+#include <ui/managers/shader_library.hpp>
+#include <ui/syntax_highlighting.hpp>
+#include <ui/view.hpp>
+
+constexpr auto VIEW_WIDTH = 1280;
+constexpr auto VIEW_HEIGHT = 1000;
+
+struct Corpus {
+    std::string name;
+    std::string text;
+};
+
+struct Backend {
+    std::string_view name;
+    std::function<std::unique_ptr<TextData>()> make;
+};
+
+struct Script {
+    std::string_view name;
+    /// Where the cursor is put before the first step
+    double start_at;
+    std::function<void(TextData *, std::mt19937 &, int)> step;
+};
+
+static std::mutex published_mutex{};
+static std::condition_variable published{};
+
+static void load_resources() {
+    FontLibrary::get_instance().load_font(
+            FontConfig{.name = "SourceCodePro", .path = "assets/fonts/SourceCodePro-Regular.ttf", .pixel_size = 20},
+            true);
+    ShaderLibrary::get_instance().load_shader(ShaderConfig{
+            .name = "text", .vs_path = "assets/shaders/textshader.vs", .fs_path = "assets/shaders/textshader.fs"});
+    ShaderLibrary::get_instance().load_shader(ShaderConfig{.name = "instanced_text",
+                                                           .vs_path = "assets/shaders/instanced_textshader.vs",
+                                                           .fs_path = "assets/shaders/textshader.fs"});
+    ShaderLibrary::get_instance().load_shader(ShaderConfig{
+            .name = "cursor", .vs_path = "assets/shaders/cursor.vs", .fs_path = "assets/shaders/cursor.fs"});
+}
+
+/// Scrolls like App does, when the cursor leaves the screen
+static void keep_cursor_visible(ui::View *view) {
+    const auto line = AS(view->get_text_buffer()->cursor.line, int);
+    const auto top = view->cursor->views_top_line;
+    if (line < top) {
+        view->scroll_to(line);
+    } else if (line >= top + view->lines_displayable) {
+        view->scroll_to(line - view->lines_displayable + 1);
+    }
+}
+
+static std::string_view displayed_text(ui::View *view) {
+    auto buf = view->get_text_buffer();
+    const auto top = view->cursor->views_top_line;
+    const auto begin = buf->meta_data.line_begin(top);
+    return buf->view_range(begin, buf->meta_data.line_begin(top + view->lines_displayable + 1) - begin);
+}
+
+static void wait_for_highlight(ui::View *view) {
+    auto &highlighter = HighlightWorker::get_instance();
+    const auto version = view->get_text_buffer()->version();
+    auto highlighted = [&]() {
+        auto snapshot = highlighter.latest(view);
+        return snapshot && snapshot->version == version;
+    };
+    std::unique_lock lock{published_mutex};
+    // the worker notifies without the lock, so a wake up may be missed; hence the short timeout
+    while (not highlighted()) published.wait_for(lock, std::chrono::milliseconds{1});
+}
+
+static void run(const Corpus &corpus, const Backend &backend, const Script &script, int steps) {
+    // the view deletes a buffer that the DataManager doesn't manage, when it's destroyed
+    auto buffer = backend.make().release();
+    buffer->has_meta_data = true;
+    buffer->info = BufferTypeInfo::EditBuffer;
+    // the extension is what makes the view highlight it as C++
+    buffer->set_file("corpus.cpp");
+    // the view is made before the text is loaded, as App makes it: it sizes its vertex buffer by the text otherwise
+    auto view = ui::View::create_managed(buffer, "bench", VIEW_WIDTH, VIEW_HEIGHT, 0, VIEW_HEIGHT);
+    // loaded the way FileLoader loads a file, which is not an edit to undo
+    const std::array parts{std::string_view{corpus.text}};
+    buffer->append_loaded(corpus.text, LineIndex::line_lengths(parts));
+    buffer->step_cursor_to(AS(AS(buffer->size(), double) * script.start_at, std::size_t));
+    keep_cursor_visible(view.get());
+    view->draw(true);
+    wait_for_highlight(view.get());
+    null_gl::take_counters();
+
+    Samples edit{"edit"}, frame{"frame"}, tokenize{"tokenize"}, highlight{"highlight"}, recolor{"recolor"};
+    std::mt19937 rng{7};
+    for (auto i = 0; i < steps; i++) {
+        edit.time([&]() { script.step(buffer, rng, i); });
+        keep_cursor_visible(view.get());
+        frame.time([&]() { view->draw(true); });
+        tokenize.time([&]() { color_format_tokenize(displayed_text(view.get())); });
+        highlight.time([&]() { wait_for_highlight(view.get()); });
+        recolor.time([&]() { view->draw(true); });
+    }
+    const auto counters = null_gl::take_counters();
+
+    fmt::print("  {} / {} / {}: {} steps, {:.1f}KB uploaded & {:.0f} glyphs drawn per frame\n", corpus.name,
+               backend.name, script.name, steps, AS(counters.bytes_uploaded, double) / (2.0 * steps * 1024.0),
+               AS(counters.instances_drawn, double) / (2.0 * steps));
+    Samples::print_header();
+    for (const auto *stage : {&edit, &frame, &tokenize, &highlight, &recolor}) stage->print();
+}
+
+int main(int argc, const char **argv) {
+    const auto steps = argc > 1 ? std::stoi(argv[1]) : 400;
+    std::vector<Corpus> corpora{};
+    for (auto i = 2; i < argc; i++) {
+        std::ifstream f{argv[i]};
+        std::stringstream contents;
+        contents << f.rdbuf();
+        corpora.push_back(Corpus{argv[i], contents.str()});
+    }
+    if (corpora.empty()) {
+        for (auto kb : {64ul, 1024ul, 16 * 1024ul}) {
+            corpora.push_back(Corpus{fmt::format("generated {}KB", kb), make_header_text(kb * 1024)});
+        }
+    }
+
+    null_gl::install();
+    load_resources();
+    HighlightWorker::get_instance().start([]() { published.notify_all(); });
+
+    const std::array backends{
+            Backend{"GapBuffer", []() { return GapBuffer::make_handle(); }},
+            Backend{"StdStringBuffer", []() { return StdStringBuffer::make_handle(); }},
+    };
+    const std::array scripts{
+            Script{"scroll", 0.0,
+                   [](TextData *buf, std::mt19937 &, int) {
+                       if (buf->cursor.line + 1 >= AS(buf->meta_data.line_count(), int)) buf->step_cursor_to(0);
+                       buf->move_cursor(Movement::Line(1, CursorDirection::Forward));
+                   }},
+            Script{"jump", 0.0,
+                   [](TextData *buf, std::mt19937 &rng, int) { buf->step_cursor_to(rng() % (buf->size() + 1)); }},
+            Script{"type", 0.5,
+                   [](TextData *buf, std::mt19937 &, int i) {
+                       constexpr std::string_view typed = "    auto value = compute(first, \"second\"); // third\n";
+                       buf->insert(typed[AS(i, std::size_t) % typed.size()]);
+                   }},
+            Script{"delete", 0.5,
+                   [](TextData *buf, std::mt19937 &, int) { buf->remove(Movement::Char(1, CursorDirection::Back)); }},
+    };
+    for (const auto &corpus : corpora) {
+        fmt::print("{}: {:.1f}KB\n", corpus.name, AS(corpus.text.size(), double) / 1024.0);
+        for (const auto &backend : backends) {
+            for (const auto &script : scripts) run(corpus, backend, script, steps);
+        }
+    }
+    HighlightWorker::get_instance().stop();
+}
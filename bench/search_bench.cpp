@@ -0,0 +1,102 @@
+//
+// Created by 46769 on 2021-02-17.
+//
+
+// Micro benchmark of search: str::find_literal with every kernel the CPU supports, against std::string_view::find,
+// and the lazy DFA of Regex, on text with the needle at the very end, so that all of it is searched; unless the needle
+// given is something the text has in it.
+//  usage: search_bench [size in MB = 256] [iterations = 10] [needle = SearchBenchNeedle]
+
+#include <algorithm>
+#include <chrono>
+#include <core/search/regex.hpp>
+#include <core/strops.hpp>
+#include <fmt/core.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+/// Something that looks like source code, words & punctuation, lines of up to 100 characters
+static std::string make_source_text(std::size_t size) {
+    std::mt19937 rng{1337};
+    const std::vector<std::string> words{"int", "return", "auto", "const", "std::size_t", "if", "for", "(", ")", "{",
+                                         "}", ";", "=", "+", "value", "index", "buffer", "view", "->", "::"};
+    std::uniform_int_distribution<std::size_t> word{0, words.size() - 1};
+    std::uniform_int_distribution<int> line_length{0, 100};
+    std::string text;
+    text.reserve(size);
+    while (text.size() < size) {
+        auto len = static_cast<std::size_t>(line_length(rng));
+        for (auto begin = text.size(); text.size() - begin < len && text.size() < size;) {
+            text += words[word(rng)];
+            text.push_back(' ');
+        }
+        text.push_back('\n');
+    }
+    text.resize(size);
+    return text;
+}
+
+template<typename Fn>
+static void bench(const std::string &name, const std::string &text, int iterations, Fn fn) {
+    std::vector<double> times{};
+    std::size_t found = 0;
+    for (auto i = 0; i < iterations; ++i) {
+        auto begin = BenchClock::now();
+        found = fn();
+        auto end = BenchClock::now();
+        times.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+    }
+    std::sort(times.begin(), times.end());
+    auto median = times[times.size() / 2];
+    auto gb_per_s = (static_cast<double>(text.size()) / 1e9) / (times.front() / 1e3);
+    fmt::print("{:<36} at: {:>10}  best: {:>8.2f}ms  median: {:>8.2f}ms  {:>6.2f} GB/s\n", name, found,
+               times.front(), median, gb_per_s);
+}
+
+int main(int argc, const char **argv) {
+    auto megabytes = argc > 1 ? std::stoul(argv[1]) : 256ul;
+    auto iterations = argc > 2 ? std::stoi(argv[2]) : 10;
+    auto text = make_source_text(megabytes * 1024 * 1024);
+    const std::string needle = argc > 3 ? argv[3] : "SearchBenchNeedle";
+    text += needle;
+    auto detected = str::detected_simd_level();
+    fmt::print("{}MB of text, {} iterations. Detected: {}\n", megabytes, iterations, str::simd_level_name(detected));
+
+    bench("std::string_view::find", text, iterations, [&]() { return std::string_view{text}.find(needle); });
+
+    std::vector<str::SimdLevel> levels{str::SimdLevel::Scalar};
+    if (detected == str::SimdLevel::SSE2 || detected == str::SimdLevel::AVX2) levels.push_back(str::SimdLevel::SSE2);
+    if (detected == str::SimdLevel::AVX2) levels.push_back(str::SimdLevel::AVX2);
+    for (auto ignore_case : {false, true}) {
+        bench(fmt::format("find_literal{}", ignore_case ? " ignore case" : ""), text, iterations, [&]() {
+            return str::find_literal(text.data(), text.size(), needle, ignore_case);
+        });
+        for (auto level : levels) {
+            auto name = fmt::format("find_literal {}{}", str::simd_level_name(level), ignore_case ? " ignore case" : "");
+            bench(name, text, iterations, [&]() {
+                return str::find_literal(level, text.data(), text.size(), needle, ignore_case);
+            });
+        }
+    }
+    bench("rfind_literal", text, iterations, [&]() {
+        // from the end of what comes before the needle, so that it too searches all of the text
+        return str::rfind_literal(text.data(), text.size() - 1, needle, false);
+    });
+
+    Haystack haystack{{std::string_view{text}}};
+    for (auto pattern : {"SearchBench\\w+", "(Search|Find)[A-Z][a-z]+Needle", "^[A-Z]\\w*Needle$"}) {
+        std::string error{};
+        auto regex = Regex::create(pattern, false, error);
+        if (not regex) {
+            fmt::print("{}: {}\n", pattern, error);
+            continue;
+        }
+        bench(fmt::format("regex {}", pattern), text, iterations, [&]() {
+            auto match = regex->find(haystack, 0, haystack.size());
+            return match ? match->begin : haystack.size();
+        });
+    }
+}
@@ -4,14 +4,21 @@
 #define WIN32_LEAN_AND_MEAN
 
 #include "app.hpp"
+#include <algorithm>
 #include <core/buffer/data_manager.hpp>
 #include <ranges>
 #include <ui/core/opengl.hpp>
 #include <ui/editor_window.hpp>
+#include <ui/grammar.hpp>
+#include <ui/highlight_worker.hpp>
+#include <ui/profiler_overlay.hpp>
 #include <ui/status_bar.hpp>
 #include <ui/view.hpp>
 #include <utility>
 #include <utils/fileutil.hpp>
+#include <utils/job_system.hpp>
+#include <utils/mapped_file.hpp>
+#include <utils/profiler.hpp>
 
 /// Utility macro for getting registered App pointer with GLFW
 #define get_app_handle(window) (App *) glfwGetWindowUserPointer(window)
@@ -35,6 +42,7 @@ static constexpr auto has_mods = [](auto mod) -> bool { return mod != 0; };
 
 static auto text_input_callback(GLFWwindow *window, unsigned int codepoint) {
     auto app = get_app_handle(window);
+    app->damage_input_areas();
     // This callback already handles "repeat" functionality, via GLFW (i suppose, since it works out of the box)
     app->handle_text_input(codepoint);
 };
@@ -44,6 +52,7 @@ static auto key_callbacks(GLFWwindow *window, int key, int scancode, int action,
     const auto input = KeyInput{key, mods};
 
     if (pressed(action) || repeated(action)) {// we _only_ want commands, or combos, to work when pressed, not when released or repeated
+        app->damage_input_areas();
         app->handle_key_input(input, action);
     }
 };
@@ -69,11 +78,16 @@ static void initialize_static_resources() {
     ShaderConfig text_shader{.name = "text",
                              .vs_path = "assets/shaders/textshader.vs",
                              .fs_path = "assets/shaders/textshader.fs"};
+    // same fragment shader, the vertex shader expands one glyph instance into a quad
+    ShaderConfig instanced_text_shader{.name = "instanced_text",
+                                       .vs_path = "assets/shaders/instanced_textshader.vs",
+                                       .fs_path = "assets/shaders/textshader.fs"};
     ShaderConfig cursor_shader{.name = "cursor",
                                .vs_path = "assets/shaders/cursor.vs",
                                .fs_path = "assets/shaders/cursor.fs"};
 
     ShaderLibrary::get_instance().load_shader(text_shader);
+    ShaderLibrary::get_instance().load_shader(instanced_text_shader);
     ShaderLibrary::get_instance().load_shader(cursor_shader);
 }
 
@@ -196,7 +210,14 @@ App *App::initialize(int app_width, int app_height, const std::string &title) {
         PANIC("Failed to create GLFW Window");
     }
 
+    prof::Profiler::get_instance().set_thread_name("main");
     initialize_static_resources();
+    // compiles the grammars now, instead of when the first file that needs one is opened
+    GrammarRegistry::get_instance();
+    // wakes the main loop up, like the file loaders do, so that new colors are drawn without waiting for input
+    HighlightWorker::get_instance().start([]() { glfwPostEmptyEvent(); });
+    // & so do jobs that finish with something for the main loop to do
+    JobSystem::get_instance().start([]() { glfwPostEmptyEvent(); });
 
     auto text_row_advance = FontLibrary::get_default_font()->get_row_advance() + 2;
     auto cv = CommandView::create("command", app_width, text_row_advance * 1, 0, text_row_advance * 1);
@@ -207,6 +228,7 @@ App *App::initialize(int app_width, int app_height, const std::string &title) {
 
     // TODO: remove these, these are just for simplicity when testing UI
     instance->new_editor_window();
+    instance->recover_journals();
     // instance->load_file("main.cpp");
     glfwSetWindowUserPointer(window, instance);
     auto &ci = CommandInterpreter::get_instance();
@@ -220,6 +242,7 @@ App *App::initialize(int app_width, int app_height, const std::string &title) {
         glfwGetCursorPos(window, &xpos, &ypos);
         auto &[w, h] = App::win_dimensions;
 
+        app->damage_input_areas();
         auto translate_y = h - (int) ypos;
         auto layout = find_within_leaf_node(app->root_layout, int(xpos), translate_y);
         if (layout) {
@@ -264,57 +287,186 @@ void App::set_dimensions(int w, int h) {
     util::println("New dimension set to {} x {}", w, h);
 }
 void App::run_loop() {
-    double nowTime = glfwGetTime();
-    Timer t{"run_loop"};
-    auto since_last_update = glfwGetTime();
+    auto &profiler = prof::Profiler::get_instance();
     while (this->no_close_condition()) {
-        // TODO: do stuff.
-        nowTime = glfwGetTime();
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        draw_all();
-        glfwWaitEventsTimeout(1);
-        if ((nowTime - since_last_update) >= 2) {
-            since_last_update = nowTime;
-            active_window->get_text_buffer()->rebuild_metadata();
+        // a frame is from here to the swap, the time spent waiting for input after it, is not the frame's
+        const auto frame_begin = prof::Profiler::now_ns();
+        auto drawn = false;
+        {
+            MICRO_BENCH("App::frame");
+            {
+                MICRO_BENCH("App::poll_loaders");
+                poll_loaders();
+                poll_savers();
+                journal_edits();
+            }
+            JobSystem::get_instance().run_completions();
+            drawn = draw_all();
         }
+        if (drawn && profiler.is_enabled()) profiler.end_frame(frame_begin, prof::Profiler::now_ns());
+        // nothing on screen changes by itself; input, the jobs & the highlighter all wake us up when it does
+        glfwWaitEvents();
+    }
+    HighlightWorker::get_instance().stop();
+    // cancels the jobs of the loaders, which the workers would otherwise see through to the end of the file, but the
+    // saves are seen through, or the user's edits are lost
+    loaders.clear();
+    for (const auto &saver : savers) saver->wait();
+    // reports the saves that failed, & rebases the journals of those that didn't
+    poll_savers();
+    savers.clear();
+    journal_edits();
+    // what wasn't saved is recovered the next time the editor starts, the journals of everything else are deleted
+    for (auto &[id, journal] : journals) {
+        auto buf = DataManager::get_instance().get_by_id(id);
+        if (buf != nullptr && buf->has_unsaved_changes()) journal->keep();
     }
+    journals.clear();
+    JobSystem::get_instance().stop();
 }
 bool App::no_close_condition() { return (!glfwWindowShouldClose(window) && !exit_command_requested); }
 void App::load_file(const fs::path &file) {
     if (!fs::exists(file)) { PANIC("File {} doesn't exist. Forced exit.", file.string()); }
-    if (active_window->view->get_text_buffer()->empty()) {
-        std::string tmp;
-        std::ifstream f{file};
-        tmp.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
-        active_window->get_text_buffer()->load_string(std::move(tmp));
-        active_window->get_text_buffer()->set_file(file);
-        active_window->get_text_buffer()->set_name(file.filename().string());
-        active_window->view->name = file.filename().string();
-        assert(!active_buffer->empty());
-    } else {
-        new_editor_window(SplitStrategy::VerticalSplit);
-        std::string tmp;
-        std::ifstream f{file};
-        tmp.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
-        active_window->get_text_buffer()->set_string(tmp);
-        active_window->get_text_buffer()->load_string(std::move(tmp));
-        active_window->get_text_buffer()->set_file(file);
-        active_window->view->name = file.filename().string();
+    if (not active_window->view->get_text_buffer()->empty()) { new_editor_window(SplitStrategy::VerticalSplit); }
+    std::shared_ptr<MappedFile> mapping = nullptr;
+    if (fs::file_size(file) >= MappedFile::LOAD_THRESHOLD) mapping = MappedFile::open(file);
+    if (mapping) {
+        auto previous = active_window->get_text_buffer();
+        active_buffer = DataManager::get_instance().create_mapped_buffer(mapping);
+        active_window->set_text_buffer(active_buffer);
+        DataManager::get_instance().request_close(previous->id);
+    }
+    auto buf = active_window->get_text_buffer();
+    buf->set_file(file);
+    buf->meta_data.load_progress = 0.0f;
+    active_window->view->name = file.filename().string();
+    // reading & indexing happens on the loader's job, the buffer is filled in as chunks arrive, in poll_loaders
+    loaders.push_back(FileLoader::start(buf->id, file, std::move(mapping), []() { glfwPostEmptyEvent(); }));
+}
+
+void App::poll_loaders() {
+    std::erase_if(loaders, [this](auto &loader) {
+        auto buf = DataManager::get_instance().get_by_id(loader->buffer_id());
+        // the buffer was closed, or re-used for something else, before the file finished loading
+        if (buf == nullptr || buf->file_path != loader->path()) return true;
+        if (not loader->poll(buf)) return false;
+        begin_journal(buf, loader->size());
+        return true;
+    });
+}
+
+void App::begin_journal(TextData *buffer, std::size_t base_size) {
+    buffer->take_changed_range(ChangeListener::Journal);
+    auto &journal = journals[buffer->id];
+    journal = std::make_unique<RecoveryJournal>(buffer->file_path, base_size);
+    // edited while it was loading, or recovered; the file doesn't have what the buffer has, so the journal begins with it
+    if (buffer->has_unsaved_changes()) journal->record(0, base_size, buffer->chunks(0, buffer->size()));
+}
+
+void App::journal_edits() {
+    std::erase_if(journals, [](auto &entry) {
+        auto &[id, journal] = entry;
+        auto buf = DataManager::get_instance().get_by_id(id);
+        // closed, or re-used for another file, which gets a journal of its own once it's loaded
+        if (buf == nullptr || buf->file_path != journal->file()) return true;
+        auto changed = buf->take_changed_range(ChangeListener::Journal);
+        if (not changed) return false;
+        auto [begin, end] = *changed;
+        if (end == std::string::npos) {
+            journal->record(0, journal->text_size(), buf->chunks(0, buf->size()));
+        } else {
+            // [begin, end) is what the text has there now, & [begin, old_end) what it had after the last record
+            const auto old_end = journal->text_size() - (buf->size() - end);
+            journal->record(begin, old_end - begin, buf->chunks(begin, end));
+        }
+        return false;
+    });
+}
+
+void App::recover_journals() {
+    std::error_code ec{};
+    // listed first, as the journals of what's recovered are written to the same directory
+    std::vector<fs::path> found{};
+    for (const auto &entry : fs::directory_iterator{RecoveryJournal::directory(), ec}) {
+        if (entry.path().extension() == ".cxjournal") found.push_back(entry.path());
+    }
+    for (const auto &path : found) {
+        auto recovered = RecoveryJournal::recover(path);
+        if (not recovered) {
+            // the file changed since, or the journal is broken; kept, for digging the edits out by hand, but only once
+            fs::rename(path, fs::path{path}.replace_extension(".stale"), ec);
+            command_view->draw_error_message(fmt::format("Could not recover the unsaved changes in {}", path.string()));
+            continue;
+        }
+        if (not active_window->view->get_text_buffer()->empty()) { new_editor_window(SplitStrategy::VerticalSplit); }
+        auto buf = active_window->get_text_buffer();
+        buf->set_file(recovered->file);
+        active_window->view->name = recovered->file.filename().string();
+        const auto &text = recovered->text;
+        for (auto chunk : text.chunks(0, text.size())) {
+            buf->append_loaded(chunk, LineIndex::line_lengths(std::span<const std::string_view>{&chunk, 1}));
+        }
+        // the buffer has unsaved changes now, those that were recovered
+        begin_journal(buf, recovered->base_size);
+        command_view->draw_message(fmt::format("Recovered {} unsaved edits to {}", recovered->edits,
+                                               recovered->file.string()));
     }
 }
 /**
  * If the application window changes dimensions, the alignment, the text placement, everything might get out of sync,
  * and to ameliorate that, one can call draw_all(true), thus forcing a recalculation of the projection matrix,
  * and upload new adjusted vertex data to the GPU, displaying the views & window correctly.
+ *
+ * Otherwise, only what is damaged is drawn, each view clearing its own part of the window, and when nothing is, there's
+ * no swap either, see SWAP_CHAIN_BUFFERS.
  * @param force_redraw
+ * @return whether anything was drawn
  */
-void App::draw_all(bool force_redraw) {
+bool App::draw_all(bool force_redraw) {
+    if (force_redraw) damage_all();
+    if (modal_shown != modal_was_drawn) {
+        // what the popup covered, has to be drawn again when it closes
+        if (modal_was_drawn) damage_all();
+        modal_redraws_pending = ui::SWAP_CHAIN_BUFFERS;
+        modal_was_drawn = modal_shown;
+    }
+    const auto damaged = window_clears_pending > 0 || command_view->is_damaged() ||
+                         (modal_shown && modal_redraws_pending > 0) ||
+                         std::ranges::any_of(editor_views, [](auto ew) { return ew->is_damaged(); });
+    if (not damaged) return false;
+
+    if (window_clears_pending > 0) {
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        --window_clears_pending;
+    }
     for (auto &ew : editor_views) ew->draw(force_redraw);
-    this->command_view->draw();
-    if (modal_shown) modal_popup->draw();
+    if (command_view->is_damaged()) this->command_view->draw();
+    // the popup & the overlay are on top of the views, which may just have been drawn over them
+    if (modal_shown) {
+        modal_popup->draw();
+        modal_redraws_pending = std::max(modal_redraws_pending - 1, 0);
+    }
+    if (profiler_overlay) profiler_overlay->draw(win_width, win_height);
     glViewport(0, 0, this->win_width, this->win_height);
+    MICRO_BENCH("App::swap_buffers");
     glfwSwapBuffers(this->window);
+    return true;
+}
+
+void App::damage_all() {
+    window_clears_pending = ui::SWAP_CHAIN_BUFFERS;
+    for (auto ew : editor_views) {
+        ew->view->damage();
+        ew->status_bar->damage();
+    }
+    command_view->damage();
+    modal_redraws_pending = ui::SWAP_CHAIN_BUFFERS;
+}
+
+void App::damage_input_areas() {
+    command_view->damage();
+    if (modal_shown) modal_redraws_pending = ui::SWAP_CHAIN_BUFFERS;
 }
 void App::update_views_dimensions(float wRatio, float hRatio) {
     update_layout_tree(root_layout, wRatio, hRatio);
@@ -330,6 +482,28 @@ void App::update_views_dimensions(float wRatio, float hRatio) {
     command_view->command_view->set_dimensions(win_width, command_view->h);
     // command_view->command_view->set_projection(glm::ortho(0.0f, float(win_width), 0.0f, float(win_height)));
     command_view->command_view->set_projection(my_screen_projection_2D(win_width, win_height, this->scroll));
+    if (profiler_overlay) profiler_overlay->set_projection(mvp);
+    damage_all();
+}
+
+void App::toggle_profiler() {
+    auto &profiler = prof::Profiler::get_instance();
+    if (profiler_overlay) {
+        profiler_overlay.reset();
+        profiler.set_enabled(false);
+        damage_all();
+    } else {
+        profiler_overlay = ui::ProfilerOverlay::create(mvp);
+        profiler.set_enabled(true);
+    }
+}
+
+void App::write_trace(const fs::path &path) {
+    if (auto written = prof::Profiler::get_instance().write_chrome_trace(path); written) {
+        set_error_message(fmt::format("Wrote {} zones to {}", *written, path.string()));
+    } else {
+        set_error_message(fmt::format("Failed to write trace to {}", path.string()));
+    }
 }
 
 constexpr auto KEY_LEFT_ANGLE_BRACKET = 61;
@@ -379,6 +553,7 @@ void App::start_command_input(const std::string &prefix, Commands commandInput)
 }
 
 void App::disable_command_input() {
+    cancel_incremental_search();
     auto &ci = CommandInterpreter::get_instance();
     ci.clear_state();
     command_view->command_view->get_text_buffer()->clear();
@@ -394,6 +569,7 @@ void App::set_error_message(const std::string &msg) {
     command_view->command_view->get_text_buffer()->insert_str(msg);
     command_view->show_last_message = true;
     command_view->active = false;
+    command_view->damage();
 }
 
 void App::input_command_or_newline() {
@@ -441,8 +617,10 @@ void App::app_debug() {
     auto pos = active_buffer->get_cursor().pos;
     util::println("Current pos: {}: '{}'", active_buffer->get_cursor().pos, active_buffer->to_string_view()[pos]);
     util::println("Size {}", active_buffer->size());
-    util::println("Lines {}", active_buffer->meta_data.line_begins.size());
-    for (auto i : active_buffer->meta_data.line_begins) { fmt::print("{},", i); }
+    util::println("Lines {}", active_buffer->meta_data.line_count());
+    for (auto i = 0u; i < active_buffer->meta_data.line_count(); ++i) {
+        fmt::print("{},", active_buffer->meta_data.line_begin(i));
+    }
     util::println("\n---------------------------");
     util::println("----- View Debug Info -----");
     util::println("Views currently open: {}", editor_views.size());
@@ -511,6 +689,7 @@ void App::new_editor_window(SplitStrategy splitStrategy) {
         ew->active = true;
     }
     active_window = editor_views.back();
+    damage_all();
     util::println("Editor window created");
     layout_id++;
 }
@@ -537,8 +716,8 @@ ui::CommandView *App::get_command_view() const { return command_view.get(); }
 
 void App::editor_window_goto(int line) {
     auto &md = active_window->get_text_buffer()->meta_data;
-    if (md.line_begins.size() > line) {
-        active_window->get_text_buffer()->step_cursor_to(md.line_begins[line]);
+    if (AS(md.line_count(), i64) > line) {
+        active_window->get_text_buffer()->step_cursor_to(md.line_begin(line));
         active_window->view->scroll_to(line);
     } else {
         active_window->get_text_buffer()->step_cursor_to(active_window->get_text_buffer()->size());
@@ -556,26 +735,73 @@ void App::restore_input() {
 ui::EditorWindow *App::get_active_window() const { return active_window; }
 
 void App::fwrite_active_to_disk(const std::string &path) {
-    auto p = fs::path{path};
-    // this is just wrapped for now, since the if/else branch are identical
-    auto write_impl = [&](auto path) {
-        auto buf_view = active_window->get_text_buffer()->to_string_view();
-        auto bytes_written = sv_write_file(p, buf_view);
-        if (bytes_written) {// success
-            get_command_view()->draw_message(
-                    fmt::format("Wrote {} bytes to file: {}", bytes_written.value(), path.string()));
-            // TODO: this could be printed on the command view
-        } else {
-            util::println("Could not retrieve file size");
+    // possibly request a "y/N" from the user when the file exists, for now we just write to disk
+    save_buffer(active_window->get_text_buffer(), fs::path{path});
+}
+
+void App::write_all_files() {
+    for (auto buf : DataManager::get_instance().managed_buffers()) {
+        if (buf->info != BufferTypeInfo::EditBuffer || buf->file_path.empty() || not buf->has_unsaved_changes()) {
+            continue;
         }
-    };
+        // every save is a job of its own, so they're written in parallel
+        save_buffer(buf, buf->file_path);
+    }
+}
 
-    if (not fs::exists(p)) {
-        write_impl(p);
-    } else {
-        // possibly request a "y/N" from the user, for now we just write to disk
-        write_impl(p);
+void App::save_buffer(TextData *buffer, const fs::path &path) {
+    if (buffer->meta_data.load_progress) {
+        command_view->draw_error_message("Can't write a buffer that hasn't finished loading");
+        return;
+    }
+    if (std::ranges::any_of(savers, [id = buffer->id](const auto &saver) { return saver->buffer_id() == id; })) {
+        command_view->draw_error_message(fmt::format("{} is already being written", buffer->fileName()));
+        return;
     }
+#ifdef WIN32
+    if (path == buffer->file_path) buffer->release_file();
+#endif
+    buffer->meta_data.save_progress = 0.0f;
+    if (path == buffer->file_path) {
+        // the journal is of the text as it is now, & tracks what's edited while it's written, for poll_savers
+        journal_edits();
+        if (auto journal = journals.find(buffer->id); journal != journals.end()) journal->second->mark();
+    }
+    // the buffer can be edited while it's being written; what's written is the text as it is now
+    savers.push_back(FileSaver::start(buffer->snapshot(), path, []() { glfwPostEmptyEvent(); }));
+}
+
+void App::poll_savers() {
+    std::erase_if(savers, [this](auto &saver) {
+        auto buf = DataManager::get_instance().get_by_id(saver->buffer_id());
+        auto result = saver->poll(buf);
+        if (not result) return false;
+        if (result->error) {
+            command_view->draw_error_message(
+                    fmt::format("Could not write {}: {}", saver->path().string(), *result->error));
+            return true;
+        }
+        if (buf != nullptr && saver->path() == buf->file_path) {
+            buf->mark_saved(saver->version());
+            // so that the journal is of the text as it is now
+            journal_edits();
+            if (auto it = journals.find(buf->id); it != journals.end()) {
+                auto &journal = *it->second;
+                const auto changed = journal.changed_since_mark();
+                journal.rebase(saver->size());
+                // edited while it was being written; the file doesn't have those edits, so the journal begins with them.
+                // Only what they changed, [begin, old_end) of what was written, is recorded, not the entire text
+                if (buf->has_unsaved_changes()) {
+                    auto [begin, end] = changed.value_or(std::pair<std::size_t, std::size_t>{0, buf->size()});
+                    const auto old_end = saver->size() - (buf->size() - end);
+                    journal.record(begin, old_end - begin, buf->chunks(begin, end));
+                }
+            }
+        }
+        command_view->draw_message(
+                fmt::format("Wrote {} bytes to file: {}", result->bytes_written, saver->path().string()));
+        return true;
+    });
 }
 
 void App::toggle_modal_popup(ui::ModalContentsType contents) {
@@ -628,21 +854,118 @@ void App::reload_keybindings() {
     command_view->draw_message("keybindings reloaded");
 }
 
-void App::find_next_in_active(const std::string &search) {
+void App::find_next_in_active(const std::string &query) {
+    if (search_origin && search && query == last_searched) {
+        // searched for as it was typed in, the cursor is on the first match already
+        search_origin.reset();
+        mode = CXMode::Search;
+        command_view->draw_message(fmt::format("search: {}", last_searched));
+        return;
+    }
+    search_origin.reset();
+    last_searched = query;
+    std::string error{};
+    auto searcher = Searcher::from_prompt(query, error);
+    if (not searcher) {
+        end_search();
+        command_view->draw_error_message(fmt::format("can't search for '{}': {}", query, error));
+        return;
+    }
+    set_search(std::move(searcher));
     mode = CXMode::Search;
-    last_searched = search;
-    auto pos = active_window->get_text_buffer()->cursor.pos;
-    active_window->get_text_buffer()->goto_next(search);
-    if (not is_within(active_window->get_text_buffer()->cursor.line, active_window->view)) {
-        active_window->view->scroll_to(active_window->get_text_buffer()->cursor.line);
+    find_in_active(CursorDirection::Forward);
+}
+
+void App::begin_incremental_search() {
+    end_search();
+    search_origin = AS(active_window->get_text_buffer()->cursor.pos, std::size_t);
+}
+
+void App::search_as_you_type(const std::string &input) {
+    if (not search_origin) return;
+    MICRO_BENCH("App::search_as_you_type");
+    auto buffer = active_window->get_text_buffer();
+    last_searched = input;
+    std::string error{};
+    // nothing to search for, or a regex that is still being typed, is the same as no search, until it's something
+    set_search(Searcher::from_prompt(input, error));
+    auto match = search ? find_match(buffer, *search_origin, CursorDirection::Forward) : std::nullopt;
+    if (search && not match) match = find_match(buffer, 0, CursorDirection::Forward);
+    buffer->step_cursor_to(match ? match->begin : *search_origin);
+    if (not is_within(buffer->cursor.line, active_window->view)) active_window->view->scroll_to(buffer->cursor.line);
+}
+
+void App::cancel_incremental_search() {
+    if (not search_origin) return;
+    auto buffer = active_window->get_text_buffer();
+    buffer->step_cursor_to(*search_origin);
+    if (not is_within(buffer->cursor.line, active_window->view)) active_window->view->scroll_to(buffer->cursor.line);
+    end_search();
+}
+
+void App::find_in_active(CursorDirection direction) {
+    if (not search) return;
+    auto buffer = active_window->get_text_buffer();
+    if (active_window->view->search != search.get()) {
+        active_window->view->set_search(search.get(), &match_indices[buffer->id]);
+    }
+    const auto pos = AS(buffer->cursor.pos, std::size_t);
+    const auto forward = direction == CursorDirection::Forward;
+    auto match = find_match(buffer, forward ? pos + 1 : pos, direction);
+    auto wrapped = false;
+    if (not match) {
+        match = find_match(buffer, forward ? 0 : buffer->size(), direction);
+        wrapped = match.has_value();
+    }
+    if (not match) {
+        command_view->draw_error_message(fmt::format("'{}' not found", last_searched));
+        return;
     }
-    if (pos == active_window->get_text_buffer()->cursor.pos) {
-        command_view->draw_message(fmt::format("no more '{}' found", last_searched));
+    buffer->step_cursor_to(match->begin);
+    if (not is_within(buffer->cursor.line, active_window->view)) active_window->view->scroll_to(buffer->cursor.line);
+    if (wrapped) {
+        const auto to = forward ? "top" : "bottom";
+        command_view->draw_message(fmt::format("search: {} (wrapped to {})", last_searched, to));
     } else {
         command_view->draw_message(fmt::format("search: {}", last_searched));
     }
 }
 
+std::optional<SearchMatch> App::find_match(TextData *buffer, std::size_t pos, CursorDirection direction) {
+    auto &index = match_indices[buffer->id];
+    index.update(*buffer, *search);
+    if (index.complete()) return direction == CursorDirection::Forward ? index.next(pos) : index.prev(pos);
+    return direction == CursorDirection::Forward ? search->find_next(*buffer, pos) : search->find_prev(*buffer, pos);
+}
+
+void App::set_search(std::unique_ptr<Searcher> searcher) {
+    search = std::move(searcher);
+    if (not search) match_indices.clear();
+    for (auto window : editor_views) {
+        auto index = search ? &match_indices[window->get_text_buffer()->id] : nullptr;
+        window->view->set_search(search.get(), index);
+    }
+}
+
+void App::end_search() {
+    if (mode == CXMode::Search) mode = CXMode::Normal;
+    search_origin.reset();
+    if (not search) return;
+    set_search(nullptr);
+}
+
+void App::select_all_in_active(const std::string &search) {
+    auto buffer = active_window->get_text_buffer();
+    if (auto found = buffer->select_all(search); found > 0) {
+        if (not is_within(buffer->cursor.line, active_window->view)) {
+            active_window->view->scroll_to(buffer->cursor.line);
+        }
+        command_view->draw_message(fmt::format("{} cursors on '{}'", found, search));
+    } else {
+        command_view->draw_error_message(fmt::format("'{}' not found", search));
+    }
+}
+
 void App::close_active() {
     /*
     auto active_buf = active_window->get_text_buffer();
@@ -772,6 +1095,9 @@ void App::handle_modal_selection(const std::optional<ui::PopupItem> &possible_se
                     case Commands::WriteFile:
                         toggle_command_input("write", Commands::WriteFile);
                         break;
+                    case Commands::WriteAllFiles:
+                        write_all_files();
+                        break;
                     case Commands::GotoLine:
                         toggle_command_input("goto", Commands::GotoLine);
                         break;
@@ -809,7 +1135,12 @@ void App::handle_text_input(int codepoint) {
     switch (mode) {
         case CXMode::Normal: {
             if (codepoint >= 32 && codepoint <= 126) {
-                active_buffer->insert((char) codepoint);
+                if (active_buffer->cursor_count() > 1) {
+                    const auto ch = (char) codepoint;
+                    active_buffer->insert_at_cursors(std::string_view{&ch, 1});
+                } else {
+                    active_buffer->insert((char) codepoint);
+                }
                 command_view->show_last_message = false;
             }
         } break;
@@ -827,7 +1158,7 @@ void App::handle_text_input(int codepoint) {
         case CXMode::Popup: {
         } break;
         case CXMode::Search: {
-            mode = CXMode::Normal;
+            end_search();
             if (codepoint >= 32 && codepoint <= 126) {
                 active_buffer->insert((char) codepoint);
                 command_view->show_last_message = false;
@@ -861,6 +1192,7 @@ void App::handle_key_input(KeyInput input, int action) {
             this->handle_popup_input(input, action);
             break;
         case CXMode::Search:
+            this->handle_search_input(input, action);
             break;
         case CXMode::MacroRecord:
             this->handle_macro_record_input(input, action);
@@ -899,8 +1231,57 @@ void App::handle_command_input(KeyInput input) {
             break;
     }
 }
+bool App::handle_multi_cursor_input(KeyInput input) {
+    auto &[key, modifier] = input;
+    if (modifier == (GLFW_MOD_CONTROL | GLFW_MOD_ALT) && (key == GLFW_KEY_UP || key == GLFW_KEY_DOWN)) {
+        active_buffer->add_cursor_on_next_line(key == GLFW_KEY_DOWN ? CursorDirection::Forward : CursorDirection::Back);
+        return true;
+    }
+    if (active_buffer->cursor_count() == 1) return false;
+    const auto word = (modifier & GLFW_MOD_CONTROL) != 0;
+    if (modifier != 0 && modifier != GLFW_MOD_CONTROL) return false;
+    switch (key) {
+        case GLFW_KEY_ESCAPE:
+            active_buffer->clear_extra_cursors();
+            break;
+        case GLFW_KEY_ENTER:
+            active_buffer->insert_at_cursors("\n");
+            break;
+        case GLFW_KEY_TAB:
+            active_buffer->insert_at_cursors("    ");
+            break;
+        case GLFW_KEY_BACKSPACE:
+            active_buffer->remove_at_cursors(word ? Movement::Word(1, CursorDirection::Back)
+                                                  : Movement::Char(1, CursorDirection::Back));
+            break;
+        case GLFW_KEY_DELETE:
+            active_buffer->remove_at_cursors(word ? Movement::Word(1, CursorDirection::Forward)
+                                                  : Movement::Char(1, CursorDirection::Forward));
+            break;
+        case GLFW_KEY_LEFT:
+        case GLFW_KEY_RIGHT: {
+            const auto dir = key == GLFW_KEY_RIGHT ? CursorDirection::Forward : CursorDirection::Back;
+            active_buffer->move_cursors(word ? Movement::Word(1, dir) : Movement::Char(1, dir));
+        } break;
+        case GLFW_KEY_UP:
+        case GLFW_KEY_DOWN:
+            if (word) return false;
+            active_buffer->move_cursors(
+                    Movement::Line(1, key == GLFW_KEY_DOWN ? CursorDirection::Forward : CursorDirection::Back));
+            break;
+        case GLFW_KEY_V: {
+            if (not word) return false;
+            if (auto data = copy_register.get_last(); data) active_buffer->insert_at_cursors(*data);
+        } break;
+        default:
+            return false;
+    }
+    return true;
+}
+
 void App::handle_normal_input(KeyInput input, int action) {
     util::println("Normal Mode Input handler <{}, {}, {}>", input.key, input.modifier, action);
+    if (handle_multi_cursor_input(input)) return;
     auto &[key, modifier] = input;
     auto buffer_set_mark_at_cursor = [this](auto mod) {
         if (mod & GLFW_MOD_SHIFT) {
@@ -1076,11 +1457,21 @@ void App::handle_normal_input(KeyInput input, int action) {
             } break;
             case GLFW_KEY_V: {// PASTE
                 auto data = copy_register.get_last();
-                if (data) { active_buffer->insert_str(*data); }
+                if (data) { active_buffer->paste(*data); }
             } break;
             case GLFW_KEY_W:// WRITE
                 toggle_command_input("write", Commands::WriteFile);
                 break;
+            case GLFW_KEY_Y:// REDO
+                active_buffer->redo();
+                break;
+            case GLFW_KEY_Z: {// UNDO, ctrl+shift+z redoes
+                if (modifier & GLFW_MOD_SHIFT) {
+                    active_buffer->redo();
+                } else {
+                    active_buffer->undo();
+                }
+            } break;
         }
     } else if (modifier == GLFW_MOD_SHIFT) {
         switch (key) {
@@ -1151,6 +1542,33 @@ void App::handle_popup_input(KeyInput input, int action) {
 
 void App::handle_macro_record_input(KeyInput input, int action) { util::println("Macro Record Mode Input handler"); }
 
+void App::handle_search_input(KeyInput input, int action) {
+    const auto &[key, modifier] = input;
+    const auto direction = (modifier & GLFW_MOD_SHIFT) ? CursorDirection::Back : CursorDirection::Forward;
+    switch (key) {
+        case GLFW_KEY_ENTER:
+        case GLFW_KEY_F3:
+            find_in_active(direction);
+            break;
+        case GLFW_KEY_ESCAPE:
+            end_search();
+            command_view->draw_message("search ended");
+            break;
+        // modifiers on their own, pressed on the way to one of the above
+        case GLFW_KEY_LEFT_SHIFT:
+        case GLFW_KEY_RIGHT_SHIFT:
+        case GLFW_KEY_LEFT_CONTROL:
+        case GLFW_KEY_RIGHT_CONTROL:
+        case GLFW_KEY_LEFT_ALT:
+        case GLFW_KEY_RIGHT_ALT:
+            break;
+        default:
+            end_search();
+            handle_normal_input(input, action);
+            break;
+    }
+}
+
 void Register::push_view(std::string_view data) {
     if (not copies.empty()) [[likely]] {
         auto last = copies.back();
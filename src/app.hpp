@@ -6,6 +6,7 @@
 #include <windows.h>
 #include <stack>
 #include <string>
+#include <unordered_map>
 
 #include <GLFW/glfw3.h>
 #include <filesystem>
@@ -15,8 +16,13 @@
 #include <bindingslib/keybindings.hpp>
 
 #include <core/math/matrix.hpp>
+#include <core/buffer/file_loader.hpp>
+#include <core/buffer/file_saver.hpp>
+#include <core/buffer/recovery_journal.hpp>
 #include <core/buffer/text_data.hpp>
 #include <core/commands/command_interpreter.hpp>
+#include <core/search/match_index.hpp>
+#include <core/search/searcher.hpp>
 
 #include <ui/core/layout.hpp>
 #include <ui/managers/font_library.hpp>
@@ -32,6 +38,7 @@ class View;
 class EditorWindow;
 class StatusBar;
 class CommandView;
+struct ProfilerOverlay;
 }// namespace ui
 
 namespace fs = std::filesystem;
@@ -67,7 +74,8 @@ public:
     void run_loop();
     void set_dimensions(int w, int h);
     void load_file(const fs::path &file);
-    void draw_all(bool force_redraw = false);
+    /// Returns whether anything was drawn, and the buffers swapped
+    bool draw_all(bool force_redraw = false);
     void update_views_dimensions(float wRatio, float hRatio);
     void toggle_command_input(const std::string &prefix, Commands commandInput);
     void disable_command_input();
@@ -82,6 +90,8 @@ public:
     void restore_input();
 
     void fwrite_active_to_disk(const std::string &path);
+    /// Saves every buffer that has changes that its file doesn't, all at the same time
+    void write_all_files();
 
     int win_height;
     int win_width;
@@ -99,19 +109,45 @@ public:
     void cycle_command_or_move_cursor(Cycle cycle);
 
     void toggle_modal_popup(ui::ModalContentsType = ui::ModalContentsType::ActionList);
+    /// Searches the active buffer for what was typed into the find prompt (see Searcher::from_prompt), & goes into
+    /// Search mode, with the matches on screen highlighted
     void find_next_in_active(const std::string& search);
+    /// The next or previous match of the current search, wrapping around at the end, or the beginning
+    void find_in_active(CursorDirection direction);
+    /// Leaves Search mode, & drops the highlights
+    void end_search();
+    /// For the find prompt: each key typed searches for what's been typed so far, moving the cursor to the first match
+    /// after where it was when the prompt was opened. Escape puts it back there
+    void begin_incremental_search();
+    void search_as_you_type(const std::string &input);
+    void cancel_incremental_search();
+    /// Puts a cursor at every occurrence of search in the active buffer, selecting it
+    void select_all_in_active(const std::string &search);
 
     void reload_configuration(fs::path cfg_path = "./assets/cxconfig.cxe");
+    /// Shows the frame time graph & starts profiling, or hides it & stops
+    void toggle_profiler();
+    /// Writes what the profiler has recorded as a Chrome trace, and says how it went in the command view
+    void write_trace(const fs::path &path);
 
     void handle_text_input(int codepoint);
     void handle_key_input(KeyInput input, int action);
+    /// Input changes what the command view & the popup show, which, unlike the editor views, they can't tell for
+    /// themselves; so they're drawn again after each
+    void damage_input_areas();
 
     // Mode handlers
     void handle_normal_input(KeyInput input, int action);
+    /// Keys that add cursors, and those that edit at all of them, when there's more than one. Returns whether input
+    /// was one of those
+    bool handle_multi_cursor_input(KeyInput input);
     void handle_actions_input(KeyInput input, int action);
     void handle_command_input(KeyInput input, int action);
     void handle_popup_input(KeyInput input, int action);
     void handle_macro_record_input(KeyInput input, int action);
+    /// Enter / F3 goes to the next match, with shift to the previous one, escape ends the search; anything else ends
+    /// it too, & is what it would have been in Normal mode
+    void handle_search_input(KeyInput input, int action);
 
 private:
     void cleanup();
@@ -123,8 +159,31 @@ private:
     std::vector<ui::EditorWindow *> editor_views;
     ui::EditorWindow *active_window;
     std::unique_ptr<ui::CommandView> command_view;
+    /// Shown while profiling, see toggle_profiler
+    std::unique_ptr<ui::ProfilerOverlay> profiler_overlay{nullptr};
+    /// Buffers of the swap chain still to be cleared all over, & have everything drawn into, see damage_all
+    int window_clears_pending{0};
+    /// Buffers of the swap chain that the modal popup's current contents haven't made it to yet
+    int modal_redraws_pending{0};
+    bool modal_was_drawn{false};
     TextData *active_buffer{nullptr};
     ui::View *active_view{nullptr};
+    /// Files still being streamed into their buffers
+    std::vector<std::unique_ptr<FileLoader>> loaders{};
+    /// Buffers still being written to disk
+    std::vector<std::unique_ptr<FileSaver>> savers{};
+    /// The unsaved edits of the buffers that have a file, by buffer id, for when the editor crashes
+    std::unordered_map<int, std::unique_ptr<RecoveryJournal>> journals{};
+    /// The current search, that the editor views highlight the matches of
+    std::unique_ptr<Searcher> search{nullptr};
+    /// The matches of search, by buffer id
+    std::unordered_map<int, MatchIndex> match_indices{};
+    /// Where the cursor was when the find prompt was opened, while it's open
+    std::optional<std::size_t> search_origin{};
+    /// Replaces the current search, & what the views highlight, nullptr for no search
+    void set_search(std::unique_ptr<Searcher> searcher);
+    /// The first match at or after pos, or the last one that ends at or before it, from the buffer's match index
+    std::optional<SearchMatch> find_match(TextData *buffer, std::size_t pos, CursorDirection direction);
 
     Register copy_register{};
     ui::core::Layout *root_layout{nullptr};
@@ -133,6 +192,20 @@ private:
     Configuration config;
 
     bool no_close_condition();
+    void poll_loaders();
+    /// Starts writing a snapshot of buffer to path, see FileSaver; the outcome is reported in poll_savers
+    void save_buffer(TextData *buffer, const fs::path &path);
+    void poll_savers();
+    /// Journals the edits of buffer from here on. base_size is of the text of its file, which the buffer has, unless it
+    /// has unsaved changes
+    void begin_journal(TextData *buffer, std::size_t base_size);
+    /// Records what's been edited in the journaled buffers since the last frame, see RecoveryJournal
+    void journal_edits();
+    /// Opens the files that have journals left behind by an editor that went down, with their unsaved edits replayed
+    void recover_journals();
+    /// Draws everything, into every buffer of the swap chain, for when what's on screen can't be trusted anymore, like
+    /// after a resize, or when something on top of the views went away
+    void damage_all();
     void graceful_exit();
 
     static WindowDimensions win_dimensions;
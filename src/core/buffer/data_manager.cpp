@@ -3,6 +3,8 @@
 //
 
 #include "data_manager.hpp"
+#include "gap_buffer.hpp"
+#include "mapped_buffer.hpp"
 #include "std_string_buffer.hpp"
 
 #include <ranges>
@@ -20,12 +22,19 @@ TextData *DataManager::get_by_id(int id) {
     return nullptr;
 }
 
+std::vector<TextData *> DataManager::managed_buffers() const {
+    std::vector<TextData *> result{};
+    for (const auto &e : data) result.push_back(e.get());
+    return result;
+}
+
 TextData *DataManager::create_managed_buffer(BufferType type) {
     if (reuse_list.empty()) {
         util::println("No available buffers in re-use list. Creating new");
         switch (type) {
             case BufferType::CodeInput: {
-                auto bufHandle = StdStringBuffer::make_handle();
+                // edit buffers get the gap buffer, so that editing anywhere in large files is cheap
+                auto bufHandle = GapBuffer::make_handle();
                 bufHandle->has_meta_data = true;
                 bufHandle->info = BufferTypeInfo::EditBuffer;
                 data.push_back(std::move(bufHandle));
@@ -60,7 +69,7 @@ TextData *DataManager::create_managed_buffer(BufferType type) {
 TextData* DataManager::create_free_buffer(BufferType type) {
     switch (type) {
         case BufferType::CodeInput: {
-            auto bufHandle = StdStringBuffer::make_non_owning();
+            auto bufHandle = GapBuffer::make_non_owning();
             bufHandle->has_meta_data = true;
             bufHandle->info = BufferTypeInfo::EditBuffer;
             return bufHandle;
@@ -75,6 +84,14 @@ TextData* DataManager::create_free_buffer(BufferType type) {
     }
 }
 
+TextData *DataManager::create_mapped_buffer(std::shared_ptr<MappedFile> mapping) {
+    auto bufHandle = MappedBuffer::make_handle(std::move(mapping));
+    bufHandle->has_meta_data = true;
+    bufHandle->info = BufferTypeInfo::EditBuffer;
+    data.push_back(std::move(bufHandle));
+    return data.back().get();
+}
+
 int DataManager::get_new_id() {
     buffers_count++;
     return buffers_count;
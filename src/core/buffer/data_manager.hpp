@@ -7,6 +7,8 @@
 #include <vector>
 #include <core/buffer/text_data.hpp>
 
+class MappedFile;
+
 template<typename T>
 using Boxed = std::unique_ptr<T>;
 
@@ -27,8 +29,12 @@ class DataManager {
 public:
     static DataManager& get_instance();
     TextData* get_by_id(int id);
+    /// The buffers in use, not those waiting to be re-used
+    std::vector<TextData *> managed_buffers() const;
     TextData* create_managed_buffer(BufferType type);
     TextData *create_free_buffer(BufferType type);
+    /// Edit buffer that reads out of a read-only mapping of a file, instead of a copy of it in memory
+    TextData *create_mapped_buffer(std::shared_ptr<MappedFile> mapping);
 
     int get_new_id();
     CommandResult request_close(int i);
@@ -0,0 +1,139 @@
+//
+// Created by 46769 on 2021-02-11.
+//
+
+#include "edit_history.hpp"
+
+/// Single characters that don't end a line are what typing produces, and what gets coalesced
+static bool is_typing(std::string_view text) { return text.size() == 1 && text.front() != '\n'; }
+
+EditHistory::Edit *EditHistory::open_entry(Edit::Kind kind) {
+    if (undo_stack.empty()) return nullptr;
+    auto &last = undo_stack.back();
+    if (last.sealed || last.kind != kind || last.text.find('\n') != std::string::npos) return nullptr;
+    return &last;
+}
+
+void EditHistory::record_insert(std::size_t pos, std::string_view text) {
+    if (text.empty()) return;
+    clear_redo();
+    if (auto last = open_entry(Edit::Kind::Insert); last && is_typing(text) && last->pos + last->text.size() == pos) {
+        last->text.append(text);
+        bytes_used += text.size();
+        enforce_cap();
+        return;
+    }
+    // a paste, or the first character of a run of typing. Only the latter is open for more characters
+    push(Edit{.kind = Edit::Kind::Insert, .sealed = not is_typing(text), .pos = pos, .text = std::string{text}});
+}
+
+void EditHistory::record_remove(std::size_t pos, std::string_view text) {
+    if (text.empty()) return;
+    clear_redo();
+    if (auto last = open_entry(Edit::Kind::Remove); last && is_typing(text)) {
+        if (pos + text.size() == last->pos) {
+            // backspace
+            last->text.insert(0, text);
+            last->pos = pos;
+            bytes_used += text.size();
+            enforce_cap();
+            return;
+        } else if (pos == last->pos) {
+            // delete
+            last->text.append(text);
+            bytes_used += text.size();
+            enforce_cap();
+            return;
+        }
+    }
+    push(Edit{.kind = Edit::Kind::Remove, .sealed = not is_typing(text), .pos = pos, .text = std::string{text}});
+}
+
+void EditHistory::record_batch(std::vector<Replacement> &&replacements) {
+    if (replacements.empty()) return;
+    clear_redo();
+    const auto pos = replacements.front().pos;
+    push(Edit{.kind = Edit::Kind::Batch,
+              .sealed = true,
+              .pos = pos,
+              .text = {},
+              .replacements = std::move(replacements)});
+}
+
+void EditHistory::seal() {
+    if (not undo_stack.empty()) undo_stack.back().sealed = true;
+}
+
+void EditHistory::shift(std::size_t pos, std::size_t inserted) {
+    auto shift_edit = [pos, inserted](Edit &edit) {
+        if (edit.pos >= pos) edit.pos += inserted;
+        for (auto &r : edit.replacements) {
+            if (r.pos >= pos) r.pos += inserted;
+        }
+    };
+    for (auto &edit : undo_stack) shift_edit(edit);
+    for (auto &edit : redo_stack) shift_edit(edit);
+}
+
+const EditHistory::Edit *EditHistory::undo() {
+    if (undo_stack.empty()) return nullptr;
+    redo_stack.push_back(std::move(undo_stack.back()));
+    undo_stack.pop_back();
+    redo_stack.back().sealed = true;
+    return &redo_stack.back();
+}
+
+const EditHistory::Edit *EditHistory::redo() {
+    if (redo_stack.empty()) return nullptr;
+    undo_stack.push_back(std::move(redo_stack.back()));
+    redo_stack.pop_back();
+    return &undo_stack.back();
+}
+
+void EditHistory::clear() {
+    undo_stack.clear();
+    redo_stack.clear();
+    bytes_used = 0;
+}
+
+void EditHistory::set_memory_cap(std::size_t bytes) {
+    memory_cap = bytes;
+    enforce_cap();
+}
+
+std::size_t EditHistory::cost(const Edit &edit) {
+    auto bytes = sizeof(Edit) + edit.text.size();
+    for (const auto &r : edit.replacements) bytes += sizeof(Replacement) + r.removed.size() + r.inserted.size();
+    return bytes;
+}
+
+void EditHistory::push(Edit &&edit) {
+    seal();
+    auto edit_cost = cost(edit);
+    if (edit_cost > memory_cap) {
+        // an edit larger than the entire journal can't be undone. Neither can anything before it, since undoing those
+        // would assume the text this edit changed is still as it was
+        clear();
+        return;
+    }
+    bytes_used += edit_cost;
+    undo_stack.push_back(std::move(edit));
+    enforce_cap();
+}
+
+void EditHistory::clear_redo() {
+    for (const auto &edit : redo_stack) bytes_used -= cost(edit);
+    redo_stack.clear();
+}
+
+void EditHistory::enforce_cap() {
+    while (bytes_used > memory_cap && not undo_stack.empty()) {
+        bytes_used -= cost(undo_stack.front());
+        undo_stack.pop_front();
+    }
+    // what's left over the cap is redo entries, which are the first to be useless once the user edits again anyway
+    while (bytes_used > memory_cap && not redo_stack.empty()) {
+        bytes_used -= cost(redo_stack.front());
+        redo_stack.erase(redo_stack.begin());
+    }
+}
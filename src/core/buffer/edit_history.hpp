@@ -0,0 +1,78 @@
+//
+// Created by 46769 on 2021-02-11.
+//
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Undo / redo journal of a TextData. Every edit is recorded as what was inserted or removed, and where; never as a
+ * copy of the buffer, so undoing costs the size of the edit, not the size of the buffer.
+ *
+ * Typing is coalesced; a run of single characters typed (or backspaced / deleted) next to each other, on the same
+ * line, is one entry. The journal is capped at memory_cap bytes, when it grows past that, the oldest entries are
+ * dropped.
+ *
+ * Edits made at several places at once, by multiple cursors, are one Batch entry, and are undone together.
+ */
+class EditHistory {
+public:
+    /// What was at pos before a batch, & what replaced it
+    struct Replacement {
+        std::size_t pos;
+        std::string removed;
+        std::string inserted;
+    };
+
+    struct Edit {
+        enum class Kind : std::uint8_t { Insert, Remove, Batch };
+        Kind kind;
+        /// Sealed entries don't take any more characters, see seal()
+        bool sealed{false};
+        std::size_t pos;
+        std::string text;
+        /// Batch only, in the order of the text, with the positions of the text as it was before the batch
+        std::vector<Replacement> replacements{};
+    };
+
+    static constexpr std::size_t DEFAULT_MEMORY_CAP = 8 * 1024 * 1024;
+
+    void record_insert(std::size_t pos, std::string_view text);
+    void record_remove(std::size_t pos, std::string_view text);
+    void record_batch(std::vector<Replacement> &&replacements);
+    /// Ends the current run of typing, so that the next edit begins a new entry
+    void seal();
+    /// Moves the edits at or after pos by inserted characters, for text that went in before them without being an
+    /// edit, see TextData::append_loaded
+    void shift(std::size_t pos, std::size_t inserted);
+
+    /// Moves the latest edit to the redo stack, and returns it so that it can be reverted. nullptr if there's nothing
+    /// to undo. The pointer is valid until the next call on the history
+    const Edit *undo();
+    /// Moves the latest undone edit back to the undo stack, and returns it so that it can be re-applied
+    const Edit *redo();
+
+    void clear();
+    void set_memory_cap(std::size_t bytes);
+    [[nodiscard]] std::size_t memory_used() const { return bytes_used; }
+    [[nodiscard]] bool can_undo() const { return not undo_stack.empty(); }
+    [[nodiscard]] bool can_redo() const { return not redo_stack.empty(); }
+
+private:
+    std::deque<Edit> undo_stack{};
+    std::vector<Edit> redo_stack{};
+    std::size_t bytes_used{0};
+    std::size_t memory_cap{DEFAULT_MEMORY_CAP};
+
+    static std::size_t cost(const Edit &edit);
+    /// Latest edit, if it's of kind & still open for typing to be added to it
+    Edit *open_entry(Edit::Kind kind);
+    void push(Edit &&edit);
+    void clear_redo();
+    void enforce_cap();
+};
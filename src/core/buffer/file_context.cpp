@@ -3,3 +3,35 @@
 //
 
 #include "file_context.hpp"
+#include <array>
+#include <string_view>
+
+struct ExtensionEntry {
+    std::string_view extension;
+    ContexTypes type;
+    Language language;
+};
+
+using namespace std::string_view_literals;
+// .h is taken to be C++, as it mostly is in the code bases this editor is used on
+constexpr std::array extensions{
+        ExtensionEntry{".cpp"sv, ContexTypes::CPPSource, Language::CPP},
+        ExtensionEntry{".cc"sv, ContexTypes::CPPSource, Language::CPP},
+        ExtensionEntry{".cxx"sv, ContexTypes::CPPSource, Language::CPP},
+        ExtensionEntry{".hpp"sv, ContexTypes::CPPHeader, Language::CPP},
+        ExtensionEntry{".hh"sv, ContexTypes::CPPHeader, Language::CPP},
+        ExtensionEntry{".h"sv, ContexTypes::CPPHeader, Language::CPP},
+        ExtensionEntry{".c"sv, ContexTypes::CPPSource, Language::C},
+        ExtensionEntry{".py"sv, ContexTypes::Unhandled, Language::Python},
+        ExtensionEntry{".rs"sv, ContexTypes::Unhandled, Language::Rust},
+        ExtensionEntry{".json"sv, ContexTypes::Unhandled, Language::JSON},
+        ExtensionEntry{".cxe"sv, ContexTypes::Config, Language::Config},
+};
+
+FileContext make_file_context(const fs::path &path) {
+    const auto ext = path.extension().string();
+    for (const auto &entry : extensions) {
+        if (entry.extension == ext) return FileContext{.type = entry.type, .language = entry.language, .path = path};
+    }
+    return FileContext{.type = ContexTypes::Unhandled, .language = Language::PlainText, .path = path};
+}
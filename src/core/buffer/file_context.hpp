@@ -3,6 +3,7 @@
 //
 
 #pragma once
+#include <cstdint>
 #include <filesystem>
 
 namespace fs = std::filesystem;
@@ -14,7 +15,22 @@ enum ContexTypes {
     Unhandled
 };
 
+/// What a file is highlighted as. ui::GrammarRegistry has a grammar for every one of these, except PlainText
+enum class Language : std::uint8_t {
+    PlainText,
+    C,
+    CPP,
+    Python,
+    Rust,
+    JSON,
+    Config,
+};
+
 struct FileContext {
-    ContexTypes type;
-    fs::path path;
-};
\ No newline at end of file
+    ContexTypes type{ContexTypes::Unhandled};
+    Language language{Language::PlainText};
+    fs::path path{};
+};
+
+/// Looks at the extension of path only, so it's cheap, but not free; TextData does it once, when its file is set
+FileContext make_file_context(const fs::path &path);
@@ -0,0 +1,91 @@
+//
+// Created by 46769 on 2021-02-10.
+//
+
+#include "file_loader.hpp"
+#include "line_index.hpp"
+#include "text_data.hpp"
+#include <fstream>
+#include <utils/mapped_file.hpp>
+#include <utils/profiler.hpp>
+
+std::unique_ptr<FileLoader> FileLoader::start(int buffer_id, const fs::path &file, std::shared_ptr<MappedFile> mapping,
+                                              std::function<void()> on_chunk_ready) {
+    auto loader = std::unique_ptr<FileLoader>(new FileLoader{});
+    loader->target_id = buffer_id;
+    loader->file_path = file;
+    loader->mapping = std::move(mapping);
+    loader->notify = std::move(on_chunk_ready);
+    loader->total_bytes = loader->mapping ? loader->mapping->view().size() : AS(fs::file_size(file), std::size_t);
+    // the loader outlives the job, its destructor waits for it
+    loader->job = JobSystem::get_instance().submit(JobPriority::Normal, [l = loader.get()](const JobHandle &handle) {
+        l->run(handle);
+        return JobSystem::Completion{};
+    });
+    return loader;
+}
+
+FileLoader::~FileLoader() {
+    job.cancel();
+    job.wait();
+}
+
+void FileLoader::run(const JobHandle &handle) {
+    std::ifstream f{};
+    // text mode, like reading the entire file at once did before
+    if (not mapping) f.open(file_path);
+    std::size_t offset = 0;
+    auto chunk_size = FIRST_CHUNK_SIZE;
+    while (not handle.cancelled()) {
+        MICRO_BENCH("FileLoader::read_chunk");
+        Chunk chunk{};
+        if (mapping) {
+            auto contents = mapping->view();
+            if (offset >= contents.size()) break;
+            chunk.mapped = contents.substr(offset, chunk_size);
+        } else {
+            chunk.owned.resize(chunk_size);
+            f.read(chunk.owned.data(), AS(chunk_size, std::streamsize));
+            chunk.owned.resize(AS(f.gcount(), std::size_t));
+            if (chunk.owned.empty()) break;
+        }
+        std::string_view parts[]{chunk.text()};
+        chunk.line_lengths = LineIndex::line_lengths(parts);
+        offset += chunk.text().size();
+        {
+            std::lock_guard lock{chunks_mutex};
+            chunks.push_back(std::move(chunk));
+        }
+        if (notify) notify();
+        chunk_size = CHUNK_SIZE;
+    }
+    done = true;
+    if (notify) notify();
+}
+
+bool FileLoader::poll(TextData *buffer) {
+    // read before taking the chunks, so that when done is true, we know we got all of them
+    auto finished = done.load();
+    std::vector<Chunk> ready{};
+    {
+        std::lock_guard lock{chunks_mutex};
+        ready.swap(chunks);
+    }
+    // anything but the chunks changing the buffer since the last poll is the user's doing
+    if (handed_over_version ? buffer->version() != *handed_over_version : buffer->has_unsaved_changes()) {
+        edited_while_loading = true;
+    }
+    for (const auto &chunk : ready) {
+        buffer->append_loaded(chunk.text(), chunk.line_lengths);
+        bytes_handed_over += chunk.text().size();
+    }
+    handed_over_version = buffer->version();
+    if (finished) {
+        buffer->meta_data.load_progress.reset();
+        if (not edited_while_loading) buffer->mark_saved(buffer->version());
+    } else if (total_bytes > 0) {
+        buffer->meta_data.load_progress =
+                std::min(1.0f, AS(bytes_handed_over, float) / AS(total_bytes, float));
+    }
+    return finished;
+}
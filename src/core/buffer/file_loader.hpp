@@ -0,0 +1,76 @@
+//
+// Created by 46769 on 2021-02-10.
+//
+
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utils/job_system.hpp>
+#include <vector>
+
+namespace fs = std::filesystem;
+class MappedFile;
+class TextData;
+
+/**
+ * Reads a file & scans it for line begins as a job (see JobSystem), in chunks, so that the main loop never blocks on a
+ * large file. The job never touches the buffer; it queues the chunks it's done with, and the main thread hands
+ * them to the buffer in poll(), which means the buffer fills up from the top and the first screenful is displayable
+ * as soon as the first (small) chunk has been read.
+ *
+ * Mapped files are not read at all, the job only indexes them, and the chunks are views into the mapping.
+ */
+class FileLoader {
+public:
+    ~FileLoader();
+    FileLoader(const FileLoader &) = delete;
+    FileLoader &operator=(const FileLoader &) = delete;
+
+    /// on_chunk_ready is called from the job, every time there is something for poll() to hand over
+    static std::unique_ptr<FileLoader> start(int buffer_id, const fs::path &file, std::shared_ptr<MappedFile> mapping,
+                                             std::function<void()> on_chunk_ready);
+
+    /// Hands the chunks read so far to buffer & updates its load progress. Main thread only. Returns true when the
+    /// entire file has been handed over, and the loader can be destroyed
+    bool poll(TextData *buffer);
+
+    [[nodiscard]] int buffer_id() const { return target_id; }
+    [[nodiscard]] const fs::path &path() const { return file_path; }
+    /// Of the text read from the file, & handed over so far
+    [[nodiscard]] std::size_t size() const { return bytes_handed_over; }
+
+private:
+    FileLoader() = default;
+    struct Chunk {
+        std::string owned{};
+        std::string_view mapped{};
+        std::vector<std::size_t> line_lengths{};
+        [[nodiscard]] std::string_view text() const { return mapped.empty() ? std::string_view{owned} : mapped; }
+    };
+    /// The first chunk is small, so that there's something to display right away
+    static constexpr std::size_t FIRST_CHUNK_SIZE = 64 * 1024;
+    static constexpr std::size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+    int target_id{0};
+    fs::path file_path{};
+    std::shared_ptr<MappedFile> mapping{nullptr};
+    std::function<void()> notify{};
+    std::size_t total_bytes{0};
+    std::size_t bytes_handed_over{0};
+    /// The version of the buffer after the last chunk was handed over, nothing before the first
+    std::optional<std::uint64_t> handed_over_version{};
+    /// Whether the buffer was edited while loading; the file doesn't have those edits, so the buffer isn't marked saved
+    bool edited_while_loading{false};
+
+    std::mutex chunks_mutex{};
+    std::vector<Chunk> chunks{};
+    std::atomic_bool done{false};
+    JobHandle job{};
+
+    void run(const JobHandle &handle);
+};
@@ -0,0 +1,265 @@
+//
+// Created by 46769 on 2021-02-21.
+//
+
+#include "file_saver.hpp"
+#include "text_data.hpp"
+#include <fmt/format.h>
+#include <utility>
+#include <utils/profiler.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+/// Tells apart the temporary files of saves of the same file
+std::atomic<unsigned> save_count{0};
+
+/// Where the text is written, before it replaces file; next to it, as a rename can't move a file to another disk
+fs::path temp_path_for(const fs::path &file) {
+    return file.parent_path() / fmt::format(".{}.{}.cxsave", file.filename().string(), save_count++);
+}
+
+#ifdef WIN32
+std::string last_error() { return fmt::format("error {}", GetLastError()); }
+
+/// The file that a save writes to
+class TempFile {
+public:
+    TempFile() = default;
+    TempFile(const TempFile &) = delete;
+    TempFile &operator=(const TempFile &) = delete;
+    ~TempFile() { close(false); }
+
+    /// Creates path, which must not exist, for replacing target. Returns why it couldn't
+    std::optional<std::string> create(const fs::path &path, const fs::path &) {
+        handle = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) return last_error();
+        return {};
+    }
+
+    std::optional<std::string> write(std::string_view data) {
+        while (not data.empty()) {
+            DWORD written = 0;
+            const auto size = AS(std::min<std::size_t>(data.size(), 1u << 30), DWORD);
+            if (not WriteFile(handle, data.data(), size, &written, nullptr)) return last_error();
+            data.remove_prefix(written);
+        }
+        return {};
+    }
+
+    /// Closes the file, after flushing what's been written to disk, if flush
+    std::optional<std::string> close(bool flush) {
+        if (handle == INVALID_HANDLE_VALUE) return {};
+        std::optional<std::string> error{};
+        if (flush && not FlushFileBuffers(handle)) error = last_error();
+        CloseHandle(std::exchange(handle, INVALID_HANDLE_VALUE));
+        return error;
+    }
+
+private:
+    HANDLE handle{INVALID_HANDLE_VALUE};
+};
+
+/// Replaces target with temp
+std::optional<std::string> replace_file(const fs::path &temp, const fs::path &target) {
+    std::error_code ec{};
+    if (fs::exists(target, ec)) {
+        // which keeps the attributes & the ACL of what it replaces
+        if (ReplaceFileW(target.c_str(), temp.c_str(), nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr)) {
+            return {};
+        }
+    } else if (MoveFileExW(temp.c_str(), target.c_str(), MOVEFILE_WRITE_THROUGH)) {
+        return {};
+    }
+    return last_error();
+}
+#else
+std::string last_error() { return std::strerror(errno); }
+
+/// The file that a save writes to
+class TempFile {
+public:
+    TempFile() = default;
+    TempFile(const TempFile &) = delete;
+    TempFile &operator=(const TempFile &) = delete;
+    ~TempFile() { close(false); }
+
+    /// Creates path, which must not exist, for replacing target. Returns why it couldn't
+    std::optional<std::string> create(const fs::path &path, const fs::path &target) {
+        struct stat target_stat {};
+        const auto replaces = ::stat(target.c_str(), &target_stat) == 0;
+        const auto mode = replaces ? target_stat.st_mode & 07777 : 0666;
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+        if (fd == -1) return last_error();
+        if (replaces) {
+            // open's mode is masked by the umask, the file keeps the mode it had
+            ::fchmod(fd, mode);
+            // only root can give a file away, anyone else saves the files of others as their own
+            [[maybe_unused]] auto owned = ::fchown(fd, target_stat.st_uid, target_stat.st_gid);
+        }
+        return {};
+    }
+
+    std::optional<std::string> write(std::string_view data) {
+        while (not data.empty()) {
+            const auto written = ::write(fd, data.data(), data.size());
+            if (written == -1) {
+                if (errno == EINTR) continue;
+                return last_error();
+            }
+            data.remove_prefix(AS(written, std::size_t));
+        }
+        return {};
+    }
+
+    /// Closes the file, after flushing what's been written to disk, if flush
+    std::optional<std::string> close(bool flush) {
+        if (fd == -1) return {};
+        std::optional<std::string> error{};
+        if (flush && ::fsync(fd) != 0) error = last_error();
+        ::close(std::exchange(fd, -1));
+        return error;
+    }
+
+private:
+    int fd{-1};
+};
+
+/// Replaces target with temp
+std::optional<std::string> replace_file(const fs::path &temp, const fs::path &target) {
+    if (::rename(temp.c_str(), target.c_str()) != 0) return last_error();
+    // the rename is on disk once the directory is
+    const auto parent = target.has_parent_path() ? target.parent_path() : fs::path{"."};
+    if (auto dir = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); dir != -1) {
+        ::fsync(dir);
+        ::close(dir);
+    }
+    return {};
+}
+#endif
+
+/// What's handed to the OS at a time; the pieces of the text are gathered up to this, or written as they are, when
+/// they're as large
+constexpr std::size_t WRITE_SIZE = 4 * 1024 * 1024;
+
+/// Writes text to file, calling on_progress with how much more of text has been written, every WRITE_SIZE of it.
+/// Counts what's written to the file, in bytes_written. Returns why it couldn't be
+std::optional<std::string> write_text(TempFile &file, const TextSnapshot &text, const JobHandle &handle,
+                                      std::size_t &bytes_written,
+                                      const std::function<void(std::size_t)> &on_progress) {
+    std::string gathered{};
+    gathered.reserve(WRITE_SIZE);
+    auto write = [&](std::string_view data) {
+        bytes_written += data.size();
+        return file.write(data);
+    };
+    auto write_gathered = [&]() {
+        auto error = write(gathered);
+        gathered.clear();
+        return error;
+    };
+    for (auto piece : text.chunks(0, text.size())) {
+        for (std::size_t offset = 0; offset < piece.size(); offset += WRITE_SIZE) {
+            if (handle.cancelled()) return "cancelled";
+            auto part = piece.substr(offset, WRITE_SIZE);
+#ifdef WIN32
+            // what writing in text mode did, before saves went through here
+            for (auto ch : part) {
+                if (ch == '\n') gathered.push_back('\r');
+                gathered.push_back(ch);
+            }
+            if (gathered.size() >= WRITE_SIZE) {
+                if (auto error = write_gathered()) return error;
+            }
+#else
+            if (gathered.size() + part.size() > WRITE_SIZE) {
+                if (auto error = write_gathered()) return error;
+            }
+            if (part.size() == WRITE_SIZE) {
+                // as large as it gets, no use copying it
+                if (auto error = write(part)) return error;
+            } else {
+                gathered.append(part);
+            }
+#endif
+            on_progress(part.size());
+        }
+    }
+    return write_gathered();
+}
+} // namespace
+
+std::unique_ptr<FileSaver> FileSaver::start(TextSnapshot snapshot, const fs::path &file,
+                                            std::function<void()> on_progress) {
+    auto saver = std::unique_ptr<FileSaver>(new FileSaver{});
+    saver->snapshot = std::move(snapshot);
+    saver->file_path = file;
+    saver->notify = std::move(on_progress);
+    // the saver outlives the job, its destructor waits for it
+    saver->job = JobSystem::get_instance().submit(JobPriority::Normal, [s = saver.get()](const JobHandle &handle) {
+        s->run(handle);
+        return JobSystem::Completion{};
+    });
+    return saver;
+}
+
+FileSaver::~FileSaver() {
+    job.cancel();
+    job.wait();
+}
+
+void FileSaver::run(const JobHandle &handle) {
+    MICRO_BENCH("FileSaver::run");
+    result.error = save(handle);
+    done = true;
+    if (notify) notify();
+}
+
+std::optional<std::string> FileSaver::save(const JobHandle &handle) {
+    std::error_code ec{};
+    auto target = file_path;
+    if (fs::is_symlink(fs::symlink_status(file_path, ec))) {
+        // what a symlink points to is replaced, not the symlink
+        target = fs::canonical(file_path, ec);
+        if (ec) return ec.message();
+    }
+    const auto temp = temp_path_for(target);
+    TempFile file{};
+    if (auto error = file.create(temp, target)) return error;
+
+    auto error = write_text(file, snapshot, handle, result.bytes_written, [this](std::size_t written) {
+        bytes_done += written;
+        if (notify) notify();
+    });
+    if (not error) error = file.close(true);
+    if (not error && handle.cancelled()) error = "cancelled";
+    if (not error) error = replace_file(temp, target);
+    if (error) {
+        file.close(false);
+        fs::remove(temp, ec);
+    }
+    return error;
+}
+
+std::optional<FileSaver::Result> FileSaver::poll(TextData *buffer) {
+    const auto finished = done.load();
+    if (buffer != nullptr) {
+        if (finished) {
+            buffer->meta_data.save_progress.reset();
+        } else if (not snapshot.empty()) {
+            buffer->meta_data.save_progress =
+                    std::min(1.0f, AS(bytes_done.load(), float) / AS(snapshot.size(), float));
+        }
+    }
+    if (not finished) return {};
+    return result;
+}
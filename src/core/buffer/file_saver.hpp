@@ -0,0 +1,73 @@
+//
+// Created by 46769 on 2021-02-21.
+//
+
+#pragma once
+#include "text_snapshot.hpp"
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utils/job_system.hpp>
+
+namespace fs = std::filesystem;
+class TextData;
+
+/**
+ * Writes a snapshot of a buffer to a file as a job (see JobSystem), so that the main loop never blocks on a large
+ * file, and the buffer can be edited while it's being saved. The file is never written to; the text is written, in large
+ * writes, to a new file next to it, which is flushed to disk & then renamed over it, so the file has either all of what
+ * it had, or all of the snapshot, whenever the editor, or the machine, goes down. The new file gets the permissions
+ * (and owner, where we're allowed to) of the one it replaces; a symlink is followed, & what it points to replaced.
+ */
+class FileSaver {
+public:
+    /// What came of a save
+    struct Result {
+        std::size_t bytes_written;
+        /// Why the file wasn't saved; it's as it was before, then
+        std::optional<std::string> error;
+    };
+
+    /// Cancels the save, if it's not done, which leaves the file as it was
+    ~FileSaver();
+    FileSaver(const FileSaver &) = delete;
+    FileSaver &operator=(const FileSaver &) = delete;
+
+    /// on_progress is called from the job, every time there's something new for poll() to report
+    static std::unique_ptr<FileSaver> start(TextSnapshot snapshot, const fs::path &file,
+                                            std::function<void()> on_progress);
+
+    /// Main thread. Updates the save progress of buffer, the one snapshotted, or nullptr if it's been closed since.
+    /// Returns what came of the save when it's done, and the saver can be destroyed
+    std::optional<Result> poll(TextData *buffer);
+    /// Blocks until the save is done, for when the editor is about to exit
+    void wait() const { job.wait(); }
+
+    [[nodiscard]] int buffer_id() const { return snapshot.buffer_id; }
+    /// The version of the buffer that's being saved
+    [[nodiscard]] std::uint64_t version() const { return snapshot.version; }
+    [[nodiscard]] const fs::path &path() const { return file_path; }
+    /// Of the text that's being saved
+    [[nodiscard]] std::size_t size() const { return snapshot.size(); }
+
+private:
+    FileSaver() = default;
+
+    TextSnapshot snapshot{};
+    fs::path file_path{};
+    std::function<void()> notify{};
+
+    /// Of the snapshot, not of the file, which on windows has a \r for every \n as well
+    std::atomic<std::size_t> bytes_done{0};
+    std::atomic_bool done{false};
+    /// Written by the job, before it sets done
+    Result result{};
+    JobHandle job{};
+
+    void run(const JobHandle &handle);
+    /// Returns why the file couldn't be saved
+    std::optional<std::string> save(const JobHandle &handle);
+};
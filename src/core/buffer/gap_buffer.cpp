@@ -0,0 +1,616 @@
+//
+// Created by 46769 on 2021-02-06.
+//
+
+#include "gap_buffer.hpp"
+#include "data_manager.hpp"
+#include <cstring>
+
+/// ----------- GAP MANAGEMENT ----------------
+
+void GapBuffer::move_gap_to(std::size_t pos) {
+    assert(pos <= size());
+    if (pos == gap_begin) return;
+    if (pos < gap_begin) {
+        // move the characters [pos, gap_begin) to the end of the gap
+        auto len = gap_begin - pos;
+        std::memmove(store.data() + gap_end - len, store.data() + pos, len);
+        gap_begin -= len;
+        gap_end -= len;
+    } else {
+        // move the characters [gap_end, gap_end + len) to the beginning of the gap
+        auto len = pos - gap_begin;
+        std::memmove(store.data() + gap_begin, store.data() + gap_end, len);
+        gap_begin += len;
+        gap_end += len;
+    }
+}
+
+void GapBuffer::ensure_gap(std::size_t required) {
+    if (gap_size() >= required) return;
+    auto tail = store.size() - gap_end;
+    auto new_capacity = std::max(store.size() * 2, size() + required + MIN_GAP_SIZE);
+    store.resize(new_capacity);
+    auto new_gap_end = new_capacity - tail;
+    std::memmove(store.data() + new_gap_end, store.data() + gap_end, tail);
+    gap_end = new_gap_end;
+}
+
+void GapBuffer::erase_range(std::size_t pos, std::size_t length) {
+    length = std::min(length, size() - pos);
+    move_gap_to(pos);
+    record_remove(pos, std::string_view{store.data() + gap_end, length});
+    gap_end += length;
+    if (has_meta_data) meta_data.on_remove(pos, length);
+}
+
+std::string_view GapBuffer::view_range(std::size_t begin, std::size_t length) {
+    state_is_pristine = true;
+    begin = std::min(begin, size());
+    length = std::min(length, size() - begin);
+    auto end = begin + length;
+    if (begin < gap_begin && end > gap_begin) {
+        // the range straddles the gap, move it out of the way on whichever side is the least amount of work
+        if (gap_begin - begin < end - gap_begin) {
+            move_gap_to(begin);
+        } else {
+            move_gap_to(end);
+        }
+    }
+    if (end <= gap_begin) {
+        return std::string_view{store.data() + begin, length};
+    } else {
+        return std::string_view{store.data() + begin + gap_size(), length};
+    }
+}
+
+/// ----------- CURSOR MOVEMENT ----------------
+
+void GapBuffer::move_cursor(Movement m) {
+    switch (m.construct) {
+        case Char:
+            m.dir == CursorDirection::Forward ? char_move_forward(m.count) : char_move_backward(m.count);
+            break;
+        case Word:
+            m.dir == CursorDirection::Forward ? word_move_forward(m.count) : word_move_backward(m.count);
+            break;
+        case Line:
+            m.dir == CursorDirection::Forward ? line_move_forward(m.count) : line_move_backward(m.count);
+            break;
+        default:
+            PANIC("Block and file movements not yet implemented");
+    }
+    state_is_pristine = false;
+}
+
+void GapBuffer::char_move_forward(std::size_t count) {
+    auto end = std::min(cursor.pos + count, size());
+    for (std::size_t i = cursor.pos; i < end; i++) {
+        if (at(i) == '\n') {
+            cursor.line++;
+            cursor.col_pos = 0;
+        } else {
+            cursor.col_pos++;
+        }
+    }
+    cursor.pos = AS(end, i64);
+}
+
+void GapBuffer::char_move_backward(std::size_t count) {
+    if (cursor.pos - AS(count, i64) <= 0) {
+        cursor.reset();
+    } else {
+        auto next_pos = cursor.pos - AS(count, i64);
+        for (auto index = cursor.pos; index > next_pos; index--) {
+            if (at(index - 1) == '\n') { cursor.line--; }
+            cursor.pos--;
+        }
+        cursor.col_pos = cursor.pos - find_line_start(Boundary::Inside, cursor.pos);
+    }
+}
+
+void GapBuffer::word_move_forward(std::size_t count) {
+    auto sz = size();
+    if (cursor.pos + 1 >= AS(sz, i64)) {
+        step_cursor_to(sz);
+        return;
+    }
+    auto new_pos = find_next_delimiter(cursor.pos);
+    count--;
+    for (; count > 0; --count) { new_pos = find_next_delimiter(new_pos); }
+    char_move_forward(new_pos - cursor.pos);
+}
+
+void GapBuffer::word_move_backward(std::size_t count) {
+    if (cursor.pos - 1 <= 0) {
+        step_cursor_to(0);
+        return;
+    }
+    auto new_pos = find_prev_delimiter(cursor.pos);
+    count--;
+    for (; count > 0; --count) { new_pos = find_prev_delimiter(new_pos); }
+    char_move_backward(cursor.pos - new_pos);
+}
+
+void GapBuffer::line_move_forward(std::size_t count) {
+    auto last_col = cursor.col_pos;
+    std::size_t pos = cursor.pos;
+    auto sz = size();
+    for (; pos < sz && count > 0; pos++) {
+        if (at(pos) == '\n') count--;
+    }
+    if (pos + last_col < sz) {
+        auto line_end = find_line_end(AS(pos, i64));
+        if (AS(pos, i64) + last_col > line_end) {
+            step_cursor_to(line_end);
+        } else {
+            step_cursor_to(pos + last_col);
+        }
+    } else {
+        step_cursor_to(sz);
+    }
+}
+
+void GapBuffer::line_move_backward(std::size_t count) {
+    int curr_column = cursor.col_pos;
+    auto pos = cursor.pos;
+    auto sz = AS(size(), i64);
+    if (pos < sz && at(pos) == '\n') count++;
+    for (; pos > 0 && count > 0; pos--) {
+        if (pos < sz && at(pos) == '\n') {
+            count--;
+            if (count == 0) break;
+        }
+    }
+    auto line_begin = find_line_start(Boundary::Inside, pos);
+    auto line_length = pos - line_begin;
+    if (curr_column > line_length) {
+        char_move_backward(cursor.pos - pos);
+    } else {
+        char_move_backward(cursor.pos - (line_begin + curr_column));
+    }
+}
+
+void GapBuffer::step_cursor_to(size_t pos) {
+    if (pos == 0) {
+        cursor.reset();
+        state_is_pristine = false;
+        return;
+    }
+    if (empty() || AS(pos, i64) == cursor.pos) return;
+    assert(pos <= size());
+    if (has_meta_data && data_is_pristine) {
+        // the line index is kept up to date by every edit, so this never has to scan the text
+        cursor.line = meta_data.line_of(pos);
+        cursor.pos = AS(pos, i64);
+        cursor.col_pos = AS(pos - meta_data.line_begin(cursor.line), int);
+        state_is_pristine = false;
+        return;
+    } else if (AS(pos, i64) > cursor.pos) {
+        while (cursor.pos != AS(pos, i64)) {
+            if (at(cursor.pos) == '\n') cursor.line++;
+            cursor.pos++;
+        }
+    } else {
+        while (cursor.pos != AS(pos, i64)) {
+            cursor.pos--;
+            if (at(cursor.pos) == '\n') { cursor.line--; }
+        }
+    }
+    cursor.col_pos = AS(std::max<i64>(0, cursor.pos - find_line_start(Boundary::Inside, cursor.pos)), int);
+    state_is_pristine = false;
+}
+
+void GapBuffer::step_to_line_end(Boundary boundary) {
+    auto sz = AS(size(), i64);
+    auto newpos = cursor.pos;
+    for (auto i = cursor.pos; i < sz; i++) {
+        if (at(i) == '\n') {
+            newpos = (boundary == Boundary::Inside) ? i - 1 : i;
+            break;
+        }
+    }
+    step_cursor_to(std::min(newpos, sz));
+}
+
+void GapBuffer::step_to_line_begin(Boundary boundary) {
+    for (auto i = cursor.pos - 1; i >= 0; --i) {
+        if (at(i) == '\n') {
+            step_cursor_to(boundary == Boundary::Inside ? i + 1 : i);
+            return;
+        }
+    }
+    step_cursor_to(0);
+}
+
+i64 GapBuffer::find_line_end(i64 i) {
+    auto sz = AS(size(), i64);
+    for (; i < sz; i++) {
+        if (at(i) == '\n') { break; }
+    }
+    return std::min(i, sz);
+}
+
+/**
+ * Returns the index of the first character on the line where position i is. With Boundary::Outside, if the character
+ * prior to i is a newline, the index of that newline is returned instead.
+ */
+i64 GapBuffer::find_line_start(Boundary boundary, i64 i) {
+    i -= 1;
+    if (i < 0) return 0;
+    if (at(i) == '\n') { return (boundary == Boundary::Outside) ? i : i + 1; }
+    for (; i >= 0; --i) {
+        if (at(i) == '\n') return i + 1;// BOL - Beginning of line
+    }
+    return 0;// BOF - Beginning of file
+}
+
+i64 GapBuffer::find_next_delimiter(i64 i) {
+    auto sz = AS(size(), i64);
+    if (i < sz && is_delimiter(at(i))) {
+        // we are already standing on whitespace... scan until we are no longer on whitespace
+        while (i < sz) {
+            if (not is_delimiter(at(i))) return i;
+            i++;
+        }
+        return i;
+    } else {
+        if (i + 1 < sz) {
+            i++;
+            for (; i < sz; i++) {
+                if (is_delimiter(at(i))) { return i; }
+            }
+            return i;
+        } else {
+            return sz;
+        }
+    }
+}
+
+i64 GapBuffer::find_prev_delimiter(i64 i) {
+    if (i - 1 > 0) {
+        --i;
+        for (; i > 0; --i) {
+            if (is_delimiter(at(i))) { return i; }
+        }
+        return i;
+    } else {
+        return 0;
+    }
+}
+
+/// ----------- EDITING ----------------
+
+void GapBuffer::insert(char ch) {
+    move_gap_to(cursor.pos);
+    ensure_gap(1);
+    store[gap_begin++] = ch;
+    if (has_meta_data) meta_data.on_insert(cursor.pos, std::string_view{&ch, 1});
+    record_insert(cursor.pos, std::string_view{&ch, 1});
+
+    if (ch == '\n') {
+        cursor.line++;
+        cursor.col_pos = 0;
+    } else {
+        cursor.col_pos++;
+    }
+    cursor.pos++;
+    state_is_pristine = false;
+}
+
+void GapBuffer::insert_str(const std::string_view &data) {
+    move_gap_to(cursor.pos);
+    ensure_gap(data.size());
+    std::memcpy(store.data() + gap_begin, data.data(), data.size());
+    gap_begin += data.size();
+    if (has_meta_data) meta_data.on_insert(cursor.pos, data);
+    record_insert(cursor.pos, data);
+    cursor.pos += AS(data.size(), i64);
+    if (auto last_nl = data.rfind('\n'); last_nl != std::string_view::npos) {
+        cursor.line += AS(std::count(data.begin(), data.end(), '\n'), int);
+        cursor.col_pos = AS(data.size() - last_nl - 1, int);
+    } else {
+        cursor.col_pos += AS(data.size(), int);
+    }
+    state_is_pristine = false;
+}
+
+void GapBuffer::insert_str_owned(const std::string &ref_data) { insert_str(ref_data); }
+
+void GapBuffer::apply_batch(const std::vector<TextEdit> &edits) {
+    if (edits.empty()) return;
+    MICRO_BENCH("GapBuffer::apply_batch");
+    std::size_t inserted_total = 0;
+    for (const auto &e : edits) inserted_total += e.inserted.size();
+    // every insert of the batch fits in the gap from here on, whatever the removes give back is extra
+    ensure_gap(inserted_total);
+    const auto record = recording_edits();
+    std::vector<EditHistory::Replacement> replaced{};
+    if (record) replaced.reserve(edits.size());
+
+    // the gap moves forward from edit to edit, so all of them together move no more of the text than what is between
+    // the first & the last. delta is how much the edits made so far have moved the positions after them
+    i64 delta = 0;
+    const auto span_begin = edits.front().pos;
+    std::size_t span_end = span_begin;
+    for (const auto &e : edits) {
+        const auto pos = AS(AS(e.pos, i64) + delta, std::size_t);
+        move_gap_to(pos);
+        const auto removed = std::min(e.removed, size() - pos);
+        if (record && (removed > 0 || not e.inserted.empty())) {
+            replaced.push_back(EditHistory::Replacement{e.pos, std::string{store.data() + gap_end, removed},
+                                                        std::string{e.inserted}});
+        }
+        gap_end += removed;
+        // a delete's inserted text may be a null view, which memcpy mustn't get, even for 0 bytes
+        if (not e.inserted.empty()) std::memcpy(store.data() + gap_begin, e.inserted.data(), e.inserted.size());
+        gap_begin += e.inserted.size();
+        if (has_meta_data) {
+            if (removed > 0) meta_data.on_remove(pos, removed);
+            if (not e.inserted.empty()) meta_data.on_insert(pos, e.inserted);
+        }
+        delta += AS(e.inserted.size(), i64) - AS(removed, i64);
+        span_end = e.pos + removed;
+    }
+    record_batch(span_begin, span_end - span_begin, AS(AS(span_end - span_begin, i64) + delta, std::size_t),
+                 std::move(replaced));
+    state_is_pristine = false;
+}
+
+void GapBuffer::erase() {
+    if (cursor.pos < AS(size(), i64)) erase_range(cursor.pos, 1);
+}
+
+void GapBuffer::clear() {
+    store.assign(MIN_GAP_SIZE, 0);
+    gap_begin = 0;
+    gap_end = MIN_GAP_SIZE;
+    file_path.clear();
+    state_is_pristine = false;
+    clear_metadata();
+    data_is_pristine = true;
+}
+
+void GapBuffer::remove(const Movement &m) {
+    switch (m.construct) {
+        case Char:
+            m.dir == CursorDirection::Forward ? remove_ch_forward(m.count) : remove_ch_backward(m.count);
+            break;
+        case Word:
+            m.dir == CursorDirection::Forward ? remove_word_forward(m.count) : remove_word_backward(m.count);
+            break;
+        case Line:
+            m.dir == CursorDirection::Forward ? remove_line_forward(m.count) : remove_line_backward(m.count);
+            break;
+        default:
+            PANIC("Removing other than char, word, line is an error at this point");
+    }
+    state_is_pristine = false;
+}
+
+void GapBuffer::remove_ch_forward(size_t i) {
+    if (cursor.pos >= AS(size(), i64)) return;
+    erase_range(cursor.pos, i);
+}
+
+void GapBuffer::remove_ch_backward(size_t i) {
+    if (cursor.pos - AS(i, i64) >= 0) {
+        step_cursor_to(cursor.pos - i);
+        remove_ch_forward(i);
+    }
+}
+
+void GapBuffer::remove_word_forward(size_t count) {
+    auto sz = size();
+    if (cursor.pos + 1 >= AS(sz, i64)) {
+        remove_ch_forward(1);
+        return;
+    }
+    auto new_pos = find_next_delimiter(cursor.pos);
+    count--;
+    for (; count > 0; --count) { new_pos = find_next_delimiter(new_pos); }
+    remove_ch_forward(new_pos - cursor.pos);
+}
+
+void GapBuffer::remove_word_backward(size_t count) {
+    if (cursor.pos - 1 <= 0) {
+        remove_ch_backward(1);
+        return;
+    }
+    if (find_prev_delimiter(cursor.pos) == cursor.pos - 1) {
+        remove_ch_backward(1);
+        return;
+    }
+    auto new_pos = find_prev_delimiter(cursor.pos);
+    count--;
+    for (; count > 0; --count) { new_pos = find_prev_delimiter(new_pos); }
+    auto distance = cursor.pos - new_pos;
+    if (new_pos != 0) {
+        remove_ch_backward(distance - 1);
+    } else {
+        remove_ch_backward(distance);
+    }
+}
+
+void GapBuffer::remove_line_forward(size_t count) {
+    // the rest of the line & its newline, then the count - 1 lines after it
+    auto end = cursor.pos;
+    auto sz = AS(size(), i64);
+    for (; count > 0 && end < sz; --count) end = std::min(find_line_end(end) + 1, sz);
+    if (end > cursor.pos) remove_ch_forward(end - cursor.pos);
+}
+
+void GapBuffer::remove_line_backward(size_t count) {
+    // what's before the cursor on the line, then the count - 1 lines before it. At the beginning of a line, that's the
+    // line before it, newline & all
+    auto begin = cursor.pos;
+    for (; count > 0 && begin > 0; --count) begin = find_line_start(Boundary::Inside, begin - 1);
+    if (begin < cursor.pos) remove_ch_backward(cursor.pos - begin);
+}
+
+/// ----------- QUERIES ----------------
+
+size_t GapBuffer::get_cursor_pos() const { return cursor.pos; }
+std::size_t GapBuffer::size() const { return store.size() - gap_size(); }
+size_t GapBuffer::capacity() const { return store.size(); }
+BufferCursor &GapBuffer::get_cursor() { return cursor; }
+
+size_t GapBuffer::lines_count() const {
+    // every edit keeps the line index up to date, which has a line more than there are newlines
+    if (has_meta_data) return meta_data.line_count() - 1;
+    auto pre = std::count(store.begin(), store.begin() + gap_begin, '\n');
+    auto post = std::count(store.begin() + gap_end, store.end(), '\n');
+    return pre + post;
+}
+
+#ifdef DEBUG
+std::string GapBuffer::to_std_string() const {
+    std::string res;
+    res.reserve(size());
+    res.append(store.data(), gap_begin);
+    res.append(store.data() + gap_end, store.size() - gap_end);
+    return res;
+}
+
+std::string_view GapBuffer::to_string_view() { return view_range(0, size()); }
+
+void GapBuffer::load_string(std::string &&data) {
+    set_string(data);
+}
+
+void GapBuffer::set_string(std::string &data) {
+    store.resize(data.size() + MIN_GAP_SIZE);
+    std::memcpy(store.data(), data.data(), data.size());
+    // gap is placed at the end, so that the first insert at the top of the file is the only expensive one
+    gap_begin = data.size();
+    gap_end = store.size();
+    meta_data.line_index.assign(data);
+    state_is_pristine = false;
+    all_text_changed();
+    data_is_pristine = true;
+}
+#endif
+
+/// ----------- META DATA ----------------
+
+void GapBuffer::rebuild_metadata() {
+    if (has_meta_data && (not data_is_pristine || info == BufferTypeInfo::Modal)) {
+        // index the two halves separately, so that we don't have to move the gap just to count lines
+        meta_data.line_index.assign(std::string_view{store.data(), gap_begin},
+                                    std::string_view{store.data() + gap_end, store.size() - gap_end});
+    }
+    state_is_pristine = false;
+    data_is_pristine = true;
+}
+
+void GapBuffer::set_bookmark() {
+    auto &bm = meta_data.bookmarks;
+    if (std::ranges::any_of(bm, [l = cursor.line](auto &b) { return b.line_number == l; })) { return; }
+    auto line_begin = find_line_start(Boundary::Inside, cursor.pos);
+    auto line_end = find_line_end(cursor.pos);
+    if (line_begin > line_end) { return; }
+
+    std::string line_contents;
+    line_contents.reserve(line_end - line_begin);
+    for (auto i = line_begin; i < line_end; i++) line_contents.push_back(at(i));
+    auto it = std::ranges::find_if(line_contents, [](auto e) { return !std::isspace(e); });
+    line_contents.erase(line_contents.begin(), it);
+
+    if (not line_contents.empty()) {
+        auto insert_at = std::ranges::upper_bound(bm, cursor.line, {}, &Bookmark::line_number);
+        auto added = bm.emplace(insert_at, cursor.line, std::move(line_contents));
+        util::println("Set bookmark at {}: '{}'", cursor.line, added->line_contents);
+    }
+}
+
+void GapBuffer::set_mark_at_cursor() {
+    mark = cursor;
+    mark_set = true;
+}
+
+void GapBuffer::set_mark_from_cursor(int length) {
+    auto tmp = cursor;
+    step_cursor_to(cursor.pos + length);
+    mark = cursor;
+    cursor = tmp;
+    mark_set = true;
+}
+
+void GapBuffer::clear_marks() {
+    mark_set = false;
+    mark.reset();
+}
+
+std::pair<BufferCursor, BufferCursor> GapBuffer::get_cursor_rect() const {
+    if (mark_set) {
+        if (mark.pos < cursor.pos) {
+            return std::make_pair(mark.clone(), cursor.clone());
+        } else {
+            return std::make_pair(cursor.clone(), mark.clone());
+        }
+    } else {
+        return std::make_pair(cursor.clone(), cursor.clone());
+    }
+}
+
+std::string_view GapBuffer::copy_range(std::pair<BufferCursor, BufferCursor> selected_range) {
+    auto &[b, e] = selected_range;
+    auto pristine = state_is_pristine;
+    auto v = view_range(b.pos, AS(e.pos - b.pos, size_t));
+    state_is_pristine = pristine;
+    return v;
+}
+
+std::vector<std::string_view> GapBuffer::chunks(std::size_t begin, std::size_t end) const {
+    end = std::min(end, size());
+    std::vector<std::string_view> result{};
+    if (begin < std::min(end, gap_begin)) result.emplace_back(store.data() + begin, std::min(end, gap_begin) - begin);
+    if (end > gap_begin) {
+        auto first = std::max(begin, gap_begin);
+        if (first < end) result.emplace_back(store.data() + first + gap_size(), end - first);
+    }
+    return result;
+}
+
+void GapBuffer::append_loaded(std::string_view text, const std::vector<std::size_t> &line_lengths) {
+    if (text.empty()) return;
+    const auto at = std::min(load_end, size());
+    if (at == size()) {
+        // the end of the store is the end of the text, wherever the gap is, so the gap stays where the user is editing
+        store.insert(store.end(), text.begin(), text.end());
+        if (has_meta_data) meta_data.line_index.append(line_lengths);
+    } else {
+        // before what the user typed at the end, while loading
+        move_gap_to(at);
+        ensure_gap(text.size());
+        std::memcpy(store.data() + gap_begin, text.data(), text.size());
+        gap_begin += text.size();
+        if (has_meta_data) meta_data.on_insert(at, text);
+    }
+    state_is_pristine = false;
+    record_loaded(at, text.size());
+}
+
+/// ----------- INIT ----------------
+
+std::unique_ptr<TextData> GapBuffer::make_handle() {
+    auto buf = std::make_unique<GapBuffer>();
+    buf->id = DataManager::get_instance().get_new_id();
+    buf->cursor.buffer_id = buf->id;
+    return buf;
+}
+
+TextData *GapBuffer::make_non_owning() {
+    auto buf = new GapBuffer;
+    buf->id = DataManager::get_instance().get_new_id();
+    buf->cursor.buffer_id = buf->id;
+    buf->has_meta_data = false;
+    return buf;
+}
+
+GapBuffer::~GapBuffer() {
+    if (DataManager::get_instance().is_managed(id)) {
+        DataManager::get_instance().print_all_managed();
+        PANIC("ERROR. BUFFER IS TRYING TO DESTROY ITSELF. THAT IS HANDLED BY DATAMANAGER. ID: {}", id);
+    }
+}
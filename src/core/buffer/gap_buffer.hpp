@@ -0,0 +1,112 @@
+//
+// Created by 46769 on 2021-02-06.
+//
+
+#pragma once
+#include "text_data.hpp"
+#include <vector>
+
+/**
+ * Gap buffer implementation of TextData. The text is stored in one contiguous block of memory, with a "gap" of unused
+ * bytes placed at the position where editing happens. Inserting or removing at the gap is O(1) (amortized, when the gap
+ * has to grow) and moving the gap costs only the distance it is moved, so typing at the top of a 40MB file no longer
+ * memmoves the entire tail of the file for every key stroke, like StdStringBuffer does.
+ *
+ *  [h e l l o _ _ _ _ _ w o r l d]
+ *             ^         ^
+ *         gap_begin   gap_end
+ *
+ * Logical positions (the ones BufferCursor talks about) never include the gap. Use at() for single characters and
+ * view_range() when a contiguous string_view is needed (rendering, lexing, searching).
+ */
+class GapBuffer : public TextData {
+public:
+    explicit GapBuffer() : TextData(), store(MIN_GAP_SIZE), gap_begin(0), gap_end(MIN_GAP_SIZE) {
+        // empty buffer, empty line index ({0}). Every edit keeps it up to date from here on
+        data_is_pristine = true;
+    }
+    ~GapBuffer() override;
+
+    /// EDITING
+    void insert(char ch) override;
+    void insert_str(const std::string_view &data) override;
+    void insert_str_owned(const std::string &ref_data) override;
+    void clear() override;
+
+    void remove(const Movement &m) override;
+    void erase() override;
+
+    /// CURSOR OPS
+    size_t get_cursor_pos() const override;
+    std::size_t size() const override;
+    size_t capacity() const override;
+    void move_cursor(Movement m) override;
+    void step_cursor_to(size_t pos) override;
+    BufferCursor &get_cursor() override;
+
+    /// INIT CALLS
+    static std::unique_ptr<TextData> make_handle();
+    static TextData *make_non_owning();
+
+    /// SEARCH OPS
+    size_t lines_count() const override;
+
+    void step_to_line_end(Boundary boundary) override;
+    void step_to_line_begin(Boundary boundary) override;
+
+#ifdef DEBUG
+    std::string to_std_string() const override;
+    std::string_view to_string_view() override;
+    void load_string(std::string &&data) override;
+    void set_string(std::string &data) override;
+#endif
+
+    // Meta data
+    void rebuild_metadata() override;
+    void set_bookmark() override;
+
+    void set_mark_at_cursor() override;
+    void set_mark_from_cursor(int length) override;
+    void clear_marks() override;
+    std::pair<BufferCursor, BufferCursor> get_cursor_rect() const override;
+    std::string_view copy_range(std::pair<BufferCursor, BufferCursor> selected_range) override;
+    std::string_view view_range(std::size_t begin, std::size_t length) override;
+    /// The text before the gap, & the text after it
+    [[nodiscard]] std::vector<std::string_view> chunks(std::size_t begin, std::size_t end) const override;
+    void append_loaded(std::string_view text, const std::vector<std::size_t> &line_lengths) override;
+    /// Makes the edits in one pass over the text, with the gap moving from the first to the last
+    void apply_batch(const std::vector<TextEdit> &edits) override;
+
+    /// Character at logical position i. Does not move the gap
+    [[nodiscard]] char at(std::size_t i) const { return (i < gap_begin) ? store[i] : store[i + gap_size()]; }
+
+private:
+    static constexpr std::size_t MIN_GAP_SIZE = 1024;
+    std::vector<char> store;
+    std::size_t gap_begin;
+    std::size_t gap_end;
+
+    [[nodiscard]] std::size_t gap_size() const { return gap_end - gap_begin; }
+    void move_gap_to(std::size_t pos);
+    void ensure_gap(std::size_t required);
+    /// Removes length characters at pos and updates the line index accordingly
+    void erase_range(std::size_t pos, std::size_t length);
+
+    void char_move_forward(std::size_t count) override;
+    void char_move_backward(std::size_t count) override;
+    void word_move_forward(std::size_t count) override;
+    void word_move_backward(std::size_t count) override;
+    void line_move_forward(std::size_t count) override;
+    void line_move_backward(std::size_t count) override;
+    void remove_ch_forward(size_t i);
+    void remove_ch_backward(size_t i);
+    void remove_word_forward(size_t i);
+    void remove_word_backward(size_t i);
+    void remove_line_forward(size_t count);
+    void remove_line_backward(size_t count);
+
+    i64 find_line_end(i64 i);
+    i64 find_next_delimiter(i64 i);
+    i64 find_prev_delimiter(i64 i);
+    i64 find_line_start(Boundary boundary, i64 i);
+};
@@ -0,0 +1,356 @@
+//
+// Created by 46769 on 2021-02-07.
+//
+
+#include "line_index.hpp"
+#include <algorithm>
+#include <core/strops.hpp>
+#include <numeric>
+
+namespace {
+    // the max amount of line lengths per leaf and children per internal node. when a node overflows it is split in
+    // two, when it drops below a quarter of this, it gets merged with its neighbour, if they fit together
+    constexpr std::size_t LEAF_MAX = 256;
+    constexpr std::size_t NODE_MAX = 32;
+    // edits of fewer lines than this are always made line by line; one line costs about as much as rebuilding this
+    // many lines of the tree
+    constexpr std::size_t BULK_LINES = 1024;
+    constexpr std::size_t REBUILD_LINES_PER_EDITED_LINE = 8;
+}// namespace
+
+struct LineIndex::Node {
+    bool leaf{true};
+    std::size_t lines{0};
+    std::size_t bytes{0};
+    std::vector<std::size_t> lengths{};
+    std::vector<std::unique_ptr<Node>> children{};
+
+    [[nodiscard]] std::size_t entries() const { return leaf ? lengths.size() : children.size(); }
+    [[nodiscard]] std::size_t max_entries() const { return leaf ? LEAF_MAX : NODE_MAX; }
+
+    void recount() {
+        if (leaf) {
+            lines = lengths.size();
+            bytes = std::accumulate(lengths.begin(), lengths.end(), std::size_t{0});
+        } else {
+            lines = 0;
+            bytes = 0;
+            for (const auto &c : children) {
+                lines += c->lines;
+                bytes += c->bytes;
+            }
+        }
+    }
+
+    [[nodiscard]] std::unique_ptr<Node> clone() const {
+        auto n = std::make_unique<Node>();
+        n->leaf = leaf;
+        n->lines = lines;
+        n->bytes = bytes;
+        n->lengths = lengths;
+        n->children.reserve(children.size());
+        for (const auto &c : children) n->children.push_back(c->clone());
+        return n;
+    }
+
+    /// Moves the upper half of this node's entries into a new sibling, which is returned
+    std::unique_ptr<Node> split() {
+        auto sibling = std::make_unique<Node>();
+        sibling->leaf = leaf;
+        if (leaf) {
+            auto mid = lengths.begin() + static_cast<std::ptrdiff_t>(lengths.size() / 2);
+            sibling->lengths.assign(mid, lengths.end());
+            lengths.erase(mid, lengths.end());
+        } else {
+            auto mid = children.begin() + static_cast<std::ptrdiff_t>(children.size() / 2);
+            sibling->children.assign(std::make_move_iterator(mid), std::make_move_iterator(children.end()));
+            children.erase(mid, children.end());
+        }
+        recount();
+        sibling->recount();
+        return sibling;
+    }
+
+    /// Moves all of other's entries to the end of this node
+    void absorb(Node &other) {
+        if (leaf) {
+            lengths.insert(lengths.end(), other.lengths.begin(), other.lengths.end());
+        } else {
+            children.insert(children.end(), std::make_move_iterator(other.children.begin()),
+                            std::make_move_iterator(other.children.end()));
+        }
+        lines += other.lines;
+        bytes += other.bytes;
+    }
+
+    /// Finds the child that line is in. line is made relative to that child
+    std::size_t child_of_line(std::size_t &line, bool inclusive) const {
+        std::size_t i = 0;
+        for (; i + 1 < children.size(); ++i) {
+            if (line < children[i]->lines || (inclusive && line == children[i]->lines)) break;
+            line -= children[i]->lines;
+        }
+        return i;
+    }
+};
+
+/// ----------- TREE OPERATIONS ----------------
+
+std::unique_ptr<LineIndex::Node> LineIndex::insert_into(Node *n, std::size_t line, std::size_t length) {
+    n->lines += 1;
+    n->bytes += length;
+    if (n->leaf) {
+        n->lengths.insert(n->lengths.begin() + static_cast<std::ptrdiff_t>(line), length);
+    } else {
+        auto i = n->child_of_line(line, true);
+        if (auto sibling = insert_into(n->children[i].get(), line, length); sibling) {
+            n->children.insert(n->children.begin() + static_cast<std::ptrdiff_t>(i) + 1, std::move(sibling));
+        }
+    }
+    return (n->entries() > n->max_entries()) ? n->split() : nullptr;
+}
+
+void LineIndex::merge_if_underfull(Node *n, std::size_t i) {
+    auto &c = n->children[i];
+    if (c->lines == 0) {
+        n->children.erase(n->children.begin() + static_cast<std::ptrdiff_t>(i));
+        return;
+    }
+    if (n->children.size() < 2 || c->entries() >= c->max_entries() / 4) return;
+    auto lo = (i + 1 < n->children.size()) ? i : i - 1;
+    auto &a = n->children[lo];
+    auto &b = n->children[lo + 1];
+    if (a->entries() + b->entries() > a->max_entries()) return;
+    a->absorb(*b);
+    n->children.erase(n->children.begin() + static_cast<std::ptrdiff_t>(lo) + 1);
+}
+
+void LineIndex::erase_from(Node *n, std::size_t line) {
+    n->lines -= 1;
+    if (n->leaf) {
+        n->bytes -= n->lengths[line];
+        n->lengths.erase(n->lengths.begin() + static_cast<std::ptrdiff_t>(line));
+        return;
+    }
+    auto i = n->child_of_line(line, false);
+    auto &c = n->children[i];
+    auto bytes_before = c->bytes;
+    erase_from(c.get(), line);
+    n->bytes -= bytes_before - c->bytes;
+    merge_if_underfull(n, i);
+}
+
+/// ----------- LINE INDEX ----------------
+
+LineIndex::LineIndex() : root(std::make_unique<Node>()) {
+    root->lengths.push_back(0);
+    root->recount();
+}
+
+LineIndex::~LineIndex() = default;
+LineIndex::LineIndex(const LineIndex &other) : root(other.root->clone()) {}
+LineIndex::LineIndex(LineIndex &&other) noexcept = default;
+LineIndex &LineIndex::operator=(const LineIndex &other) {
+    if (this != &other) root = other.root->clone();
+    return *this;
+}
+LineIndex &LineIndex::operator=(LineIndex &&other) noexcept = default;
+
+void LineIndex::build(const std::vector<std::size_t> &lengths) {
+    // fill nodes halfway, so that edits don't have to start with splitting every node they touch
+    std::vector<std::unique_ptr<Node>> level{};
+    for (std::size_t i = 0; i < lengths.size(); i += LEAF_MAX / 2) {
+        auto leaf = std::make_unique<Node>();
+        auto end = std::min(lengths.size(), i + LEAF_MAX / 2);
+        leaf->lengths.assign(lengths.begin() + static_cast<std::ptrdiff_t>(i),
+                             lengths.begin() + static_cast<std::ptrdiff_t>(end));
+        leaf->recount();
+        level.push_back(std::move(leaf));
+    }
+    while (level.size() > 1) {
+        std::vector<std::unique_ptr<Node>> parents{};
+        for (std::size_t i = 0; i < level.size(); i += NODE_MAX / 2) {
+            auto parent = std::make_unique<Node>();
+            parent->leaf = false;
+            auto end = std::min(level.size(), i + NODE_MAX / 2);
+            for (auto c = i; c < end; ++c) parent->children.push_back(std::move(level[c]));
+            parent->recount();
+            parents.push_back(std::move(parent));
+        }
+        level = std::move(parents);
+    }
+    root = std::move(level.front());
+}
+
+void LineIndex::assign(std::string_view first, std::string_view second) {
+    std::string_view parts[]{first, second};
+    assign(parts);
+}
+
+void LineIndex::assign(std::span<const std::string_view> parts) { build(line_lengths(parts)); }
+
+void LineIndex::append(const std::vector<std::size_t> &lengths) {
+    if (lengths.empty()) return;
+    // the first length continues what used to be the last line, the rest are new lines
+    auto last = line_count() - 1;
+    set_line_length(last, line_length(last) + lengths.front());
+    for (std::size_t i = 1; i < lengths.size(); ++i) insert_line(line_count(), lengths[i]);
+}
+
+std::vector<std::size_t> LineIndex::line_lengths(std::span<const std::string_view> parts) {
+    std::size_t total = 0;
+    for (auto part : parts) total += part.size();
+    std::vector<std::size_t> lengths{0};
+    lengths.reserve(total / 64);
+    std::size_t base = 0;
+    for (auto part : parts) {
+        str::find_line_starts(part.data(), part.size(), base, lengths);
+        base += part.size();
+    }
+    // line begins [0, b1, b2, .., total] -> line lengths [b1, b2 - b1, .., total - bn]
+    lengths.push_back(total);
+    std::adjacent_difference(lengths.begin(), lengths.end(), lengths.begin());
+    lengths.erase(lengths.begin());
+    return lengths;
+}
+
+std::size_t LineIndex::line_count() const { return root->lines; }
+std::size_t LineIndex::text_size() const { return root->bytes; }
+
+std::size_t LineIndex::line_begin(std::size_t line) const {
+    if (line >= line_count()) return text_size();
+    const Node *n = root.get();
+    std::size_t offset = 0;
+    while (not n->leaf) {
+        std::size_t i = 0;
+        for (; i + 1 < n->children.size() && line >= n->children[i]->lines; ++i) {
+            line -= n->children[i]->lines;
+            offset += n->children[i]->bytes;
+        }
+        n = n->children[i].get();
+    }
+    for (std::size_t i = 0; i < line; ++i) offset += n->lengths[i];
+    return offset;
+}
+
+std::size_t LineIndex::line_length(std::size_t line) const {
+    if (line >= line_count()) return 0;
+    const Node *n = root.get();
+    while (not n->leaf) { n = n->children[n->child_of_line(line, false)].get(); }
+    return n->lengths[line];
+}
+
+std::size_t LineIndex::line_of(std::size_t pos) const {
+    const Node *n = root.get();
+    std::size_t line = 0;
+    while (not n->leaf) {
+        std::size_t i = 0;
+        for (; i + 1 < n->children.size() && pos >= n->children[i]->bytes; ++i) {
+            pos -= n->children[i]->bytes;
+            line += n->children[i]->lines;
+        }
+        n = n->children[i].get();
+    }
+    std::size_t i = 0;
+    for (; i + 1 < n->lengths.size() && pos >= n->lengths[i]; ++i) { pos -= n->lengths[i]; }
+    return line + i;
+}
+
+void LineIndex::set_line_length(std::size_t line, std::size_t length) {
+    std::vector<Node *> path{};
+    Node *n = root.get();
+    while (not n->leaf) {
+        path.push_back(n);
+        n = n->children[n->child_of_line(line, false)].get();
+    }
+    path.push_back(n);
+    auto old_length = n->lengths[line];
+    n->lengths[line] = length;
+    for (auto p : path) p->bytes = p->bytes - old_length + length;
+}
+
+void LineIndex::insert_line(std::size_t line, std::size_t length) {
+    if (auto sibling = insert_into(root.get(), line, length); sibling) {
+        auto new_root = std::make_unique<Node>();
+        new_root->leaf = false;
+        new_root->children.push_back(std::move(root));
+        new_root->children.push_back(std::move(sibling));
+        new_root->recount();
+        root = std::move(new_root);
+    }
+}
+
+void LineIndex::erase_line(std::size_t line) {
+    erase_from(root.get(), line);
+    while (not root->leaf && root->children.size() == 1) { root = std::move(root->children.front()); }
+}
+
+bool LineIndex::rebuild_is_cheaper(std::size_t lines) const {
+    return lines >= BULK_LINES && lines * REBUILD_LINES_PER_EDITED_LINE >= line_count();
+}
+
+std::vector<std::size_t> LineIndex::lengths() const {
+    std::vector<std::size_t> result{};
+    result.reserve(line_count());
+    auto collect = [&](auto &self, const Node *n) -> void {
+        if (n->leaf) {
+            result.insert(result.end(), n->lengths.begin(), n->lengths.end());
+            return;
+        }
+        for (const auto &c : n->children) self(self, c.get());
+    };
+    collect(collect, root.get());
+    return result;
+}
+
+void LineIndex::on_insert(std::size_t pos, std::string_view text) {
+    if (text.empty()) return;
+    auto line = line_of(pos);
+    auto column = pos - line_begin(line);
+    auto length = line_length(line);
+    if (text.find('\n') == std::string_view::npos) {
+        set_line_length(line, length + text.size());
+        return;
+    }
+    const auto inserted = line_lengths(std::span<const std::string_view>{&text, 1});
+    // the line pos is on, now ends with the first newline inserted, every newline after that begins a new line, and
+    // the last one gets the remainder of the original line
+    const auto first = column + inserted.front();
+    const auto last = inserted.back() + (length - column);
+    if (rebuild_is_cheaper(inserted.size())) {
+        auto all = lengths();
+        std::vector<std::size_t> spliced{};
+        spliced.reserve(all.size() + inserted.size() - 1);
+        spliced.insert(spliced.end(), all.begin(), all.begin() + static_cast<std::ptrdiff_t>(line));
+        spliced.push_back(first);
+        spliced.insert(spliced.end(), inserted.begin() + 1, inserted.end() - 1);
+        spliced.push_back(last);
+        spliced.insert(spliced.end(), all.begin() + static_cast<std::ptrdiff_t>(line + 1), all.end());
+        build(spliced);
+        return;
+    }
+    set_line_length(line, first);
+    for (auto it = inserted.begin() + 1; it + 1 != inserted.end(); ++it) insert_line(++line, *it);
+    insert_line(line + 1, last);
+}
+
+std::size_t LineIndex::on_remove(std::size_t pos, std::size_t length) {
+    if (length == 0) return 0;
+    auto first = line_of(pos);
+    auto last = line_of(pos + length);
+    auto first_column = pos - line_begin(first);
+    auto last_column = pos + length - line_begin(last);
+    // what's left of first, is joined with what's left of last
+    const auto joined = first_column + line_length(last) - last_column;
+    if (rebuild_is_cheaper(last - first)) {
+        auto all = lengths();
+        all[first] = joined;
+        all.erase(all.begin() + static_cast<std::ptrdiff_t>(first + 1),
+                  all.begin() + static_cast<std::ptrdiff_t>(last + 1));
+        build(all);
+        return last - first;
+    }
+    set_line_length(first, joined);
+    for (auto l = last; l > first; --l) erase_line(first + 1);
+    return last - first;
+}
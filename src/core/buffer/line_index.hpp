@@ -0,0 +1,74 @@
+//
+// Created by 46769 on 2021-02-07.
+//
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/**
+ * Maps between byte offsets and line numbers of a text buffer. Internally a B+-tree, where the leaves hold the length
+ * of each line (including its terminating newline, the last line has none) and every node caches the amount of lines
+ * and bytes in its sub tree. This makes offset -> line, line -> offset, and inserting / removing lines O(log n),
+ * instead of having to shift every line begin after the edit point, like a flat vector of line begins has to.
+ *
+ * An empty text has one line, of length 0. Offsets and line numbers are 64-bit all the way through, so files > 2GB
+ * are not a problem.
+ */
+class LineIndex {
+public:
+    LineIndex();
+    ~LineIndex();
+    LineIndex(const LineIndex &other);
+    LineIndex(LineIndex &&other) noexcept;
+    LineIndex &operator=(const LineIndex &other);
+    LineIndex &operator=(LineIndex &&other) noexcept;
+
+    /// Rebuilds the index for the text first + second. Two parts, so that GapBuffer can pass the text on either side
+    /// of the gap, without having to close it first.
+    void assign(std::string_view first, std::string_view second = {});
+    /// Rebuilds the index for the concatenation of parts
+    void assign(std::span<const std::string_view> parts);
+    /// Appends the lines of text that was added to the end. lengths are what line_lengths returns for that text, so the
+    /// scanning can be done on another thread
+    void append(const std::vector<std::size_t> &lengths);
+    /// Lengths of the lines in the concatenation of parts. The last one has no newline, and may be 0
+    static std::vector<std::size_t> line_lengths(std::span<const std::string_view> parts);
+
+    /// Keeps the index in sync with text having been inserted at pos. An insert of more lines than the index has a
+    /// small fraction of (a large paste) splices them in and rebuilds the tree once, instead of inserting line by line
+    void on_insert(std::size_t pos, std::string_view text);
+    /// Keeps the index in sync with [pos, pos + length) having been removed. Returns the amount of lines removed. Like
+    /// on_insert, removing a large part of the lines rebuilds the tree from what's left
+    std::size_t on_remove(std::size_t pos, std::size_t length);
+    /// The length of every line, in order
+    [[nodiscard]] std::vector<std::size_t> lengths() const;
+
+    [[nodiscard]] std::size_t line_count() const;
+    /// Total size of the indexed text, in bytes
+    [[nodiscard]] std::size_t text_size() const;
+    /// Offset of the first character on line. line_begin(line_count()) returns text_size()
+    [[nodiscard]] std::size_t line_begin(std::size_t line) const;
+    /// Length of line, including its newline
+    [[nodiscard]] std::size_t line_length(std::size_t line) const;
+    /// Line that offset pos is on
+    [[nodiscard]] std::size_t line_of(std::size_t pos) const;
+
+private:
+    struct Node;
+    std::unique_ptr<Node> root;
+
+    void set_line_length(std::size_t line, std::size_t length);
+    void insert_line(std::size_t line, std::size_t length);
+    void erase_line(std::size_t line);
+    void build(const std::vector<std::size_t> &lengths);
+    /// Whether changing this many lines one at a time costs more than rebuilding the tree
+    [[nodiscard]] bool rebuild_is_cheaper(std::size_t lines) const;
+
+    static std::unique_ptr<Node> insert_into(Node *n, std::size_t line, std::size_t length);
+    static void erase_from(Node *n, std::size_t line);
+    static void merge_if_underfull(Node *n, std::size_t i);
+};
@@ -0,0 +1,590 @@
+//
+// Created by 46769 on 2021-02-09.
+//
+
+#include "mapped_buffer.hpp"
+#include "data_manager.hpp"
+
+/// ----------- PIECE MANAGEMENT ----------------
+
+std::string_view MappedBuffer::piece_view(const Piece &piece) const {
+    if (piece.source == Source::File) return file->view().substr(piece.offset, piece.length);
+    return std::string_view{added}.substr(piece.offset, piece.length);
+}
+
+std::size_t MappedBuffer::piece_at(std::size_t pos) const {
+    assert(pos < size());
+    auto it = std::upper_bound(piece_begins.begin(), piece_begins.end(), pos);
+    return AS(std::distance(piece_begins.begin(), it) - 1, std::size_t);
+}
+
+std::size_t MappedBuffer::split_at(std::size_t pos) {
+    if (pos >= size()) return pieces.size();
+    auto idx = piece_at(pos);
+    auto offset = pos - piece_begins[idx];
+    if (offset == 0) return idx;
+    auto &piece = pieces[idx];
+    Piece tail{piece.source, piece.offset + offset, piece.length - offset};
+    piece.length = offset;
+    pieces.insert(pieces.begin() + AS(idx + 1, std::ptrdiff_t), tail);
+    update_piece_begins();
+    return idx + 1;
+}
+
+void MappedBuffer::update_piece_begins() {
+    piece_begins.resize(pieces.size() + 1);
+    piece_begins[0] = 0;
+    for (std::size_t i = 0; i < pieces.size(); ++i) piece_begins[i + 1] = piece_begins[i] + pieces[i].length;
+}
+
+void MappedBuffer::erase_range(std::size_t pos, std::size_t length) {
+    length = std::min(length, size() - pos);
+    if (length == 0) return;
+    auto first = split_at(pos);
+    auto last = split_at(pos + length);
+    if (last - first == 1) {
+        record_remove(pos, piece_view(pieces[first]));
+    } else {
+        std::string removed{};
+        removed.reserve(length);
+        for (auto i = first; i < last; ++i) removed.append(piece_view(pieces[i]));
+        record_remove(pos, removed);
+    }
+    pieces.erase(pieces.begin() + AS(first, std::ptrdiff_t), pieces.begin() + AS(last, std::ptrdiff_t));
+    update_piece_begins();
+    meta_data.on_remove(pos, length);
+}
+
+void MappedBuffer::take_ownership(std::string &&data) {
+    added = std::move(data);
+    pieces.clear();
+    if (not added.empty()) pieces.push_back(Piece{Source::Added, 0, added.size()});
+    update_piece_begins();
+    // a FileLoader still appending from the mapping means it's not ours to let go of yet
+    if (not meta_data.load_progress) file.reset();
+}
+
+char MappedBuffer::at(std::size_t i) const {
+    auto idx = piece_at(i);
+    return piece_view(pieces[idx])[i - piece_begins[idx]];
+}
+
+std::string_view MappedBuffer::view_range(std::size_t begin, std::size_t length) {
+    state_is_pristine = true;
+    begin = std::min(begin, size());
+    length = std::min(length, size() - begin);
+    if (length == 0) return {};
+    auto idx = piece_at(begin);
+    if (begin + length <= piece_begins[idx + 1]) {
+        return piece_view(pieces[idx]).substr(begin - piece_begins[idx], length);
+    }
+    // the range spans multiple pieces, which is the only time we have to copy anything. The visible part of the
+    // buffer is never very large
+    scratch.clear();
+    scratch.reserve(length);
+    auto remaining = length;
+    auto offset = begin - piece_begins[idx];
+    for (; remaining > 0; ++idx, offset = 0) {
+        auto part = piece_view(pieces[idx]).substr(offset, remaining);
+        scratch.append(part);
+        remaining -= part.size();
+    }
+    return scratch;
+}
+
+std::vector<std::string_view> MappedBuffer::chunks(std::size_t begin, std::size_t end) const {
+    end = std::min(end, size());
+    std::vector<std::string_view> result{};
+    if (begin >= end) return result;
+    for (auto idx = piece_at(begin); idx < pieces.size() && piece_begins[idx] < end; ++idx) {
+        auto first = std::max(begin, piece_begins[idx]);
+        auto last = std::min(end, piece_begins[idx + 1]);
+        result.push_back(piece_view(pieces[idx]).substr(first - piece_begins[idx], last - first));
+    }
+    return result;
+}
+
+std::vector<TextSnapshot::Piece> MappedBuffer::snapshot_pieces(std::size_t begin, std::size_t end) const {
+    end = std::min(end, size());
+    std::vector<TextSnapshot::Piece> result{};
+    if (begin >= end) return result;
+    // added is appended to, & moves when it grows, so what's of it is copied, a run of pieces at a time
+    std::vector<std::string_view> added_run{};
+    auto copy_added_run = [&]() {
+        if (added_run.empty()) return;
+        for (auto &piece : TextSnapshot::copy_of(added_run)) result.push_back(std::move(piece));
+        added_run.clear();
+    };
+    for (auto idx = piece_at(begin); idx < pieces.size() && piece_begins[idx] < end; ++idx) {
+        auto first = std::max(begin, piece_begins[idx]);
+        auto last = std::min(end, piece_begins[idx + 1]);
+        auto text = piece_view(pieces[idx]).substr(first - piece_begins[idx], last - first);
+        if (pieces[idx].source == Source::Added) {
+            added_run.push_back(text);
+            continue;
+        }
+        copy_added_run();
+        result.push_back(TextSnapshot::Piece{file, text});
+    }
+    copy_added_run();
+    return result;
+}
+
+/// ----------- CURSOR MOVEMENT ----------------
+
+void MappedBuffer::move_cursor(Movement m) {
+    switch (m.construct) {
+        case Char:
+            m.dir == CursorDirection::Forward ? char_move_forward(m.count) : char_move_backward(m.count);
+            break;
+        case Word:
+            m.dir == CursorDirection::Forward ? word_move_forward(m.count) : word_move_backward(m.count);
+            break;
+        case Line:
+            m.dir == CursorDirection::Forward ? line_move_forward(m.count) : line_move_backward(m.count);
+            break;
+        default:
+            PANIC("Block and file movements not yet implemented");
+    }
+    state_is_pristine = false;
+}
+
+void MappedBuffer::set_cursor(std::size_t pos) {
+    cursor.line = meta_data.line_of(pos);
+    cursor.pos = AS(pos, i64);
+    cursor.col_pos = AS(pos - meta_data.line_begin(cursor.line), int);
+    state_is_pristine = false;
+}
+
+std::size_t MappedBuffer::line_text_length(std::size_t line) const {
+    auto length = meta_data.line_index.line_length(line);
+    return line + 1 < meta_data.line_count() ? length - 1 : length;
+}
+
+void MappedBuffer::char_move_forward(std::size_t count) {
+    step_cursor_to(std::min<std::size_t>(cursor.pos + count, size()));
+}
+
+void MappedBuffer::char_move_backward(std::size_t count) {
+    step_cursor_to(AS(std::max<i64>(0, cursor.pos - AS(count, i64)), std::size_t));
+}
+
+void MappedBuffer::word_move_forward(std::size_t count) {
+    auto sz = size();
+    if (cursor.pos + 1 >= AS(sz, i64)) {
+        step_cursor_to(sz);
+        return;
+    }
+    auto new_pos = find_next_delimiter(cursor.pos);
+    count--;
+    for (; count > 0; --count) { new_pos = find_next_delimiter(new_pos); }
+    step_cursor_to(new_pos);
+}
+
+void MappedBuffer::word_move_backward(std::size_t count) {
+    if (cursor.pos - 1 <= 0) {
+        step_cursor_to(0);
+        return;
+    }
+    auto new_pos = find_prev_delimiter(cursor.pos);
+    count--;
+    for (; count > 0; --count) { new_pos = find_prev_delimiter(new_pos); }
+    step_cursor_to(new_pos);
+}
+
+void MappedBuffer::line_move_forward(std::size_t count) {
+    auto line = AS(cursor.line, std::size_t) + count;
+    if (line >= meta_data.line_count()) {
+        step_cursor_to(size());
+        return;
+    }
+    auto column = std::min(AS(cursor.col_pos, std::size_t), line_text_length(line));
+    step_cursor_to(meta_data.line_begin(line) + column);
+}
+
+void MappedBuffer::line_move_backward(std::size_t count) {
+    if (count > AS(cursor.line, std::size_t)) {
+        step_cursor_to(0);
+        return;
+    }
+    auto line = cursor.line - count;
+    auto column = std::min(AS(cursor.col_pos, std::size_t), line_text_length(line));
+    step_cursor_to(meta_data.line_begin(line) + column);
+}
+
+void MappedBuffer::step_cursor_to(size_t pos) {
+    if (pos == 0) {
+        cursor.reset();
+        state_is_pristine = false;
+        return;
+    }
+    if (AS(pos, i64) == cursor.pos) return;
+    set_cursor(std::min(pos, size()));
+}
+
+void MappedBuffer::step_to_line_end(Boundary boundary) {
+    auto line = AS(cursor.line, std::size_t);
+    if (line + 1 >= meta_data.line_count()) {
+        step_cursor_to(size());
+        return;
+    }
+    auto newline = meta_data.line_begin(line + 1) - 1;
+    auto line_begin = meta_data.line_begin(line);
+    step_cursor_to(boundary == Boundary::Inside ? std::max(line_begin, newline - 1) : newline);
+}
+
+void MappedBuffer::step_to_line_begin(Boundary boundary) {
+    auto line_begin = meta_data.line_begin(cursor.line);
+    step_cursor_to(boundary == Boundary::Outside && line_begin > 0 ? line_begin - 1 : line_begin);
+}
+
+i64 MappedBuffer::find_next_delimiter(i64 i) const {
+    auto sz = AS(size(), i64);
+    if (i < sz && is_delimiter(at(i))) {
+        // we are already standing on whitespace... scan until we are no longer on whitespace
+        while (i < sz) {
+            if (not is_delimiter(at(i))) return i;
+            i++;
+        }
+        return i;
+    } else {
+        if (i + 1 < sz) {
+            i++;
+            for (; i < sz; i++) {
+                if (is_delimiter(at(i))) { return i; }
+            }
+            return i;
+        } else {
+            return sz;
+        }
+    }
+}
+
+i64 MappedBuffer::find_prev_delimiter(i64 i) const {
+    if (i - 1 > 0) {
+        --i;
+        for (; i > 0; --i) {
+            if (is_delimiter(at(i))) { return i; }
+        }
+        return i;
+    } else {
+        return 0;
+    }
+}
+
+/// ----------- EDITING ----------------
+
+void MappedBuffer::insert(char ch) { insert_str(std::string_view{&ch, 1}); }
+
+void MappedBuffer::insert_str(const std::string_view &data) {
+    if (data.empty()) return;
+    auto pos = AS(cursor.pos, std::size_t);
+    auto added_offset = added.size();
+    added.append(data);
+    auto idx = split_at(pos);
+    if (idx > 0 && pieces[idx - 1].source == Source::Added &&
+        pieces[idx - 1].offset + pieces[idx - 1].length == added_offset) {
+        // typing appends to the piece that the last insert created, so the piece count only grows when we move
+        pieces[idx - 1].length += data.size();
+    } else {
+        pieces.insert(pieces.begin() + AS(idx, std::ptrdiff_t), Piece{Source::Added, added_offset, data.size()});
+    }
+    update_piece_begins();
+    meta_data.on_insert(pos, data);
+    record_insert(pos, data);
+
+    cursor.pos += AS(data.size(), i64);
+    if (auto last_nl = data.rfind('\n'); last_nl != std::string_view::npos) {
+        cursor.line += AS(std::count(data.begin(), data.end(), '\n'), int);
+        cursor.col_pos = AS(data.size() - last_nl - 1, int);
+    } else {
+        cursor.col_pos += AS(data.size(), int);
+    }
+    state_is_pristine = false;
+}
+
+void MappedBuffer::insert_str_owned(const std::string &ref_data) { insert_str(ref_data); }
+
+void MappedBuffer::apply_batch(const std::vector<TextEdit> &edits) {
+    if (edits.empty()) return;
+    MICRO_BENCH("MappedBuffer::apply_batch");
+    const auto record = recording_edits();
+    std::vector<EditHistory::Replacement> replaced{};
+    if (record) replaced.reserve(edits.size());
+
+    // the old pieces are still what the edits' positions refer to, until the new list replaces them at the end
+    std::vector<Piece> rebuilt{};
+    rebuilt.reserve(pieces.size() + 2 * edits.size() + 1);
+    auto keep = [&](std::size_t from, std::size_t to) {
+        while (from < to) {
+            auto idx = piece_at(from);
+            auto offset = from - piece_begins[idx];
+            auto length = std::min(pieces[idx].length - offset, to - from);
+            rebuilt.push_back(Piece{pieces[idx].source, pieces[idx].offset + offset, length});
+            from += length;
+        }
+    };
+
+    i64 delta = 0;
+    std::size_t kept_to = 0;
+    for (const auto &e : edits) {
+        const auto removed = std::min(e.removed, size() - e.pos);
+        keep(kept_to, e.pos);
+        kept_to = e.pos + removed;
+        if (record && (removed > 0 || not e.inserted.empty())) {
+            replaced.push_back(EditHistory::Replacement{e.pos, std::string{view_range(e.pos, removed)},
+                                                        std::string{e.inserted}});
+        }
+        if (not e.inserted.empty()) {
+            rebuilt.push_back(Piece{Source::Added, added.size(), e.inserted.size()});
+            added.append(e.inserted);
+        }
+        const auto pos = AS(AS(e.pos, i64) + delta, std::size_t);
+        if (removed > 0) meta_data.on_remove(pos, removed);
+        if (not e.inserted.empty()) meta_data.on_insert(pos, e.inserted);
+        delta += AS(e.inserted.size(), i64) - AS(removed, i64);
+    }
+    keep(kept_to, size());
+    const auto span_begin = edits.front().pos;
+    const auto span_end = std::max(kept_to, span_begin);
+    pieces = std::move(rebuilt);
+    update_piece_begins();
+    record_batch(span_begin, span_end - span_begin, AS(AS(span_end - span_begin, i64) + delta, std::size_t),
+                 std::move(replaced));
+    state_is_pristine = false;
+}
+
+void MappedBuffer::erase() {
+    if (cursor.pos < AS(size(), i64)) erase_range(cursor.pos, 1);
+}
+
+void MappedBuffer::clear() {
+    file.reset();
+    added = std::string{};
+    pieces.clear();
+    update_piece_begins();
+    file_path.clear();
+    state_is_pristine = false;
+    clear_metadata();
+    data_is_pristine = true;
+}
+
+void MappedBuffer::remove(const Movement &m) {
+    switch (m.construct) {
+        case Char:
+            m.dir == CursorDirection::Forward ? remove_ch_forward(m.count) : remove_ch_backward(m.count);
+            break;
+        case Word:
+            m.dir == CursorDirection::Forward ? remove_word_forward(m.count) : remove_word_backward(m.count);
+            break;
+        case Line:
+            break;
+        default:
+            PANIC("Removing other than char, word, line is an error at this point");
+    }
+    state_is_pristine = false;
+}
+
+void MappedBuffer::remove_ch_forward(size_t i) {
+    if (cursor.pos >= AS(size(), i64)) return;
+    erase_range(cursor.pos, i);
+}
+
+void MappedBuffer::remove_ch_backward(size_t i) {
+    if (cursor.pos - AS(i, i64) >= 0) {
+        step_cursor_to(cursor.pos - i);
+        remove_ch_forward(i);
+    }
+}
+
+void MappedBuffer::remove_word_forward(size_t count) {
+    if (cursor.pos + 1 >= AS(size(), i64)) {
+        remove_ch_forward(1);
+        return;
+    }
+    auto new_pos = find_next_delimiter(cursor.pos);
+    count--;
+    for (; count > 0; --count) { new_pos = find_next_delimiter(new_pos); }
+    remove_ch_forward(new_pos - cursor.pos);
+}
+
+void MappedBuffer::remove_word_backward(size_t count) {
+    if (cursor.pos - 1 <= 0) {
+        remove_ch_backward(1);
+        return;
+    }
+    if (find_prev_delimiter(cursor.pos) == cursor.pos - 1) {
+        remove_ch_backward(1);
+        return;
+    }
+    auto new_pos = find_prev_delimiter(cursor.pos);
+    count--;
+    for (; count > 0; --count) { new_pos = find_prev_delimiter(new_pos); }
+    auto distance = cursor.pos - new_pos;
+    if (new_pos != 0) {
+        remove_ch_backward(distance - 1);
+    } else {
+        remove_ch_backward(distance);
+    }
+}
+
+/// ----------- QUERIES ----------------
+
+size_t MappedBuffer::get_cursor_pos() const { return cursor.pos; }
+std::size_t MappedBuffer::size() const { return piece_begins.back(); }
+size_t MappedBuffer::capacity() const { return added.capacity() + (file ? file->view().size() : 0); }
+BufferCursor &MappedBuffer::get_cursor() { return cursor; }
+size_t MappedBuffer::lines_count() const { return meta_data.line_count() - 1; }
+
+void MappedBuffer::release_file() {
+    if (not file || meta_data.load_progress) return;
+    std::string text{};
+    text.reserve(size());
+    for (const auto &piece : pieces) text.append(piece_view(piece));
+    take_ownership(std::move(text));
+    // the last snapshot refers to the mapping as well
+    forget_snapshot();
+}
+
+#ifdef DEBUG
+std::string MappedBuffer::to_std_string() const {
+    std::string res;
+    res.reserve(size());
+    for (const auto &piece : pieces) res.append(piece_view(piece));
+    return res;
+}
+
+std::string_view MappedBuffer::to_string_view() {
+    if (pieces.size() == 1 && pieces.front().source == Source::Added) return added;
+    if (pieces.empty()) return {};
+    take_ownership(to_std_string());
+    return added;
+}
+
+void MappedBuffer::load_string(std::string &&data) {
+    take_ownership(std::move(data));
+    meta_data.line_index.assign(added);
+    state_is_pristine = false;
+    all_text_changed();
+    data_is_pristine = true;
+}
+
+void MappedBuffer::set_string(std::string &data) { load_string(std::string{data}); }
+#endif
+
+/// ----------- META DATA ----------------
+
+void MappedBuffer::rebuild_metadata() {
+    if (not data_is_pristine || info == BufferTypeInfo::Modal) {
+        std::vector<std::string_view> parts{};
+        parts.reserve(pieces.size());
+        for (const auto &piece : pieces) parts.push_back(piece_view(piece));
+        meta_data.line_index.assign(parts);
+    }
+    state_is_pristine = false;
+    data_is_pristine = true;
+}
+
+void MappedBuffer::set_bookmark() {
+    auto &bm = meta_data.bookmarks;
+    if (std::ranges::any_of(bm, [l = cursor.line](auto &b) { return b.line_number == l; })) { return; }
+    auto pristine = state_is_pristine;
+    std::string line_contents{view_range(meta_data.line_begin(cursor.line), line_text_length(cursor.line))};
+    state_is_pristine = pristine;
+    auto it = std::ranges::find_if(line_contents, [](auto e) { return !std::isspace(e); });
+    line_contents.erase(line_contents.begin(), it);
+
+    if (not line_contents.empty()) {
+        auto insert_at = std::ranges::upper_bound(bm, cursor.line, {}, &Bookmark::line_number);
+        auto added_bookmark = bm.emplace(insert_at, cursor.line, std::move(line_contents));
+        util::println("Set bookmark at {}: '{}'", cursor.line, added_bookmark->line_contents);
+    }
+}
+
+void MappedBuffer::set_mark_at_cursor() {
+    mark = cursor;
+    mark_set = true;
+}
+
+void MappedBuffer::set_mark_from_cursor(int length) {
+    auto tmp = cursor;
+    step_cursor_to(cursor.pos + length);
+    mark = cursor;
+    cursor = tmp;
+    mark_set = true;
+}
+
+void MappedBuffer::clear_marks() {
+    mark_set = false;
+    mark.reset();
+}
+
+std::pair<BufferCursor, BufferCursor> MappedBuffer::get_cursor_rect() const {
+    if (mark_set) {
+        if (mark.pos < cursor.pos) {
+            return std::make_pair(mark.clone(), cursor.clone());
+        } else {
+            return std::make_pair(cursor.clone(), mark.clone());
+        }
+    } else {
+        return std::make_pair(cursor.clone(), cursor.clone());
+    }
+}
+
+std::string_view MappedBuffer::copy_range(std::pair<BufferCursor, BufferCursor> selected_range) {
+    auto &[b, e] = selected_range;
+    auto pristine = state_is_pristine;
+    auto v = view_range(b.pos, AS(e.pos - b.pos, size_t));
+    state_is_pristine = pristine;
+    return v;
+}
+
+void MappedBuffer::append_loaded(std::string_view text, const std::vector<std::size_t> &line_lengths) {
+    if (text.empty()) return;
+    auto contents = file->view();
+    assert(text.data() >= contents.data() && text.data() + text.size() <= contents.data() + contents.size());
+    auto offset = AS(text.data() - contents.data(), std::size_t);
+    const auto at = std::min(load_end, size());
+    if (at == size()) {
+        if (not pieces.empty() && pieces.back().source == Source::File &&
+            pieces.back().offset + pieces.back().length == offset) {
+            pieces.back().length += text.size();
+            piece_begins.back() += text.size();
+        } else {
+            pieces.push_back(Piece{Source::File, offset, text.size()});
+            piece_begins.push_back(piece_begins.back() + text.size());
+        }
+        meta_data.line_index.append(line_lengths);
+    } else {
+        // before what the user typed at the end, while loading
+        auto idx = split_at(at);
+        if (idx > 0 && pieces[idx - 1].source == Source::File &&
+            pieces[idx - 1].offset + pieces[idx - 1].length == offset) {
+            pieces[idx - 1].length += text.size();
+        } else {
+            pieces.insert(pieces.begin() + AS(idx, std::ptrdiff_t), Piece{Source::File, offset, text.size()});
+        }
+        update_piece_begins();
+        meta_data.on_insert(at, text);
+    }
+    state_is_pristine = false;
+    record_loaded(at, text.size());
+}
+
+/// ----------- INIT ----------------
+
+std::unique_ptr<TextData> MappedBuffer::make_handle(std::shared_ptr<MappedFile> file) {
+    auto buf = std::unique_ptr<MappedBuffer>(new MappedBuffer{});
+    buf->id = DataManager::get_instance().get_new_id();
+    buf->cursor.buffer_id = buf->id;
+    buf->file = std::move(file);
+    buf->data_is_pristine = true;
+    return buf;
+}
+
+MappedBuffer::~MappedBuffer() {
+    if (DataManager::get_instance().is_managed(id)) {
+        DataManager::get_instance().print_all_managed();
+        PANIC("ERROR. BUFFER IS TRYING TO DESTROY ITSELF. THAT IS HANDLED BY DATAMANAGER. ID: {}", id);
+    }
+}
@@ -0,0 +1,131 @@
+//
+// Created by 46769 on 2021-02-09.
+//
+
+#pragma once
+#include "text_data.hpp"
+#include <optional>
+#include <utils/mapped_file.hpp>
+#include <vector>
+
+/**
+ * Piece table on top of a read-only MappedFile, for files that are too large to be worth reading into a GapBuffer.
+ * Opening one costs the mapping (O(1)) and building the line index, which reads straight out of the mapping. The
+ * file contents are never copied or written to; everything inserted gets appended to `added`, and the text is
+ * described by a list of pieces, each referring to a range of either the mapping or `added`:
+ *
+ *  file:   [h e l l o   w o r l d]      added: [b i g  ]
+ *  pieces: {File, 0, 6} {Added, 0, 4} {File, 6, 5}   ->   "hello big world"
+ *
+ * So the only memory of our own a 4GB log file costs is the line index and whatever was typed into it.
+ */
+class MappedBuffer : public TextData {
+public:
+    ~MappedBuffer() override;
+
+    /// EDITING
+    void insert(char ch) override;
+    void insert_str(const std::string_view &data) override;
+    void insert_str_owned(const std::string &ref_data) override;
+    void clear() override;
+
+    void remove(const Movement &m) override;
+    void erase() override;
+
+    /// CURSOR OPS
+    size_t get_cursor_pos() const override;
+    std::size_t size() const override;
+    size_t capacity() const override;
+    void move_cursor(Movement m) override;
+    void step_cursor_to(size_t pos) override;
+    BufferCursor &get_cursor() override;
+
+    /// INIT CALLS
+    /// The buffer starts out empty, FileLoader appends the file contents as it gets them indexed
+    static std::unique_ptr<TextData> make_handle(std::shared_ptr<MappedFile> file);
+
+    /// SEARCH OPS
+    size_t lines_count() const override;
+
+    void step_to_line_end(Boundary boundary) override;
+    void step_to_line_begin(Boundary boundary) override;
+
+#ifdef DEBUG
+    std::string to_std_string() const override;
+    /// Has to make the entire buffer contiguous, which means copying the file contents into memory. The mapping is
+    /// released when that happens, since whoever wants the entire buffer, most likely wants to write it to disk, which
+    /// can be the very file we have mapped.
+    std::string_view to_string_view() override;
+    void load_string(std::string &&data) override;
+    void set_string(std::string &data) override;
+#endif
+
+    // Meta data
+    void rebuild_metadata() override;
+    /// Copies the text into memory & releases the mapping, unless a FileLoader is still indexing it
+    void release_file() override;
+    void set_bookmark() override;
+
+    void set_mark_at_cursor() override;
+    void set_mark_from_cursor(int length) override;
+    void clear_marks() override;
+    std::pair<BufferCursor, BufferCursor> get_cursor_rect() const override;
+    std::string_view copy_range(std::pair<BufferCursor, BufferCursor> selected_range) override;
+    std::string_view view_range(std::size_t begin, std::size_t length) override;
+    /// The pieces, straight from the mapping & the added text
+    [[nodiscard]] std::vector<std::string_view> chunks(std::size_t begin, std::size_t end) const override;
+    /// The pieces of the file refer to the mapping, which the snapshot keeps alive, only the added text is copied
+    [[nodiscard]] std::vector<TextSnapshot::Piece> snapshot_pieces(std::size_t begin, std::size_t end) const override;
+    /// text has to be a part of the mapping this buffer was created with, which is what FileLoader hands us
+    void append_loaded(std::string_view text, const std::vector<std::size_t> &line_lengths) override;
+    /// Rebuilds the piece list once for all of the edits, instead of once per edit
+    void apply_batch(const std::vector<TextEdit> &edits) override;
+
+    /// Character at logical position i
+    [[nodiscard]] char at(std::size_t i) const;
+
+private:
+    MappedBuffer() = default;
+    enum class Source { File, Added };
+    struct Piece {
+        Source source;
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    /// Shared with the FileLoader indexing it
+    std::shared_ptr<MappedFile> file{nullptr};
+    std::string added{};
+    std::vector<Piece> pieces{};
+    /// piece_begins[i] is the logical offset where pieces[i] begins, the last element is size()
+    std::vector<std::size_t> piece_begins{0};
+    /// Backing store for view_range, when the range spans more than one piece
+    std::string scratch{};
+
+    [[nodiscard]] std::string_view piece_view(const Piece &piece) const;
+    /// Index of the piece that position pos is in
+    [[nodiscard]] std::size_t piece_at(std::size_t pos) const;
+    /// Splits the piece at pos, so that a piece begins at pos. Returns the index of that piece
+    std::size_t split_at(std::size_t pos);
+    void update_piece_begins();
+    void erase_range(std::size_t pos, std::size_t length);
+    void take_ownership(std::string &&data);
+    /// Sets the cursor to pos, line and column are looked up in the line index
+    void set_cursor(std::size_t pos);
+    /// Length of line, not counting its newline
+    [[nodiscard]] std::size_t line_text_length(std::size_t line) const;
+
+    void char_move_forward(std::size_t count) override;
+    void char_move_backward(std::size_t count) override;
+    void word_move_forward(std::size_t count) override;
+    void word_move_backward(std::size_t count) override;
+    void line_move_forward(std::size_t count) override;
+    void line_move_backward(std::size_t count) override;
+    void remove_ch_forward(size_t i);
+    void remove_ch_backward(size_t i);
+    void remove_word_forward(size_t i);
+    void remove_word_backward(size_t i);
+
+    i64 find_next_delimiter(i64 i) const;
+    i64 find_prev_delimiter(i64 i) const;
+};
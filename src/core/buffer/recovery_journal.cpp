@@ -0,0 +1,314 @@
+//
+// Created by 46769 on 2021-02-22.
+//
+
+#include "recovery_journal.hpp"
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <sstream>
+#include <utility>
+#include <utils/mapped_file.hpp>
+#include <utils/profiler.hpp>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr std::string_view MAGIC = "CXJ1";
+
+constexpr std::array<std::uint32_t, 256> CRC_TABLE = []() {
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+        auto crc = i;
+        for (auto bit = 0; bit < 8; ++bit) crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        table[i] = crc;
+    }
+    return table;
+}();
+
+std::uint32_t crc32(std::string_view data) {
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (auto ch : data) crc = CRC_TABLE[(crc ^ AS(ch, std::uint8_t)) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template<typename T>
+void append(std::string &out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+/// Appends the checksum of what's been appended to out since begin
+void append_crc(std::string &out, std::size_t begin) {
+    append(out, crc32(std::string_view{out}.substr(begin)));
+}
+
+/// Reads what the journal has, from the front, until it runs out
+class Reader {
+public:
+    explicit Reader(std::string_view data) : data(data) {}
+
+    template<typename T>
+    std::optional<T> read() {
+        if (data.size() - at < sizeof(T)) return {};
+        T value;
+        std::memcpy(&value, data.data() + at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+    std::optional<std::string_view> read_text(std::size_t size) {
+        if (data.size() - at < size) return {};
+        auto text = data.substr(at, size);
+        at += size;
+        return text;
+    }
+    /// Whether the checksum that's next is that of what was read since begin
+    bool checksum_matches(std::size_t begin) {
+        auto expected = crc32(data.substr(begin, at - begin));
+        auto crc = read<std::uint32_t>();
+        return crc && *crc == expected;
+    }
+    [[nodiscard]] std::size_t position() const { return at; }
+
+private:
+    std::string_view data;
+    std::size_t at{0};
+};
+
+std::int64_t modification_time(const fs::path &file) {
+    std::error_code ec{};
+    auto time = fs::last_write_time(file, ec);
+    return ec ? 0 : AS(time.time_since_epoch().count(), std::int64_t);
+}
+
+/// Creates dir, & the directory of the editor it's in, for only the user to get into
+void create_private_directory(const fs::path &dir) {
+    std::error_code ec{};
+    fs::create_directories(dir, ec);
+    for (const auto &created : {dir.parent_path(), dir}) {
+        fs::permissions(created, fs::perms::owner_all, fs::perm_options::replace, ec);
+    }
+}
+
+/// Creates file, or empties it, for only the user to read. false if it couldn't be, or it's something else than a file
+bool create_private_file(const fs::path &file) {
+#ifdef WIN32
+    // what's in the user's local app data is theirs already
+    return true;
+#else
+    // never through a symlink, which someone else could have put there
+    auto fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd == -1) return false;
+    // it may have been there already, created by someone else's umask
+    const auto is_private = ::fchmod(fd, 0600) == 0;
+    ::close(fd);
+    return is_private;
+#endif
+}
+
+/// The text of file, read the way FileLoader reads it: mapped, if it's large enough to be, in text mode otherwise
+TextSnapshot read_base(const fs::path &file) {
+    std::error_code ec{};
+    const auto file_size = fs::file_size(file, ec);
+    if (ec) return {};
+    if (file_size >= MappedFile::LOAD_THRESHOLD) {
+        if (std::shared_ptr<MappedFile> mapping = MappedFile::open(file)) {
+            const auto view = mapping->view();
+            return TextSnapshot{{TextSnapshot::Piece{std::move(mapping), view}}};
+        }
+    }
+    std::ifstream in{file};
+    std::stringstream contents{};
+    contents << in.rdbuf();
+    auto text = std::make_shared<std::string>(std::move(contents).str());
+    const std::string_view view{*text};
+    return TextSnapshot{{TextSnapshot::Piece{std::move(text), view}}};
+}
+
+fs::path journal_path_for(const fs::path &file) {
+    std::error_code ec{};
+    auto absolute = fs::absolute(file, ec);
+    const auto name = (ec ? file : absolute).lexically_normal().u8string();
+    const auto id = crc32(std::string_view{reinterpret_cast<const char *>(name.data()), name.size()});
+    return RecoveryJournal::directory() / fmt::format("{}.{:08x}.cxjournal", file.filename().string(), id);
+}
+} // namespace
+
+RecoveryJournal::RecoveryJournal(fs::path file, std::size_t base_size)
+    : file_path(std::move(file)), journal_path(journal_path_for(file_path)), size(base_size),
+      restart(header(base_size)) {}
+
+RecoveryJournal::~RecoveryJournal() {
+    if (not kept) {
+        std::lock_guard lock{mutex};
+        pending.clear();
+    }
+    // the job writes whatever's pending before it's done
+    job.wait();
+    out.close();
+    std::error_code ec{};
+    if (not kept) fs::remove(journal_path, ec);
+}
+
+fs::path RecoveryJournal::directory() {
+#ifdef WIN32
+    if (auto local = _wgetenv(L"LOCALAPPDATA"); local != nullptr && *local != L'\0') {
+        return fs::path{local} / "cxgledit" / "journal";
+    }
+    // which is the user's own, on windows
+    return fs::temp_directory_path() / "cxgledit" / "journal";
+#else
+    if (auto state = std::getenv("XDG_STATE_HOME"); state != nullptr && *state != '\0') {
+        return fs::path{state} / "cxgledit" / "journal";
+    }
+    fs::path home{};
+    if (auto env = std::getenv("HOME"); env != nullptr && *env != '\0') {
+        home = env;
+    } else if (auto user = ::getpwuid(::getuid()); user != nullptr && user->pw_dir != nullptr) {
+        home = user->pw_dir;
+    }
+    return home / ".local" / "state" / "cxgledit" / "journal";
+#endif
+}
+
+std::string RecoveryJournal::header(std::size_t base_size) const {
+    std::string result{MAGIC};
+    append(result, AS(base_size, std::uint64_t));
+    append(result, modification_time(file_path));
+    const auto path = file_path.u8string();
+    append(result, AS(path.size(), std::uint32_t));
+    result.append(reinterpret_cast<const char *>(path.data()), path.size());
+    append_crc(result, 0);
+    return result;
+}
+
+void RecoveryJournal::record(std::size_t pos, std::size_t removed, const std::vector<std::string_view> &text) {
+    std::size_t inserted = 0;
+    for (auto part : text) inserted += part.size();
+    {
+        std::lock_guard lock{mutex};
+        const auto begin = pending.size();
+        append(pending, AS(pos, std::uint64_t));
+        append(pending, AS(removed, std::uint64_t));
+        append(pending, AS(inserted, std::uint64_t));
+        for (auto part : text) pending.append(part);
+        append_crc(pending, begin);
+    }
+    size = size - removed + inserted;
+    if (marked) {
+        // widened the way TextData's changed ranges are
+        if (not since_mark) {
+            since_mark = {pos, pos + inserted};
+        } else {
+            auto &[begin, end] = *since_mark;
+            if (end > pos) end = (end >= pos + removed ? end - removed : pos) + inserted;
+            begin = std::min(begin, pos);
+            end = std::max(end, pos + inserted);
+        }
+    }
+    write_pending();
+}
+
+void RecoveryJournal::mark() {
+    marked = true;
+    since_mark.reset();
+}
+
+void RecoveryJournal::rebase(std::size_t base_size) {
+    {
+        std::lock_guard lock{mutex};
+        pending.clear();
+        restart = header(base_size);
+    }
+    size = base_size;
+    marked = false;
+    since_mark.reset();
+    // to delete what's been written so far
+    write_pending();
+}
+
+void RecoveryJournal::write_pending() {
+    {
+        std::lock_guard lock{mutex};
+        if (writing) return;
+        writing = true;
+    }
+    job = JobSystem::get_instance().submit(JobPriority::Normal, [this](const JobHandle &) {
+        run();
+        return JobSystem::Completion{};
+    });
+}
+
+void RecoveryJournal::run() {
+    MICRO_BENCH("RecoveryJournal::run");
+    while (true) {
+        std::string batch{};
+        std::optional<std::string> begin_with{};
+        {
+            std::lock_guard lock{mutex};
+            if (pending.empty()) {
+                if (restart && out.is_open()) {
+                    // rebased, with nothing recorded since; the journal begins again with the next record
+                    out.close();
+                    std::error_code ec{};
+                    fs::remove(journal_path, ec);
+                }
+                writing = false;
+                return;
+            }
+            batch.swap(pending);
+            begin_with = std::exchange(restart, std::nullopt);
+        }
+        if (begin_with) {
+            out.close();
+            create_private_directory(journal_path.parent_path());
+            // if it can't be created, the stream stays closed, & the journal writes nothing
+            if (create_private_file(journal_path)) out.open(journal_path, std::ios::binary | std::ios::trunc);
+            out.write(begin_with->data(), AS(begin_with->size(), std::streamsize));
+        }
+        out.write(batch.data(), AS(batch.size(), std::streamsize));
+        // to the OS, which has it, should the editor crash
+        out.flush();
+    }
+}
+
+std::optional<RecoveryJournal::Recovered> RecoveryJournal::recover(const fs::path &path) {
+    MICRO_BENCH("RecoveryJournal::recover");
+    auto journal = MappedFile::open(path);
+    if (not journal) return {};
+    Reader reader{journal->view()};
+    if (reader.read_text(MAGIC.size()) != MAGIC) return {};
+    auto base_size = reader.read<std::uint64_t>();
+    auto base_mtime = reader.read<std::int64_t>();
+    auto path_size = reader.read<std::uint32_t>();
+    if (not base_size || not base_mtime || not path_size) return {};
+    auto file = reader.read_text(*path_size);
+    if (not file || not reader.checksum_matches(0)) return {};
+
+    Recovered recovered{.file = fs::path{std::u8string{file->begin(), file->end()}}, .base_size = *base_size};
+    if (modification_time(recovered.file) != *base_mtime) return {};
+    // on a rope, so that an edit costs O(log n), & not moving the rest of the text
+    auto text = read_base(recovered.file);
+    if (text.size() != *base_size) return {};
+    while (true) {
+        const auto begin = reader.position();
+        auto pos = reader.read<std::uint64_t>();
+        auto removed = reader.read<std::uint64_t>();
+        auto inserted = reader.read<std::uint64_t>();
+        if (not pos || not removed || not inserted) break;
+        auto replacement = reader.read_text(*inserted);
+        if (not replacement || not reader.checksum_matches(begin)) break;
+        if (*pos > text.size() || *removed > text.size() - *pos) break;
+        text = text.replaced(*pos, *removed, TextSnapshot::copy_of({*replacement}));
+        ++recovered.edits;
+    }
+    recovered.text = std::move(text);
+    return recovered;
+}
@@ -0,0 +1,109 @@
+//
+// Created by 46769 on 2021-02-22.
+//
+
+#pragma once
+#include "text_snapshot.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <utils/job_system.hpp>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * Crash recovery for the unsaved changes of a buffer: an append-only file of what's been edited since the buffer's file
+ * was loaded or saved, that's replayed on top of the file the next time the editor starts, when it went down without
+ * saving (or deleting the journal, which is what a clean exit does).
+ *
+ * An edit is recorded as the range of the text that was replaced & what's there now, once a frame (see
+ * TextData::take_changed_range), so typing costs a record of a character or two a frame. The records are written, a
+ * batch at a time, by a job (see JobSystem), so the main thread never waits on the disk; it only copies what changed.
+ * The job hands every batch to the OS, which has it even if the editor crashes right after. Everything is checksummed,
+ * & replay stops at the first record that doesn't add up, which is the one being written when the editor went down.
+ *
+ *  header: "CXJ1" | base size u64 | base mtime i64 | path size u32 | path | crc32
+ *  record: pos u64 | removed u64 | size u64 | text | crc32
+ *
+ * The base size & modification time are those of the file when the journal began; if it's changed since, the journal
+ * doesn't apply to it anymore, & isn't replayed. The size is of the text as FileLoader reads the file, which is in text
+ * mode, unless it's mapped (see MappedFile::LOAD_THRESHOLD).
+ *
+ * Journals have the unsaved text of files that may well be private, so they're kept where only the user can read them,
+ * in their state directory, & not in the shared temp directory, which is wiped on a reboot too.
+ */
+class RecoveryJournal {
+public:
+    /// What a journal recovered: the text of file, with every edit that was recorded replayed on top of it
+    struct Recovered {
+        fs::path file;
+        /// Size of the text of file, which the edits were replayed on top of
+        std::size_t base_size;
+        /// On top of the file, or its mapping, which the snapshot keeps alive
+        TextSnapshot text{};
+        std::size_t edits{0};
+    };
+
+    /// Journal of the buffer of file, which has base_size characters now, the same as the file. Nothing is written
+    /// until the first edit is recorded
+    RecoveryJournal(fs::path file, std::size_t base_size);
+    /// Waits for the writes in flight & deletes the journal; the edits have been saved, or are being thrown away. Unless
+    /// it's kept, then what's been recorded is written first
+    ~RecoveryJournal();
+    RecoveryJournal(const RecoveryJournal &) = delete;
+    RecoveryJournal &operator=(const RecoveryJournal &) = delete;
+
+    /// Main thread. [pos, pos + removed) of the text was replaced by text
+    void record(std::size_t pos, std::size_t removed, const std::vector<std::string_view> &text);
+    /// Main thread. The file has been saved, & has base_size characters now; what's been recorded is dropped
+    void rebase(std::size_t base_size);
+    /// Main thread. Tracks what's recorded from here on, see changed_since_mark; for a save of the text as it is now
+    void mark();
+    /// [begin, end) of the text, which is what the records since mark() replaced, of the text as it was then. Nothing if
+    /// nothing's been recorded since, or it's been rebased
+    [[nodiscard]] std::optional<std::pair<std::size_t, std::size_t>> changed_since_mark() const { return since_mark; }
+    /// Main thread. Keeps the journal when it's destroyed, for the next start to recover the edits in it
+    void keep() { kept = true; }
+
+    [[nodiscard]] const fs::path &file() const { return file_path; }
+    /// Size of the text, after the last edit recorded
+    [[nodiscard]] std::size_t text_size() const { return size; }
+
+    /// Where the journals are kept; $XDG_STATE_HOME/cxgledit/journal, or %LOCALAPPDATA%/cxgledit/journal on windows
+    static fs::path directory();
+    /// Replays the journal at path on top of the file it's for. Nothing when the file has changed since the journal
+    /// began, or path isn't a journal
+    static std::optional<Recovered> recover(const fs::path &path);
+
+private:
+    fs::path file_path;
+    fs::path journal_path;
+    std::size_t size;
+    bool kept{false};
+    bool marked{false};
+    std::optional<std::pair<std::size_t, std::size_t>> since_mark{};
+
+    std::mutex mutex{};
+    /// Records not yet handed to the job
+    std::string pending{};
+    /// The header of the journal; set when the journal has to begin again with it, before pending
+    std::optional<std::string> restart{};
+    /// Whether there's a job writing, which writes whatever's pending before it's done
+    bool writing{false};
+    JobHandle job{};
+
+    /// Only touched by the job
+    std::ofstream out{};
+
+    /// The header of a journal of file, when it has base_size characters
+    [[nodiscard]] std::string header(std::size_t base_size) const;
+    /// Main thread. Starts a job writing what's pending, if there's none already
+    void write_pending();
+    void run();
+};
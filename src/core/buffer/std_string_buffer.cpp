@@ -202,26 +202,24 @@ void StdStringBuffer::line_move_backward(std::size_t count) {
     }
 }
 
-void StdStringBuffer::erase() { store.erase(cursor.pos, 1); }
+void StdStringBuffer::erase() { erase_range(cursor.pos, 1); }
 
 void StdStringBuffer::insert_str(const std::string_view &data) {
-    if (store.capacity() <= store.size() + data.size()) { store.reserve(store.capacity() * 2); }
+    if (store.capacity() <= store.size() + data.size()) {
+        store.reserve(std::max(store.capacity() * 2, store.size() + data.size()));
+    }
     store.insert(cursor.pos, data);
-    auto inc = data.size();
-    cursor.pos += inc;
-    if (auto nlines = count_elements(data, '\n'); nlines) {
-        auto &ref = nlines.value();
-        auto data_index = ref.back().found_at_idx;
-        auto nlines_count = ref.size();
-        cursor.line += nlines_count;
-        if (cursor.pos > data_index) {
-            cursor.col_pos = std::abs(static_cast<int>(cursor.pos) - static_cast<int>(data_index));
-        }
+    if (has_meta_data) meta_data.on_insert(cursor.pos, data);
+    record_insert(cursor.pos, data);
+    cursor.pos += AS(data.size(), i64);
+    if (auto last_nl = data.rfind('\n'); last_nl != std::string_view::npos) {
+        cursor.line += AS(std::count(data.begin(), data.end(), '\n'), int);
+        // the cursor ends up on the line after the last newline inserted
+        cursor.col_pos = AS(data.size() - last_nl - 1, int);
     } else {
-        cursor.col_pos += inc;
+        cursor.col_pos += AS(data.size(), int);
     }
-    // FIXME: do this more optimally. Since we don't what the data contains, we just rebuild entire meta data for now
-    if (has_meta_data) rebuild_metadata();
+    state_is_pristine = false;
 }
 void StdStringBuffer::clear() {
     store.clear();
@@ -231,33 +229,19 @@ void StdStringBuffer::clear() {
     clear_metadata();
 }
 void StdStringBuffer::insert(char ch) {
-    auto &md_lines = meta_data.line_begins;
     if (cursor.pos == store.capacity() || store.size() >= store.capacity()) { store.reserve(store.capacity() * 2); }
     store.insert(store.begin() + cursor.pos, ch);
+    if (has_meta_data) meta_data.on_insert(cursor.pos, std::string_view{&ch, 1});
+    record_insert(cursor.pos, std::string_view{&ch, 1});
 
     if (ch == '\n') {
-        if (has_meta_data) {
-            md_lines.insert(md_lines.begin() + cursor.line, cursor.pos);
-            std::for_each(md_lines.begin() + cursor.line + 1, md_lines.end(), [](auto &e) { e += 1; });
-            for (auto &b :
-                 meta_data
-                         .bookmarks) {// we only bookkeep line numbers for bookmarks, as the metadata has a separate index for line begins
-                if (b.line_number > cursor.line) { b.line_number++; }
-            }
-        }
         cursor.line++;
         cursor.col_pos = 0;
     } else {
-        if (has_meta_data) {
-            if (cursor.line + 1 < md_lines.size()) {
-                std::for_each(md_lines.begin() + cursor.line + 1, md_lines.end(), [](auto &e) { e += 1; });
-            }
-        }
         cursor.col_pos++;
     }
     cursor.pos++;
     this->state_is_pristine = false;
-    data_is_pristine = false;
 }
 
 size_t StdStringBuffer::get_cursor_pos() const { return cursor.pos; }
@@ -297,54 +281,36 @@ void StdStringBuffer::remove(const Movement &m) {
             PANIC("Removing other than char, word, line is an error at this point");
     }
     this->state_is_pristine = false;
-    data_is_pristine = false;
 }
 
-void StdStringBuffer::remove_ch_forward(size_t i) {
-    auto line_deleted = false;
-    if (cursor.pos + i < store.size()) {
-        auto e = cursor.pos + i;
-        for (auto index = cursor.pos; index < e && not line_deleted; index++) {
-            if (store[index] == '\n') { line_deleted = true; }
-        }
-        store.erase(cursor.pos, i);
-    } else {
-        auto sz = store.size();
-        for (auto index = cursor.pos; index < sz && not line_deleted; index++) {
-            if (store[index] == '\n') { line_deleted = true; }
-        }
-        store.erase(cursor.pos);
-    }
-
-    if (line_deleted) {
-        rebuild_metadata();
-    } else {
-        if (has_meta_data) {
-            std::for_each(meta_data.line_begins.begin() + cursor.line, meta_data.line_begins.end(),
-                          [i](auto &e) { e -= i; });
-        }
-    }
+void StdStringBuffer::erase_range(std::size_t pos, std::size_t length) {
+    if (pos >= store.size()) return;
+    length = std::min(length, store.size() - pos);
+    record_remove(pos, std::string_view{store}.substr(pos, length));
+    store.erase(pos, length);
+    if (has_meta_data) meta_data.on_remove(AS(pos, int), AS(length, int));
 }
+
+void StdStringBuffer::remove_ch_forward(size_t i) { erase_range(cursor.pos, i); }
+
 void StdStringBuffer::remove_ch_backward(size_t i) {
     if ((int) cursor.pos - (int) i >= 0) {
         step_cursor_to(cursor.pos - i);
-        store.erase(cursor.pos, i);
-        rebuild_metadata();
+        erase_range(cursor.pos, i);
         this->state_is_pristine = false;
-        data_is_pristine = false;
     }
 }
 
 void StdStringBuffer::remove_word_forward(size_t count) {
     auto sz = size();
     if (cursor.pos + 1 >= sz) {
-        store.erase(cursor.pos);
+        erase_range(cursor.pos, sz - cursor.pos);
         return;
     }
     auto new_pos = find_next_delimiter(cursor.pos);
     count--;
     for (; count > 0; --count) { new_pos = find_next_delimiter(new_pos); }
-    store.erase(cursor.pos, new_pos - cursor.pos);
+    erase_range(cursor.pos, new_pos - cursor.pos);
 }
 
 void StdStringBuffer::remove_word_backward(size_t count) {
@@ -382,33 +348,8 @@ void StdStringBuffer::step_cursor_to(size_t pos) {
     auto distance = std::abs(AS(pos, int) - cursor.pos);
     if (distance > 30) {
         if (has_meta_data && data_is_pristine) {
-            util::println("Using meta data to move cursor");
-            if (pos < cursor.pos) {
-                auto i = 0;
-                auto lineToGoTo = 0;
-                for (; i <= cursor.line; i++) {
-                    if (pos >= meta_data.line_begins[i] && pos <= meta_data.line_begins[i + 1]) {
-                        lineToGoTo = i;
-                        break;
-                    }
-                }
-                cursor.line = lineToGoTo;
-                cursor.pos = AS(pos, int);
-            } else {
-                auto i = cursor.line;
-                auto last_item = meta_data.line_begins.size() - 1;
-                auto lineToGoTo = 0;
-                if (meta_data.line_begins[i] == cursor.pos) i++;
-                for (; i < last_item; i++) {
-                    if (pos >= meta_data.line_begins[i] && pos <= meta_data.line_begins[i + 1]) {
-                        lineToGoTo = i;
-                        break;
-                    }
-                }
-                if (i == last_item) lineToGoTo = meta_data.line_begins.size() - 1;
-                cursor.line = lineToGoTo;
-                cursor.pos = AS(pos, int);
-            }
+            cursor.line = meta_data.line_of(pos);
+            cursor.pos = AS(pos, int);
         } else {
             util::println("Meta data incomplete, scanning buffer for movement...");
             if (pos > cursor.pos) {
@@ -438,7 +379,7 @@ void StdStringBuffer::step_cursor_to(size_t pos) {
     }
 
     auto col_pos_res = cursor.pos - find_line_start(Boundary::Inside, cursor.pos);
-    cursor.col_pos = std::max(0, col_pos_res);
+    cursor.col_pos = AS(std::max<i64>(0, col_pos_res), int);
     state_is_pristine = false;
 }
 
@@ -449,22 +390,22 @@ std::string_view StdStringBuffer::to_string_view() {
     return store;
 }
 void StdStringBuffer::load_string(std::string &&data) {
-    auto line_indices = str::count_newlines(data.data(), data.size());
-    this->meta_data = TextMetaData{std::move(line_indices)};
-    auto l = std::unique(this->meta_data.line_begins.begin(), this->meta_data.line_begins.end());
-    this->meta_data.line_begins.erase(l, meta_data.line_begins.end());
+    this->meta_data = TextMetaData{};
+    this->meta_data.line_index.assign(data);
     store = std::move(data);
     state_is_pristine = false;
     data_is_pristine = true;
+    all_text_changed();
 }
 
 void StdStringBuffer::set_string(std::string &data) {
-    auto line_indices = str::count_newlines(data.data(), data.size());
-    this->meta_data = TextMetaData{std::move(line_indices)};
+    this->meta_data = TextMetaData{};
+    this->meta_data.line_index.assign(data);
     store.reserve(data.size() * 4);
     for (auto c : data) store.push_back(c);
     state_is_pristine = false;
     data_is_pristine = true;
+    all_text_changed();
 }
 
 #endif
@@ -523,7 +464,7 @@ void StdStringBuffer::step_to_line_end(Boundary boundary) {
             }
         }
     }
-    step_cursor_to(std::min(newpos, sz));
+    step_cursor_to(std::min<i64>(newpos, sz));
 }
 
 void StdStringBuffer::step_to_line_begin(Boundary boundary) {
@@ -544,16 +485,10 @@ void StdStringBuffer::step_to_line_begin(Boundary boundary) {
 
 void StdStringBuffer::rebuild_metadata() {
     if (has_meta_data && (data_is_pristine == false) && info == BufferTypeInfo::EditBuffer) {
-        if (has_meta_data) {
-            auto line_indices = str::count_newlines(store.data(), store.size());
-            this->meta_data.line_begins = std::move(line_indices);
-        }
+        if (has_meta_data) { this->meta_data.line_index.assign(store); }
         data_is_pristine = true;
     } else if (info == BufferTypeInfo::Modal) {
-        if (has_meta_data) {
-            auto line_indices = str::count_newlines(store.data(), store.size());
-            this->meta_data.line_begins = std::move(line_indices);
-        }
+        if (has_meta_data) { this->meta_data.line_index.assign(store); }
     }
     state_is_pristine = false;
     data_is_pristine = true;
@@ -591,10 +526,11 @@ std::string_view StdStringBuffer::copy_range(std::pair<BufferCursor, BufferCurso
     auto &[b, e] = selected_range;
     return {store.data() + b.pos, AS(e.pos - b.pos, size_t)};
 }
-void StdStringBuffer::insert_str_owned(const std::string &ref_data) {
-    for (auto ch : ref_data) { insert(ch); }
-    if (has_meta_data) rebuild_metadata();
+std::string_view StdStringBuffer::view_range(std::size_t begin, std::size_t length) {
+    state_is_pristine = true;
+    return std::string_view{store}.substr(begin, length);
 }
+void StdStringBuffer::insert_str_owned(const std::string &ref_data) { insert_str(ref_data); }
 
 StdStringBuffer::~StdStringBuffer() {
     if (DataManager::get_instance().is_managed(id)) {
@@ -605,15 +541,10 @@ StdStringBuffer::~StdStringBuffer() {
     }
 }
 
-void StdStringBuffer::goto_next(std::string search) {
-    auto pos = store.find(search, cursor.pos + 1);
-    auto oldpos = cursor.pos;
-    if (pos != std::string::npos) {
-        cached_search = search;
-        util::println("found '{}' at {}: [{}]", search, pos, store.substr(pos, search.size()));
-        step_cursor_to(pos);
-        util::println("Move {} -> {}", oldpos, cursor.pos);
-    }
+std::vector<std::string_view> StdStringBuffer::chunks(std::size_t begin, std::size_t end) const {
+    end = std::min(end, store.size());
+    if (begin >= end) return {};
+    return {std::string_view{store}.substr(begin, end - begin)};
 }
 size_t StdStringBuffer::capacity() const { return store.capacity(); }
 
@@ -59,7 +59,8 @@ public:
     void clear_marks() override;
     std::pair<BufferCursor, BufferCursor> get_cursor_rect() const override;
     std::string_view copy_range(std::pair<BufferCursor, BufferCursor> selected_range) override;
-    void goto_next(std::string search) override;
+    std::string_view view_range(std::size_t begin, std::size_t length) override;
+    [[nodiscard]] std::vector<std::string_view> chunks(std::size_t begin, std::size_t end) const override;
     std::string store;
 private:
     void char_move_forward(std::size_t count) override;
@@ -68,6 +69,8 @@ private:
     void word_move_backward(std::size_t count) override;
     void line_move_forward(std::size_t count) override;
     void line_move_backward(std::size_t count) override;
+    /// Removes length characters at pos and updates the line index accordingly
+    void erase_range(std::size_t pos, std::size_t length);
     void remove_ch_forward(size_t i);
     void remove_ch_backward(size_t i);
     void remove_word_forward(size_t i);
@@ -75,8 +78,6 @@ private:
     void remove_line_forward(size_t i);
     void remove_line_backward(size_t i);
 
-    std::string cached_search;
-
     // This variable is set/checked every time a view wants to display. So once
     // vertex data is generated, this is set to true, until any text is inserted to the buffer
     // at which point it is set to false. This way we don't have to reconstruct vertex data every render cycle.
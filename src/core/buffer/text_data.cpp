@@ -8,7 +8,9 @@
 // FIXME: Fix word move forward / backward, so that cursor info data is recorded correctly. It's a mess right now
 // FIXME: Fix line move backward, forward seems to work perfectly fine, line position, column info etc
 
+#include <algorithm>
 #include <core/buffer/data_manager.hpp>
+#include <core/search/searcher.hpp>
 #include <utility>
 
 void BufferCursor::reset() {
@@ -25,10 +27,40 @@ BufferCursor BufferCursor::clone() const {
     return BufferCursor{.pos = pos, .line = line, .col_pos = col_pos, .buffer_id = buffer_id};
 }
 
+/// ----------- META DATA ----------------
+
+int TextMetaData::line_of(std::size_t pos) const { return AS(line_index.line_of(pos), int); }
+
+void TextMetaData::on_insert(std::size_t pos, std::string_view inserted) {
+    auto lines_before = line_index.line_count();
+    line_index.on_insert(pos, inserted);
+    auto new_lines = AS(line_index.line_count() - lines_before, int);
+    if (new_lines == 0) return;
+    // we only bookkeep line numbers for bookmarks, as the metadata has a separate index for line begins
+    auto line = line_of(pos);
+    for (auto &b : bookmarks) {
+        if (b.line_number > line) { b.line_number += new_lines; }
+    }
+}
+
+void TextMetaData::on_remove(std::size_t pos, std::size_t length) {
+    auto line = line_of(pos);
+    auto removed_lines = AS(line_index.on_remove(pos, length), int);
+    if (removed_lines == 0) return;
+    for (auto &b : bookmarks) {
+        if (b.line_number > line + removed_lines) {
+            b.line_number -= removed_lines;
+        } else if (b.line_number > line) {
+            b.line_number = line;
+        }
+    }
+}
+
 /// ----------- NON-PURE VIRTUAL ABSTRACT IMPL METHODS ----------------
 
 void TextData::set_file(fs::path p) {
     file_path = p;
+    context = make_file_context(p);
     meta_data.buf_name = p.filename().string();
     set_name(p.filename().string());
 }
@@ -40,20 +72,398 @@ void TextData::clear_metadata() {
     cursor.pos = 0;
     cursor.col_pos = 0;
     cursor.line = 0;
-    meta_data.line_begins.clear();
+    meta_data.line_index = LineIndex{};
     meta_data.buf_name.clear();
+    context = FileContext{};
+    history.clear();
+    extra_cursors.clear();
+    load_end = 0;
+    all_text_changed();
 }
 
 void TextData::set_name(std::string buffer_name) { name = std::move(buffer_name); }
 
-FileContext TextData::file_context() const {
-    if (auto ext = file_path.filename().extension(); ext == ".cpp" || ext == ".c") {
-        return FileContext{.type = ContexTypes::CPPSource, .path = file_path};
-    } else if (ext == ".hpp" || ext == ".h") {
-        return FileContext{.type = ContexTypes::CPPHeader, .path = file_path};
-    } else if (ext == ".cxe") {
-        return FileContext{.type = ContexTypes::Config, .path = file_path};
+void TextData::append_loaded(std::string_view text, const std::vector<std::size_t> &) {
+    if (text.empty()) return;
+    const auto at = std::min(load_end, size());
+    auto saved = cursor;
+    recording = false;
+    step_cursor_to(at);
+    insert_str(text);
+    recording = true;
+    cursor = saved;
+    shift_past_loaded(at, text.size());
+}
+
+void TextData::record_loaded(std::size_t pos, std::size_t size) {
+    text_changed(pos, 0, size);
+    shift_extra_cursors(pos, 0, size);
+    shift_past_loaded(pos, size);
+}
+
+void TextData::shift_past_loaded(std::size_t pos, std::size_t size) {
+    load_end = pos + size;
+    // nothing's been typed after what's been loaded, the cursor stays where it is, at the end or before it
+    if (load_end == this->size()) return;
+    history.shift(pos, size);
+    for (auto c : {&cursor, &mark}) {
+        if (AS(c->pos, std::size_t) < pos) continue;
+        c->pos += AS(size, i64);
+        if (not has_meta_data) continue;
+        c->line = meta_data.line_of(AS(c->pos, std::size_t));
+        c->col_pos = AS(AS(c->pos, std::size_t) - meta_data.line_begin(c->line), int);
+    }
+    state_is_pristine = false;
+}
+
+void TextData::text_changed(std::size_t pos, std::size_t removed, std::size_t inserted) {
+    ++text_version;
+    if (pos < load_end) load_end = (load_end >= pos + removed ? load_end - removed : pos) + inserted;
+    for (auto &changed_range : changed_ranges) {
+        if (not changed_range) {
+            changed_range = {pos, pos + inserted};
+            continue;
+        }
+        auto &[begin, end] = *changed_range;
+        // what was changed before, moves with what this changes, if it's after pos
+        if (end > pos && end != std::string::npos) end = (end >= pos + removed ? end - removed : pos) + inserted;
+        begin = std::min(begin, pos);
+        end = std::max(end, pos + inserted);
+    }
+}
+
+void TextData::all_text_changed() {
+    ++text_version;
+    changed_ranges.fill(std::pair<std::size_t, std::size_t>{0, std::string::npos});
+}
+
+std::optional<std::pair<std::size_t, std::size_t>> TextData::take_changed_range(ChangeListener listener) {
+    return std::exchange(changed_ranges[AS(listener, std::size_t)], std::nullopt);
+}
+
+TextSnapshot TextData::snapshot() {
+    auto changed = take_changed_range(ChangeListener::Snapshot);
+    if (latest_snapshot.buffer_id != id || (changed && changed->second == std::string::npos)) {
+        MICRO_BENCH("TextData::snapshot");
+        latest_snapshot = TextSnapshot{snapshot_pieces(0, size())};
+    } else if (changed) {
+        MICRO_BENCH("TextData::snapshot");
+        auto [begin, end] = *changed;
+        // [begin, end) is what the text has there now, & [begin, old_end) what the last snapshot has
+        const auto old_end = latest_snapshot.size() - (size() - end);
+        latest_snapshot = latest_snapshot.replaced(begin, old_end - begin, snapshot_pieces(begin, end));
+    }
+    latest_snapshot.buffer_id = id;
+    latest_snapshot.version = text_version;
+    return latest_snapshot;
+}
+
+std::vector<TextSnapshot::Piece> TextData::snapshot_pieces(std::size_t begin, std::size_t end) const {
+    return TextSnapshot::copy_of(chunks(begin, end));
+}
+
+void TextData::record_insert(std::size_t pos, std::string_view text) {
+    text_changed(pos, 0, text.size());
+    shift_extra_cursors(pos, 0, text.size());
+    if (has_meta_data && recording) history.record_insert(pos, text);
+}
+
+void TextData::record_remove(std::size_t pos, std::string_view text) {
+    text_changed(pos, text.size(), 0);
+    shift_extra_cursors(pos, text.size(), 0);
+    if (has_meta_data && recording) history.record_remove(pos, text);
+}
+
+void TextData::record_batch(std::size_t pos, std::size_t removed, std::size_t inserted,
+                            std::vector<EditHistory::Replacement> &&replaced) {
+    text_changed(pos, removed, inserted);
+    if (recording_edits()) history.record_batch(std::move(replaced));
+}
+
+/// ----------- MULTIPLE CURSORS ----------------
+
+namespace {
+/// [begin, end) of what a batch replaces at each cursor, sorted & merged where they overlap, and which of them the
+/// primary cursor is in
+struct CursorRanges {
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    std::size_t primary;
+};
+
+/// ranges.front() is the primary cursor's
+CursorRanges merge_ranges(std::vector<std::pair<std::size_t, std::size_t>> &&ranges) {
+    std::vector<std::size_t> order(ranges.size());
+    for (auto i = 0u; i < order.size(); ++i) order[i] = i;
+    std::ranges::sort(order, [&](auto a, auto b) { return ranges[a] < ranges[b]; });
+    CursorRanges merged{.ranges = {}, .primary = 0};
+    merged.ranges.reserve(ranges.size());
+    for (auto i : order) {
+        auto [begin, end] = ranges[i];
+        // two cursors at the same place are one, as are two selections that overlap
+        auto &last = merged.ranges;
+        if (not last.empty() && (begin < last.back().second || begin == last.back().first)) {
+            last.back().second = std::max(last.back().second, end);
+        } else {
+            merged.ranges.emplace_back(begin, end);
+        }
+        if (i == 0) merged.primary = merged.ranges.size() - 1;
+    }
+    return merged;
+}
+}// namespace
+
+void TextData::add_cursor(std::size_t pos, std::optional<std::size_t> anchor) {
+    pos = std::min(pos, size());
+    extra_cursors.push_back(Selection{.anchor = AS(std::min(anchor.value_or(pos), size()), i64), .pos = AS(pos, i64)});
+    normalize_cursors();
+    state_is_pristine = false;
+}
+
+void TextData::add_cursor_on_next_line(CursorDirection dir) {
+    if (not has_meta_data) return;
+    auto from = AS(cursor.pos, std::size_t);
+    if (not extra_cursors.empty()) {
+        from = dir == CursorDirection::Forward ? std::max(from, AS(extra_cursors.back().pos, std::size_t))
+                                               : std::min(from, AS(extra_cursors.front().pos, std::size_t));
+    }
+    const auto line = AS(meta_data.line_of(from), std::size_t);
+    if (dir == CursorDirection::Back ? line == 0 : line + 1 >= meta_data.line_count()) return;
+    const auto next_line = dir == CursorDirection::Forward ? line + 1 : line - 1;
+    // the column is the primary cursor's, not the one of the cursor next to it, which may be on a shorter line
+    auto length = meta_data.line_index.line_length(next_line);
+    if (next_line + 1 < meta_data.line_count()) --length;
+    add_cursor(meta_data.line_begin(next_line) + std::min(AS(cursor.col_pos, std::size_t), length));
+}
+
+void TextData::clear_extra_cursors() {
+    if (extra_cursors.empty()) return;
+    extra_cursors.clear();
+    state_is_pristine = false;
+}
+
+std::size_t TextData::select_all(std::string_view needle) {
+    std::string error{};
+    auto searcher = Searcher::create(needle, SearchOptions{}, error);
+    if (not searcher) return 0;
+    std::vector<std::size_t> found{};
+    for (const auto &match : searcher->find_all(*this, 0, size())) found.push_back(match.begin);
+    if (found.empty()) return 0;
+
+    extra_cursors.clear();
+    extra_cursors.reserve(found.size() - 1);
+    for (auto it = found.begin() + 1; it != found.end(); ++it) {
+        extra_cursors.push_back(Selection{.anchor = AS(*it, i64), .pos = AS(*it + needle.size(), i64)});
+    }
+    cursor.reset();
+    step_cursor_to(found.front());
+    set_mark_at_cursor();
+    step_cursor_to(found.front() + needle.size());
+    state_is_pristine = false;
+    return found.size();
+}
+
+void TextData::insert_at_cursors(std::string_view text) {
+    std::vector<std::pair<std::size_t, std::size_t>> ranges{};
+    ranges.reserve(cursor_count());
+    auto [primary_begin, primary_end] = get_cursor_rect();
+    ranges.emplace_back(AS(primary_begin.pos, std::size_t), AS(primary_end.pos, std::size_t));
+    for (const auto &s : extra_cursors) ranges.emplace_back(s.begin(), s.end());
+    auto merged = merge_ranges(std::move(ranges));
+
+    std::vector<TextEdit> edits{};
+    edits.reserve(merged.ranges.size());
+    for (auto [begin, end] : merged.ranges) edits.push_back(TextEdit{begin, end - begin, text});
+    apply_batch(edits);
+
+    std::vector<i64> positions{};
+    positions.reserve(edits.size());
+    i64 delta = 0;
+    for (const auto &e : edits) {
+        positions.push_back(AS(e.pos, i64) + delta + AS(text.size(), i64));
+        delta += AS(text.size(), i64) - AS(e.removed, i64);
+    }
+    place_cursors(positions, merged.primary);
+}
+
+void TextData::remove_at_cursors(const Movement &m) {
+    auto range_of = [&](std::size_t anchor, std::size_t pos) {
+        if (anchor == pos) anchor = position_after(pos, m);
+        return std::pair{std::min(anchor, pos), std::max(anchor, pos)};
+    };
+    std::vector<std::pair<std::size_t, std::size_t>> ranges{};
+    ranges.reserve(cursor_count());
+    const auto primary_pos = AS(cursor.pos, std::size_t);
+    ranges.push_back(range_of(mark_set ? AS(mark.pos, std::size_t) : primary_pos, primary_pos));
+    for (const auto &s : extra_cursors) ranges.push_back(range_of(AS(s.anchor, std::size_t), AS(s.pos, std::size_t)));
+    auto merged = merge_ranges(std::move(ranges));
+
+    std::vector<TextEdit> edits{};
+    edits.reserve(merged.ranges.size());
+    for (auto [begin, end] : merged.ranges) edits.push_back(TextEdit{begin, end - begin, {}});
+    apply_batch(edits);
+
+    std::vector<i64> positions{};
+    positions.reserve(edits.size());
+    i64 delta = 0;
+    for (const auto &e : edits) {
+        positions.push_back(AS(e.pos, i64) + delta);
+        delta -= AS(e.removed, i64);
+    }
+    place_cursors(positions, merged.primary);
+}
+
+void TextData::move_cursors(const Movement &m) {
+    for (auto &s : extra_cursors) {
+        s.pos = AS(position_after(s.pos, m), i64);
+        s.anchor = s.pos;
+    }
+    if (mark_set) clear_marks();
+    move_cursor(m);
+    normalize_cursors();
+}
+
+void TextData::apply_batch(const std::vector<TextEdit> &edits) {
+    if (edits.empty()) return;
+    // a backend without a batch of its own makes the edits one at a time, from the last, so that the positions of the
+    // ones before it are still what they were. The cursors are placed by the caller, so they're not kept up to date
+    const auto record = recording_edits();
+    auto was_recording = std::exchange(recording, false);
+    auto extras = std::exchange(extra_cursors, {});
+    std::vector<EditHistory::Replacement> replaced{};
+    for (auto it = edits.rbegin(); it != edits.rend(); ++it) {
+        cursor.reset();
+        step_cursor_to(it->pos);
+        if (record && (it->removed > 0 || not it->inserted.empty())) {
+            auto removed = view_range(it->pos, it->removed);
+            replaced.push_back(EditHistory::Replacement{it->pos, std::string{removed}, std::string{it->inserted}});
+        }
+        if (it->removed > 0) remove(Movement::Char(it->removed, CursorDirection::Forward));
+        if (not it->inserted.empty()) insert_str(it->inserted);
+    }
+    extra_cursors = std::move(extras);
+    recording = was_recording;
+    std::reverse(replaced.begin(), replaced.end());
+    if (record) history.record_batch(std::move(replaced));
+    state_is_pristine = false;
+}
+
+void TextData::replace(std::size_t pos, std::size_t removed, std::string_view text) {
+    MICRO_BENCH("TextData::replace");
+    clear_marks();
+    apply_batch({TextEdit{pos, removed, text}});
+    cursor.reset();
+    step_cursor_to(pos + text.size());
+}
+
+void TextData::paste(std::string_view text) {
+    if (not mark_set) {
+        replace(AS(cursor.pos, std::size_t), 0, text);
+        return;
+    }
+    auto [begin, end] = get_cursor_rect();
+    replace(AS(begin.pos, std::size_t), AS(end.pos - begin.pos, std::size_t), text);
+}
+
+std::size_t TextData::position_after(std::size_t from, const Movement &m) {
+    auto saved = cursor;
+    cursor.reset();
+    step_cursor_to(from);
+    move_cursor(m);
+    auto to = AS(cursor.pos, std::size_t);
+    cursor = saved;
+    return to;
+}
+
+void TextData::place_cursors(const std::vector<i64> &positions, std::size_t primary) {
+    clear_marks();
+    extra_cursors.clear();
+    extra_cursors.reserve(positions.size() - 1);
+    for (auto i = 0u; i < positions.size(); ++i) {
+        if (i != primary) extra_cursors.push_back(Selection{.anchor = positions[i], .pos = positions[i]});
+    }
+    // the primary cursor's line & column may have changed, even where its position hasn't
+    cursor.reset();
+    step_cursor_to(AS(positions[primary], std::size_t));
+    normalize_cursors();
+    state_is_pristine = false;
+}
+
+void TextData::shift_extra_cursors(std::size_t pos, std::size_t removed, std::size_t inserted) {
+    const auto begin = AS(pos, i64);
+    const auto end = AS(pos + removed, i64);
+    const auto delta = AS(inserted, i64) - AS(removed, i64);
+    for (auto &s : extra_cursors) {
+        for (auto p : {&s.anchor, &s.pos}) {
+            if (*p >= end) {
+                *p += delta;
+            } else if (*p > begin) {
+                *p = begin;
+            }
+        }
+    }
+}
+
+void TextData::normalize_cursors() {
+    std::ranges::sort(extra_cursors, [](auto &a, auto &b) { return a.pos < b.pos; });
+    auto last = std::unique(extra_cursors.begin(), extra_cursors.end(),
+                            [](auto &a, auto &b) { return a.pos == b.pos; });
+    extra_cursors.erase(last, extra_cursors.end());
+    std::erase_if(extra_cursors, [this](auto &s) { return s.pos == cursor.pos; });
+}
+
+bool TextData::undo() {
+    auto edit = history.undo();
+    if (edit == nullptr) return false;
+    recording = false;
+    clear_marks();
+    clear_extra_cursors();
+    if (edit->kind == EditHistory::Edit::Kind::Batch) {
+        // what each replacement inserted is where it was put, moved by what the ones before it inserted & removed
+        std::vector<TextEdit> reverted{};
+        reverted.reserve(edit->replacements.size());
+        i64 delta = 0;
+        for (const auto &r : edit->replacements) {
+            reverted.push_back(TextEdit{AS(AS(r.pos, i64) + delta, std::size_t), r.inserted.size(), r.removed});
+            delta += AS(r.inserted.size(), i64) - AS(r.removed.size(), i64);
+        }
+        apply_batch(reverted);
+        cursor.reset();
+        step_cursor_to(edit->pos);
+        recording = true;
+        return true;
+    }
+    step_cursor_to(edit->pos);
+    if (edit->kind == EditHistory::Edit::Kind::Insert) {
+        remove(Movement::Char(edit->text.size(), CursorDirection::Forward));
+    } else {
+        insert_str(edit->text);
+    }
+    recording = true;
+    return true;
+}
+
+bool TextData::redo() {
+    auto edit = history.redo();
+    if (edit == nullptr) return false;
+    recording = false;
+    clear_marks();
+    clear_extra_cursors();
+    if (edit->kind == EditHistory::Edit::Kind::Batch) {
+        std::vector<TextEdit> edits{};
+        edits.reserve(edit->replacements.size());
+        for (const auto &r : edit->replacements) edits.push_back(TextEdit{r.pos, r.removed.size(), r.inserted});
+        apply_batch(edits);
+        cursor.reset();
+        step_cursor_to(edit->pos);
+        recording = true;
+        return true;
+    }
+    step_cursor_to(edit->pos);
+    if (edit->kind == EditHistory::Edit::Kind::Insert) {
+        insert_str(edit->text);
     } else {
-        return FileContext{.type = ContexTypes::Unhandled, .path = file_path};
+        remove(Movement::Char(edit->text.size(), CursorDirection::Forward));
     }
+    recording = true;
+    return true;
 }
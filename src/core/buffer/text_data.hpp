@@ -4,15 +4,22 @@
 
 #pragma once
 #include "bookmark.hpp"
+#include "edit_history.hpp"
 #include "file_context.hpp"
+#include "line_index.hpp"
+#include "text_snapshot.hpp"
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <core/core.hpp>
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <utils/strops.hpp>
+#include <vector>
 
 namespace ui {
     class View;
@@ -54,15 +61,33 @@ static inline bool is_delimiter(char ch) {
 namespace fs = std::filesystem;
 
 struct TextMetaData {
-    std::vector<int> line_begins{0};
+    LineIndex line_index{};
     std::string buf_name{};
     std::vector<Bookmark> bookmarks{};
+    /// Set while a FileLoader is streaming the file into the buffer, fraction of it that has arrived
+    std::optional<float> load_progress{};
+    /// Set while a FileSaver is writing the buffer to disk, fraction of it that has been written
+    std::optional<float> save_progress{};
+
+    /// Line that position pos is on
+    [[nodiscard]] int line_of(std::size_t pos) const;
+    /// Offset of the first character on line
+    [[nodiscard]] std::size_t line_begin(std::size_t line) const { return line_index.line_begin(line); }
+    [[nodiscard]] std::size_t line_count() const { return line_index.line_count(); }
+    /// Updates the line index & bookmarks after inserted was inserted at pos, without rescanning the text
+    void on_insert(std::size_t pos, std::string_view inserted);
+    /// Updates the line index & bookmarks after [pos, pos + length) was removed
+    void on_remove(std::size_t pos, std::size_t length);
 };
 
 enum class BufferTypeInfo { CommandInput, StatusBar, EditBuffer, Modal };
 
+/// What keeps something built from the text up to date as it changes, each with a changed range of its own. See
+/// TextData::take_changed_range
+enum class ChangeListener : std::size_t { Highlighter, Search, Snapshot, Journal, Count };
+
 struct BufferCursor {
-    int pos{0};
+    i64 pos{0};
     int line{0};
     int col_pos{0};
     int buffer_id{0};
@@ -71,6 +96,24 @@ struct BufferCursor {
     BufferCursor clone() const;
 };
 
+/// A cursor other than TextData::cursor, and the other end of its selection; anchor is pos when there's none
+struct Selection {
+    i64 anchor{0};
+    i64 pos{0};
+    [[nodiscard]] std::size_t begin() const { return AS(std::min(anchor, pos), std::size_t); }
+    [[nodiscard]] std::size_t end() const { return AS(std::max(anchor, pos), std::size_t); }
+    [[nodiscard]] bool empty() const { return anchor == pos; }
+    bool operator==(const Selection &) const = default;
+};
+
+/// removed characters at pos, replaced by inserted. See TextData::apply_batch. inserted is not owned, it has to outlive
+/// the batch, so that a paste, or the same text typed at 10k cursors, isn't copied for every edit
+struct TextEdit {
+    std::size_t pos;
+    std::size_t removed;
+    std::string_view inserted;
+};
+
 class TextData {
 public:
     BufferTypeInfo info;
@@ -110,8 +153,29 @@ public:
 
     virtual void rebuild_metadata() = 0;
     virtual void clear_metadata();
-    virtual bool has_metadata() { return has_meta_data && not meta_data.line_begins.empty(); }
+    virtual bool has_metadata() { return has_meta_data; }
     virtual bool is_pristine() const { return state_is_pristine; }
+    /// Changes every time the text changes, but not when only the cursor moves, so that the frontend can tell the
+    /// two apart, and keep what it built from the text when it's the same text
+    [[nodiscard]] std::uint64_t version() const { return text_version; }
+    /// [begin, end) of the text, as it is now, that has changed since listener last called this; everything outside of
+    /// it is the same text as then, only moved. For the syntax highlighter to know which of the lexer states it has
+    /// kept are stale, and for search, which of the matches it has kept
+    std::optional<std::pair<std::size_t, std::size_t>> take_changed_range(ChangeListener listener);
+    /// The text as it is now, that never changes, for a job on another thread to read while the text is edited, see
+    /// TextSnapshot. O(1) when the text hasn't changed since the last one was taken; otherwise it copies what changed
+    /// since then (the changed range, see take_changed_range), not the entire text. Main thread, like everything else
+    /// that touches the buffer
+    [[nodiscard]] TextSnapshot snapshot();
+    /// Whether the text has changed since it was loaded from, or last saved to, its file
+    [[nodiscard]] bool has_unsaved_changes() const { return text_version != saved_version; }
+    /// The file has the text as it was at version now, see FileSaver
+    void mark_saved(std::uint64_t version) { saved_version = version; }
+    /// Lets go of what the backend keeps open of the file it was loaded from, copying what it needs of it into memory,
+    /// for when the file is about to be replaced, which windows doesn't allow while it's mapped
+    virtual void release_file() {}
+    /// For the frontend, when it has caught up with the state of the buffer without asking for any of its text
+    void mark_pristine() { state_is_pristine = true; }
     virtual void set_bookmark() = 0;
 #ifdef DEBUG
     virtual std::string to_std_string() const = 0;
@@ -125,7 +189,7 @@ public:
         util::println("Buffer cursor [i:{}, ln: {}, col: {}]", cursor.pos, cursor.line, cursor.col_pos);
     }
     void print_line_meta_data() const {
-        util::println("meta data - line begin: {}", meta_data.line_begins[cursor.line]);
+        util::println("meta data - line begin: {}", meta_data.line_begin(cursor.line));
         util::println("Buffer meta data up to date: {}", data_is_pristine);
     }
 #endif
@@ -143,11 +207,64 @@ public:
     fs::path file_path;
     TextMetaData meta_data;
     virtual std::string_view copy_range(std::pair<BufferCursor, BufferCursor> selected_range) = 0;
-    virtual void goto_next(std::string search) = 0;
+    /// Returns a contiguous view of [begin, begin + length). Like to_string_view, this is what the frontend calls when
+    /// it wants data to display, so it marks the state as pristine. Backends that don't store their text contiguously
+    /// (GapBuffer) only have to make the requested range contiguous, not the entire buffer.
+    virtual std::string_view view_range(std::size_t begin, std::size_t length) = 0;
+    /// [begin, end) of the text, as the pieces that the backend keeps it in, in order. Nothing is copied or moved, so
+    /// the views are good until the text changes. What search walks, see Haystack
+    [[nodiscard]] virtual std::vector<std::string_view> chunks(std::size_t begin, std::size_t end) const = 0;
+    /// [begin, end) of the text, as pieces for a snapshot to keep. Copies of chunks(), unless the backend has text
+    /// that never changes to refer to instead
+    [[nodiscard]] virtual std::vector<TextSnapshot::Piece> snapshot_pieces(std::size_t begin, std::size_t end) const;
+    /// Appends text that FileLoader read, to the end of what's been loaded so far, leaving the cursor where it is in the
+    /// text. What's been typed after that stays after it, see load_end. line_lengths are what LineIndex::line_lengths
+    /// returns for text, scanned on the loader's thread so that we don't have to, & only used when it goes at the end
+    virtual void append_loaded(std::string_view text, const std::vector<std::size_t> &line_lengths);
+
+    /**
+     * Multiple cursors. cursor (and mark) is the primary one, the one that everything that edits at a single place
+     * uses. The others are Selections, that only have a position; their lines & columns are looked up by whoever
+     * needs them. Edits at all of the cursors are made as one batch, see apply_batch, so that typing at 10k cursors
+     * costs the 10k edits, and not 10k of everything that follows an edit.
+     */
+    /// Adds a cursor at pos, selecting from anchor to it, if there's an anchor. Not where there already is one
+    void add_cursor(std::size_t pos, std::optional<std::size_t> anchor = {});
+    void clear_extra_cursors();
+    /// Adds a cursor on the line after the last cursor, or before the first, at the column of the primary one
+    void add_cursor_on_next_line(CursorDirection dir);
+    [[nodiscard]] std::size_t cursor_count() const { return extra_cursors.size() + 1; }
+    /// The cursors besides the primary one, in the order of the text
+    [[nodiscard]] const std::vector<Selection> &get_extra_cursors() const { return extra_cursors; }
+    /// Selects every occurrence of needle, the first with the primary cursor. Returns how many there are
+    std::size_t select_all(std::string_view needle);
+    /// Replaces the selection of every cursor with text, or inserts it, at those without one
+    void insert_at_cursors(std::string_view text);
+    /// Removes the selection of every cursor, or what m moves over, from those without one
+    void remove_at_cursors(const Movement &m);
+    /// Moves every cursor as m, dropping their selections
+    void move_cursors(const Movement &m);
+    /// Makes edits, which are sorted by pos & don't overlap, with their positions as they are before any of them is
+    /// made, as one change of the text: one version, one entry in the history. Where the cursors end up is up to the
+    /// caller
+    virtual void apply_batch(const std::vector<TextEdit> &edits);
+    /// Replaces [pos, pos + removed) with text as one edit, however large it is: the text is moved once, the line index,
+    /// bookmarks & the changed range are updated once, & it's one entry in the history. Leaves the cursor after text,
+    /// with no selection. What a paste goes through
+    void replace(std::size_t pos, std::size_t removed, std::string_view text);
+    /// Replaces the selection with text, or inserts it at the cursor, if there's none
+    void paste(std::string_view text);
+
+    /// Reverts the latest edit. Returns false if there was nothing to undo
+    bool undo();
+    /// Re-applies the latest undone edit. Returns false if there was nothing to redo
+    bool redo();
+    EditHistory history{};
 
     void set_name(std::string buffer_name);
 
-    virtual FileContext file_context() const;
+    /// What the file of the buffer is, worked out when the file is set, see set_file
+    [[nodiscard]] const FileContext &file_context() const { return context; }
 
 protected:
     /**
@@ -158,6 +275,33 @@ protected:
      */
     bool state_is_pristine{false};
     bool data_is_pristine{false};
+    std::uint64_t text_version{0};
+    std::uint64_t saved_version{0};
+    std::array<std::optional<std::pair<std::size_t, std::size_t>>, AS(ChangeListener::Count, std::size_t)>
+            changed_ranges{};
+    /// Bumps the text version & widens the changed range, by removed characters at pos being replaced by inserted
+    void text_changed(std::size_t pos, std::size_t removed, std::size_t inserted);
+    /// Like text_changed, for when all of the text has been replaced
+    void all_text_changed();
+    /// Where the next chunk that FileLoader hands us goes, the end of what's been loaded so far. Edits before it move
+    /// it, those at it don't, so what's typed at the end while the file is loading stays after the rest of the file
+    std::size_t load_end{0};
+    /// For append_loaded, once size characters of the file went in at pos: the changed range & load_end, & the
+    /// cursors & history of what's after pos move with the text
+    void record_loaded(std::size_t pos, std::size_t size);
+
+    /// Every backend calls these from the places where text actually gets inserted / removed, the same places that
+    /// keep the meta data up to date. They bump the text version, and only buffers with meta data (the edit buffers)
+    /// keep a history
+    void record_insert(std::size_t pos, std::string_view text);
+    void record_remove(std::size_t pos, std::string_view text);
+    /// For backends that have a batch of their own; the batch replaced [pos, pos + removed) by inserted characters.
+    /// replaced is what goes into the history, and can be left empty when not recording_edits()
+    void record_batch(std::size_t pos, std::size_t removed, std::size_t inserted,
+                      std::vector<EditHistory::Replacement> &&replaced);
+    [[nodiscard]] bool recording_edits() const { return has_meta_data && recording; }
+    /// Drops the last snapshot taken, & what it keeps alive; the next one is taken from scratch
+    void forget_snapshot() { latest_snapshot = TextSnapshot{}; }
 
 private:
     virtual void char_move_forward(std::size_t count) = 0;
@@ -166,4 +310,21 @@ private:
     virtual void word_move_backward(std::size_t count) = 0;
     virtual void line_move_forward(std::size_t count) = 0;
     virtual void line_move_backward(std::size_t count) = 0;
+    /// Off while undo / redo / append_loaded edit the buffer, as those edits are not the user's
+    bool recording{true};
+    FileContext context{};
+    std::vector<Selection> extra_cursors{};
+    /// The last snapshot taken, which the next one is built from
+    TextSnapshot latest_snapshot{};
+
+    /// Where m would move the cursor, if it was at from
+    std::size_t position_after(std::size_t from, const Movement &m);
+    /// Puts the primary cursor at positions[primary], & the others at the rest of them, without selections
+    void place_cursors(const std::vector<i64> &positions, std::size_t primary);
+    /// Keeps the other cursors where they were in the text, when [pos, pos + removed) is replaced by inserted ones
+    void shift_extra_cursors(std::size_t pos, std::size_t removed, std::size_t inserted);
+    /// The part of record_loaded that record_insert doesn't do
+    void shift_past_loaded(std::size_t pos, std::size_t size);
+    /// Sorts the other cursors, & drops those that are where another one, or the primary one, is
+    void normalize_cursors();
 };
\ No newline at end of file
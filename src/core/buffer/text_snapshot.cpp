@@ -0,0 +1,171 @@
+//
+// Created by 46769 on 2021-02-20.
+//
+
+#include "text_snapshot.hpp"
+#include <algorithm>
+#include <cassert>
+#include <core/core.hpp>
+#include <utility>
+
+/// A piece of text, when it has no children, or what its two children are, in order. Heights of the children differ by
+/// at most 1, so that the tree stays O(log n) deep however it's edited
+struct TextSnapshot::Node {
+    std::size_t size;
+    int height;
+    std::shared_ptr<const Node> left{};
+    std::shared_ptr<const Node> right{};
+    Piece piece{};
+
+    [[nodiscard]] bool is_piece() const { return left == nullptr; }
+};
+
+namespace {
+using Node = TextSnapshot::Node;
+using NodePtr = std::shared_ptr<const Node>;
+
+/// Pieces shorter than this, next to each other, are copied into one, so that typing a character at a time between
+/// snapshots doesn't leave a piece per character behind
+constexpr std::size_t MERGE_SIZE = 256;
+
+NodePtr make_piece(TextSnapshot::Piece piece) {
+    return std::make_shared<const Node>(Node{.size = piece.text.size(), .height = 0, .piece = std::move(piece)});
+}
+
+NodePtr make_branch(NodePtr left, NodePtr right) {
+    const auto size = left->size + right->size;
+    const auto height = std::max(left->height, right->height) + 1;
+    return std::make_shared<const Node>(
+            Node{.size = size, .height = height, .left = std::move(left), .right = std::move(right)});
+}
+
+/// AVL join: a's text followed by b's, as a balanced tree, in O(difference of their heights)
+NodePtr join(const NodePtr &a, const NodePtr &b) {
+    if (not a) return b;
+    if (not b) return a;
+    if (a->is_piece() && b->is_piece() && a->size + b->size <= MERGE_SIZE) {
+        auto text = std::make_shared<std::string>(a->piece.text);
+        text->append(b->piece.text);
+        std::string_view view{*text};
+        return make_piece({std::move(text), view});
+    }
+    if (a->height > b->height + 1) {
+        // b goes down the right side of a, until it's next to something about as tall
+        auto right = join(a->right, b);
+        if (right->height <= a->left->height + 1) return make_branch(a->left, right);
+        if (right->left->height <= right->right->height) {
+            return make_branch(make_branch(a->left, right->left), right->right);
+        }
+        return make_branch(make_branch(a->left, right->left->left), make_branch(right->left->right, right->right));
+    }
+    if (b->height > a->height + 1) {
+        auto left = join(a, b->left);
+        if (left->height <= b->right->height + 1) return make_branch(left, b->right);
+        if (left->right->height <= left->left->height) {
+            return make_branch(left->left, make_branch(left->right, b->right));
+        }
+        return make_branch(make_branch(left->left, left->right->left), make_branch(left->right->right, b->right));
+    }
+    return make_branch(a, b);
+}
+
+/// [0, pos) & [pos, size) of node's text. A piece that pos is inside of, is split into two views of the same text
+std::pair<NodePtr, NodePtr> split(const NodePtr &node, std::size_t pos) {
+    if (not node || pos == 0) return {nullptr, node};
+    if (pos >= node->size) return {node, nullptr};
+    if (node->is_piece()) {
+        const auto &[owner, text] = node->piece;
+        return {make_piece({owner, text.substr(0, pos)}), make_piece({owner, text.substr(pos)})};
+    }
+    if (pos < node->left->size) {
+        auto [left, right] = split(node->left, pos);
+        return {std::move(left), join(right, node->right)};
+    }
+    auto [left, right] = split(node->right, pos - node->left->size);
+    return {join(node->left, left), std::move(right)};
+}
+
+/// pieces [first, last) as a tree that's as balanced as it gets
+NodePtr build(std::vector<TextSnapshot::Piece> &pieces, std::size_t first, std::size_t last) {
+    if (first == last) return nullptr;
+    if (last - first == 1) return make_piece(std::move(pieces[first]));
+    const auto mid = first + (last - first) / 2;
+    return make_branch(build(pieces, first, mid), build(pieces, mid, last));
+}
+
+NodePtr build(std::vector<TextSnapshot::Piece> &&pieces) {
+    std::erase_if(pieces, [](const auto &piece) { return piece.text.empty(); });
+    return build(pieces, 0, pieces.size());
+}
+
+/// Calls fn with what the pieces of node have of [begin, end), first to last. Positions are relative to node
+template<typename Fn>
+void for_each_piece(const NodePtr &node, std::size_t begin, std::size_t end, Fn &fn) {
+    if (not node || begin >= end || begin >= node->size) return;
+    if (node->is_piece()) {
+        fn(node->piece.text.substr(begin, std::min(end, node->size) - begin));
+        return;
+    }
+    const auto split_at = node->left->size;
+    if (begin < split_at) for_each_piece(node->left, begin, end, fn);
+    if (end > split_at) for_each_piece(node->right, begin > split_at ? begin - split_at : 0, end - split_at, fn);
+}
+} // namespace
+
+TextSnapshot::TextSnapshot(std::vector<Piece> &&pieces) : root(build(std::move(pieces))) {}
+
+std::vector<TextSnapshot::Piece> TextSnapshot::copy_of(const std::vector<std::string_view> &text) {
+    auto block = std::make_shared<std::string>();
+    std::size_t length = 0;
+    for (auto part : text) length += part.size();
+    block->reserve(length);
+    for (auto part : text) block->append(part);
+    std::string_view view{*block};
+    std::vector<Piece> pieces{};
+    pieces.push_back(Piece{std::move(block), view});
+    return pieces;
+}
+
+TextSnapshot TextSnapshot::replaced(std::size_t pos, std::size_t removed, std::vector<Piece> &&pieces) const {
+    assert(pos + removed <= size());
+    auto [before, rest] = split(root, pos);
+    auto after = split(rest, removed).second;
+    return TextSnapshot{join(join(before, build(std::move(pieces))), after)};
+}
+
+std::size_t TextSnapshot::size() const { return root ? root->size : 0; }
+
+char TextSnapshot::at(std::size_t pos) const {
+    assert(pos < size());
+    const Node *node = root.get();
+    while (not node->is_piece()) {
+        if (pos < node->left->size) {
+            node = node->left.get();
+        } else {
+            pos -= node->left->size;
+            node = node->right.get();
+        }
+    }
+    return node->piece.text[pos];
+}
+
+std::vector<std::string_view> TextSnapshot::chunks(std::size_t begin, std::size_t end) const {
+    std::vector<std::string_view> result{};
+    auto add = [&](std::string_view part) { result.push_back(part); };
+    for_each_piece(root, begin, end, add);
+    return result;
+}
+
+void TextSnapshot::copy(std::size_t begin, std::size_t end, std::string &out) const {
+    end = std::min(end, size());
+    if (begin >= end) return;
+    out.reserve(out.size() + end - begin);
+    auto add = [&](std::string_view part) { out.append(part); };
+    for_each_piece(root, begin, end, add);
+}
+
+std::string TextSnapshot::to_string() const {
+    std::string result{};
+    copy(0, size(), result);
+    return result;
+}
@@ -0,0 +1,66 @@
+//
+// Created by 46769 on 2021-02-20.
+//
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * The text of a buffer as it was at one version of it, which never changes, for what works with the text off of the
+ * main thread (saving, searching, lexing) while the user keeps editing it. Copying one is O(1), and any number of
+ * threads can read the same one without locking anything.
+ *
+ * It's a persistent rope: a balanced tree of pieces of text, where no node is changed once it's built. The next version
+ * is a new root, built from the one before it by copying the nodes on the path down to what changed, so two versions
+ * share every node, and every piece of text, that the edits between them didn't touch:
+ *
+ *  v1:        (*)                 v2, [c] edited:        (*)'
+ *           /     \                                    /     \
+ *         (*)     (*)                               (*)v1    (*)'
+ *        /  \    /  \                                       /    \
+ *      [a] [b] [c] [d]                                   [c']    [d]v1
+ *
+ * A piece keeps what it's a view into alive; a block of text copied from the buffer, or the file that a MappedBuffer
+ * has mapped, so a snapshot of a mapped file copies none of it.
+ */
+class TextSnapshot {
+public:
+    /// A view into text, and what keeps that text alive
+    struct Piece {
+        std::shared_ptr<const void> owner;
+        std::string_view text;
+    };
+    /// Defined in text_snapshot.cpp
+    struct Node;
+
+    TextSnapshot() = default;
+    /// The text of pieces, in order. O(number of pieces)
+    explicit TextSnapshot(std::vector<Piece> &&pieces);
+    /// text copied into a block of its own, as pieces
+    [[nodiscard]] static std::vector<Piece> copy_of(const std::vector<std::string_view> &text);
+
+    /// This text, with [pos, pos + removed) replaced by pieces. O(log n), & shares everything else with this one
+    [[nodiscard]] TextSnapshot replaced(std::size_t pos, std::size_t removed, std::vector<Piece> &&pieces) const;
+
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] bool empty() const { return size() == 0; }
+    [[nodiscard]] char at(std::size_t pos) const;
+    /// [begin, end) of the text, as the pieces it's made of, in order. Good for as long as this snapshot is; a Haystack
+    /// can be made of them, to search it
+    [[nodiscard]] std::vector<std::string_view> chunks(std::size_t begin, std::size_t end) const;
+    /// Appends [begin, end) to out
+    void copy(std::size_t begin, std::size_t end, std::string &out) const;
+    [[nodiscard]] std::string to_string() const;
+
+    /// What this is a snapshot of; TextData::id, & its version() then
+    int buffer_id{-1};
+    std::uint64_t version{0};
+
+private:
+    explicit TextSnapshot(std::shared_ptr<const Node> node) : root(std::move(node)) {}
+    std::shared_ptr<const Node> root{};
+};
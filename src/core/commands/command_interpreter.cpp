@@ -92,6 +92,7 @@ void CommandInterpreter::set_current_command_read(Commands type) {
         case Commands::UserCommand:
             break;
         case Commands::Search:
+            ctx->begin_incremental_search();
             break;
     }
     getting_input = true;
@@ -150,6 +151,9 @@ void CommandInterpreter::evaluate_current_input() {
             break;
         case Commands::Fail:
             break;
+        case Commands::Search:
+            ctx->search_as_you_type(str);
+            break;
     }
 }
 void CommandInterpreter::register_application(App *pApp) { this->ctx = pApp; }
@@ -245,6 +249,15 @@ void CommandInterpreter::parse_command(std::string_view str) {
         ctx->reload_configuration();
     } else if (cmd_str_rep == "kbreload") {
         ctx->reload_keybindings();
+    } else if (cmd_str_rep == "cursors" && delim != std::string_view::npos) {
+        // cursors <text>, a cursor at every occurrence of text in the active buffer
+        ctx->select_all_in_active(std::string{str.substr(delim + 1)});
+    } else if (cmd_str_rep == "profile") {
+        ctx->toggle_profiler();
+    } else if (cmd_str_rep == "trace") {
+        // trace <file>, which is trace.json if it's left out
+        auto path = delim == std::string_view::npos ? "trace.json"sv : str.substr(delim + 1);
+        ctx->write_trace(path);
     }
 }
 bool CommandInterpreter::command_can_autocomplete() {
@@ -0,0 +1,34 @@
+//
+// Created by 46769 on 2021-02-17.
+//
+
+#include "haystack.hpp"
+#include <cassert>
+
+Haystack::Haystack(std::vector<std::string_view> &&text_chunks) {
+    chunks.reserve(text_chunks.size());
+    chunk_begins.reserve(text_chunks.size() + 1);
+    for (auto chunk : text_chunks) {
+        if (chunk.empty()) continue;
+        chunks.push_back(chunk);
+        chunk_begins.push_back(chunk_begins.back() + chunk.size());
+    }
+}
+
+std::size_t Haystack::chunk_of(std::size_t pos) const {
+    assert(pos < size());
+    auto it = std::upper_bound(chunk_begins.begin(), chunk_begins.end(), pos);
+    return AS(std::distance(chunk_begins.begin(), it) - 1, std::size_t);
+}
+
+char Haystack::at(std::size_t pos) const {
+    auto idx = chunk_of(pos);
+    return chunks[idx][pos - chunk_begins[idx]];
+}
+
+void Haystack::copy(std::size_t begin, std::size_t end, std::string &out) const {
+    scan_forward(begin, end, [&](std::string_view part, std::size_t) {
+        out.append(part);
+        return true;
+    });
+}
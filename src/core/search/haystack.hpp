@@ -0,0 +1,65 @@
+//
+// Created by 46769 on 2021-02-17.
+//
+
+#pragma once
+#include <algorithm>
+#include <core/core.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// [begin, end) of the text searched
+struct SearchMatch {
+    std::size_t begin;
+    std::size_t end;
+    bool operator==(const SearchMatch &) const = default;
+};
+
+/**
+ * Text to search, as the chunks that a buffer keeps it in (see TextData::chunks), in order, the first beginning at 0.
+ * The searches walk the chunks, so nothing is copied or made contiguous to search a buffer, whatever it is made of.
+ */
+class Haystack {
+public:
+    explicit Haystack(std::vector<std::string_view> &&text_chunks);
+
+    [[nodiscard]] std::size_t size() const { return chunk_begins.back(); }
+    [[nodiscard]] char at(std::size_t pos) const;
+    /// Whether a line begins at pos; the text does, and every line after a newline
+    [[nodiscard]] bool line_begins_at(std::size_t pos) const { return pos == 0 || at(pos - 1) == '\n'; }
+    /// Whether a line ends at pos; with a newline, or with the text
+    [[nodiscard]] bool line_ends_at(std::size_t pos) const { return pos == size() || at(pos) == '\n'; }
+    /// Appends [begin, end) to out
+    void copy(std::size_t begin, std::size_t end, std::string &out) const;
+
+    /// Calls fn(part, position of part) with what the chunks have of [begin, end), first to last, while fn returns true
+    template<typename Fn>
+    void scan_forward(std::size_t begin, std::size_t end, Fn fn) const {
+        if (begin >= end) return;
+        for (auto idx = chunk_of(begin); idx < chunks.size() && chunk_begins[idx] < end; ++idx) {
+            auto first = std::max(begin, chunk_begins[idx]);
+            auto last = std::min(end, chunk_begins[idx + 1]);
+            if (not fn(chunks[idx].substr(first - chunk_begins[idx], last - first), first)) return;
+        }
+    }
+
+    /// Same as scan_forward, but from the last to the first
+    template<typename Fn>
+    void scan_backward(std::size_t begin, std::size_t end, Fn fn) const {
+        if (begin >= end) return;
+        for (auto idx = chunk_of(end - 1) + 1; idx-- > 0 && chunk_begins[idx + 1] > begin;) {
+            auto first = std::max(begin, chunk_begins[idx]);
+            auto last = std::min(end, chunk_begins[idx + 1]);
+            if (not fn(chunks[idx].substr(first - chunk_begins[idx], last - first), first)) return;
+        }
+    }
+
+private:
+    std::vector<std::string_view> chunks;
+    /// chunk_begins[i] is where chunks[i] begins in the text, the last element is size()
+    std::vector<std::size_t> chunk_begins{0};
+
+    /// Index of the chunk that pos is in, pos < size()
+    [[nodiscard]] std::size_t chunk_of(std::size_t pos) const;
+};
@@ -0,0 +1,130 @@
+//
+// Created by 46769 on 2021-02-19.
+//
+
+#include "match_index.hpp"
+#include <algorithm>
+#include <core/buffer/text_data.hpp>
+#include <core/strops.hpp>
+
+static const std::vector<SearchMatch> NO_MATCHES{};
+
+static bool by_begin(const SearchMatch &match, std::size_t pos) { return match.begin < pos; }
+
+void MatchIndex::update(TextData &text, Searcher &searcher) {
+    if (text.id != buffer_id) {
+        levels.clear();
+        buffer_id = text.id;
+    }
+    auto changed = text.take_changed_range(ChangeListener::Search);
+    const auto same_query = not levels.empty() && levels.back().query == searcher.query() &&
+                            levels.back().options == searcher.options();
+    if (not changed && same_query && text.version() == text_version) return;
+
+    MICRO_BENCH("MatchIndex::update");
+    Haystack haystack{text.chunks(0, text.size())};
+    if (changed && not levels.empty()) {
+        // what the queries before the current one matched is of no use after an edit, & what the current one matched
+        // is only of use to searcher if it searches for the same thing
+        levels.erase(levels.begin(), levels.end() - 1);
+        if (not same_query || not apply_edit(haystack, searcher, changed->first, changed->second)) levels.clear();
+    }
+    text_version = text.version();
+    text_size = haystack.size();
+
+    while (not levels.empty() && not narrows(levels.back(), searcher)) levels.pop_back();
+    if (not levels.empty() && levels.back().query == searcher.query() && levels.back().options == searcher.options()) {
+        return;
+    }
+
+    Level level{.query = searcher.query(), .options = searcher.options(), .regex = searcher.is_regex()};
+    if (levels.empty() || not levels.back().complete) {
+        levels.clear();
+        search(haystack, searcher, 0, haystack.size(), level);
+    } else {
+        const auto length = searcher.query().size();
+        for (const auto &match : levels.back().matches) {
+            if (searcher.literal_at(haystack, match.begin)) level.matches.push_back({match.begin, match.begin + length});
+        }
+    }
+    levels.push_back(std::move(level));
+}
+
+bool MatchIndex::narrows(const Level &level, const Searcher &searcher) {
+    if (level.regex || searcher.is_regex()) {
+        return level.query == searcher.query() && level.options == searcher.options();
+    }
+    // a search that ignores case matches more than one that doesn't, not less
+    if (searcher.options().ignore_case && not level.options.ignore_case) return false;
+    const std::string_view query = searcher.query();
+    if (query.size() < level.query.size()) return false;
+    return str::find_literal(query.data(), level.query.size(), level.query, level.options.ignore_case) == 0;
+}
+
+void MatchIndex::search(const Haystack &text, Searcher &searcher, std::size_t begin, std::size_t end, Level &level) {
+    // a string search keeps those that overlap, see narrows
+    level.complete = searcher.find_all(text, begin, end, not level.regex, MAX_MATCHES, level.matches);
+}
+
+bool MatchIndex::apply_edit(const Haystack &text, Searcher &searcher, std::size_t begin, std::size_t end) {
+    auto &level = levels.back();
+    if (level.regex || not level.complete || end == std::string::npos) return false;
+    // [begin, end) is what the text has there now, & [begin, old_end) what it had
+    const auto old_end = text_size - (text.size() - end);
+    const auto length = level.query.size();
+    auto &matches = level.matches;
+    // the matches that overlap what was changed are gone, those after it move with the text
+    const auto window_begin = begin > length ? begin - length + 1 : 0;
+    auto first = std::lower_bound(matches.begin(), matches.end(), window_begin, by_begin);
+    auto last = std::lower_bound(first, matches.end(), old_end, by_begin);
+    for (auto it = last; it != matches.end(); ++it) {
+        it->begin = it->begin - old_end + end;
+        it->end = it->begin + length;
+    }
+    auto at = matches.erase(first, last);
+
+    // & what's there now is searched for the ones that overlap it; the window is too short for those that were moved
+    Level found{.query = level.query, .options = level.options, .regex = false};
+    search(text, searcher, window_begin, std::min(text.size(), end + length - 1), found);
+    matches.insert(at, found.matches.begin(), found.matches.end());
+    if (matches.size() > MAX_MATCHES) {
+        matches.resize(MAX_MATCHES);
+        level.complete = false;
+    }
+    return true;
+}
+
+const std::vector<SearchMatch> &MatchIndex::matches() const {
+    return levels.empty() ? NO_MATCHES : levels.back().matches;
+}
+
+bool MatchIndex::complete() const { return levels.empty() || levels.back().complete; }
+
+std::span<const SearchMatch> MatchIndex::in_range(std::size_t begin, std::size_t end) const {
+    const auto &all = matches();
+    auto first = std::lower_bound(all.begin(), all.end(), begin, by_begin);
+    auto last = std::lower_bound(first, all.end(), end, by_begin);
+    return {first, last};
+}
+
+std::optional<SearchMatch> MatchIndex::next(std::size_t pos) const {
+    const auto &all = matches();
+    auto it = std::lower_bound(all.begin(), all.end(), pos, by_begin);
+    if (it == all.end()) return {};
+    return *it;
+}
+
+std::optional<SearchMatch> MatchIndex::prev(std::size_t pos) const {
+    // the ends are in order too; a string search's matches all have the same length, & a regex's don't overlap
+    const auto &all = matches();
+    auto it = std::partition_point(all.begin(), all.end(), [pos](const auto &match) { return match.end <= pos; });
+    if (it == all.begin()) return {};
+    return *std::prev(it);
+}
+
+std::size_t MatchIndex::ordinal(std::size_t pos) const {
+    const auto &all = matches();
+    return AS(std::distance(all.begin(), std::upper_bound(all.begin(), all.end(), pos, [](auto p, const auto &match) {
+                  return p < match.begin;
+              })), std::size_t);
+}
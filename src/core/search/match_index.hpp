@@ -0,0 +1,68 @@
+//
+// Created by 46769 on 2021-02-19.
+//
+
+#pragma once
+#include "haystack.hpp"
+#include "searcher.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+class TextData;
+
+/**
+ * Every match of a search in a buffer, in the order of the text, kept up to date as the search is typed, & the text
+ * edited, instead of searching all of the text again each time:
+ *  - a string search for more of what the one before it searched for (the next key typed into the find prompt) can
+ *    only match where that one did, so only those places are checked. The matches of each query on the way there are
+ *    kept, so that backspace costs nothing. A string search keeps the matches that overlap, for this to work
+ *  - an edit has only what it changed searched again (see TextData::take_changed_range), the matches after it are
+ *    moved. A regex can match any length of text around an edit, so those are searched again in full
+ * A buffer can have more matches than is reasonable to keep; past MAX_MATCHES the rest are dropped, the matches are
+ * not complete(), and what needs them searches the text instead.
+ */
+class MatchIndex {
+public:
+    static constexpr std::size_t MAX_MATCHES = 100000;
+
+    /// Brings the matches up to date with text & searcher, cheap when neither has changed since the last call
+    void update(TextData &text, Searcher &searcher);
+
+    [[nodiscard]] const std::vector<SearchMatch> &matches() const;
+    /// Whether matches() has every match in it, or stopped at MAX_MATCHES
+    [[nodiscard]] bool complete() const;
+    /// The matches that begin in [begin, end)
+    [[nodiscard]] std::span<const SearchMatch> in_range(std::size_t begin, std::size_t end) const;
+    /// The first match that begins at or after pos
+    [[nodiscard]] std::optional<SearchMatch> next(std::size_t pos) const;
+    /// The last match that ends at or before pos
+    [[nodiscard]] std::optional<SearchMatch> prev(std::size_t pos) const;
+    /// How many matches begin at or before pos, i.e. which one it is, counting from 1, when one begins at pos
+    [[nodiscard]] std::size_t ordinal(std::size_t pos) const;
+
+private:
+    /// The matches of one query
+    struct Level {
+        std::string query;
+        SearchOptions options;
+        bool regex;
+        std::vector<SearchMatch> matches{};
+        bool complete{true};
+    };
+    /// The queries typed so far, each one narrowing the one before it; the last is the current one
+    std::vector<Level> levels{};
+    int buffer_id{-1};
+    std::uint64_t text_version{0};
+    std::size_t text_size{0};
+
+    /// Whether every match of searcher is where a match of level begins
+    [[nodiscard]] static bool narrows(const Level &level, const Searcher &searcher);
+    /// Every match of searcher in [begin, end) of text, appended to level, until it has MAX_MATCHES
+    static void search(const Haystack &text, Searcher &searcher, std::size_t begin, std::size_t end, Level &level);
+    /// Moves the matches of the current query over what the edits since the last update did to [begin, end) of the
+    /// text; false if it has to be searched again in full instead
+    bool apply_edit(const Haystack &text, Searcher &searcher, std::size_t begin, std::size_t end);
+};
@@ -0,0 +1,754 @@
+//
+// Created by 46769 on 2021-02-17.
+//
+
+#include "regex.hpp"
+#include <algorithm>
+#include <core/strops.hpp>
+
+namespace {
+using ByteSet = std::bitset<256>;
+
+/// ----------- PARSER ----------------
+
+struct Node {
+    enum class Kind { Bytes, Concat, Alternate, Repeat, LineStart, LineEnd };
+    Kind kind;
+    ByteSet bytes{};
+    std::vector<Node> children{};
+    /// Repeat only, max is -1 when there's no upper bound
+    int min{0}, max{-1};
+};
+
+constexpr auto MAX_REPEAT = 1000;
+
+ByteSet byte_range(int first, int last) {
+    ByteSet set{};
+    for (auto b = first; b <= last; ++b) set.set(AS(b, std::size_t));
+    return set;
+}
+
+ByteSet one_byte(char ch) { return byte_range(AS(ch, std::uint8_t), AS(ch, std::uint8_t)); }
+
+/// The first byte of a set that isn't empty; the only one, of a set of one
+char only_byte(const ByteSet &set) {
+    auto b = 0;
+    while (not set[AS(b, std::size_t)]) ++b;
+    return AS(b, char);
+}
+
+bool nullable(const Node &node) {
+    switch (node.kind) {
+        case Node::Kind::Bytes:
+            return false;
+        case Node::Kind::Concat:
+            return std::ranges::all_of(node.children, nullable);
+        case Node::Kind::Alternate:
+            return std::ranges::any_of(node.children, nullable);
+        case Node::Kind::Repeat:
+            return node.min == 0 || nullable(node.children.front());
+        default:
+            return true;
+    }
+}
+
+/// Recursive descent, alternation -> concatenation -> repetition -> atom. The first error sticks, & ends the parse
+class Parser {
+public:
+    Parser(std::string_view pattern, bool ignore_case) : pattern(pattern), ignore_case(ignore_case) {}
+
+    std::optional<Node> parse(std::string &error) {
+        auto root = alternation();
+        if (this->error.empty() && pos < pattern.size()) fail("unmatched )");
+        if (this->error.empty() && nullable(root)) fail("matches empty text");
+        if (not this->error.empty()) {
+            error = std::move(this->error);
+            return {};
+        }
+        return root;
+    }
+
+private:
+    std::string_view pattern;
+    bool ignore_case;
+    std::size_t pos{0};
+    std::string error{};
+    int depth{0};
+
+    [[nodiscard]] bool more() const { return error.empty() && pos < pattern.size(); }
+    [[nodiscard]] char peek() const { return pattern[pos]; }
+    void fail(std::string_view what) {
+        if (error.empty()) error = fmt::format("{}, at {}", what, pos);
+        pos = pattern.size();
+    }
+
+    /// set, with the other case of every letter in it, when ignoring case
+    ByteSet folded(ByteSet set) const {
+        if (ignore_case) {
+            for (auto ch = 'a'; ch <= 'z'; ++ch) {
+                auto lower = AS(ch, std::size_t), upper = AS(ch - 'a' + 'A', std::size_t);
+                if (set[lower] || set[upper]) set.set(lower).set(upper);
+            }
+        }
+        return set;
+    }
+
+    /// Negated sets are folded before they're negated, see bracket; the negation of a folded set has both cases of a
+    /// letter, or neither, so folding it again changes nothing
+    Node bytes(ByteSet set) const { return Node{.kind = Node::Kind::Bytes, .bytes = folded(set)}; }
+
+    Node alternation() {
+        auto first = concatenation();
+        if (not more() || peek() != '|') return first;
+        Node alternate{.kind = Node::Kind::Alternate};
+        alternate.children.push_back(std::move(first));
+        while (more() && peek() == '|') {
+            ++pos;
+            alternate.children.push_back(concatenation());
+        }
+        return alternate;
+    }
+
+    Node concatenation() {
+        Node concat{.kind = Node::Kind::Concat};
+        while (more() && peek() != '|' && peek() != ')') concat.children.push_back(repetition());
+        if (concat.children.size() == 1) return std::move(concat.children.front());
+        return concat;
+    }
+
+    Node repetition() {
+        auto node = atom();
+        while (more()) {
+            auto min = 0, max = -1;
+            if (peek() == '*') {
+                ++pos;
+            } else if (peek() == '+') {
+                min = 1;
+                ++pos;
+            } else if (peek() == '?') {
+                max = 1;
+                ++pos;
+            } else if (peek() != '{' || not bounds(min, max)) {
+                break;
+            }
+            if (node.kind == Node::Kind::LineStart || node.kind == Node::Kind::LineEnd) fail("repeated anchor");
+            // a lazy repetition matches the same text, it only prefers shorter matches, which leftmost-longest doesn't
+            if (more() && peek() == '?') ++pos;
+            Node repeat{.kind = Node::Kind::Repeat, .min = min, .max = max};
+            repeat.children.push_back(std::move(node));
+            node = std::move(repeat);
+        }
+        return node;
+    }
+
+    /// {n}, {n,} or {n,m}. Anything else, and the { is just a {
+    bool bounds(int &min, int &max) {
+        auto end = pattern.find('}', pos);
+        if (end == std::string_view::npos) return false;
+        auto inside = pattern.substr(pos + 1, end - pos - 1);
+        auto number = [](std::string_view digits, int &out) {
+            if (digits.empty() || digits.size() > 4) return false;
+            out = 0;
+            for (auto ch : digits) {
+                if (ch < '0' || ch > '9') return false;
+                out = out * 10 + (ch - '0');
+            }
+            return true;
+        };
+        auto comma = inside.find(',');
+        if (comma == std::string_view::npos) {
+            if (not number(inside, min)) return false;
+            max = min;
+        } else {
+            if (not number(inside.substr(0, comma), min)) return false;
+            auto upper = inside.substr(comma + 1);
+            if (upper.empty()) {
+                max = -1;
+            } else if (not number(upper, max)) {
+                return false;
+            }
+        }
+        pos = end + 1;
+        if (min > MAX_REPEAT || max > MAX_REPEAT) {
+            fail("repetition too large");
+        } else if (max != -1 && max < min) {
+            fail("repetition bounds out of order");
+        }
+        return true;
+    }
+
+    Node atom() {
+        auto ch = peek();
+        ++pos;
+        switch (ch) {
+            case '(': {
+                if (pattern.substr(pos, 2) == "?:") pos += 2;
+                if (++depth > 100) fail("groups nested too deep");
+                auto inner = alternation();
+                --depth;
+                if (not more() || peek() != ')') {
+                    fail("unmatched (");
+                } else {
+                    ++pos;
+                }
+                return inner;
+            }
+            case '[':
+                return bytes(bracket());
+            case '.':
+                return bytes(~one_byte('\n'));
+            case '^':
+                return Node{.kind = Node::Kind::LineStart};
+            case '$':
+                return Node{.kind = Node::Kind::LineEnd};
+            case '\\':
+                return bytes(escape());
+            case '*':
+            case '+':
+            case '?':
+                fail("nothing to repeat");
+                return Node{.kind = Node::Kind::Concat};
+            default:
+                return bytes(one_byte(ch));
+        }
+    }
+
+    /// The bytes that an escape, with the \ consumed, stands for
+    ByteSet escape() {
+        if (pos >= pattern.size()) {
+            fail("trailing \\");
+            return {};
+        }
+        auto ch = pattern[pos++];
+        auto digits = byte_range('0', '9');
+        auto word = byte_range('a', 'z') | byte_range('A', 'Z') | digits | one_byte('_');
+        auto space = one_byte(' ') | one_byte('\t') | one_byte('\n') | one_byte('\r') | one_byte('\f') | one_byte('\v');
+        switch (ch) {
+            case 'd':
+                return digits;
+            case 'D':
+                return ~digits;
+            case 'w':
+                return word;
+            case 'W':
+                return ~word;
+            case 's':
+                return space;
+            case 'S':
+                return ~space;
+            case 'n':
+                return one_byte('\n');
+            case 't':
+                return one_byte('\t');
+            case 'r':
+                return one_byte('\r');
+            case 'f':
+                return one_byte('\f');
+            case 'v':
+                return one_byte('\v');
+            case 'x': {
+                auto hex = [](char h) {
+                    if (h >= '0' && h <= '9') return h - '0';
+                    if (h >= 'a' && h <= 'f') return h - 'a' + 10;
+                    if (h >= 'A' && h <= 'F') return h - 'A' + 10;
+                    return -1;
+                };
+                if (pos + 2 > pattern.size() || hex(pattern[pos]) < 0 || hex(pattern[pos + 1]) < 0) {
+                    fail("\\x needs two hex digits");
+                    return {};
+                }
+                auto value = hex(pattern[pos]) * 16 + hex(pattern[pos + 1]);
+                pos += 2;
+                return byte_range(value, value);
+            }
+            default:
+                if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')) {
+                    fail(fmt::format("unknown escape \\{}", ch));
+                    return {};
+                }
+                return one_byte(ch);
+        }
+    }
+
+    /// [...], with the [ consumed. A ] first, or a - first or last, are themselves
+    ByteSet bracket() {
+        auto negated = pos < pattern.size() && pattern[pos] == '^';
+        if (negated) ++pos;
+        ByteSet set{};
+        auto first = true;
+        while (true) {
+            if (pos >= pattern.size()) {
+                fail("unmatched [");
+                return {};
+            }
+            auto ch = pattern[pos];
+            if (ch == ']' && not first) {
+                ++pos;
+                break;
+            }
+            first = false;
+            ++pos;
+            ByteSet item{};
+            if (ch == '\\') {
+                item = escape();
+                if (item.count() != 1) {
+                    set |= item;
+                    continue;
+                }
+                ch = only_byte(item);
+            }
+            if (pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+                ++pos;
+                auto last = pattern[pos++];
+                if (last == '\\') {
+                    auto escaped = escape();
+                    if (escaped.count() != 1) {
+                        fail("class in a range");
+                        return {};
+                    }
+                    last = only_byte(escaped);
+                }
+                if (AS(last, std::uint8_t) < AS(ch, std::uint8_t)) {
+                    fail("range out of order");
+                    return {};
+                }
+                set |= byte_range(AS(ch, std::uint8_t), AS(last, std::uint8_t));
+            } else {
+                set |= one_byte(ch);
+            }
+        }
+        // [^a] doesn't match A either; folded after the negation, it would match a as well
+        set = folded(set);
+        return negated ? ~set : set;
+    }
+};
+
+/// ----------- NFA ----------------
+
+/// Thompson's construction. A fragment is a piece of the NFA with a start, & the transitions that are still to be
+/// pointed at whatever comes after it
+class NfaBuilder {
+public:
+    static constexpr std::size_t MAX_STATES = 50000;
+
+    NfaBuilder(bool reversed) : reversed(reversed) {}
+
+    std::optional<Regex::Nfa> build(const Node &root) {
+        auto fragment = build_node(root);
+        auto match = add(Regex::NfaState{.kind = Regex::NfaState::Kind::Match});
+        patch(fragment, match);
+        nfa.start = fragment.start;
+        if (nfa.states.size() > MAX_STATES) return {};
+        return std::move(nfa);
+    }
+
+private:
+    using Kind = Regex::NfaState::Kind;
+    /// (state, whether it's out1 rather than out)
+    using Hole = std::pair<std::int32_t, bool>;
+    struct Fragment {
+        std::int32_t start;
+        std::vector<Hole> holes;
+    };
+
+    Regex::Nfa nfa{};
+    /// Builds the NFA of the expression as it matches the text read backwards
+    bool reversed;
+
+    std::int32_t add(Regex::NfaState state) {
+        nfa.states.push_back(state);
+        return AS(nfa.states.size() - 1, std::int32_t);
+    }
+
+    void patch(const Fragment &fragment, std::int32_t target) {
+        for (auto [state, second] : fragment.holes) (second ? nfa.states[state].out1 : nfa.states[state].out) = target;
+    }
+
+    Fragment epsilon() {
+        auto s = add(Regex::NfaState{.kind = Kind::Split});
+        return Fragment{s, {{s, false}}};
+    }
+
+    Fragment sequence(Fragment first, Fragment second) {
+        patch(first, second.start);
+        return Fragment{first.start, std::move(second.holes)};
+    }
+
+    /// x? as a fragment, from the fragment of x
+    Fragment optional(Fragment fragment) {
+        auto s = add(Regex::NfaState{.kind = Kind::Split, .out = fragment.start});
+        fragment.holes.emplace_back(s, true);
+        return Fragment{s, std::move(fragment.holes)};
+    }
+
+    Fragment build_node(const Node &node) {
+        // large repetitions of large expressions run out of states, which is checked for in build
+        if (nfa.states.size() > MAX_STATES) return epsilon();
+        switch (node.kind) {
+            case Node::Kind::Bytes: {
+                nfa.byte_sets.push_back(node.bytes);
+                auto s = add(Regex::NfaState{.kind = Kind::Bytes,
+                                             .bytes = AS(nfa.byte_sets.size() - 1, std::int32_t)});
+                return Fragment{s, {{s, false}}};
+            }
+            case Node::Kind::LineStart:
+            case Node::Kind::LineEnd: {
+                // read backwards, a line that begins at a position is one that ends there, & the other way around
+                auto line_start = (node.kind == Node::Kind::LineStart) != reversed;
+                auto s = add(Regex::NfaState{.kind = line_start ? Kind::LineStart : Kind::LineEnd});
+                return Fragment{s, {{s, false}}};
+            }
+            case Node::Kind::Concat: {
+                if (node.children.empty()) return epsilon();
+                std::optional<Fragment> result{};
+                auto append = [&](const Node &child) {
+                    auto fragment = build_node(child);
+                    result = result ? sequence(std::move(*result), std::move(fragment)) : std::move(fragment);
+                };
+                if (reversed) {
+                    std::for_each(node.children.rbegin(), node.children.rend(), append);
+                } else {
+                    std::for_each(node.children.begin(), node.children.end(), append);
+                }
+                return std::move(*result);
+            }
+            case Node::Kind::Alternate: {
+                auto result = build_node(node.children.back());
+                for (auto it = node.children.rbegin() + 1; it != node.children.rend(); ++it) {
+                    auto fragment = build_node(*it);
+                    auto s = add(Regex::NfaState{.kind = Kind::Split, .out = fragment.start, .out1 = result.start});
+                    fragment.holes.insert(fragment.holes.end(), result.holes.begin(), result.holes.end());
+                    result = Fragment{s, std::move(fragment.holes)};
+                }
+                return result;
+            }
+            case Node::Kind::Repeat: {
+                const auto &child = node.children.front();
+                std::optional<Fragment> result{};
+                auto append = [&](Fragment fragment) {
+                    result = result ? sequence(std::move(*result), std::move(fragment)) : std::move(fragment);
+                };
+                for (auto i = 0; i < node.min; ++i) append(build_node(child));
+                if (node.max == -1) {
+                    // x*, a split that either goes through x & back to itself, or on
+                    auto fragment = build_node(child);
+                    auto s = add(Regex::NfaState{.kind = Kind::Split, .out = fragment.start});
+                    patch(fragment, s);
+                    append(Fragment{s, {{s, true}}});
+                } else {
+                    for (auto i = node.min; i < node.max; ++i) append(optional(build_node(child)));
+                }
+                return result ? std::move(*result) : epsilon();
+            }
+        }
+        return epsilon();
+    }
+};
+}// namespace
+
+/// ----------- LAZY DFA ----------------
+
+Regex::LazyDfa::LazyDfa(Nfa &&automaton) : nfa(std::move(automaton)) {
+    seen.resize(nfa.states.size(), 0);
+    compile_columns();
+    find_first_byte();
+    flush();
+}
+
+void Regex::LazyDfa::find_first_byte() {
+    ByteSet first{};
+    std::vector<std::int32_t> reached{};
+    ++generation;
+    close(nfa.start, true, false, reached);
+    ++generation;
+    close(nfa.start, false, false, reached);
+    for (auto s : reached) {
+        if (nfa.states[s].kind == NfaState::Kind::Bytes) first |= nfa.byte_sets[nfa.states[s].bytes];
+    }
+    // the state after a newline is another one, when there are anchors, so it can't be skipped over
+    auto anchored = [](const NfaState &s) {
+        return s.kind == NfaState::Kind::LineStart || s.kind == NfaState::Kind::LineEnd;
+    };
+    if (std::ranges::any_of(nfa.states, anchored)) first.set('\n');
+    if (first.count() == 1) {
+        first_byte = only_byte(first);
+    } else if (first.count() == 2) {
+        // the upper case letter comes first
+        auto upper = only_byte(first);
+        if (upper >= 'A' && upper <= 'Z' && first[AS(upper + 0x20, std::size_t)]) {
+            first_byte = AS(upper + 0x20, char);
+            first_byte_any_case = true;
+        }
+    }
+}
+
+void Regex::LazyDfa::compile_columns() {
+    // refined by one set at a time; bytes stay in the same column while no set tells them apart. The newline is one of
+    // the sets, as it's what the line anchors look at
+    auto refine = [this](const ByteSet &set) {
+        std::array<int, 512> remap{};
+        remap.fill(-1);
+        std::size_t count = 0;
+        for (std::size_t b = 0; b < 256; ++b) {
+            auto &column = remap[columns[b] * 2 + (set[b] ? 1 : 0)];
+            if (column < 0) column = AS(count++, int);
+            columns[b] = AS(column, std::uint8_t);
+        }
+        column_count = count;
+    };
+    columns.fill(0);
+    refine(one_byte('\n'));
+    for (const auto &set : nfa.byte_sets) refine(set);
+}
+
+void Regex::LazyDfa::flush() {
+    states.clear();
+    state_ids.clear();
+    transitions.clear();
+    starts.fill(-1);
+    ++flushes;
+    intern(State{.threads = {}, .can_start = false, .line_start = false});
+}
+
+std::int32_t Regex::LazyDfa::intern(const State &state) {
+    auto key = state.threads;
+    key.push_back(state.can_start ? -2 : -3);
+    key.push_back(state.line_start ? -4 : -5);
+    if (auto it = state_ids.find(key); it != state_ids.end()) return it->second;
+    if (states.size() >= MAX_STATES) flush();
+    auto handle = AS(states.size() * column_count, std::int32_t);
+    states.push_back(state);
+    state_ids.emplace(std::move(key), handle);
+    transitions.resize(transitions.size() + column_count, UNKNOWN);
+    return handle;
+}
+
+void Regex::LazyDfa::close(std::int32_t state, bool line_start, bool line_end, std::vector<std::int32_t> &out) {
+    stack.push_back(state);
+    while (not stack.empty()) {
+        auto s = stack.back();
+        stack.pop_back();
+        if (s < 0 || seen[s] == generation) continue;
+        seen[s] = generation;
+        const auto &n = nfa.states[s];
+        switch (n.kind) {
+            case NfaState::Kind::Bytes:
+            case NfaState::Kind::Match:
+                out.push_back(s);
+                break;
+            case NfaState::Kind::Split:
+                stack.push_back(n.out1);
+                stack.push_back(n.out);
+                break;
+            case NfaState::Kind::LineStart:
+                if (line_start) stack.push_back(n.out);
+                break;
+            case NfaState::Kind::LineEnd:
+                // it's not known whether a line ends here, until the byte after is
+                if (line_end) {
+                    stack.push_back(n.out);
+                } else {
+                    out.push_back(s);
+                }
+                break;
+        }
+    }
+}
+
+std::int32_t Regex::LazyDfa::start(bool anchored, bool line_start) {
+    auto &id = starts[(anchored ? 2 : 0) + (line_start ? 1 : 0)];
+    if (id < 0) {
+        State state{.threads = {}, .can_start = not anchored, .line_start = line_start};
+        ++generation;
+        close(nfa.start, line_start, false, state.threads);
+        if (not state.threads.empty()) {
+            std::sort(state.threads.begin(), state.threads.end());
+            state.threads.push_back(GROUP_END);
+        }
+        auto interned = intern(state);
+        // interning may have flushed the cache, & the start states with it
+        starts[(anchored ? 2 : 0) + (line_start ? 1 : 0)] = interned;
+        return interned;
+    }
+    return id;
+}
+
+std::int32_t Regex::LazyDfa::compute(std::int32_t from, char byte) {
+    const auto newline = byte == '\n';
+    const auto byte_index = AS(byte, std::uint8_t);
+    // a copy, as interning the next state may flush the cache, this one with it
+    const auto current = states[from / column_count];
+    std::vector<std::vector<std::int32_t>> groups{{}};
+    for (auto s : current.threads) {
+        if (s == GROUP_END) {
+            groups.emplace_back();
+        } else {
+            groups.back().push_back(s);
+        }
+    }
+    groups.pop_back();
+
+    // a $ holds before a newline, so the threads waiting on one go on
+    if (newline) {
+        ++generation;
+        for (auto &group : groups) {
+            std::vector<std::int32_t> expanded{};
+            for (auto s : group) close(s, current.line_start, true, expanded);
+            group = std::move(expanded);
+        }
+    }
+    // leftmost: once a thread has matched, those that began after it can only make matches that begin later
+    auto matched = false;
+    auto can_start = current.can_start;
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        auto is_match = [this](auto s) { return nfa.states[s].kind == NfaState::Kind::Match; };
+        if (std::ranges::any_of(groups[g], is_match)) {
+            groups.resize(g + 1);
+            matched = true;
+            can_start = false;
+            break;
+        }
+    }
+
+    State next{.threads = {}, .can_start = can_start, .line_start = newline};
+    ++generation;
+    auto append_group = [&](std::vector<std::int32_t> &group) {
+        if (group.empty()) return;
+        std::sort(group.begin(), group.end());
+        next.threads.insert(next.threads.end(), group.begin(), group.end());
+        next.threads.push_back(GROUP_END);
+    };
+    for (const auto &group : groups) {
+        std::vector<std::int32_t> stepped{};
+        for (auto s : group) {
+            const auto &n = nfa.states[s];
+            if (n.kind == NfaState::Kind::Bytes && nfa.byte_sets[n.bytes][byte_index]) {
+                close(n.out, newline, false, stepped);
+            }
+        }
+        append_group(stepped);
+    }
+    if (can_start) {
+        std::vector<std::int32_t> fresh{};
+        close(nfa.start, newline, false, fresh);
+        append_group(fresh);
+    }
+    if (next.threads.empty() && not next.can_start) next.line_start = false;
+
+    const auto flushes_before = flushes;
+    auto to = intern(next);
+    if (flushes != flushes_before) {
+        from = intern(current);
+        // from may have pushed out what it leads to, the next time around; interned again in that case
+        if (flushes != flushes_before + 1) return compute(from, byte);
+    }
+    auto t = (to << 1) | (matched ? 1 : 0);
+    transitions[AS(from, std::size_t) + columns[byte_index]] = t;
+    return t;
+}
+
+bool Regex::LazyDfa::matches_at_end(std::int32_t state, bool line_end) {
+    if (state == DEAD) return false;
+    const auto &current = states[state / column_count];
+    std::vector<std::int32_t> reached{};
+    ++generation;
+    for (auto s : current.threads) {
+        if (s != GROUP_END) close(s, current.line_start, line_end, reached);
+    }
+    return std::ranges::any_of(reached, [this](auto s) { return nfa.states[s].kind == NfaState::Kind::Match; });
+}
+
+/// ----------- SEARCH ----------------
+
+Regex::Regex(Nfa &&forward_nfa, Nfa &&reverse_nfa) : forward(std::move(forward_nfa)), reverse(std::move(reverse_nfa)) {}
+
+std::unique_ptr<Regex> Regex::create(std::string_view pattern, bool ignore_case, std::string &error) {
+    auto root = Parser{pattern, ignore_case}.parse(error);
+    if (not root) return nullptr;
+    auto forward_nfa = NfaBuilder{false}.build(*root);
+    auto reverse_nfa = NfaBuilder{true}.build(*root);
+    if (not forward_nfa || not reverse_nfa) {
+        error = "regex too large";
+        return nullptr;
+    }
+    return std::unique_ptr<Regex>(new Regex{std::move(*forward_nfa), std::move(*reverse_nfa)});
+}
+
+std::optional<SearchMatch> Regex::find(const Haystack &text, std::size_t from, std::size_t to) {
+    if (from >= to) return {};
+    // where the leftmost-longest match ends
+    auto state = forward.start(false, text.line_begins_at(from));
+    // the idle state is start(false, false), this makes sure that it's there to compare with
+    forward.start(false, false);
+    std::optional<std::size_t> end{};
+    text.scan_forward(from, to, [&](std::string_view part, std::size_t pos) {
+        for (std::size_t i = 0; i < part.size(); ++i) {
+            if (forward.first_byte && forward.idle(state)) {
+                const std::string_view first{&*forward.first_byte, 1};
+                i += str::find_literal(part.data() + i, part.size() - i, first, forward.first_byte_any_case);
+                if (i == part.size()) break;
+            }
+            auto t = forward.next(state, part[i]);
+            if (t & 1) end = pos + i;
+            state = t >> 1;
+            if (state == LazyDfa::DEAD) return false;
+        }
+        return true;
+    });
+    if (forward.matches_at_end(state, text.line_ends_at(to))) end = to;
+    if (not end) return {};
+
+    // & back from there, to where the longest of the matches that end there begins
+    state = reverse.start(true, text.line_ends_at(*end));
+    auto begin = *end;
+    text.scan_backward(from, *end, [&](std::string_view part, std::size_t pos) {
+        for (auto i = part.size(); i-- > 0;) {
+            auto t = reverse.next(state, part[i]);
+            if (t & 1) begin = pos + i + 1;
+            state = t >> 1;
+            if (state == LazyDfa::DEAD) return false;
+        }
+        return true;
+    });
+    if (reverse.matches_at_end(state, text.line_begins_at(from))) begin = from;
+    return SearchMatch{begin, *end};
+}
+
+std::optional<SearchMatch> Regex::rfind(const Haystack &text, std::size_t from, std::size_t to) {
+    if (from >= to) return {};
+    // the same as find, mirrored: the reversed expression finds the match that ends the last & where it begins
+    auto state = reverse.start(false, text.line_ends_at(to));
+    reverse.start(false, false);
+    std::optional<std::size_t> begin{};
+    text.scan_backward(from, to, [&](std::string_view part, std::size_t pos) {
+        for (auto i = part.size(); i-- > 0;) {
+            if (reverse.first_byte && reverse.idle(state)) {
+                const std::string_view last{&*reverse.first_byte, 1};
+                auto at = str::rfind_literal(part.data(), i + 1, last, reverse.first_byte_any_case);
+                if (at == i + 1) break;
+                i = at;
+            }
+            auto t = reverse.next(state, part[i]);
+            if (t & 1) begin = pos + i + 1;
+            state = t >> 1;
+            if (state == LazyDfa::DEAD) return false;
+        }
+        return true;
+    });
+    if (reverse.matches_at_end(state, text.line_begins_at(from))) begin = from;
+    if (not begin) return {};
+
+    state = forward.start(true, text.line_begins_at(*begin));
+    auto end = *begin;
+    text.scan_forward(*begin, to, [&](std::string_view part, std::size_t pos) {
+        for (std::size_t i = 0; i < part.size(); ++i) {
+            auto t = forward.next(state, part[i]);
+            if (t & 1) end = pos + i;
+            state = t >> 1;
+            if (state == LazyDfa::DEAD) return false;
+        }
+        return true;
+    });
+    if (forward.matches_at_end(state, text.line_ends_at(to))) end = to;
+    return SearchMatch{*begin, end};
+}
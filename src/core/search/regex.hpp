@@ -0,0 +1,127 @@
+//
+// Created by 46769 on 2021-02-17.
+//
+
+#pragma once
+#include "haystack.hpp"
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Regular expressions for search. Compiled to an NFA (Thompson's construction), which is run as a DFA that is built
+ * lazily, a state at a time, the first time the text searched leads to it. A search only pays for the states the text
+ * needs, and each byte searched costs a table lookup, however complex the expression is.
+ *
+ * Matches are leftmost-longest: the longest of the matches that begin first. A DFA can only tell where a match ends,
+ * so a search scans forward to where the match ends, and from there, back to where it begins, with a DFA of the
+ * reversed expression. The forward DFA keeps the threads of the NFA that began at different positions apart, in the
+ * order they began, and drops the later ones once an earlier one has matched; that way it stops at the end of the
+ * leftmost match, instead of running on to the end of the last one.
+ *
+ * Syntax: bytes, . (any but a newline), [classes] & [^negated ones], \d \w \s & their negations \D \W \S, escapes
+ * \n \t \r \xHH & \ before punctuation, groups (...) & (?:...), alternation |, repetition * + ? {n} {n,} {n,m} (a lazy
+ * ? after one is accepted, and ignored), and the line anchors ^ & $. Expressions that can match empty text are not
+ * allowed, as searching for them would find something everywhere.
+ */
+class Regex {
+public:
+    /// nullptr if pattern is not a regex we can compile, with what's wrong with it in error
+    static std::unique_ptr<Regex> create(std::string_view pattern, bool ignore_case, std::string &error);
+
+    /// The leftmost-longest match in [from, to) of text
+    std::optional<SearchMatch> find(const Haystack &text, std::size_t from, std::size_t to);
+    /// The match in [from, to) of text that ends the last, and of those, the longest
+    std::optional<SearchMatch> rfind(const Haystack &text, std::size_t from, std::size_t to);
+
+    struct NfaState {
+        enum class Kind : std::uint8_t { Bytes, Split, LineStart, LineEnd, Match };
+        Kind kind;
+        std::int32_t out{-1};
+        /// Split only, -1 makes it a plain epsilon transition to out
+        std::int32_t out1{-1};
+        /// Bytes only, index of the set of bytes it consumes, in Nfa::byte_sets
+        std::int32_t bytes{-1};
+    };
+
+    struct Nfa {
+        std::vector<NfaState> states{};
+        std::vector<std::bitset<256>> byte_sets{};
+        std::int32_t start{0};
+    };
+
+    /// States are handles, the index of the state times column_count, so that a transition is an add & a load
+    class LazyDfa {
+    public:
+        explicit LazyDfa(Nfa &&automaton);
+        static constexpr std::int32_t DEAD = 0;
+        /// States past this many, the cache is thrown away & built again from scratch, as the text needs it
+        static constexpr std::size_t MAX_STATES = 4096;
+
+        /// State that a search begins in. An unanchored search begins a thread at every position, an anchored one only
+        /// at the first. line_start, if a line begins where the search does
+        std::int32_t start(bool anchored, bool line_start);
+        /// The state after byte, shifted up by one, with the lowest bit set if a match ended before byte
+        std::int32_t next(std::int32_t state, char byte) {
+            auto t = transitions[AS(state, std::size_t) + columns[AS(byte, std::uint8_t)]];
+            return t >= 0 ? t : compute(state, byte);
+        }
+        /// Whether a match ends where the search does. line_end, if a line ends there too
+        bool matches_at_end(std::int32_t state, bool line_end);
+
+        /// The byte that every match begins with, if there's one, and whether it matches in either case. An unanchored
+        /// search, with nothing under way (idle), skips to where the byte is next, instead of stepping through the bytes
+        /// in between one at a time
+        std::optional<char> first_byte{};
+        bool first_byte_any_case{false};
+        [[nodiscard]] bool idle(std::int32_t state) const { return state == starts[0]; }
+
+    private:
+        static constexpr std::int32_t GROUP_END = -1;
+        static constexpr std::int32_t UNKNOWN = -1;
+        struct State {
+            /// NFA states, in groups that end with GROUP_END. Each group are the threads that began at one position,
+            /// the earliest first
+            std::vector<std::int32_t> threads;
+            /// Whether a new thread begins at the next position; until something has matched, if unanchored
+            bool can_start;
+            /// Whether a line begins where the state is, for the ^ that come next
+            bool line_start;
+        };
+
+        Nfa nfa;
+        /// Bytes that every NFA state treats the same are one column of the transition table
+        std::array<std::uint8_t, 256> columns{};
+        std::size_t column_count{1};
+        std::vector<State> states{};
+        std::map<std::vector<std::int32_t>, std::int32_t> state_ids{};
+        /// transitions[state + column], see next
+        std::vector<std::int32_t> transitions{};
+        /// anchored * 2 + line_start
+        std::array<std::int32_t, 4> starts{};
+        std::size_t flushes{0};
+        std::vector<std::uint32_t> seen{};
+        std::uint32_t generation{0};
+        std::vector<std::int32_t> stack{};
+
+        void compile_columns();
+        void find_first_byte();
+        std::int32_t compute(std::int32_t from, char byte);
+        std::int32_t intern(const State &state);
+        void flush();
+        /// Adds the states that state leads to without consuming a byte, to out, skipping those seen this generation
+        void close(std::int32_t state, bool line_start, bool line_end, std::vector<std::int32_t> &out);
+    };
+
+private:
+    Regex(Nfa &&forward_nfa, Nfa &&reverse_nfa);
+    LazyDfa forward;
+    /// Of the reversed expression, runs backwards from where a match ends
+    LazyDfa reverse;
+};
@@ -0,0 +1,174 @@
+//
+// Created by 46769 on 2021-02-17.
+//
+
+#include "searcher.hpp"
+#include <cassert>
+#include <core/buffer/text_data.hpp>
+#include <core/strops.hpp>
+#include <limits>
+
+Searcher::Searcher(std::string_view query, SearchOptions options, std::unique_ptr<Regex> &&compiled)
+    : pattern(query), search_options(options), regex(std::move(compiled)) {}
+
+std::unique_ptr<Searcher> Searcher::create(std::string_view query, SearchOptions options, std::string &error) {
+    if (query.empty()) {
+        error = "nothing to search for";
+        return nullptr;
+    }
+    std::unique_ptr<Regex> compiled{nullptr};
+    if (options.regex) {
+        compiled = Regex::create(query, options.ignore_case, error);
+        if (not compiled) return nullptr;
+    }
+    return std::unique_ptr<Searcher>(new Searcher{query, options, std::move(compiled)});
+}
+
+std::unique_ptr<Searcher> Searcher::from_prompt(std::string_view input, std::string &error) {
+    auto has_upper = std::ranges::any_of(input, [](char ch) { return ch >= 'A' && ch <= 'Z'; });
+    if (input.size() > 2 && input.front() == '/') {
+        if (input.ends_with("/i") && input.size() > 3) {
+            return create(input.substr(1, input.size() - 3), SearchOptions{.regex = true, .ignore_case = true}, error);
+        }
+        if (input.back() == '/') {
+            auto pattern = input.substr(1, input.size() - 2);
+            return create(pattern, SearchOptions{.regex = true, .ignore_case = not has_upper}, error);
+        }
+    }
+    return create(input, SearchOptions{.regex = false, .ignore_case = not has_upper}, error);
+}
+
+std::optional<SearchMatch> Searcher::find(const Haystack &text, std::size_t from, std::size_t to) {
+    if (regex) return regex->find(text, from, to);
+    const std::string_view needle = pattern;
+    const auto overlap = needle.size() - 1;
+    std::optional<SearchMatch> found{};
+    text.scan_forward(from, to, [&](std::string_view part, std::size_t pos) {
+        if (auto at = str::find_literal(part.data(), part.size(), needle, search_options.ignore_case); at < part.size()) {
+            found = SearchMatch{pos + at, pos + at + needle.size()};
+            return false;
+        }
+        // & what begins at the end of this chunk, to end in the next one
+        auto part_end = pos + part.size();
+        if (overlap == 0 || part_end >= to) return true;
+        auto window_begin = part_end - std::min(part.size(), overlap);
+        boundary.clear();
+        text.copy(window_begin, std::min(to, part_end + overlap), boundary);
+        auto at = str::find_literal(boundary.data(), boundary.size(), needle, search_options.ignore_case);
+        if (at < boundary.size()) {
+            found = SearchMatch{window_begin + at, window_begin + at + needle.size()};
+            return false;
+        }
+        return true;
+    });
+    return found;
+}
+
+std::optional<SearchMatch> Searcher::rfind(const Haystack &text, std::size_t from, std::size_t to) {
+    if (regex) return regex->rfind(text, from, to);
+    const std::string_view needle = pattern;
+    const auto overlap = needle.size() - 1;
+    std::optional<SearchMatch> found{};
+    text.scan_backward(from, to, [&](std::string_view part, std::size_t pos) {
+        // what ends in the chunk after this one, but begins in this one, ends later than anything in it
+        auto part_end = pos + part.size();
+        if (overlap > 0 && part_end < to) {
+            auto window_begin = part_end - std::min(part.size(), overlap);
+            boundary.clear();
+            text.copy(window_begin, std::min(to, part_end + overlap), boundary);
+            auto at = str::rfind_literal(boundary.data(), boundary.size(), needle, search_options.ignore_case);
+            if (at < boundary.size()) {
+                found = SearchMatch{window_begin + at, window_begin + at + needle.size()};
+                return false;
+            }
+        }
+        auto at = str::rfind_literal(part.data(), part.size(), needle, search_options.ignore_case);
+        if (at < part.size()) {
+            found = SearchMatch{pos + at, pos + at + needle.size()};
+            return false;
+        }
+        return true;
+    });
+    return found;
+}
+
+std::optional<SearchMatch> Searcher::find_next(const TextData &text, std::size_t from) {
+    MICRO_BENCH("Searcher::find_next");
+    Haystack haystack{text.chunks(0, text.size())};
+    return find(haystack, from, haystack.size());
+}
+
+std::optional<SearchMatch> Searcher::find_prev(const TextData &text, std::size_t to) {
+    MICRO_BENCH("Searcher::find_prev");
+    Haystack haystack{text.chunks(0, text.size())};
+    return rfind(haystack, 0, std::min(to, haystack.size()));
+}
+
+std::vector<SearchMatch> Searcher::find_all(const TextData &text, std::size_t begin, std::size_t end) {
+    MICRO_BENCH("Searcher::find_all");
+    Haystack haystack{text.chunks(0, text.size())};
+    std::vector<SearchMatch> matches{};
+    find_all(haystack, begin, end, false, std::numeric_limits<std::size_t>::max(), matches);
+    return matches;
+}
+
+bool Searcher::find_all(const Haystack &text, std::size_t begin, std::size_t end, bool overlapping,
+                        std::size_t max_matches, std::vector<SearchMatch> &out) {
+    end = std::min(end, text.size());
+    if (regex) {
+        // matches are never empty, so this always moves on
+        for (auto match = find(text, begin, end); match; match = find(text, match->end, end)) {
+            if (out.size() == max_matches) return false;
+            out.push_back(*match);
+        }
+        return true;
+    }
+    // a chunk at a time, so that the chunk isn't looked up again for every match, as find would
+    const std::string_view needle = pattern;
+    const auto overlap = needle.size() - 1;
+    const auto step = overlapping ? 1 : needle.size();
+    // where the next match can begin
+    auto next = begin;
+    auto full = false;
+    auto add = [&](std::size_t at) {
+        if (out.size() == max_matches) return not(full = true);
+        out.push_back(SearchMatch{at, at + needle.size()});
+        next = at + step;
+        return true;
+    };
+    text.scan_forward(begin, end, [&](std::string_view part, std::size_t pos) {
+        for (auto from = std::max(next, pos) - pos; from < part.size(); from = next - pos) {
+            auto at = str::find_literal(part.data() + from, part.size() - from, needle, search_options.ignore_case);
+            if (at == part.size() - from || not add(pos + from + at)) break;
+        }
+        if (full) return false;
+        // & what begins at the end of this chunk, to end in the next one
+        const auto part_end = pos + part.size();
+        const auto window_begin = std::max(next, part_end - std::min(part.size(), overlap));
+        if (overlap == 0 || part_end >= end || window_begin >= part_end) return true;
+        boundary.clear();
+        text.copy(window_begin, std::min(end, part_end + overlap), boundary);
+        for (auto from = std::size_t{0}; from < boundary.size(); from = next - window_begin) {
+            auto at = str::find_literal(boundary.data() + from, boundary.size() - from, needle,
+                                        search_options.ignore_case);
+            // those that begin in the next chunk are found there
+            if (at == boundary.size() - from || window_begin + from + at >= part_end) break;
+            if (not add(window_begin + from + at)) return false;
+        }
+        return true;
+    });
+    return not full;
+}
+
+bool Searcher::literal_at(const Haystack &text, std::size_t pos) const {
+    assert(not regex);
+    if (pos + pattern.size() > text.size()) return false;
+    std::size_t matched = 0;
+    text.scan_forward(pos, pos + pattern.size(), [&](std::string_view part, std::size_t) {
+        const auto needle = std::string_view{pattern}.substr(matched, part.size());
+        if (str::find_literal(part.data(), part.size(), needle, search_options.ignore_case) != 0) return false;
+        matched += part.size();
+        return true;
+    });
+    return matched == pattern.size();
+}
@@ -0,0 +1,63 @@
+//
+// Created by 46769 on 2021-02-17.
+//
+
+#pragma once
+#include "haystack.hpp"
+#include "regex.hpp"
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class TextData;
+
+struct SearchOptions {
+    bool regex{false};
+    bool ignore_case{false};
+    bool operator==(const SearchOptions &) const = default;
+};
+
+/**
+ * A compiled search, for a string (searched with the SIMD kernels of str::find_literal) or a regex (see Regex). Made
+ * once per query, and then run against whatever buffer, as many times as there is something to find: the next match,
+ * the one before, and every match in a range, for the highlighting of the ones on screen.
+ */
+class Searcher {
+public:
+    /// nullptr if query is an empty string, or a regex that doesn't compile, with why in error
+    static std::unique_ptr<Searcher> create(std::string_view query, SearchOptions options, std::string &error);
+    /// For what is typed into the find prompt: /regex/ or /regex/i is a regex, anything else a string. Either ignores
+    /// case unless it has an upper case letter in it, or, for a regex, is followed by i
+    static std::unique_ptr<Searcher> from_prompt(std::string_view input, std::string &error);
+
+    /// The first match that begins at or after from
+    std::optional<SearchMatch> find_next(const TextData &text, std::size_t from);
+    /// The last match that ends at or before to
+    std::optional<SearchMatch> find_prev(const TextData &text, std::size_t to);
+    /// The matches in [begin, end), that don't overlap, first to last
+    std::vector<SearchMatch> find_all(const TextData &text, std::size_t begin, std::size_t end);
+    /// Same as above, for whoever keeps the haystack, appending to out. A string search finds the matches that overlap
+    /// too, if overlapping. Stops, & returns false, when out has max_matches in it
+    bool find_all(const Haystack &text, std::size_t begin, std::size_t end, bool overlapping, std::size_t max_matches,
+                  std::vector<SearchMatch> &out);
+    /// Whether a string search matches at pos. Not for a regex
+    [[nodiscard]] bool literal_at(const Haystack &text, std::size_t pos) const;
+
+    [[nodiscard]] const std::string &query() const { return pattern; }
+    [[nodiscard]] SearchOptions options() const { return search_options; }
+    [[nodiscard]] bool is_regex() const { return regex != nullptr; }
+
+private:
+    Searcher(std::string_view query, SearchOptions options, std::unique_ptr<Regex> &&compiled);
+    std::string pattern;
+    SearchOptions search_options;
+    /// Only for a regex
+    std::unique_ptr<Regex> regex;
+    /// Where a string that begins in one chunk & ends in the next is searched for
+    std::string boundary{};
+
+    std::optional<SearchMatch> find(const Haystack &text, std::size_t from, std::size_t to);
+    std::optional<SearchMatch> rfind(const Haystack &text, std::size_t from, std::size_t to);
+};
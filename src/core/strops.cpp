@@ -5,43 +5,24 @@
 #include "strops.hpp"
 #include "core.hpp"
 
-#ifdef INTRINSICS_ENABLED
-#include <immintrin.h>
-/*
- * does broad word scanning of data, it scans 8 bytes in "parallell", checking for new lines
- * this does _not_ have to be done this complicated and manually. The compiler actually does this for us
- * as soon as we set optimization level to above "none". However, with SIMD & AVX2, we can instead of 8 bytes,
- * scan 32 bytes, which should increase the speed a bit further. But holy shit that's a lot of unnecessary work for
- * what is relatively small amount of textual data. Scanning a file with 5000 lines, takes in the order of ~40-50 ns with
- * the optimization set to O3 and doing the naive for-loop
-*/
-optimization turned on u64 newline_count_64bit(const char *data, std::size_t len) {
-    constexpr auto WORD_SIZE = 8;// 8 bytes = 64 bit
-    constexpr auto PEXT_FACTOR = 0x0101010101010101L;
-    auto pop_count = 0;
-    auto total_iterations = len / WORD_SIZE;
-    auto mask = "\n\n\n\n\n\n\n\n";
-    auto wm = *(u64 *) mask;
-
-    for (auto i = 0; i < total_iterations; i++) {
-        auto index = i * 8;
-        auto w0 = ~(*(u64 *) (data + index) ^ wm);
-        auto w1 = (w0 >> 4) & w0;
-        auto w2 = (w1 >> 2) & w1;
-        auto w3 = (w2 >> 1) & w2;
-
-        auto bits = _pext_u64(w3, PEXT_FACTOR);
-
-        // below translates to (on my system) to pop_count = _mm_popcnt_u64(bits);
-        pop_count += __builtin_popcount(bits);
-    }
-    for (auto i = total_iterations * WORD_SIZE; i < len; ++i) {
-        if (data[i] == '\n') pop_count++;
-    }
-    return pop_count;
-}
+#include <array>
+#include <bit>
+#include <cstring>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define STROPS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC lets us use any intrinsic without having to compile the entire TU for that instruction set
+#define TARGET_SSE2
+#define TARGET_AVX2
 #else
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 std::vector<int> make_lines_indices(const char *data, std::size_t len) {
     auto res = 0;
     std::vector<int> line_begins{};
@@ -55,15 +36,482 @@ std::vector<int> make_lines_indices(const char *data, std::size_t len) {
     }
     return line_begins;
 }
+
+/// ----------- LINE START KERNELS ----------------
+
+static void line_starts_scalar(const char *data, std::size_t length, std::size_t base, std::vector<std::size_t> &out) {
+    for (std::size_t i = 0; i < length; ++i) {
+        if (data[i] == '\n') out.push_back(base + i + 1);
+    }
+}
+
+#ifdef STROPS_X86
+/*
+ * Both kernels compare a block of bytes against '\n' in one go, and turn the result into a bit mask with movemask.
+ * Newlines are rare compared to other characters, so most blocks produce a 0 mask and cost only a couple of
+ * instructions; for the rest, we walk the set bits, one per line begin.
+ */
+TARGET_SSE2 static void line_starts_sse2(const char *data, std::size_t length, std::size_t base,
+                                         std::vector<std::size_t> &out) {
+    const auto newline = _mm_set1_epi8('\n');
+    std::size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        auto mask = static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        for (; mask != 0; mask &= mask - 1) { out.push_back(base + i + std::countr_zero(mask) + 1); }
+    }
+    line_starts_scalar(data + i, length - i, base + i, out);
+}
+
+TARGET_AVX2 static void line_starts_avx2(const char *data, std::size_t length, std::size_t base,
+                                         std::vector<std::size_t> &out) {
+    const auto newline = _mm256_set1_epi8('\n');
+    std::size_t i = 0;
+    // 64 bytes per iteration, two loads in flight hides some of the latency
+    for (; i + 64 <= length; i += 64) {
+        auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 32));
+        auto lo_mask = static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, newline)));
+        auto hi_mask = static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, newline)));
+        auto mask = (static_cast<u64>(hi_mask) << 32) | lo_mask;
+        for (; mask != 0; mask &= mask - 1) { out.push_back(base + i + std::countr_zero(mask) + 1); }
+    }
+    line_starts_sse2(data + i, length - i, base + i, out);
+}
+#endif
+
+/// ----------- LEXER SCANNERS ----------------
+
+static bool is_identifier_char(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_';
+}
+
+static bool is_blank(char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; }
+
+static std::size_t span_identifier_scalar(const char *data, std::size_t length) {
+    std::size_t i = 0;
+    while (i < length && is_identifier_char(data[i])) ++i;
+    return i;
+}
+
+static std::size_t span_blanks_scalar(const char *data, std::size_t length) {
+    std::size_t i = 0;
+    while (i < length && is_blank(data[i])) ++i;
+    return i;
+}
+
+static std::size_t find_block_comment_end_scalar(const char *data, std::size_t length) {
+    for (std::size_t i = 0; i + 1 < length; ++i) {
+        if (data[i] == '*' && data[i + 1] == '/') return i;
+    }
+    return length;
+}
+
+#ifdef STROPS_X86
+/*
+ * SSE2 has no unsigned byte compares, so ranges are checked by flipping the sign bit of both sides, which turns the
+ * unsigned order into the signed one. Letters are folded to lower case by setting bit 5 first; that also maps some
+ * punctuation onto [a-z]'s neighbours, but never into it.
+ */
+TARGET_SSE2 static __m128i in_range(__m128i chunk, char low, char high) {
+    const auto flip = _mm_set1_epi8(static_cast<char>(0x80));
+    auto flipped = _mm_xor_si128(chunk, flip);
+    auto below = _mm_cmplt_epi8(flipped, _mm_xor_si128(_mm_set1_epi8(low), flip));
+    auto above = _mm_cmpgt_epi8(flipped, _mm_xor_si128(_mm_set1_epi8(high), flip));
+    return _mm_andnot_si128(_mm_or_si128(below, above), _mm_set1_epi8(static_cast<char>(0xff)));
+}
+
+TARGET_SSE2 static std::size_t span_identifier_sse2(const char *data, std::size_t length) {
+    std::size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        auto letter = in_range(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), 'a', 'z');
+        auto digit = in_range(chunk, '0', '9');
+        auto underscore = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+        auto mask = static_cast<u32>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), underscore)));
+        if (mask != 0xffff) return i + std::countr_one(mask);
+    }
+    return i + span_identifier_scalar(data + i, length - i);
+}
+
+TARGET_SSE2 static std::size_t span_blanks_sse2(const char *data, std::size_t length) {
+    std::size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        auto blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                  _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')),
+                                               _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+        auto mask = static_cast<u32>(_mm_movemask_epi8(blank));
+        if (mask != 0xffff) return i + std::countr_one(mask);
+    }
+    return i + span_blanks_scalar(data + i, length - i);
+}
+
+TARGET_SSE2 static std::size_t find_block_comment_end_sse2(const char *data, std::size_t length) {
+    std::size_t i = 0;
+    // a '*' at position n of a block is a match when there's a '/' at n + 1, which the second, shifted load holds
+    for (; i + 17 <= length; i += 16) {
+        auto stars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        auto slashes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 1));
+        auto mask = static_cast<u32>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(stars, _mm_set1_epi8('*')), _mm_cmpeq_epi8(slashes, _mm_set1_epi8('/')))));
+        if (mask != 0) return i + std::countr_zero(mask);
+    }
+    return i + find_block_comment_end_scalar(data + i, length - i);
+}
+#endif
+
+/// ----------- LITERAL SEARCH ----------------
+
+/// How common a byte is in source code & prose, roughly, higher is more common. Ranks, not counts; all the literal
+/// search needs to know is which bytes of a needle are the least likely to show up
+static constexpr auto BYTE_FREQUENCY = [] {
+    std::array<std::uint8_t, 256> frequency{};
+    for (auto &f : frequency) f = 1;
+    for (auto c = 'A'; c <= 'Z'; ++c) frequency[AS(c, std::uint8_t)] = 60;
+    for (auto c = '0'; c <= '9'; ++c) frequency[AS(c, std::uint8_t)] = 80;
+    for (auto c : std::string_view{"!#$%&+-/:<>?@[\\]^`|~"}) frequency[AS(c, std::uint8_t)] = 70;
+    for (auto c : std::string_view{"\"'()*,.;=_{}"}) frequency[AS(c, std::uint8_t)] = 120;
+    // lower case letters by how common they are in english, most common first
+    std::uint8_t rank = 250;
+    for (auto c : std::string_view{"etaoinsrhldcumfpgwybvkxjqz"}) frequency[AS(c, std::uint8_t)] = rank -= 4;
+    frequency[' '] = 255;
+    frequency['\n'] = 180;
+    frequency['\t'] = 160;
+    return frequency;
+}();
+
+static constexpr char fold_case(char ch) { return (ch >= 'A' && ch <= 'Z') ? AS(ch + ('a' - 'A'), char) : ch; }
+static constexpr bool is_letter(char ch) { return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'); }
+
+namespace {
+/// A needle, with the two bytes of it that the kernels look for first
+struct LiteralNeedle {
+    std::string_view text;
+    bool ignore_case;
+    /// Offsets of the rarest & the second rarest byte of text, which are the same if text is one byte
+    std::size_t rare1{0}, rare2{0};
+    /// The bytes at those offsets, folded to lower case when they are letters of a case insensitive search
+    char byte1{0}, byte2{0};
+    bool fold1{false}, fold2{false};
+
+    LiteralNeedle(std::string_view text, bool ignore_case) : text(text), ignore_case(ignore_case) {
+        auto frequency = [&](std::size_t i) {
+            auto ch = text[i];
+            auto f = BYTE_FREQUENCY[AS(ch, std::uint8_t)];
+            if (ignore_case && is_letter(ch)) f = std::max(f, BYTE_FREQUENCY[AS(fold_case(ch) ^ 0x20, std::uint8_t)]);
+            return f;
+        };
+        for (std::size_t i = 1; i < text.size(); ++i) {
+            if (frequency(i) < frequency(rare1)) rare1 = i;
+        }
+        rare2 = rare1 == 0 ? text.size() - 1 : 0;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            if (i != rare1 && frequency(i) < frequency(rare2)) rare2 = i;
+        }
+        if (rare2 < rare1) std::swap(rare1, rare2);
+        fold1 = ignore_case && is_letter(text[rare1]);
+        fold2 = ignore_case && is_letter(text[rare2]);
+        byte1 = fold1 ? fold_case(text[rare1]) : text[rare1];
+        byte2 = fold2 ? fold_case(text[rare2]) : text[rare2];
+    }
+
+    [[nodiscard]] bool matches_at(const char *at) const {
+        if (not ignore_case) return std::memcmp(at, text.data(), text.size()) == 0;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            if (fold_case(at[i]) != fold_case(text[i])) return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool candidate_at(const char *at) const {
+        return (fold1 ? fold_case(at[rare1]) : at[rare1]) == byte1 && (fold2 ? fold_case(at[rare2]) : at[rare2]) == byte2;
+    }
+};
+}// namespace
+
+static std::size_t find_literal_scalar(const char *data, std::size_t length, const LiteralNeedle &needle) {
+    const auto size = needle.text.size();
+    if (size > length) return length;
+    const auto last_start = length - size;
+    if (not needle.fold1) {
+        // memchr is vectorized by every C library we build with; the rarest byte keeps it from stopping too often
+        for (std::size_t i = 0; i <= last_start;) {
+            auto hit = static_cast<const char *>(
+                    std::memchr(data + i + needle.rare1, needle.byte1, last_start - i + 1));
+            if (hit == nullptr) return length;
+            auto at = AS(hit - data, std::size_t) - needle.rare1;
+            if (needle.matches_at(data + at)) return at;
+            i = at + 1;
+        }
+        return length;
+    }
+    for (std::size_t i = 0; i <= last_start; ++i) {
+        if (needle.candidate_at(data + i) && needle.matches_at(data + i)) return i;
+    }
+    return length;
+}
+
+static std::size_t rfind_literal_scalar(const char *data, std::size_t length, const LiteralNeedle &needle) {
+    const auto size = needle.text.size();
+    if (size > length) return length;
+    for (auto i = length - size + 1; i-- > 0;) {
+        if (needle.candidate_at(data + i) && needle.matches_at(data + i)) return i;
+    }
+    return length;
+}
+
+#ifdef STROPS_X86
+/*
+ * The kernels load the block of candidate starts twice, offset by where the two rare bytes are in the needle, so a
+ * set bit in the mask of both compares is a start where both rare bytes are in place. Letters of a case insensitive
+ * search are compared with bit 5 set on both sides, which only ever maps letters onto lower case letters; the bit is
+ * or:ed in with a zero vector for the bytes that aren't, so that the loops have no branches but the one on a hit.
+ */
+/// The first start in mask, bit i being start block + i, that the needle is at. npos if none of them
+static std::size_t verify_candidates(const char *data, std::size_t block, u32 mask, const LiteralNeedle &needle) {
+    for (; mask != 0; mask &= mask - 1) {
+        auto at = block + std::countr_zero(mask);
+        if (needle.matches_at(data + at)) return at;
+    }
+    return std::string_view::npos;
+}
+
+struct RareBytesSse2 {
+    __m128i byte1, byte2, fold1, fold2;
+
+    TARGET_SSE2 explicit RareBytesSse2(const LiteralNeedle &needle)
+        : byte1(_mm_set1_epi8(needle.byte1)), byte2(_mm_set1_epi8(needle.byte2)),
+          fold1(needle.fold1 ? _mm_set1_epi8(0x20) : _mm_setzero_si128()),
+          fold2(needle.fold2 ? _mm_set1_epi8(0x20) : _mm_setzero_si128()) {}
+
+    /// Byte i is all ones if both rare bytes are in place, for the needle starting at at + i
+    [[nodiscard]] TARGET_SSE2 __m128i candidates(const char *at, const LiteralNeedle &needle) const {
+        auto first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(at + needle.rare1));
+        auto second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(at + needle.rare2));
+        return _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(first, fold1), byte1),
+                             _mm_cmpeq_epi8(_mm_or_si128(second, fold2), byte2));
+    }
+};
+
+TARGET_SSE2 static u32 mask_of(__m128i candidates) { return AS(_mm_movemask_epi8(candidates), u32); }
+
+TARGET_SSE2 static std::size_t find_literal_sse2(const char *data, std::size_t length, const LiteralNeedle &needle) {
+    const auto size = needle.text.size();
+    if (size > length) return length;
+    // starts in [0, starts) are the ones where the needle fits
+    const auto starts = length - size + 1;
+    const RareBytesSse2 rare{needle};
+    std::size_t i = 0;
+    // two blocks at a time, tested as one, as hits are rare, & the test is what the loop would otherwise wait on
+    for (; i + 32 <= starts; i += 32) {
+        auto low = rare.candidates(data + i, needle), high = rare.candidates(data + i + 16, needle);
+        if (mask_of(_mm_or_si128(low, high)) == 0) continue;
+        if (auto at = verify_candidates(data, i, mask_of(low), needle); at != std::string_view::npos) return at;
+        if (auto at = verify_candidates(data, i + 16, mask_of(high), needle); at != std::string_view::npos) return at;
+    }
+    for (; i + 16 <= starts; i += 16) {
+        auto at = verify_candidates(data, i, mask_of(rare.candidates(data + i, needle)), needle);
+        if (at != std::string_view::npos) return at;
+    }
+    auto rest = find_literal_scalar(data + i, length - i, needle);
+    return rest == length - i ? length : i + rest;
+}
+
+TARGET_SSE2 static std::size_t rfind_literal_sse2(const char *data, std::size_t length, const LiteralNeedle &needle) {
+    const auto size = needle.text.size();
+    if (size > length) return length;
+    auto starts = length - size + 1;
+    const RareBytesSse2 rare{needle};
+    for (; starts >= 16; starts -= 16) {
+        const auto i = starts - 16;
+        for (auto mask = mask_of(rare.candidates(data + i, needle)); mask != 0;) {
+            auto bit = 31 - std::countl_zero(mask);
+            if (needle.matches_at(data + i + bit)) return i + bit;
+            mask &= ~(1u << bit);
+        }
+    }
+    // what's left are the starts before the ones searched, the needle ending at most size - 1 bytes into those
+    auto rest = rfind_literal_scalar(data, starts + size - 1, needle);
+    return rest == starts + size - 1 ? length : rest;
+}
+
+struct RareBytesAvx2 {
+    __m256i byte1, byte2, fold1, fold2;
+
+    TARGET_AVX2 explicit RareBytesAvx2(const LiteralNeedle &needle)
+        : byte1(_mm256_set1_epi8(needle.byte1)), byte2(_mm256_set1_epi8(needle.byte2)),
+          fold1(needle.fold1 ? _mm256_set1_epi8(0x20) : _mm256_setzero_si256()),
+          fold2(needle.fold2 ? _mm256_set1_epi8(0x20) : _mm256_setzero_si256()) {}
+
+    [[nodiscard]] TARGET_AVX2 __m256i candidates(const char *at, const LiteralNeedle &needle) const {
+        auto first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(at + needle.rare1));
+        auto second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(at + needle.rare2));
+        return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(first, fold1), byte1),
+                                _mm256_cmpeq_epi8(_mm256_or_si256(second, fold2), byte2));
+    }
+};
+
+TARGET_AVX2 static u32 mask_of(__m256i candidates) { return AS(_mm256_movemask_epi8(candidates), u32); }
+
+TARGET_AVX2 static std::size_t find_literal_avx2(const char *data, std::size_t length, const LiteralNeedle &needle) {
+    const auto size = needle.text.size();
+    if (size > length) return length;
+    const auto starts = length - size + 1;
+    const RareBytesAvx2 rare{needle};
+    std::size_t i = 0;
+    for (; i + 64 <= starts; i += 64) {
+        auto low = rare.candidates(data + i, needle), high = rare.candidates(data + i + 32, needle);
+        auto any = _mm256_or_si256(low, high);
+        if (_mm256_testz_si256(any, any)) continue;
+        if (auto at = verify_candidates(data, i, mask_of(low), needle); at != std::string_view::npos) return at;
+        if (auto at = verify_candidates(data, i + 32, mask_of(high), needle); at != std::string_view::npos) return at;
+    }
+    for (; i + 32 <= starts; i += 32) {
+        auto at = verify_candidates(data, i, mask_of(rare.candidates(data + i, needle)), needle);
+        if (at != std::string_view::npos) return at;
+    }
+    auto rest = find_literal_sse2(data + i, length - i, needle);
+    return rest == length - i ? length : i + rest;
+}
 #endif
+
 namespace str {
 
-    std::vector<int> count_newlines(const char *data, std::size_t length) {
-#ifdef INTRINSICS_ENABLED
-        return newline_count_64bit(data, length);
+    static SimdLevel detect_simd_level() {
+#ifdef STROPS_X86
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        auto max_leaf = info[0];
+        __cpuid(info, 1);
+        auto has_sse2 = (info[3] & (1 << 26)) != 0;
+        // AVX2 also needs the OS to save the YMM registers on context switches (OSXSAVE + XCR0 bit 1 & 2)
+        auto os_saves_ymm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+        auto has_avx2 = false;
+        if (max_leaf >= 7) {
+            __cpuidex(info, 7, 0);
+            has_avx2 = (info[1] & (1 << 5)) != 0;
+        }
+        if (has_avx2 && os_saves_ymm) return SimdLevel::AVX2;
+        if (has_sse2) return SimdLevel::SSE2;
 #else
-        return make_lines_indices(data, length);
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+#endif
+#endif
+        return SimdLevel::Scalar;
+    }
+
+    SimdLevel detected_simd_level() {
+        static const auto level = detect_simd_level();
+        return level;
+    }
+
+    const char *simd_level_name(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::AVX2:
+                return "AVX2";
+            case SimdLevel::SSE2:
+                return "SSE2";
+            default:
+                return "scalar";
+        }
+    }
+
+    void find_line_starts(SimdLevel level, const char *data, std::size_t length, std::size_t base,
+                          std::vector<std::size_t> &out) {
+        switch (level) {
+#ifdef STROPS_X86
+            case SimdLevel::AVX2:
+                line_starts_avx2(data, length, base, out);
+                break;
+            case SimdLevel::SSE2:
+                line_starts_sse2(data, length, base, out);
+                break;
+#endif
+            default:
+                line_starts_scalar(data, length, base, out);
+        }
+    }
+
+    void find_line_starts(const char *data, std::size_t length, std::size_t base, std::vector<std::size_t> &out) {
+        find_line_starts(detected_simd_level(), data, length, base, out);
+    }
+
+    std::vector<std::size_t> count_newlines(const char *data, std::size_t length) {
+        std::vector<std::size_t> line_begins{0};
+        // growing the vector while scanning costs more than the scan itself, guess at ~64 characters per line
+        line_begins.reserve(length / 64);
+        find_line_starts(data, length, 0, line_begins);
+        return line_begins;
+    }
+
+    // runs in source code are short, most identifiers fit in one SSE2 block; AVX2 kernels would only add setup
+    std::size_t span_identifier(const char *data, std::size_t length) {
+#ifdef STROPS_X86
+        if (detected_simd_level() != SimdLevel::Scalar) return span_identifier_sse2(data, length);
+#endif
+        return span_identifier_scalar(data, length);
+    }
+
+    std::size_t span_blanks(const char *data, std::size_t length) {
+#ifdef STROPS_X86
+        if (detected_simd_level() != SimdLevel::Scalar) return span_blanks_sse2(data, length);
+#endif
+        return span_blanks_scalar(data, length);
+    }
+
+    std::size_t find_block_comment_end(const char *data, std::size_t length) {
+#ifdef STROPS_X86
+        if (detected_simd_level() != SimdLevel::Scalar) return find_block_comment_end_sse2(data, length);
+#endif
+        return find_block_comment_end_scalar(data, length);
+    }
+
+    std::size_t find_literal(SimdLevel level, const char *data, std::size_t length, std::string_view needle,
+                             bool ignore_case) {
+        if (needle.empty()) return length;
+        const LiteralNeedle literal{needle, ignore_case};
+        switch (level) {
+#ifdef STROPS_X86
+            case SimdLevel::AVX2:
+                return find_literal_avx2(data, length, literal);
+            case SimdLevel::SSE2:
+                return find_literal_sse2(data, length, literal);
+#endif
+            default:
+                return find_literal_scalar(data, length, literal);
+        }
+    }
+
+    std::size_t find_literal(const char *data, std::size_t length, std::string_view needle, bool ignore_case) {
+        if (needle.empty()) return length;
+        const LiteralNeedle literal{needle, ignore_case};
+        // measured (bench/search_bench): memchr on the one rare byte is on par with the kernels, or ahead of them
+        if (not literal.fold1) return find_literal_scalar(data, length, literal);
+#ifdef STROPS_X86
+        switch (detected_simd_level()) {
+            case SimdLevel::AVX2:
+                return find_literal_avx2(data, length, literal);
+            case SimdLevel::SSE2:
+                return find_literal_sse2(data, length, literal);
+            default:
+                break;
+        }
+#endif
+        return find_literal_scalar(data, length, literal);
+    }
+
+    // searching backward is for going to the previous match, which is usually close by; SSE2 is plenty for that
+    std::size_t rfind_literal(const char *data, std::size_t length, std::string_view needle, bool ignore_case) {
+        if (needle.empty()) return length;
+        const LiteralNeedle literal{needle, ignore_case};
+#ifdef STROPS_X86
+        if (detected_simd_level() != SimdLevel::Scalar) return rfind_literal_sse2(data, length, literal);
 #endif
+        return rfind_literal_scalar(data, length, literal);
     }
 }// namespace str
 
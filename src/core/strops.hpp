@@ -12,18 +12,52 @@
 
 using u64 = uint64_t;
 
-#ifdef INTRINSICS_ENABLED
-#include <immintrin.h>
+/// The naive, byte-at-a-time line begin scan. Kept as a reference for the benchmark in bench/
+std::vector<int> make_lines_indices(const char *data, std::size_t len);
 
-u64 newline_count_64bit(const char *data, std::size_t len);
+namespace str {
+    enum class SimdLevel { Scalar, SSE2, AVX2 };
 
-#else
+    /// Best instruction set the running CPU supports. Detected once, on first call
+    SimdLevel detected_simd_level();
+    const char *simd_level_name(SimdLevel level);
 
-std::vector<int> make_lines_indices(const char *data, std::size_t len);
+    /**
+     * Appends base + (index after each '\n' in data) to out, i.e. the offsets of the lines beginning in data. Uses the
+     * widest kernel the CPU supports (AVX2 -> SSE2 -> scalar), picked at run time, so no compile time flags are needed.
+     */
+    void find_line_starts(const char *data, std::size_t length, std::size_t base, std::vector<std::size_t> &out);
+    /// Same as above, but forces a specific kernel. level must be supported by the CPU.
+    void find_line_starts(SimdLevel level, const char *data, std::size_t length, std::size_t base,
+                          std::vector<std::size_t> &out);
 
-#endif
-namespace str {
-    std::vector<int> count_newlines(const char *data, std::size_t length);
+    /// Line begins of data, first line always begins at 0
+    std::vector<std::size_t> count_newlines(const char *data, std::size_t length);
+
+    /**
+     * Scanners for the lexer. Each returns the length of the run of a kind of characters that data begins with, or
+     * where something is found. 16 bytes are classified at a time on SSE2 CPUs, the rest byte by byte.
+     */
+    /// Length of the run of [A-Za-z0-9_]
+    std::size_t span_identifier(const char *data, std::size_t length);
+    /// Length of the run of spaces, tabs & carriage returns. Newlines end it, as the lexer works line by line
+    std::size_t span_blanks(const char *data, std::size_t length);
+    /// Offset of the first "*/" in data, or length if there is none
+    std::size_t find_block_comment_end(const char *data, std::size_t length);
+
+    /**
+     * Literal search. Candidates are found a block of 16 (SSE2) or 32 (AVX2) bytes at a time, by comparing two bytes of
+     * needle, the ones that are the rarest in text, and needle is only compared in full where both of those match.
+     * ignore_case matches ASCII letters of either case. When the rarest byte has only the one case, memchr of it, which
+     * the C libraries vectorize about as well, is what finds the candidates, whatever the CPU has.
+     */
+    /// Offset of the first occurrence of needle in data, or length if there is none, or needle is empty
+    std::size_t find_literal(const char *data, std::size_t length, std::string_view needle, bool ignore_case = false);
+    /// Offset of the last occurrence of needle in data, or length if there is none, or needle is empty
+    std::size_t rfind_literal(const char *data, std::size_t length, std::string_view needle, bool ignore_case = false);
+    /// Same as above, but forces a specific kernel. level must be supported by the CPU.
+    std::size_t find_literal(SimdLevel level, const char *data, std::size_t length, std::string_view needle,
+                             bool ignore_case = false);
 }
 
 namespace util::str {
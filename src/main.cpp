@@ -26,7 +26,6 @@ int main(int argc, const char **argv) {
  * father other features so to speak.
  * TODO(abstraction, major): tie in all edits of buffer & their possible side effects behind the EditorWindow class
  * TODO(abstraction, major): tie in all edits of buffer & their possible side effects behind the EditorWindow class
- * TODO(cosmetic, minor): Add delay to syntax highlighting / lexing, so that the entire text doesn't flicker about
  * TODO(feature, minor): add write file command
  *  - done, but no overwrite confirmation
  * TODO(feature, minor): add copy / paste commands
@@ -46,7 +45,6 @@ int main(int argc, const char **argv) {
  *      thus doesn't have the suckyness of freetype, which must be installed manually in the deps folder
  * TODO(feature, minor): make application file-type aware. This can have multiple uses, one is described in app.cpp when it comes to reloading
  *      settings from a .cxe file, while editing a .cxe file
- * TODO(feature, minor): undo/redo operations.
  * Add some debug code for OpenGL and read up about OpenGL
  *
     GLint s;
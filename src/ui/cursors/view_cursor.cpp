@@ -12,6 +12,19 @@ namespace ui {
 // View Cursor
 constexpr auto line_shade_color = Vec4f{0.5,0.5,0.5,0.25};
 
+/// Appends a rect of height at y1 from x1 to x2, growing what's reserved on the GPU when it no longer fits
+static void push_rect(CursorVAO &vao, GLfloat x1, GLfloat x2, GLfloat y1, GLfloat h) {
+    auto &data = vao.vbo->data;
+    vao.vbo->pristine = false;
+    data.emplace_back(x1, y1 + h);
+    data.emplace_back(x1, y1);
+    data.emplace_back(x2, y1);
+    data.emplace_back(x1, y1 + h);
+    data.emplace_back(x2, y1);
+    data.emplace_back(x2, y1 + h);
+    if (data.size() * sizeof(CursorVertex) > vao.vbo->reservedGPUMemory) vao.reserve_gpu_size(data.size() / 6 * 2);
+}
+
 std::unique_ptr<ViewCursor> ViewCursor::create_from(std::unique_ptr<View> &owning_view) {
     auto buf_curs = owning_view->get_text_buffer()->get_cursor();
 
@@ -31,6 +44,7 @@ std::unique_ptr<ViewCursor> ViewCursor::create_from(std::unique_ptr<View> &ownin
     vc->index = buf_curs.pos;
     vc->cursor_data = std::move(cursor_vao);
     vc->line_shade_data = std::move(line_shade_vao);
+    vc->match_data = CursorVAO::make(GL_ARRAY_BUFFER, 6 * 1024);
     vc->view = owning_view.get();
     vc->shader = shader;
     vc->setup_dimensions(8, font->max_glyph_height + 4);
@@ -56,6 +70,7 @@ std::unique_ptr<ViewCursor> ViewCursor::create_from(View *view) {
     vc->index = buf_curs.pos;
     vc->cursor_data = std::move(cursor_vao);
     vc->line_shade_data = std::move(line_shade_vao);
+    vc->match_data = CursorVAO::make(GL_ARRAY_BUFFER, 6 * 1024);
     vc->view = view;
     vc->shader = shader;
     vc->setup_dimensions(4, font->max_glyph_height + 4);
@@ -70,6 +85,9 @@ void ViewCursor::draw(bool isActive) {
     line_shade_data->bind_all();
     shader->set_fillcolor(line_shade_color);
     line_shade_data->draw();
+    match_data->bind_all();
+    shader->set_fillcolor(match_color);
+    match_data->draw();
     cursor_data->bind_all();
     shader->set_fillcolor(caret_color);
     cursor_data->draw();
@@ -85,6 +103,10 @@ void ViewCursor::forced_draw() {
     shader->set_fillcolor(line_shade_color);
     line_shade_data->flush_and_draw();
 
+    match_data->bind_all();
+    shader->set_fillcolor(match_color);
+    match_data->flush_and_draw();
+
     cursor_data->bind_all();
     shader->set_fillcolor(caret_color);
     cursor_data->flush_and_draw();
@@ -138,6 +160,20 @@ void ViewCursor::set_line_rect(GLfloat x1, GLfloat x2, GLfloat y1) {
     data.emplace_back(x + w, y + h);
 }
 
+void ViewCursor::add_rect(GLfloat x1, GLfloat x2, GLfloat y1) {
+    push_rect(*cursor_data, x1, x2, y1, AS(height, GLfloat));
+}
+
+void ViewCursor::clear_matches() {
+    if (match_data->vbo->data.empty()) return;
+    match_data->vbo->data.clear();
+    match_data->vbo->pristine = false;
+}
+
+void ViewCursor::add_match_rect(GLfloat x1, GLfloat x2, GLfloat y1) {
+    push_rect(*match_data, x1, x2, y1, AS(height, GLfloat));
+}
+
 void ViewCursor::setup_dimensions(int Width, int Height) {
     this->width = Width;
     this->height = Height;
@@ -26,6 +26,11 @@ namespace ui {
 
         void set_line_rect(GLfloat x1, GLfloat x2, GLfloat y1);
         void set_line_rect(GLfloat x1, GLfloat x2, GLfloat y1, int height);
+        /// Adds a rect to what's drawn of the cursor, keeping what's there; for the other cursors of the buffer
+        void add_rect(GLfloat x1, GLfloat x2, GLfloat y1);
+        /// The search matches on screen, drawn under the cursor
+        void clear_matches();
+        void add_match_rect(GLfloat x1, GLfloat x2, GLfloat y1);
 
         // void set_projection(glm::mat4 orthoProjection);
         void set_projection(Matrix orthoProjection);
@@ -41,7 +46,9 @@ namespace ui {
         int pos_x;
         int pos_y;
         RGBAColor caret_color = {1.0, 0.0, 0.2, .4};
+        RGBAColor match_color = {0.9, 0.7, 0.1, .35};
         std::unique_ptr<CursorVAO> cursor_data;
         std::unique_ptr<CursorVAO> line_shade_data;
+        std::unique_ptr<CursorVAO> match_data;
     };
 }
\ No newline at end of file
@@ -50,15 +50,27 @@ EditorWindow::~EditorWindow() {
 
 void EditorWindow::draw(bool force_redraw) {
     if (force_redraw) {
+        view->damage();
+        status_bar->damage();
         view->forced_draw(this->active);
-    } else {
+    } else if (view->is_damaged(this->active)) {
         view->draw(this->active);
     }
-    this->status_bar->draw(view);
+    if (status_bar->is_damaged(view)) this->status_bar->draw(view);
 }
 
+bool EditorWindow::is_damaged() const { return view->is_damaged(active) || status_bar->is_damaged(view); }
+
 TextData *EditorWindow::get_text_buffer() const { return view->get_text_buffer(); }
 
+void EditorWindow::set_text_buffer(TextData *buffer) {
+    view->data = buffer;
+    view->td_id = buffer->id;
+    view->cursor->views_top_line = 0;
+    view->damage();
+    status_bar->set_buffer_cursor(&buffer->cursor);
+}
+
 void EditorWindow::update_layout(core::DimInfo dim_info) {
     auto &[x, y, width, height] = dim_info;
     auto sb_height = FontLibrary::get_default_font()->get_row_advance() + 2;
@@ -69,12 +81,14 @@ void EditorWindow::update_layout(core::DimInfo dim_info) {
     view->set_dimensions(width, text_editor_height);
     status_bar->ui_view->set_dimensions(width, sb_height);
     status_bar->ui_view->anchor_at(x, height);
+    status_bar->damage();
     this->dimInfo = dim_info;
 }
 
 void EditorWindow::set_projection(Matrix projection) const {
     this->view->set_projection(projection);
     this->status_bar->ui_view->set_projection(projection);
+    this->status_bar->damage();
 }
 
 void EditorWindow::handle_click(int x, int yPOS) {
@@ -84,11 +98,11 @@ void EditorWindow::handle_click(int x, int yPOS) {
         auto row_clicked = std::floor(std::max(0, yPOS - status_bar->ui_view->height) /
                                       float(view->get_font()->get_row_advance())) +
                            view->get_cursor()->views_top_line;
-        if (meta_data.line_begins.size() > row_clicked) {
-            auto bufIdx = meta_data.line_begins[int(row_clicked)];
+        if (meta_data.line_count() > row_clicked) {
+            auto bufIdx = meta_data.line_begin(std::size_t(row_clicked));
             view->get_text_buffer()->step_cursor_to(bufIdx);
         } else {
-            auto bufIdx = meta_data.line_begins.back();
+            auto bufIdx = meta_data.line_begin(meta_data.line_count() - 1);
             view->get_text_buffer()->step_cursor_to(bufIdx);
         }
     } else {
@@ -100,15 +114,18 @@ void EditorWindow::handle_click(int x, int yPOS) {
 void EditorWindow::set_view_colors(RGBColor bg, RGBColor fg) {
     view->fg_color = fg;
     view->bg_color = bg;
+    view->damage();
 }
 void EditorWindow::set_font(SimpleFont *pFont) {
     view->font = pFont;
     view->cursor->setup_dimensions(view->cursor->width, pFont->max_glyph_height + 4);
+    view->damage();
 
 }
 
 void EditorWindow::set_caret_style(Configuration::Cursor style) {
     view->cursor->caret_color = style.color;
+    view->damage();
     std::visit(
             [this](auto &&style) {
                 using T = std::decay_t<decltype(style)>;
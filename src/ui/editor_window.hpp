@@ -28,9 +28,13 @@ struct EditorWindow {
     StatusBar *status_bar = nullptr;
     int ui_layout_id;
     ui::core::DimInfo dimInfo;
+    /// Draws the view & the status bar, if they're damaged, or everything, if force_redraw
     void draw(bool force_redraw = false);
+    [[nodiscard]] bool is_damaged() const;
     ~EditorWindow();
     [[nodiscard]] TextData *get_text_buffer() const;
+    /// Swaps the buffer displayed by this window. Closing the old buffer is up to the caller
+    void set_text_buffer(TextData *buffer);
     // static EditorWindow *create(std::optional<TextData *> textData, glm::mat4 projection, int layout_id, core::DimInfo dimInfo);
     static EditorWindow *create(std::optional<TextData *> textData, Matrix projection, int layout_id,
                                 core::DimInfo dimInfo);
@@ -0,0 +1,272 @@
+//
+// Created by 46769 on 2021-02-14.
+//
+
+#include "grammar.hpp"
+#include <algorithm>
+#include <core/core.hpp>
+#include <core/strops.hpp>
+#include <limits>
+
+using namespace std::string_view_literals;
+
+/// ----------------- GRAMMARS -----------------
+
+// clang-format off
+constexpr std::array c_keywords{
+    "auto"sv, "break"sv, "case"sv, "char"sv, "const"sv, "continue"sv, "default"sv, "do"sv, "double"sv, "else"sv,
+    "enum"sv, "extern"sv, "float"sv, "for"sv, "goto"sv, "if"sv, "inline"sv, "int"sv, "long"sv, "register"sv,
+    "restrict"sv, "return"sv, "short"sv, "signed"sv, "sizeof"sv, "static"sv, "struct"sv, "switch"sv, "typedef"sv,
+    "union"sv, "unsigned"sv, "void"sv, "volatile"sv, "while"sv, "_Bool"sv, "bool"sv, "true"sv, "false"sv, "NULL"sv,
+};
+constexpr std::array python_keywords{
+    "False"sv, "None"sv, "True"sv, "and"sv, "as"sv, "assert"sv, "async"sv, "await"sv, "break"sv, "class"sv,
+    "continue"sv, "def"sv, "del"sv, "elif"sv, "else"sv, "except"sv, "finally"sv, "for"sv, "from"sv, "global"sv,
+    "if"sv, "import"sv, "in"sv, "is"sv, "lambda"sv, "nonlocal"sv, "not"sv, "or"sv, "pass"sv, "raise"sv, "return"sv,
+    "try"sv, "while"sv, "with"sv, "yield"sv, "self"sv,
+};
+constexpr std::array rust_keywords{
+    "as"sv, "async"sv, "await"sv, "break"sv, "const"sv, "continue"sv, "crate"sv, "dyn"sv, "else"sv, "enum"sv,
+    "extern"sv, "false"sv, "fn"sv, "for"sv, "if"sv, "impl"sv, "in"sv, "let"sv, "loop"sv, "match"sv, "mod"sv,
+    "move"sv, "mut"sv, "pub"sv, "ref"sv, "return"sv, "self"sv, "Self"sv, "static"sv, "struct"sv, "super"sv,
+    "trait"sv, "true"sv, "type"sv, "unsafe"sv, "use"sv, "where"sv, "while"sv, "bool"sv, "char"sv, "str"sv, "i8"sv,
+    "i16"sv, "i32"sv, "i64"sv, "i128"sv, "isize"sv, "u8"sv, "u16"sv, "u32"sv, "u64"sv, "u128"sv, "usize"sv, "f32"sv,
+    "f64"sv,
+};
+constexpr std::array json_keywords{"true"sv, "false"sv, "null"sv};
+// clang-format on
+
+static const std::array grammar_specs{
+        GrammarSpec{.language = Language::C, .name = "C", .keywords = c_keywords, .line_comment = "//",
+                    .block_comment_open = "/*", .block_comment_close = "*/", .quotes = "\"'", .directive = '#',
+                    .digit_separators = "'"},
+        GrammarSpec{.language = Language::Python, .name = "Python", .keywords = python_keywords, .line_comment = "#",
+                    .quotes = "\"'", .long_strings = {"\"\"\"", "'''"}, .directive = '@', .digit_separators = "_"},
+        // Rust strings may span lines; its ' is left alone, as it begins lifetimes as well as characters
+        GrammarSpec{.language = Language::Rust, .name = "Rust", .keywords = rust_keywords, .line_comment = "//",
+                    .block_comment_open = "/*", .block_comment_close = "*/", .long_strings = {"\""},
+                    .directive = '#', .digit_separators = "_", .bang_macros = true},
+        GrammarSpec{.language = Language::JSON, .name = "JSON", .keywords = json_keywords, .quotes = "\""},
+        GrammarSpec{.language = Language::Config, .name = "Configuration", .quotes = "\"", .sections = true},
+};
+
+/// ----------------- COMPILING -----------------
+
+enum ByteClass : std::uint8_t {
+    Space = 1 << 0,
+    Digit = 1 << 1,
+    NameBegin = 1 << 2,
+    NumberPart = 1 << 3,
+    /// May begin a comment, a string, a directive or an include path, depending on what comes after it
+    Opener = 1 << 4,
+};
+
+Grammar::Grammar(Language language, std::string_view name, LineLexer lexer)
+    : language(language), name(name), hand_written(lexer) {}
+
+Grammar::Grammar(const GrammarSpec &spec) : language(spec.language), name(spec.name), spec(spec) {
+    compile_classes();
+    compile_keywords();
+}
+
+void Grammar::compile_classes() {
+    auto mark = [this](char ch, ByteClass cls) { classes[AS(ch, unsigned char)] |= cls; };
+    for (auto ch : {' ', '\t', '\n', '\v', '\f', '\r'}) mark(ch, Space);
+    for (auto ch = '0'; ch <= '9'; ch++) {
+        mark(ch, Digit);
+        mark(ch, NumberPart);
+    }
+    for (auto ch = 'a'; ch <= 'z'; ch++) {
+        for (auto letter : {ch, AS(ch - 'a' + 'A', char)}) {
+            mark(letter, NameBegin);
+            mark(letter, NumberPart);
+        }
+    }
+    mark('_', NameBegin);
+    mark('.', NumberPart);
+    for (auto ch : spec.digit_separators) mark(ch, NumberPart);
+
+    for (auto opener : {spec.line_comment, spec.block_comment_open, spec.long_strings[0], spec.long_strings[1]}) {
+        if (not opener.empty()) mark(opener.front(), Opener);
+    }
+    for (auto ch : spec.quotes) mark(ch, Opener);
+    if (spec.directive != 0) {
+        mark(spec.directive, Opener);
+        mark('<', Opener);
+    }
+}
+
+void Grammar::compile_keywords() {
+    for (auto keyword : spec.keywords) {
+        for (auto ch : keyword) {
+            auto &column = keyword_columns[AS(ch, unsigned char)];
+            if (column != 0) continue;
+            if (column_count > std::numeric_limits<std::uint8_t>::max()) {
+                PANIC("Keywords of {} use too many bytes", name);
+            }
+            column = AS(column_count++, std::uint8_t);
+        }
+    }
+    transitions.assign(2 * column_count, 0);
+    accepting.assign(2, false);
+    for (auto keyword : spec.keywords) {
+        std::size_t state = 1;
+        for (auto ch : keyword) {
+            const auto at = state * column_count + keyword_columns[AS(ch, unsigned char)];
+            if (transitions[at] == 0) {
+                if (accepting.size() > std::numeric_limits<std::uint16_t>::max()) {
+                    PANIC("Keywords of {} need more states than a transition can hold", name);
+                }
+                transitions[at] = AS(accepting.size(), std::uint16_t);
+                accepting.push_back(false);
+                transitions.resize(transitions.size() + column_count, 0);
+            }
+            state = transitions[at];
+        }
+        accepting[state] = true;
+    }
+}
+
+bool Grammar::is_keyword(std::string_view word) const {
+    std::size_t state = 1;
+    for (auto ch : word) {
+        // bytes no keyword has, are in column 0, which leads every state to the dead state
+        state = transitions[state * column_count + keyword_columns[AS(ch, unsigned char)]];
+        if (state == 0) return false;
+    }
+    return accepting[state];
+}
+
+/// ----------------- LEXING -----------------
+
+void Grammar::lex_line(std::string_view line, std::size_t offset, LineLexState &state,
+                       std::vector<Token> &tokens) const {
+    if (hand_written) {
+        hand_written(line, offset, state, tokens);
+    } else {
+        lex_table_line(line, offset, state, tokens);
+    }
+}
+
+static bool begins_with(std::string_view text, std::size_t pos, std::string_view delimiter) {
+    return not delimiter.empty() && text.substr(pos, delimiter.size()) == delimiter;
+}
+
+/// Where a block comment that's open from pos ends, or the end of the line, if it doesn't end on it
+static std::size_t block_comment_end(const GrammarSpec &spec, std::string_view line, std::size_t pos,
+                                     std::size_t content_end, LineLexState &state) {
+    const auto close = line.find(spec.block_comment_close, pos);
+    state.in_block_comment = close == std::string_view::npos;
+    return state.in_block_comment ? content_end : close + spec.block_comment_close.size();
+}
+
+/// Where the string closed by delimiter ends, or npos if it doesn't end on this line
+static std::size_t string_end(std::string_view line, std::size_t pos, std::size_t content_end,
+                              std::string_view delimiter) {
+    for (auto i = pos; i < content_end; i++) {
+        if (line[i] == '\\') {
+            i++;
+        } else if (begins_with(line, i, delimiter)) {
+            return i + delimiter.size();
+        }
+    }
+    return std::string_view::npos;
+}
+
+/// Where the long string that's open from pos ends, or the end of the line, if it doesn't end on it
+static std::size_t long_string_end(const GrammarSpec &spec, std::string_view line, std::size_t pos,
+                                   std::size_t content_end, LineLexState &state) {
+    const auto end = string_end(line, pos, content_end, spec.long_strings[state.open_string - 1]);
+    if (end == std::string_view::npos) return content_end;
+    state.open_string = 0;
+    return end;
+}
+
+void Grammar::lex_table_line(std::string_view line, std::size_t offset, LineLexState &state,
+                             std::vector<Token> &tokens) const {
+    auto push = [&](std::size_t begin, std::size_t end, TokenType type) {
+        if (end > begin) tokens.push_back(Token{begin + offset, end + offset, type});
+        return end;
+    };
+    auto class_of = [this](char ch) { return classes[AS(ch, unsigned char)]; };
+    const auto sz = line.size();
+    const auto content_end = (sz > 0 && line.back() == '\n') ? sz - 1 : sz;
+    // directives only reach to the end of their line, nothing else is carried over to the next one
+    state.last_lexed = TokenType::Illegal;
+
+    auto i = std::size_t{0};
+    if (state.in_block_comment) {
+        i = push(0, block_comment_end(spec, line, 0, content_end, state), TokenType::Comment);
+    } else if (state.open_string != 0) {
+        i = push(0, long_string_end(spec, line, 0, content_end, state), TokenType::StringLiteral);
+    } else if (spec.sections) {
+        const auto first = str::span_blanks(line.data(), sz);
+        if (first < content_end && line[first] == '[') {
+            const auto close = line.find(']', first);
+            i = push(first, close == std::string_view::npos ? content_end : close + 1, TokenType::Namespace);
+        }
+    }
+
+    while (i < content_end) {
+        const auto ch = line[i];
+        const auto cls = class_of(ch);
+        if (cls & Space) {
+            i += std::max(str::span_blanks(line.data() + i, content_end - i), std::size_t{1});
+        } else if (cls & NameBegin) {
+            const auto end = i + str::span_identifier(line.data() + i, content_end - i);
+            if (is_keyword(line.substr(i, end - i))) {
+                i = push(i, end, TokenType::Keyword);
+            } else if (spec.bang_macros && end < content_end && line[end] == '!') {
+                i = push(i, end + 1, TokenType::Macro);
+            } else {
+                i = end;
+            }
+        } else if (cls & Digit) {
+            auto end = i + 1;
+            while (end < content_end && (class_of(line[end]) & NumberPart)) end++;
+            i = push(i, end, TokenType::NumberLiteral);
+        } else if (not(cls & Opener)) {
+            i++;
+        } else if (begins_with(line, i, spec.line_comment)) {
+            push(i, content_end, TokenType::Comment);
+            break;
+        } else if (begins_with(line, i, spec.block_comment_open)) {
+            const auto from = i + spec.block_comment_open.size();
+            i = push(i, block_comment_end(spec, line, from, content_end, state), TokenType::Comment);
+        } else if (auto opened = std::find_if(spec.long_strings.begin(), spec.long_strings.end(),
+                                              [&](auto delimiter) { return begins_with(line, i, delimiter); });
+                   opened != spec.long_strings.end()) {
+            state.open_string = AS(opened - spec.long_strings.begin() + 1, std::uint8_t);
+            const auto from = i + opened->size();
+            i = push(i, long_string_end(spec, line, from, content_end, state), TokenType::StringLiteral);
+        } else if (spec.quotes.find(ch) != std::string_view::npos) {
+            const auto end = string_end(line, i + 1, content_end, std::string_view{&line[i], 1});
+            i = push(i, end == std::string_view::npos ? content_end : end, TokenType::StringLiteral);
+        } else if (ch == spec.directive) {
+            const auto end = i + 1 + str::span_identifier(line.data() + i + 1, content_end - i - 1);
+            state.last_lexed = TokenType::Macro;
+            i = push(i, end, TokenType::Macro);
+        } else if (ch == '<' && state.last_lexed == TokenType::Macro) {
+            const auto close = line.find('>', i);
+            i = close == std::string_view::npos ? i + 1 : push(i, close + 1, TokenType::Include);
+        } else {
+            i++;
+        }
+    }
+}
+
+/// ----------------- REGISTRY -----------------
+
+const GrammarRegistry &GrammarRegistry::get_instance() {
+    static GrammarRegistry registry;
+    return registry;
+}
+
+GrammarRegistry::GrammarRegistry() {
+    grammars[AS(Language::CPP, std::size_t)] = std::make_unique<Grammar>(Language::CPP, "C++", lex_line);
+    for (const auto &spec : grammar_specs) grammars[AS(spec.language, std::size_t)] = std::make_unique<Grammar>(spec);
+}
+
+const Grammar *GrammarRegistry::grammar_for(Language language) const {
+    return grammars[AS(language, std::size_t)].get();
+}
@@ -0,0 +1,93 @@
+//
+// Created by 46769 on 2021-02-14.
+//
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <core/buffer/file_context.hpp>
+#include <core/core.hpp>
+#include <ui/syntax_highlighting.hpp>
+
+/**
+ * How a language is written, for the table driven lexer. Everything it colors, besides keywords, is one of a few kinds
+ * of delimited runs; which covers the languages we highlight, other than C++, which has a lexer of its own.
+ */
+struct GrammarSpec {
+    Language language;
+    std::string_view name;
+    std::span<const std::string_view> keywords{};
+    std::string_view line_comment{};
+    std::string_view block_comment_open{};
+    std::string_view block_comment_close{};
+    /// Characters that begin & end strings, which end with the line if they're not closed on it
+    std::string_view quotes{};
+    /// Delimiters that begin & end strings that may span lines, like Python's """. Tried before quotes
+    std::array<std::string_view, 2> long_strings{};
+    /// Begins a directive, which is colored up to the end of the name after it, like #define in C or @property in
+    /// Python. A <path> after a directive, on its line, is colored as an include path
+    char directive{0};
+    /// Characters a number literal may have after its first digit, besides letters, digits & '.'
+    std::string_view digit_separators{};
+    /// Lines that begin with [ are section headers, up to the ], like the tables of .cxe files
+    bool sections{false};
+    /// A name followed by ! is a macro, like Rust's println!
+    bool bang_macros{false};
+};
+
+/**
+ * What a language is lexed by, one line at a time, see lex_line in syntax_highlighting.hpp. Either a hand written
+ * lexer, or a GrammarSpec compiled into tables when the grammar is constructed:
+ *  - a class per byte, so that the lexer looks at every byte once, and only looks closer at those that may begin a
+ *    comment, string or directive
+ *  - a DFA that recognizes the keywords, one transition per character of a name. Its alphabet is only the bytes that
+ *    the keywords have, so the transition table is states x (a column per such byte + 1) 16-bit states
+ */
+class Grammar {
+public:
+    using LineLexer = void (*)(std::string_view line, std::size_t offset, LineLexState &state,
+                               std::vector<Token> &tokens);
+
+    Grammar(Language language, std::string_view name, LineLexer lexer);
+    explicit Grammar(const GrammarSpec &spec);
+
+    void lex_line(std::string_view line, std::size_t offset, LineLexState &state, std::vector<Token> &tokens) const;
+    [[nodiscard]] bool is_keyword(std::string_view name) const;
+
+    Language language;
+    std::string_view name;
+
+private:
+    GrammarSpec spec{};
+    LineLexer hand_written{nullptr};
+    std::array<std::uint8_t, 256> classes{};
+    std::array<std::uint8_t, 256> keyword_columns{};
+    std::size_t column_count{1};
+    /// transitions[state * column_count + column]. State 0 is dead, state 1 is where every name begins
+    std::vector<std::uint16_t> transitions{};
+    std::vector<bool> accepting{};
+
+    void compile_classes();
+    void compile_keywords();
+    void lex_table_line(std::string_view line, std::size_t offset, LineLexState &state,
+                        std::vector<Token> &tokens) const;
+};
+
+/// The grammar of every Language there is one for. They're all compiled the first time the registry is used, which
+/// App does when it starts. Grammars never change after that, so the highlighter's thread uses them as well
+class GrammarRegistry {
+public:
+    static const GrammarRegistry &get_instance();
+    /// nullptr for Language::PlainText
+    [[nodiscard]] const Grammar *grammar_for(Language language) const;
+
+private:
+    GrammarRegistry();
+    /// Indexed by Language
+    std::array<std::unique_ptr<Grammar>, AS(Language::Config, std::size_t) + 1> grammars{};
+};
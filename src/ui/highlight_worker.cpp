@@ -0,0 +1,173 @@
+//
+// Created by 46769 on 2021-02-13.
+//
+
+#include "highlight_worker.hpp"
+#include <algorithm>
+#include <core/buffer/text_data.hpp>
+#include <ui/grammar.hpp>
+#include <utils/profiler.hpp>
+
+HighlightWorker &HighlightWorker::get_instance() {
+    static HighlightWorker hw;
+    return hw;
+}
+
+HighlightWorker::~HighlightWorker() { stop(); }
+
+void HighlightWorker::start(std::function<void()> on_snapshot_ready) {
+    if (worker.joinable()) return;
+    notify = std::move(on_snapshot_ready);
+    stopping = false;
+    worker = std::thread{[this]() { run(); }};
+}
+
+void HighlightWorker::stop() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) worker.join();
+}
+
+bool HighlightWorker::is_mirrored(int buffer_id) const {
+    return std::any_of(requested.begin(), requested.end(),
+                       [buffer_id](const auto &entry) { return entry.second.buffer_id == buffer_id; });
+}
+
+void HighlightWorker::request(const void *client, TextData *buffer, std::size_t first, std::size_t count) {
+    const auto version = buffer->version();
+    const auto language = buffer->file_context().language;
+    auto changed = buffer->take_changed_range(ChangeListener::Highlighter);
+    auto last = requested.find(client);
+    if (not changed && last != requested.end() && last->second.buffer_id == buffer->id &&
+        last->second.version == version && last->second.language == language && first >= last->second.first_line &&
+        first + count <= last->second.first_line + last->second.line_count) {
+        return;
+    }
+
+    Job job{.client = client, .buffer_id = buffer->id, .version = version, .language = language};
+    if (not is_mirrored(buffer->id) || (changed && changed->second == std::string::npos)) {
+        // the worker has nothing of this buffer, or none of what it has is valid anymore
+        job.edit = Edit{.begin = 0, .tail = 0, .text = buffer->snapshot()};
+    } else if (changed) {
+        auto [begin, end] = *changed;
+        job.edit = Edit{.begin = begin, .tail = buffer->size() - end, .text = buffer->snapshot()};
+    }
+    const auto margin = count * MARGIN_SCREENS;
+    job.first_line = first > margin ? first - margin : 0;
+    job.line_count = first - job.first_line + count + margin;
+
+    std::vector<Job> jobs{};
+    if (last != requested.end() && last->second.buffer_id != buffer->id) {
+        const auto previous = last->second.buffer_id;
+        requested.erase(last);
+        if (not is_mirrored(previous)) jobs.push_back(Job{.buffer_id = previous, .release_buffer = true});
+    }
+    requested[client] = Requested{buffer->id, version, language, job.first_line, job.line_count};
+    jobs.push_back(std::move(job));
+    {
+        std::lock_guard lock{mutex};
+        std::move(jobs.begin(), jobs.end(), std::back_inserter(pending));
+    }
+    wake.notify_one();
+}
+
+std::shared_ptr<const HighlightSnapshot> HighlightWorker::latest(const void *client) const {
+    std::lock_guard lock{mutex};
+    if (auto it = snapshots.find(client); it != snapshots.end()) return it->second;
+    return nullptr;
+}
+
+void HighlightWorker::forget(const void *client) {
+    auto last = requested.find(client);
+    if (last == requested.end()) return;
+    const auto buffer_id = last->second.buffer_id;
+    requested.erase(last);
+    {
+        // queued, & not just erased here, so that a snapshot the worker is busy with, isn't published after this
+        std::lock_guard lock{mutex};
+        pending.push_back(Job{.client = client, .buffer_id = buffer_id, .forget_client = true,
+                              .release_buffer = not is_mirrored(buffer_id)});
+    }
+    wake.notify_one();
+}
+
+void HighlightWorker::apply(Mirror &mirror, const Edit &edit) {
+    if (edit.begin == 0 && edit.tail == 0) {
+        mirror.text = edit.text.to_string();
+        mirror.lines.assign(mirror.text);
+        mirror.lexer.text_changed(mirror.lines, 0, std::string::npos);
+        return;
+    }
+    std::string inserted{};
+    edit.text.copy(edit.begin, edit.text.size() - edit.tail, inserted);
+    const auto removed = mirror.text.size() - edit.tail - edit.begin;
+    mirror.lines.on_remove(edit.begin, removed);
+    mirror.text.replace(edit.begin, removed, inserted);
+    mirror.lines.on_insert(edit.begin, inserted);
+    mirror.lexer.text_changed(mirror.lines, edit.begin, edit.begin + inserted.size());
+}
+
+std::shared_ptr<const HighlightSnapshot> HighlightWorker::highlight(Mirror &mirror, const Job &job) {
+    MICRO_BENCH("HighlightWorker::highlight");
+    auto snapshot = std::make_shared<HighlightSnapshot>();
+    snapshot->buffer_id = job.buffer_id;
+    snapshot->version = job.version;
+    snapshot->revision = ++revision;
+    snapshot->first_line = std::min(job.first_line, mirror.lines.line_count());
+    const auto end_line = std::min(job.first_line + job.line_count, mirror.lines.line_count());
+    for (auto line = snapshot->first_line; line <= end_line; line++) {
+        snapshot->line_begins.push_back(mirror.lines.line_begin(line));
+    }
+    snapshot->spans = mirror.lexer.color_format_lines(mirror.text, mirror.lines, snapshot->first_line,
+                                                      end_line - snapshot->first_line);
+    return snapshot;
+}
+
+void HighlightWorker::run() {
+    prof::Profiler::get_instance().set_thread_name("highlighter");
+    while (true) {
+        std::vector<Job> jobs{};
+        {
+            std::unique_lock lock{mutex};
+            wake.wait(lock, [this]() { return stopping || not pending.empty(); });
+            if (stopping) return;
+            jobs.swap(pending);
+        }
+        // every edit has to be applied, in order, but only the latest request of a client is worth highlighting
+        std::unordered_map<const void *, const Job *> latest_of{};
+        std::vector<const void *> forgotten{};
+        for (const auto &job : jobs) {
+            if (job.forget_client) {
+                latest_of.erase(job.client);
+                forgotten.push_back(job.client);
+            }
+            if (job.release_buffer) mirrors.erase(job.buffer_id);
+            if (job.forget_client || job.release_buffer) continue;
+            if (job.edit) {
+                MICRO_BENCH("HighlightWorker::apply");
+                apply(mirrors[job.buffer_id], *job.edit);
+            }
+            if (auto mirror = mirrors.find(job.buffer_id); mirror != mirrors.end()) {
+                // the same grammar as before, unless the buffer was saved as another kind of file
+                mirror->second.lexer.set_grammar(GrammarRegistry::get_instance().grammar_for(job.language));
+            }
+            latest_of[job.client] = &job;
+        }
+        std::vector<std::pair<const void *, std::shared_ptr<const HighlightSnapshot>>> published{};
+        for (const auto &[client, job] : latest_of) {
+            if (auto mirror = mirrors.find(job->buffer_id); mirror != mirrors.end()) {
+                published.emplace_back(client, highlight(mirror->second, *job));
+            }
+        }
+        {
+            std::lock_guard lock{mutex};
+            // what's published for a forgotten client was requested after it was forgotten, by whatever re-uses it
+            for (auto client : forgotten) snapshots.erase(client);
+            for (auto &[client, snapshot] : published) snapshots[client] = std::move(snapshot);
+        }
+        if (not published.empty() && notify) notify();
+    }
+}
@@ -0,0 +1,132 @@
+//
+// Created by 46769 on 2021-02-13.
+//
+
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <core/buffer/file_context.hpp>
+#include <core/buffer/line_index.hpp>
+#include <core/buffer/text_snapshot.hpp>
+#include <ui/syntax_highlighting.hpp>
+
+class TextData;
+
+/// Color information of some lines of a buffer, as they were at version of it. Never changes once published
+struct HighlightSnapshot {
+    int buffer_id;
+    std::uint64_t version;
+    /// Increases with every snapshot published, of any buffer
+    std::uint64_t revision;
+    std::size_t first_line;
+    /// Where the lines first_line, first_line + 1, ... began in that version, and where the last one ended
+    std::vector<std::size_t> line_begins;
+    /// Sorted, positions are offsets into that version of the buffer
+    std::vector<ColorFormatInfo> spans;
+
+    [[nodiscard]] bool has_line(std::size_t line) const {
+        return line >= first_line && line + 1 < first_line + line_begins.size();
+    }
+    /// Offset of line, relative to which its spans are positioned. line must be one that has_line
+    [[nodiscard]] std::size_t line_begin(std::size_t line) const { return line_begins[line - first_line]; }
+    [[nodiscard]] std::size_t line_end(std::size_t line) const { return line_begins[line - first_line + 1]; }
+};
+
+/**
+ * Lexes buffers on a worker thread, so that the render thread never waits on highlighting. The worker keeps a copy of
+ * every buffer it highlights, which the render thread keeps up to date by handing over a snapshot of the buffer, & what
+ * changed since the last request, see TextData::take_changed_range; the worker copies that out of the snapshot, so the
+ * render thread copies nothing, even when it's the entire buffer. Several requests that pile up while the worker is
+ * busy are lexed once, for the last one.
+ *
+ * What the worker publishes is an immutable snapshot per buffer. The render thread draws with the latest one there is,
+ * which, right after an edit, is of the previous version of the buffer; its colors are placed per line, so the lines
+ * that weren't edited look right even then, and the edited one is right as soon as the next snapshot is published.
+ */
+class HighlightWorker {
+public:
+    static HighlightWorker &get_instance();
+    ~HighlightWorker();
+    HighlightWorker(const HighlightWorker &) = delete;
+    HighlightWorker &operator=(const HighlightWorker &) = delete;
+
+    /// Starts the worker. on_snapshot_ready is called from the worker thread, every time a snapshot is published
+    void start(std::function<void()> on_snapshot_ready);
+    void stop();
+
+    /// Main thread. Asks for lines [first, first + count) of buffer to be highlighted, as it is now, for client (a
+    /// view). Does nothing if the latest request of client already covers those lines, of this version of buffer
+    void request(const void *client, TextData *buffer, std::size_t first, std::size_t count);
+    /// Latest snapshot highlighted for client, or nullptr if there's none yet
+    [[nodiscard]] std::shared_ptr<const HighlightSnapshot> latest(const void *client) const;
+    /// Main thread. Drops what's kept for client, and the copy of its buffer, if no other client shows it
+    void forget(const void *client);
+
+private:
+    HighlightWorker() = default;
+
+    /// What changed in a buffer: [begin, size - tail) of the worker's copy is replaced by [begin, text.size() - tail)
+    /// of text
+    struct Edit {
+        std::size_t begin;
+        std::size_t tail;
+        TextSnapshot text;
+    };
+    struct Job {
+        const void *client{nullptr};
+        int buffer_id{0};
+        std::uint64_t version{0};
+        Language language{Language::PlainText};
+        std::optional<Edit> edit{};
+        std::size_t first_line{0}, line_count{0};
+        /// The client is gone; what's kept for it is dropped, instead of highlighted
+        bool forget_client{false};
+        /// No client shows the buffer anymore; its copy is dropped
+        bool release_buffer{false};
+    };
+    /// The worker's copy of a buffer
+    struct Mirror {
+        std::string text{};
+        LineIndex lines{};
+        IncrementalLexer lexer{};
+    };
+    /// What a client last asked for
+    struct Requested {
+        int buffer_id;
+        std::uint64_t version;
+        Language language;
+        std::size_t first_line, line_count;
+    };
+
+    /// Lines lexed above & below those asked for, so that scrolling a few lines uses what's already been published
+    static constexpr std::size_t MARGIN_SCREENS = 1;
+
+    /// Only touched by the main thread
+    std::unordered_map<const void *, Requested> requested{};
+
+    mutable std::mutex mutex{};
+    std::condition_variable wake{};
+    std::vector<Job> pending{};
+    std::unordered_map<const void *, std::shared_ptr<const HighlightSnapshot>> snapshots{};
+    bool stopping{false};
+
+    /// Only touched by the worker thread
+    std::unordered_map<int, Mirror> mirrors{};
+    std::uint64_t revision{0};
+    std::function<void()> notify{};
+    std::thread worker{};
+
+    [[nodiscard]] bool is_mirrored(int buffer_id) const;
+    void run();
+    static void apply(Mirror &mirror, const Edit &edit);
+    std::shared_ptr<const HighlightSnapshot> highlight(Mirror &mirror, const Job &job);
+};
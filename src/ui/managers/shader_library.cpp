@@ -25,3 +25,6 @@ Shader *ShaderLibrary::get_shader(const std::string &key) {
     }
 }
 Shader *ShaderLibrary::get_text_shader() { return ShaderLibrary::get_instance().get_shader("text"); }
+Shader *ShaderLibrary::get_instanced_text_shader() {
+    return ShaderLibrary::get_instance().get_shader("instanced_text");
+}
@@ -22,6 +22,7 @@ public:
     void load_shader(ShaderConfig cfg);
     [[nodiscard]] Shader *get_shader(const std::string &key);
     [[nodiscard]] static Shader *get_text_shader();
+    [[nodiscard]] static Shader *get_instanced_text_shader();
 
 private:
     ShaderLibrary() = default;
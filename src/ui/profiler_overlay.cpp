@@ -0,0 +1,99 @@
+//
+// Created by 46769 on 2021-02-16.
+//
+
+#include "profiler_overlay.hpp"
+#include <algorithm>
+#include <core/buffer/data_manager.hpp>
+#include <ui/managers/shader_library.hpp>
+#include <ui/render/vertex_buffer.hpp>
+#include <ui/view.hpp>
+#include <utils/profiler.hpp>
+
+namespace ui {
+
+static void push_rect(CursorVAO *vao, float x, float y, float w, float h) {
+    auto &data = vao->vbo->data;
+    data.emplace_back(x, y + h);
+    data.emplace_back(x, y);
+    data.emplace_back(x + w, y);
+    data.emplace_back(x, y + h);
+    data.emplace_back(x + w, y);
+    data.emplace_back(x + w, y + h);
+}
+
+std::unique_ptr<ProfilerOverlay> ProfilerOverlay::create(Matrix projection) {
+    auto text = DataManager::get_instance().create_free_buffer(BufferType::StatusBar);
+    auto overlay = std::make_unique<ProfilerOverlay>();
+    overlay->ui_view = View::create_managed(text, "profiler", WIDTH, GRAPH_HEIGHT, 0, 0);
+    overlay->shader = ShaderLibrary::get_instance().get_shader("cursor");
+    overlay->shader->setup();
+    overlay->shader->setup_fillcolor_ids();
+    const auto bar_memory = gpu_mem_required_for_quads<CursorVertex>(prof::FrameHistory::FRAMES);
+    overlay->bars = CursorVAO::make(GL_ARRAY_BUFFER, bar_memory);
+    overlay->slow_bars = CursorVAO::make(GL_ARRAY_BUFFER, bar_memory);
+    overlay->budget_line = CursorVAO::make(GL_ARRAY_BUFFER, gpu_mem_required_for_quads<CursorVertex>(1));
+    overlay->set_projection(projection);
+    return overlay;
+}
+
+void ProfilerOverlay::set_projection(Matrix projection) {
+    mvp = projection;
+    ui_view->set_projection(projection);
+}
+
+void ProfilerOverlay::draw(int window_width, int window_height) {
+    const auto &frames = prof::Profiler::get_instance().frames();
+    const auto row_advance = ui_view->font->get_row_advance();
+    const auto text_height = row_advance * (2 + STAGES_SHOWN);
+    const auto x = std::max(window_width - WIDTH, 0);
+    const auto top = window_height;
+    const auto graph_bottom = top - text_height - GRAPH_HEIGHT;
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, graph_bottom, WIDTH, text_height + GRAPH_HEIGHT);
+    glClearColor(bg_color.x, bg_color.y, bg_color.z, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    auto output = fmt::format("frame {:.2f}ms - avg {:.2f}ms, max {:.2f}ms of {} frames", frames.last(),
+                              frames.average(), frames.max(), frames.count);
+    const auto stages = std::min(frames.last_frame_stages.size(), AS(STAGES_SHOWN, std::size_t));
+    for (auto i = 0u; i < stages; i++) {
+        const auto &[name, ms] = frames.last_frame_stages[i];
+        output += fmt::format("\n  {:.3f}ms {}", ms, name);
+    }
+    output += "\n'trace <file>' writes a Chrome trace";
+    ui_view->anchor_at(x, top);
+    ui_view->get_text_buffer()->clear();
+    ui_view->get_text_buffer()->insert_str(output);
+    ui_view->draw_statusbar();
+
+    // one bar per frame, the oldest to the left
+    const auto bar_width = AS(WIDTH, float) / AS(prof::FrameHistory::FRAMES, float);
+    const auto pixels_per_ms = AS(GRAPH_HEIGHT, float) / GRAPH_MAX_MS;
+    bars->vbo->data.clear();
+    slow_bars->vbo->data.clear();
+    budget_line->vbo->data.clear();
+    for (auto i = 0u; i < frames.count; i++) {
+        const auto index = (frames.next + prof::FrameHistory::FRAMES - frames.count + i) % prof::FrameHistory::FRAMES;
+        const auto ms = frames.ms[index];
+        const auto bar_x = AS(x, float) + AS(prof::FrameHistory::FRAMES - frames.count + i, float) * bar_width;
+        const auto height = std::min(ms, GRAPH_MAX_MS) * pixels_per_ms;
+        push_rect(ms > BUDGET_MS ? slow_bars.get() : bars.get(), bar_x, AS(graph_bottom, float), bar_width, height);
+    }
+    push_rect(budget_line.get(), AS(x, float), AS(graph_bottom, float) + BUDGET_MS * pixels_per_ms, AS(WIDTH, float),
+              1.0f);
+
+    shader->use();
+    shader->set_projection(mvp);
+    for (auto [vao, color] : {std::pair{bars.get(), bar_color}, std::pair{slow_bars.get(), slow_bar_color},
+                              std::pair{budget_line.get(), budget_color}}) {
+        if (vao->vbo->data.empty()) continue;
+        shader->set_fillcolor(color);
+        vao->flush_and_draw();
+    }
+    glDisable(GL_SCISSOR_TEST);
+}
+
+ProfilerOverlay::~ProfilerOverlay() { util::println("Destroying profiler overlay"); }
+}// namespace ui
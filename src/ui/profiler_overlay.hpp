@@ -0,0 +1,48 @@
+//
+// Created by 46769 on 2021-02-16.
+//
+
+#pragma once
+#include <core/core.hpp>
+#include <core/math/matrix.hpp>
+#include <core/math/vector.hpp>
+#include <memory>
+
+struct CursorVAO;
+class Shader;
+
+namespace ui {
+class View;
+
+/**
+ * The frame times the profiler has recorded, drawn as a bar graph in the top right corner of the window, along with
+ * where the last frame went, by zone. Bars are drawn with the cursor shader, bars of frames over the 60Hz budget in
+ * red, and the text in a View of its own, like StatusBar's.
+ */
+struct ProfilerOverlay {
+    static constexpr auto WIDTH = 480;
+    static constexpr auto GRAPH_HEIGHT = 120;
+    /// The height of a bar that's this many milliseconds, or longer, is the height of the graph
+    static constexpr auto GRAPH_MAX_MS = 33.3f;
+    static constexpr auto BUDGET_MS = 16.7f;
+    /// Zones listed under the graph, the most expensive ones of the last frame
+    static constexpr auto STAGES_SHOWN = 5;
+
+    ~ProfilerOverlay();
+    static std::unique_ptr<ProfilerOverlay> create(Matrix projection);
+    void set_projection(Matrix projection);
+    /// Drawn on top of whatever is in the top right corner of a window of this size
+    void draw(int window_width, int window_height);
+
+    Boxed<View> ui_view;
+    Shader *shader = nullptr;
+    std::unique_ptr<CursorVAO> bars;
+    std::unique_ptr<CursorVAO> slow_bars;
+    std::unique_ptr<CursorVAO> budget_line;
+    Matrix mvp;
+    Vec3f bg_color{0.1f, 0.1f, 0.12f};
+    RGBAColor bar_color{0.3f, 0.8f, 0.4f, 0.9f};
+    RGBAColor slow_bar_color{0.9f, 0.2f, 0.2f, 0.9f};
+    RGBAColor budget_color{0.9f, 0.8f, 0.6f, 0.6f};
+};
+}// namespace ui
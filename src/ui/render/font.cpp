@@ -4,13 +4,16 @@
 
 // App headers
 #include "font.hpp"
+#include <ui/highlight_worker.hpp>
 #include <ui/syntax_highlighting.hpp>
 #include <ui/view.hpp>
 #include <ui/core/layout.hpp>
-#include <core/buffer/std_string_buffer.hpp>
 
 // Sys headers
 #include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
 #include <numeric>
 #include <vector>
 #include <ranges>
@@ -123,6 +126,7 @@ std::unique_ptr<SimpleFont> SimpleFont::setup_font(const std::string &path, int
     font->max_glyph_width = max_glyph_width;
     font->max_glyph_height = max_glyph_height;
     font->size_bearing_difference_max = max_bearing_size_diff;
+    font->upload_glyph_table();
 
     return font;
 }
@@ -130,6 +134,37 @@ std::unique_ptr<SimpleFont> SimpleFont::setup_font(const std::string &path, int
 SimpleFont::SimpleFont(int pixelSize, std::unique_ptr<Texture> &&texture, std::vector<glyph_info> &&glyphs)
     : pixel_size(pixelSize), t(std::move(texture)), glyph_cache(std::move(glyphs)) {}
 
+void SimpleFont::upload_glyph_table() {
+    // std430 layout of the glyph table in instanced_textshader.vs
+    struct GlyphBox {
+        GLfloat u0, v0, u1, v1;
+        GLfloat x, y, w, h;
+    };
+    std::vector<GlyphBox> boxes{};
+    boxes.reserve(glyph_cache.size());
+    for (const auto &glyph : glyph_cache) {
+        boxes.push_back(GlyphBox{.u0 = float(glyph.x0) / float(t->width),
+                                 .v0 = float(glyph.y0) / float(t->height),
+                                 .u1 = float(glyph.x1) / float(t->width),
+                                 .v1 = float(glyph.y1) / float(t->height),
+                                 .x = float(glyph.bearing.x),
+                                 .y = -static_cast<float>(glyph.size.y - glyph.bearing.y),
+                                 .w = float(glyph.x1 - glyph.x0),
+                                 .h = float(glyph.y1 - glyph.y0)});
+    }
+    glGenBuffers(1, &glyph_table);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, glyph_table);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, boxes.size() * sizeof(GlyphBox), boxes.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void SimpleFont::bind_glyph_table() const { glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, glyph_table); }
+
+GLuint SimpleFont::glyph_index(char c) const {
+    auto index = AS(AS(c, unsigned char), GLuint);
+    return index < glyph_cache.size() ? index : AS('?', GLuint);
+}
+
 int SimpleFont::get_row_advance() const { return row_height; }
 
 void SimpleFont::create_vertex_data_in(VAO *vao, ui::View *view, int xPos, int yPos) {
@@ -273,7 +308,7 @@ void SimpleFont::create_vertex_data_in(VAO *vao, ui::View *view, int xPos, int y
     }
 
     if (bufPtr->mark_set) {
-        if (cursor_b.pos == text.size()) cx2 = x;
+        if (cursor_b.pos == AS(text.size(), i64)) cx2 = x;
         // TODO: implement multi-line selection. selecting multiple lines on the backend is super-easy as the data
         //  structure is simply a 1-dimensional stream of characters, displaying it properly isn't as easy
         //  and there are multiple ways to represent this. We can push "quads" to a vector, one per each line
@@ -288,7 +323,7 @@ void SimpleFont::create_vertex_data_in(VAO *vao, ui::View *view, int xPos, int y
 }
 
 void SimpleFont::create_culled_vertex_data_for(ui::View *view, int xPos, int yPos) {
-    // FN_MICRO_BENCH();
+    MICRO_BENCH("SimpleFont::create_culled_vertex_data_for");
     auto text = view->get_text_buffer()->to_string_view();
     auto view_cursor = view->get_cursor();
 
@@ -428,7 +463,7 @@ void SimpleFont::create_culled_vertex_data_for(ui::View *view, int xPos, int yPo
     }
 
     if (bufPtr->mark_set) {
-        if (cursor_b.pos == text.size()) cx2 = x;
+        if (cursor_b.pos == AS(text.size(), i64)) cx2 = x;
         // TODO: implement multi-line selection. selecting multiple lines on the backend is super-easy as the data
         //  structure is simply a 1-dimensional stream of characters, displaying it properly isn't as easy
         //  and there are multiple ways to represent this. We can push "quads" to a vector, one per each line
@@ -446,7 +481,7 @@ void SimpleFont::create_culled_vertex_data_for(ui::View *view, int xPos, int yPo
 void SimpleFont::emplace_colorized_text_gpu_data(VAO *vao, std::string_view text, int xPos, int yPos,
                                                  std::optional<std::vector<ColorizeTextRange>> colorData) {
 
-    // FN_MICRO_BENCH();
+    MICRO_BENCH("SimpleFont::emplace_colorized_text_gpu_data");
 
     vao->vbo->data.clear();
     vao->vbo->data.reserve(gpu_mem_required_for_quads<TextVertex>(text.size()));
@@ -566,244 +601,245 @@ void SimpleFont::add_colorized_text_gpu_data(VAO *vao, std::vector<TextDrawable>
     }
 }
 
-void SimpleFont::create_vertex_data_no_highlighting(ui::View *view, ui::core::ScreenPos startingTopLeftPos) {
-    // FN_MICRO_BENCH();
-    auto buf = view->get_text_buffer();
-    auto character_start = buf->meta_data.line_begins[view->cursor->views_top_line];
-    auto char_end = 0;
-    if(view->cursor->views_top_line + view->lines_displayable >= buf->meta_data.line_begins.size() - 1) {
-        char_end = buf->size();
-    } else {
-        auto end_line = view->cursor->views_top_line + view->lines_displayable;
-        char_end = buf->meta_data.line_begins[end_line+1];
-    }
-    auto total_characters = char_end - character_start;
-    auto reserve = total_characters * 2;
-
-    auto total_text = view->get_text_buffer()->to_string_view();
-    auto view_cursor = view->get_cursor();
-    // TODO(use cy2 for when we select multiple lines): right now only one line can be selected, which is why cy2 is not used
-    GLfloat cx1, cx2, cy1, cy2;
-    auto bufPtr = view->get_text_buffer();
-
-    auto [cursor_a, cursor_b] = bufPtr->get_cursor_rect();
-    int data_index_pos = cursor_a.pos - character_start;
-    int data_index_pos_end = cursor_b.pos - character_start;
+/// Colors of part of a line, relative to where the line begins
+struct LineColorSpan {
+    std::size_t begin, end;
+    Vec3f color;
+};
 
-    view->vao->vbo->data.clear();
-    view->vao->vbo->data.reserve(gpu_mem_required_for_quads<TextVertex>(reserve));
-    auto &store = view->vao->vbo->data;
-    auto[start_x, start_y] = startingTopLeftPos;
-    auto x = start_x;
-    auto y = start_y;
+static std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6u) + (seed >> 2u));
+}
 
-    auto r = 1.0f;
-    auto g = 1.0f;
-    auto b = 1.0f;
+/// What a line looks like; two lines with the same key have the same glyphs
+static std::uint64_t line_key(std::string_view line, const std::vector<LineColorSpan> &spans) {
+    std::uint64_t key = std::hash<std::string_view>{}(line);
+    for (const auto &[begin, end, color] : spans) {
+        key = hash_combine(key, begin);
+        key = hash_combine(key, end);
+        key = hash_combine(key, std::bit_cast<std::uint32_t>(color.x));
+        key = hash_combine(key, std::bit_cast<std::uint32_t>(color.y));
+        key = hash_combine(key, std::bit_cast<std::uint32_t>(color.z));
+    }
+    return key;
+}
 
-    // auto words = text_elements(text);
-    // auto tokens = tokenize(text);
-    // keywords_ranges.reserve(tokens.size());
+static GLuint pack_color(const Vec3f &color) {
+    auto channel = [](GLfloat c) { return AS(std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f), GLuint); };
+    return channel(color.x) | (channel(color.y) << 8u) | (channel(color.z) << 16u) | (0xffu << 24u);
+}
 
-    std::string_view text{total_text.data() + character_start, (unsigned)total_characters};
-    auto pos = character_start;
-    bool have_text = !text.empty();
-    auto xpos = float(x);
-    auto ypos = float(y);
-    if (not have_text) {
-        view_cursor->update_cursor_data(x, y - 6);
-    } else {
-        // TODO(optimization): change so that instead of doing IF-THEN_ELSE inside this for loop for every character
-        //  make it so, that it checks IF we are inside range, then draw the data up until last character, then iterate 1 step
-        //  and check again
-        for (auto c = text.begin(); c != text.end(); c++, pos++, data_index_pos--, data_index_pos_end--) {
-            auto &glyph = this->glyph_cache[*c];
-            if (*c == '\n') {
-                if (data_index_pos == 0) {
-                    if (bufPtr->mark_set) {
-                        cx1 = x;
-                        cy1 = y - 6;
-                    } else {
-                        view_cursor->update_cursor_data(x, y - 6);
-                    }
-                }
-                if (data_index_pos_end == 0) { cx2 = x; }
-                x = start_x;
-                y -= row_height;
-                continue;
-            }
-            xpos = float(x) + glyph.bearing.x;
-            ypos = float(y) - static_cast<float>(glyph.size.y - glyph.bearing.y);
-            auto x0 = float(glyph.x0) / float(t->width);
-            auto x1 = float(glyph.x1) / float(t->width);
-            auto y0 = float(glyph.y0) / float(t->height);
-            auto y1 = float(glyph.y1) / float(t->height);
-            auto w = float(glyph.x1 - glyph.x0);
-            auto h = float(glyph.y1 - glyph.y0);
-            store.emplace_back(xpos, ypos + h, x0, y0, r, g, b);
-            store.emplace_back(xpos, ypos, x0, y1, r, g, b);
-            store.emplace_back(xpos + w, ypos, x1, y1, r, g, b);
-            store.emplace_back(xpos, ypos + h, x0, y0, r, g, b);
-            store.emplace_back(xpos + w, ypos, x1, y1, r, g, b);
-            store.emplace_back(xpos + w, ypos + h, x1, y0, r, g, b);
-            if (data_index_pos == 0) {
-                if (bufPtr->mark_set) {
-                    cx1 = x;
-                    cy1 = y - 6;
-                } else {
-                    view_cursor->update_cursor_data(xpos, y - 6);
-                }
-            }
-            if (data_index_pos_end == 0) { cx2 = x; }
-            x += glyph.advance;
+/// Glyphs of line (without its newline), laid out from where the line's baseline begins, at (0, 0). Glyphs without a
+/// bitmap, like space, only advance the pen
+static void build_line_glyphs(const SimpleFont &font, std::string_view line, const std::vector<LineColorSpan> &spans,
+                              std::vector<GlyphInstance> &store) {
+    store.reserve(line.size());
+    auto span = spans.begin();
+    auto x = 0;
+    for (auto i = 0u; i < line.size(); i++) {
+        while (span != spans.end() && span->end <= i) span++;
+        auto index = font.glyph_index(line[i]);
+        auto &glyph = font.glyph_cache[index];
+        if (glyph.x1 > glyph.x0 && glyph.y1 > glyph.y0) {
+            // default text color where there's no syntax color
+            auto color = (span != spans.end() && span->begin <= i) ? span->color : WHITE;
+            store.push_back(GlyphInstance{.x = float(x), .y = 0.0f, .glyph = index, .color = pack_color(color)});
         }
+        x += glyph.advance;
     }
+}
 
-    if (bufPtr->mark_set) {
-        if (cursor_b.pos == text.size()) cx2 = x;
-        // TODO: implement multi-line selection. selecting multiple lines on the backend is super-easy as the data
-        //  structure is simply a 1-dimensional stream of characters, displaying it properly isn't as easy
-        //  and there are multiple ways to represent this. We can push "quads" to a vector, one per each line
-        //  or we can do like in some editors and not have the "selection" visualization at all, but just leave kind of like
-        //  an empty [] half-transparent marker where the selection begins (kind of like how 4coder does it)
-        view_cursor->set_line_rect(cx1, cx2, cy1);
-    } else if (view->get_text_buffer()->get_cursor_pos() == view->get_text_buffer()->size()) {
-        xpos = float(x);
-        ypos = float(y);
-        view_cursor->update_cursor_data(xpos, y - 6);
-    }
+void SimpleFont::create_vertex_data_no_highlighting(ui::View *view, ui::core::ScreenPos startingTopLeftPos) {
+    create_line_cached_glyphs(view, startingTopLeftPos, false);
 }
 
+void SimpleFont::create_vertex_data_for_syntax(ui::View *view, ui::core::ScreenPos startingTopLeftPos) {
+    create_line_cached_glyphs(view, startingTopLeftPos, true);
+}
 
-void SimpleFont::create_vertex_data_for_syntax(ui::View* view, const ui::core::ScreenPos startingTopLeftPos) {
-    // FN_MICRO_BENCH();
+void SimpleFont::create_line_cached_glyphs(ui::View *view, ui::core::ScreenPos startingTopLeftPos, bool highlight) {
+    MICRO_BENCH("SimpleFont::create_line_cached_glyphs");
     auto buf = view->get_text_buffer();
-    auto character_start = buf->meta_data.line_begins[view->cursor->views_top_line];
-    auto char_end = 0;
-    if(view->cursor->views_top_line + view->lines_displayable >= buf->meta_data.line_begins.size() - 1) {
-        char_end = buf->size();
-    } else {
-        auto end_line = view->cursor->views_top_line + view->lines_displayable;
-        char_end = buf->meta_data.line_begins[end_line+1];
+    auto &cache = view->line_cache;
+    auto [start_x, start_y] = startingTopLeftPos;
+    // lexing happens on the highlighter's thread; what we draw with is the latest it has published, which may be of
+    // an older version of the buffer. The lines are re-built when a newer one is published
+    auto &highlighter = HighlightWorker::get_instance();
+    std::shared_ptr<const HighlightSnapshot> snapshot{nullptr};
+    if (highlight) {
+        highlighter.request(view, buf, view->cursor->views_top_line, view->lines_displayable + 1);
+        snapshot = highlighter.latest(view);
+        if (snapshot && snapshot->buffer_id != buf->id) snapshot = nullptr;
     }
-    auto total_characters = char_end - character_start;
-    auto reserve = total_characters * 2;
-
-    auto total_text = view->get_text_buffer()->to_string_view();
-    auto view_cursor = view->get_cursor();
-    // TODO(use cy2 for when we select multiple lines): right now only one line can be selected, which is why cy2 is not used
-    GLfloat cx1, cx2, cy1, cy2;
-    auto bufPtr = view->get_text_buffer();
-
-    auto [cursor_a, cursor_b] = bufPtr->get_cursor_rect();
-    int data_index_pos = cursor_a.pos - character_start;
-    int data_index_pos_end = cursor_b.pos - character_start;
-
-    view->vao->vbo->data.clear();
-    view->vao->vbo->data.reserve(gpu_mem_required_for_quads<TextVertex>(reserve));
-    auto &store = view->vao->vbo->data;
-    auto[start_x, start_y] = startingTopLeftPos;
-    auto x = start_x;
-    auto y = start_y;
-
-    auto r = 1.0f;
-    auto g = 1.0f;
-    auto b = 1.0f;
-
-    // auto words = text_elements(text);
-    // auto tokens = tokenize(text);
-    // keywords_ranges.reserve(tokens.size());
+    const auto revision = snapshot ? snapshot->revision : 0;
+    // when only the cursor has moved, the lines on screen are what they were last time, and so are their glyphs
+    const bool same_lines = cache.valid && cache.text_version == buf->version() &&
+                            cache.top_line == view->cursor->views_top_line &&
+                            cache.rows_displayable == view->lines_displayable && cache.origin_x == start_x &&
+                            cache.origin_y == start_y && cache.highlighted == highlight &&
+                            cache.highlight_revision == revision;
+    if (not same_lines) update_line_glyphs(view, startingTopLeftPos, highlight, snapshot.get());
+    place_cursor(view, startingTopLeftPos);
+    buf->mark_pristine();
+}
 
-    std::string_view text{total_text.data() + character_start, (unsigned)total_characters};
-    auto formatted_tokens = color_format_tokenize_range(total_text.data() + character_start, total_characters, character_start);
-    auto item_it = formatted_tokens.begin();
-    auto pos = character_start;
-    bool have_text = !text.empty();
-    auto xpos = float(x);
-    auto ypos = float(y);
-    if (not have_text) {
-        view_cursor->update_cursor_data(x, y - 6);
-    } else {
-        // TODO(optimization): change so that instead of doing IF-THEN_ELSE inside this for loop for every character
-        //  make it so, that it checks IF we are inside range, then draw the data up until last character, then iterate 1 step
-        //  and check again
-        for (auto c = text.begin(); c != text.end(); c++, pos++, data_index_pos--, data_index_pos_end--) {
-            if (item_it != formatted_tokens.end()) {
-                auto &kw = *item_it;
-                auto [begin, end, col] = *item_it;
-                if (pos > end) {
-                    item_it++;
-                    if (item_it != formatted_tokens.end()) {
-                        begin = item_it->begin;
-                        end = item_it->end;
-                        col = item_it->color;
-                    }
-                }
-                if (pos >= begin && pos < end) {// handled syntax color
-                    r = col.x;
-                    g = col.y;
-                    b = col.z;
-                } else {// default text color
-                    r = 1;
-                    g = 1;
-                    b = 1;
-                }
-                if (pos >= end && item_it != formatted_tokens.end()) item_it++;
-            }
-            auto &glyph = this->glyph_cache[*c];
-            if (*c == '\n') {
-                if (data_index_pos == 0) {
-                    if (bufPtr->mark_set) {
-                        cx1 = x;
-                        cy1 = y - 6;
-                    } else {
-                        view_cursor->update_cursor_data(x, y - 6);
-                    }
-                }
-                if (data_index_pos_end == 0) { cx2 = x; }
-                x = start_x;
-                y -= row_height;
-                continue;
+void SimpleFont::update_line_glyphs(ui::View *view, ui::core::ScreenPos startingTopLeftPos, bool highlight,
+                                    const HighlightSnapshot *snapshot) {
+    auto buf = view->get_text_buffer();
+    auto &cache = view->line_cache;
+    const auto top = view->cursor->views_top_line;
+    auto [start_x, start_y] = startingTopLeftPos;
+
+    auto character_start = buf->meta_data.line_begin(top);
+    // line_begin of a line past the last one, is the end of the buffer
+    auto char_end = buf->meta_data.line_begin(top + view->lines_displayable + 1);
+    // only the displayed range needs to be contiguous, the rest of the buffer stays wherever the backend keeps it
+    auto text = buf->view_range(character_start, char_end - character_start);
+
+    std::vector<std::uint64_t> rows{};
+    rows.reserve(cache.rows.size());
+    // element references of an unordered_map stay valid when it grows
+    std::vector<const std::vector<GlyphInstance> *> row_glyphs{};
+    row_glyphs.reserve(cache.rows.size());
+    std::size_t glyph_count = 0;
+    std::vector<LineColorSpan> spans{};
+    auto line_number = AS(top, std::size_t);
+    for (std::size_t line_start = 0; line_start < text.size(); line_number++) {
+        const auto line = text.substr(line_start, std::min(text.find('\n', line_start), text.size()) - line_start);
+        const auto line_end = line_start + line.size();
+        spans.clear();
+        if (highlight && snapshot && snapshot->has_line(line_number)) {
+            // placed by where the line began in the snapshot's version, so that edits above it don't shift its colors
+            const auto begin = snapshot->line_begin(line_number);
+            const auto end = snapshot->line_end(line_number);
+            auto it = std::partition_point(snapshot->spans.begin(), snapshot->spans.end(),
+                                           [begin](const auto &span) { return span.end <= begin; });
+            for (; it != snapshot->spans.end() && it->begin < end; it++) {
+                spans.push_back(LineColorSpan{.begin = std::max(it->begin, begin) - begin,
+                                              .end = std::min(it->end, end) - begin,
+                                              .color = it->color});
             }
-            xpos = float(x) + glyph.bearing.x;
-            ypos = float(y) - static_cast<float>(glyph.size.y - glyph.bearing.y);
-            auto x0 = float(glyph.x0) / float(t->width);
-            auto x1 = float(glyph.x1) / float(t->width);
-            auto y0 = float(glyph.y0) / float(t->height);
-            auto y1 = float(glyph.y1) / float(t->height);
-            auto w = float(glyph.x1 - glyph.x0);
-            auto h = float(glyph.y1 - glyph.y0);
-            store.emplace_back(xpos, ypos + h, x0, y0, r, g, b);
-            store.emplace_back(xpos, ypos, x0, y1, r, g, b);
-            store.emplace_back(xpos + w, ypos, x1, y1, r, g, b);
-            store.emplace_back(xpos, ypos + h, x0, y0, r, g, b);
-            store.emplace_back(xpos + w, ypos, x1, y1, r, g, b);
-            store.emplace_back(xpos + w, ypos + h, x1, y0, r, g, b);
-            if (data_index_pos == 0) {
-                if (bufPtr->mark_set) {
-                    cx1 = x;
-                    cy1 = y - 6;
-                } else {
-                    view_cursor->update_cursor_data(xpos, y - 6);
-                }
+        }
+        const auto key = line_key(line, spans);
+        auto [entry, inserted] = cache.lines.try_emplace(key);
+        if (inserted) build_line_glyphs(*this, line, spans, entry->second);
+        rows.push_back(key);
+        row_glyphs.push_back(&entry->second);
+        glyph_count += entry->second.size();
+        line_start = line_end + 1;
+    }
+
+    if (not cache.valid || rows != cache.rows) {
+        // straight into the GPU visible segment that's drawn from now on, see GlyphVAO
+        MICRO_BENCH("GlyphVAO::upload");
+        auto out = view->glyph_vao->map_next(glyph_count);
+        auto y = start_y;
+        for (const auto glyphs : row_glyphs) {
+            for (auto glyph : *glyphs) {
+                glyph.x += AS(start_x, float);
+                glyph.y += AS(y, float);
+                *out++ = glyph;
             }
-            if (data_index_pos_end == 0) { cx2 = x; }
-            x += glyph.advance;
+            y -= row_height;
         }
+        view->glyph_vao->commit();
     }
 
-    if (bufPtr->mark_set) {
-        if (cursor_b.pos == text.size()) cx2 = x;
+    cache.rows = std::move(rows);
+    cache.valid = true;
+    cache.text_version = buf->version();
+    cache.top_line = top;
+    cache.rows_displayable = view->lines_displayable;
+    cache.origin_x = start_x;
+    cache.origin_y = start_y;
+    cache.highlighted = highlight;
+    cache.highlight_revision = snapshot ? snapshot->revision : 0;
+    if (cache.lines.size() > LineGlyphCache::MAX_CACHED_LINES) {
+        // keep what's on screen, the rest is whatever has been scrolled past
+        decltype(cache.lines) displayed{};
+        for (const auto key : cache.rows) {
+            if (auto it = cache.lines.find(key); it != cache.lines.end()) displayed.insert(cache.lines.extract(it));
+        }
+        cache.lines = std::move(displayed);
+    }
+}
+
+void SimpleFont::place_cursor(ui::View *view, ui::core::ScreenPos startingTopLeftPos) {
+    auto buf = view->get_text_buffer();
+    auto view_cursor = view->get_cursor();
+    const auto top = view_cursor->views_top_line;
+    auto [start_x, start_y] = startingTopLeftPos;
+    struct Caret {
+        GLfloat x, glyph_x, y;
+    };
+    // x of where the character at pos begins, and of where its glyph begins, or nothing if pos is not on screen
+    auto measure = [&](std::size_t pos) -> std::optional<Caret> {
+        auto line = buf->meta_data.line_of(pos);
+        if (line < top || line > top + view->lines_displayable) return {};
+        auto line_begin = buf->meta_data.line_begin(line);
+        auto col = pos - line_begin;
+        auto text = buf->view_range(line_begin, col + 1);
+        auto x = start_x;
+        for (auto c : text.substr(0, col)) x += glyph_cache[glyph_index(c)].advance;
+        auto glyph_x = float(x);
+        if (text.size() > col && text[col] != '\n') glyph_x += glyph_cache[glyph_index(text[col])].bearing.x;
+        return Caret{float(x), glyph_x, float(start_y - (line - top) * row_height - 6)};
+    };
+    auto placed = false;
+
+    if (buf->mark_set) {
+        auto [cursor_a, cursor_b] = buf->get_cursor_rect();
         // TODO: implement multi-line selection. selecting multiple lines on the backend is super-easy as the data
         //  structure is simply a 1-dimensional stream of characters, displaying it properly isn't as easy
         //  and there are multiple ways to represent this. We can push "quads" to a vector, one per each line
         //  or we can do like in some editors and not have the "selection" visualization at all, but just leave kind of like
         //  an empty [] half-transparent marker where the selection begins (kind of like how 4coder does it)
-        view_cursor->set_line_rect(cx1, cx2, cy1);
-    } else if (view->get_text_buffer()->get_cursor_pos() == view->get_text_buffer()->size()) {
-        xpos = float(x);
-        ypos = float(y);
-        view_cursor->update_cursor_data(xpos, y - 6);
+        auto begin = measure(AS(cursor_a.pos, std::size_t));
+        auto end = measure(AS(cursor_b.pos, std::size_t));
+        if (begin && end) {
+            view_cursor->set_line_rect(begin->x, end->x, begin->y);
+            placed = true;
+        }
+    } else if (auto caret = measure(buf->get_cursor_pos()); caret) {
+        view_cursor->update_cursor_data(caret->glyph_x, caret->y);
+        placed = true;
+    }
+
+    // the matches, a rect per line that they are on
+    view_cursor->clear_matches();
+    for (const auto &match : view->matches_on_screen()) {
+        for (auto from = match.begin; from < match.end;) {
+            const auto &meta = buf->meta_data;
+            auto line = AS(meta.line_of(from), std::size_t);
+            // at its newline, when it has one
+            auto line_end = line + 1 < meta.line_count() ? meta.line_begin(line + 1) - 1 : buf->size();
+            auto to = std::min(match.end, line_end);
+            if (auto begin = measure(from), end = measure(to); begin && end) {
+                auto right = std::max(end->x, begin->x + AS(view_cursor->width, GLfloat));
+                view_cursor->add_match_rect(begin->x, right, begin->y);
+            }
+            // past the newline, to the next line
+            from = to + 1;
+        }
+    }
+
+    const auto &extras = buf->get_extra_cursors();
+    if (extras.empty()) return;
+    // what's there is the primary cursor's from before, when it's not on screen anymore
+    if (not placed) view_cursor->cursor_data->vbo->data.clear();
+    // the others are in the order of the text, so the ones on screen are one run of them
+    const auto first = buf->meta_data.line_begin(top);
+    const auto last = buf->meta_data.line_begin(top + view->lines_displayable + 1);
+    auto it = std::partition_point(extras.begin(), extras.end(),
+                                   [first](const auto &s) { return AS(s.pos, std::size_t) < first; });
+    for (; it != extras.end() && AS(it->pos, std::size_t) <= last; ++it) {
+        if (it->empty()) {
+            if (auto caret = measure(AS(it->pos, std::size_t)); caret) {
+                view_cursor->add_rect(caret->glyph_x, caret->glyph_x + AS(view_cursor->width, GLfloat), caret->y);
+            }
+        } else if (auto begin = measure(it->begin()), end = measure(it->end()); begin && end && begin->y == end->y) {
+            view_cursor->add_rect(begin->x, end->x, begin->y);
+        }
     }
 }
 
@@ -816,13 +852,12 @@ void SimpleFont::create_vertex_data_for_only_visible(ui::View *view, ui::core::S
     assert(row_height == view->font->get_row_advance());
     auto total_text = view->get_text_buffer()->to_string_view();
 
-    if(view->get_text_buffer()->meta_data.line_begins.size() > total_lines) {
+    if(view->get_text_buffer()->meta_data.line_count() > AS(total_lines, std::size_t)) {
         for(auto i = std::max(top_line, 1); i <= bottom_line; i++) {
-            if(((StdStringBuffer*)buf)->store[buf->meta_data.line_begins[i]-1] != '\n') {
-                util::println("{}", ((StdStringBuffer*)buf)->store[buf->meta_data.line_begins[i]]);
+            if(total_text[buf->meta_data.line_begin(i)-1] != '\n') {
+                util::println("{}", total_text[buf->meta_data.line_begin(i)]);
             }
         }
-        auto total_text = view->get_text_buffer()->to_string_view();
         auto view_cursor = view->get_cursor();
         // TODO(use cy2 for when we select multiple lines): right now only one line can be selected, which is why cy2 is not used
         GLfloat cx1, cx2, cy1, cy2;
@@ -832,8 +867,8 @@ void SimpleFont::create_vertex_data_for_only_visible(ui::View *view, ui::core::S
         int data_index_pos = cursor_a.pos;
         int data_index_pos_end = cursor_b.pos;
 
-        auto char_range_offset = view->get_text_buffer()->meta_data.line_begins[top_line];
-        auto char_range_end = view->get_text_buffer()->meta_data.line_begins[bottom_line+1];
+        auto char_range_offset = view->get_text_buffer()->meta_data.line_begin(top_line);
+        auto char_range_end = view->get_text_buffer()->meta_data.line_begin(bottom_line+1);
         auto characters_total = char_range_end - char_range_offset;
 
         view->vao->vbo->data.clear();
@@ -932,7 +967,7 @@ void SimpleFont::create_vertex_data_for_only_visible(ui::View *view, ui::core::S
         }
 
         if (bufPtr->mark_set) {
-            if (cursor_b.pos == text.size()) cx2 = x;
+            if (cursor_b.pos == AS(text.size(), i64)) cx2 = x;
             // TODO: implement multi-line selection. selecting multiple lines on the backend is super-easy as the data
             //  structure is simply a 1-dimensional stream of characters, displaying it properly isn't as easy
             //  and there are multiple ways to represent this. We can push "quads" to a vector, one per each line
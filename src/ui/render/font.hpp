@@ -4,8 +4,11 @@
 
 #pragma once
 #include <array>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <map>
 
@@ -23,6 +26,7 @@ namespace core {
 }
 class View;
 }// namespace ui
+struct HighlightSnapshot;
 
 struct SyntaxColor {
     GLfloat r{0.0f}, g{0.0f}, b{0.0f};
@@ -55,22 +59,6 @@ constexpr auto WHITE            = Vec3f{1.0f, 1.0f, 1.0f};
 constexpr auto GRAY             = Vec3f{0.5f, 0.5f, 0.5f};
 constexpr auto LIGHT_GRAY       = Vec3f{0.65f, 0.65f, 0.65f};
 
-using HighLight = std::pair<const char *, Vec3f>;
-constexpr std::array keywords{mp("int", c_keyword),        mp("bool", c_keyword),      mp("void", c_keyword),
-                              mp("long", c_keyword),       mp("double", c_keyword),    mp("float", c_keyword),
-                              mp("struct", c_keyword),     mp("using", c_keyword),     mp("const", c_keyword),
-                              mp("char", c_keyword),       mp("constexpr", c_keyword), mp("auto", c_keyword),
-                              mp("this", c_keyword),       mp("static", c_keyword),    mp("class", c_keyword),
-                              mp("public", c_keyword),     mp("private", c_keyword),   mp("protected", c_keyword),
-                              mp("unsigned", c_keyword),   mp("signed", c_keyword),    mp("mutable", c_keyword),
-                              mp("volatile", c_keyword),   mp("return", c_keyword),    mp("signed", c_keyword),
-                              mp("nullptr", c_keyword),    mp("final", c_keyword),     mp("virtual", c_keyword),
-                              mp("override", c_keyword),   mp("true", c_keyword),      mp("false", c_keyword),
-                              mp("if", c_keyword),         mp("else", c_keyword),      mp("namespace", c_keyword),
-                              mp("friend", c_keyword),     mp("operator", c_keyword),  mp("explicit", c_keyword),
-                              mp("#define", YELLOW),       mp("#include", YELLOW),     mp("sizeof", c_keyword),
-                              mp("static_cast", c_keyword)};
-
 constexpr std::array highlight{RED, GREEN, BLUE, YELLOW, WHITE};
 // clang-format on
 
@@ -101,6 +89,42 @@ struct TextDrawable {
 };
 
 using OptionalColData = std::optional<std::vector<ColorizeTextRange>>;
+
+/**
+ * The glyph instances of the lines a View displays, built once per line and kept for as long as the line looks the
+ * same. Lines are keyed by a hash of their text & colors, and their glyphs are laid out relative to the line's own
+ * origin, which means a line that scrolls, or moves down because a line above it was added, doesn't have to be built
+ * again.
+ *
+ * rows are the keys of the lines the View's glyph stream holds right now. When the text changed, but those lines
+ * didn't, nothing is written to the stream, and when only the cursor moved, the lines aren't even looked at.
+ */
+struct LineGlyphCache {
+    static constexpr std::size_t MAX_CACHED_LINES = 4096;
+
+    std::unordered_map<std::uint64_t, std::vector<GlyphInstance>> lines{};
+    std::vector<std::uint64_t> rows{};
+    bool valid{false};
+    std::uint64_t text_version{0};
+    int top_line{0};
+    int rows_displayable{0};
+    int origin_x{0}, origin_y{0};
+    bool highlighted{false};
+    /// HighlightSnapshot::revision the lines were colored with, 0 when there was none
+    std::uint64_t highlight_revision{0};
+
+    /// The next draw re-builds all of the View's instance data
+    void invalidate() {
+        valid = false;
+        rows.clear();
+    }
+    /// Drops the lines as well, they're only valid for the font they were built with
+    void clear() {
+        invalidate();
+        lines.clear();
+    }
+};
+
 class SimpleFont {
 public:
     static SyntaxColor colors[8];
@@ -113,6 +137,10 @@ public:
     SimpleFont(int pixelSize, std::unique_ptr<Texture> &&texture, std::vector<glyph_info> &&glyphs);
 
     void create_vertex_data_in(VAO *vao, ui::View *view, int xpos, int ypos);
+    /// Makes the glyph table the instanced text shader reads glyph boxes from, the table of this font
+    void bind_glyph_table() const;
+    /// Index of c in glyph_cache (and the glyph table), '?' for characters the font wasn't set up with
+    [[nodiscard]] GLuint glyph_index(char c) const;
     void create_culled_vertex_data_for(ui::View *view, int xpos, int ypos);
 
     void emplace_colorized_text_gpu_data(VAO *vao, std::string_view text, int xPos, int yPos,
@@ -122,6 +150,8 @@ public:
     int calculate_text_width(std::string_view str);
 
     std::unique_ptr<Texture> t{nullptr};
+    /// Shader storage buffer with where each glyph is in the atlas, and how its quad is placed, see upload_glyph_table
+    GLuint glyph_table{0};
     [[nodiscard]] int get_row_advance() const;
     std::vector<glyph_info> glyph_cache;
     int row_height;
@@ -129,6 +159,8 @@ public:
     int max_glyph_height;
     int size_bearing_difference_max;
 
+    /// These write the glyph instances of the lines pView displays to its glyph stream, through its LineGlyphCache,
+    /// unless they're the same as last time
     void create_vertex_data_for_syntax(ui::View *pView, ui::core::ScreenPos startingTopLeftPos);
     void create_vertex_data_no_highlighting(ui::View *pView, ui::core::ScreenPos startingTopLeftPos);
 
@@ -137,4 +169,11 @@ public:
 private:
     // glyph_info* data = info;
     int pixel_size{};
+
+    void create_line_cached_glyphs(ui::View *view, ui::core::ScreenPos startingTopLeftPos, bool highlight);
+    void update_line_glyphs(ui::View *view, ui::core::ScreenPos startingTopLeftPos, bool highlight,
+                            const HighlightSnapshot *snapshot);
+    void upload_glyph_table();
+    /// Moves the caret (or the selection) of view to where the cursor is, by measuring the line it's on
+    void place_cursor(ui::View *view, ui::core::ScreenPos startingTopLeftPos);
 };
\ No newline at end of file
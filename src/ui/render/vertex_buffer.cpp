@@ -3,6 +3,7 @@
 //
 
 #include "vertex_buffer.hpp"
+#include <GLFW/glfw3.h>
 #include <core/core.hpp>
 
 std::unique_ptr<TextVertexBufferObject> TextVertexBufferObject::create(GLuint vboId, GLenum type,
@@ -21,6 +22,7 @@ TextVertexBufferObject::TextVertexBufferObject(GLuint id, GLenum bufferType, Loc
 void TextVertexBufferObject::bind() { glBindBuffer(this->type, this->id); }
 
 int TextVertexBufferObject::upload_to_gpu(bool clear_on_upload) {
+    MICRO_BENCH("TextVertexBufferObject::upload_to_gpu");
     auto vertices = data.size();
     if(vertices == 0) {
         reserve_gpu_memory(1024);
@@ -107,6 +109,132 @@ VAO::VAO(GLuint VAO_ID, std::unique_ptr<TextVertexBufferObject>&& VBO) : vao_id(
 
 }
 
+/// ------------------------------------ GLYPHS ------------------------------------
+
+// glBufferStorage is GL 4.4 (or ARB_buffer_storage), which our 4.3 loader doesn't know of
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+using BufferStorageFn = void(APIENTRYP)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+/// glBufferStorage, or nullptr if the driver doesn't have it
+static BufferStorageFn buffer_storage() {
+    static auto fn = glfwExtensionSupported("GL_ARB_buffer_storage")
+                             ? reinterpret_cast<BufferStorageFn>(glfwGetProcAddress("glBufferStorage"))
+                             : nullptr;
+    return fn;
+}
+
+std::unique_ptr<GlyphVAO> GlyphVAO::make(usize reservedInstances) {
+    auto vao = std::make_unique<GlyphVAO>();
+    glGenVertexArrays(1, &vao->vao_id);
+    vao->allocate(std::max<usize>(reservedInstances, 1024));
+    return vao;
+}
+
+void GlyphVAO::allocate(usize instances_per_segment) {
+    glBindVertexArray(vao_id);
+    if (vbo_id != 0) {
+        // GL keeps the old buffer alive for as long as draws in flight use it
+        glDeleteBuffers(1, &vbo_id);
+    }
+    for (auto &fence : fences) {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    segment_capacity = instances_per_segment;
+    const auto bytes = AS(SEGMENTS * segment_capacity * sizeof(GlyphInstance), GLsizeiptr);
+    glGenBuffers(1, &vbo_id);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
+    mapped = nullptr;
+    if (auto storage = buffer_storage(); storage != nullptr) {
+        constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        storage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+        mapped = static_cast<GlyphInstance *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    }
+    persistent = mapped != nullptr;
+
+    // every attribute is per instance, the shader picks the corner of the quad from gl_VertexID
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void *) offsetof(GlyphInstance, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(GlyphInstance), (void *) offsetof(GlyphInstance, glyph));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    // the 4 bytes of the packed color, normalized to [0, 1]
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GlyphInstance),
+                          (void *) offsetof(GlyphInstance, color));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+GlyphVAO::~GlyphVAO() {
+    for (auto fence : fences) {
+        if (fence != nullptr) glDeleteSync(fence);
+    }
+    glDeleteBuffers(1, &vbo_id);
+    glDeleteVertexArrays(1, &vao_id);
+}
+
+void GlyphVAO::bind_all() {
+    glBindVertexArray(vao_id);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
+}
+
+void GlyphVAO::wait_for(int segment) {
+    auto &fence = fences[segment];
+    if (fence == nullptr) return;
+    MICRO_BENCH("GlyphVAO::wait_for");
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+GlyphInstance *GlyphVAO::map_next(std::size_t count) {
+    // a new buffer is empty, but whatever was drawn is about to be replaced by what's written now anyway
+    if (count > segment_capacity) allocate(count * 2);
+    written_segment = (drawn_segment + 1) % SEGMENTS;
+    written_count = count;
+    wait_for(written_segment);
+    const auto first = written_segment * segment_capacity;
+    if (persistent) return mapped + first;
+    // mapping nothing is an error
+    if (count == 0) return nullptr;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    return static_cast<GlyphInstance *>(glMapBufferRange(GL_ARRAY_BUFFER, AS(first * sizeof(GlyphInstance), GLintptr),
+                                                         AS(count * sizeof(GlyphInstance), GLsizeiptr), flags));
+}
+
+void GlyphVAO::commit() {
+    if (not persistent && written_count > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    drawn_segment = written_segment;
+    last_items_rendered = AS(written_count, int);
+}
+
+void GlyphVAO::draw() {
+    bind_all();
+    if (last_items_rendered > 0) {
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, last_items_rendered,
+                                          AS(drawn_segment * segment_capacity, GLuint));
+    }
+    // the segment can't be written again until the GPU is done with this draw
+    auto &fence = fences[drawn_segment];
+    if (fence != nullptr) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
 /// ------------------------------------ CURSOR ------------------------------------
 
 CursorVertexBufferObject::CursorVertexBufferObject(GLuint id, GLenum bufferType,
@@ -124,6 +252,7 @@ std::unique_ptr<CursorVertexBufferObject> CursorVertexBufferObject::create(GLuin
 }
 void CursorVertexBufferObject::bind() { glBindBuffer(this->type, this->id); }
 int CursorVertexBufferObject::upload_to_gpu(bool clear_on_upload) {
+    MICRO_BENCH("CursorVertexBufferObject::upload_to_gpu");
     auto vertices = data.size();
     glBufferSubData(GL_ARRAY_BUFFER, 0, this->data.size() * sizeof(CursorVertex), data.data());
     if (clear_on_upload) { data.clear(); }
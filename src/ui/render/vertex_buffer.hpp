@@ -4,6 +4,7 @@
 
 #pragma once
 #include <glad/glad.h>
+#include <array>
 #include <memory>
 #include <string>
 #include <vector>
@@ -19,6 +20,15 @@ struct TextVertex {
     GLfloat r{}, g{}, b{};
 };
 
+/// One glyph, which the instanced text shader expands into a quad, using the glyph table of the font. x, y is the pen
+/// position, on the baseline. 16 bytes, instead of the 6 TextVertex (168 bytes) a quad takes
+struct GlyphInstance {
+    GLfloat x{}, y{};
+    GLuint glyph{};
+    /// RGBA8, r in the lowest byte, which is the byte order the shader reads it in
+    GLuint color{};
+};
+
 template<typename T>
 constexpr auto gpu_mem_required_for_quads(std::size_t quads) -> std::size_t {
     return sizeof(T) * 6 * quads;
@@ -94,4 +104,42 @@ struct VAO {
     GLuint vao_id;
     std::unique_ptr<TextVertexBufferObject> vbo;
     int last_items_rendered{};
+};
+
+/**
+ * VAO variant for instanced glyph rendering, one GlyphInstance per glyph, drawn as 6 vertices per instance.
+ *
+ * The instances are streamed through a ring of SEGMENTS segments of one buffer. Whoever builds them writes straight
+ * into the mapped segment, there's no local copy to upload from, and a segment is only written again once the fence
+ * placed after the last draw from it has signaled. So the CPU never waits on the GPU, unless the GPU is SEGMENTS - 1
+ * frames behind, and the driver never has to sync, or orphan, behind our back.
+ *
+ * Where ARB_buffer_storage is supported, the buffer is mapped once, persistently. Otherwise, each segment is mapped
+ * when it's written, unsynchronized, relying on the same fences.
+ */
+struct GlyphVAO {
+    static constexpr auto SEGMENTS = 3;
+    ~GlyphVAO();
+    static std::unique_ptr<GlyphVAO> make(usize reservedInstances = 0);
+    void bind_all();
+    /// Room for count instances in GPU visible memory, in the segment after the one that's drawn now. All of it is to
+    /// be written (never read), and then handed over with commit()
+    GlyphInstance *map_next(std::size_t count);
+    /// Makes what was written since map_next, what draw() draws
+    void commit();
+    void draw();
+    GLuint vao_id{0};
+    GLuint vbo_id{0};
+    int last_items_rendered{0};
+
+private:
+    void allocate(usize instances_per_segment);
+    void wait_for(int segment);
+    usize segment_capacity{0};
+    bool persistent{false};
+    GlyphInstance *mapped{nullptr};
+    int drawn_segment{0};
+    int written_segment{0};
+    usize written_count{0};
+    std::array<GLsync, SEGMENTS> fences{};
 };
\ No newline at end of file
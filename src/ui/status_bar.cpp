@@ -6,6 +6,7 @@
 #include <core/buffer/data_manager.hpp>
 #include <core/buffer/text_data.hpp>
 #include <ui/view.hpp>
+#include <algorithm>
 #include <app.hpp>
 
 namespace ui {
@@ -18,10 +19,14 @@ StatusBar *StatusBar::create(int width, int height, int x, int y) {
     auto sb = new StatusBar{};
     sb->ui_view = std::move(ui_view);
     sb->buffer_cursor = cursor_info;
+    sb->damage();
     return sb;
 }
 
-void StatusBar::set_buffer_cursor(BufferCursor *cursor) { buffer_cursor = cursor; }
+void StatusBar::set_buffer_cursor(BufferCursor *cursor) {
+    buffer_cursor = cursor;
+    damage();
+}
 
 void StatusBar::draw(View *view) {
     glEnable(GL_SCISSOR_TEST);
@@ -30,17 +35,46 @@ void StatusBar::draw(View *view) {
     glClearColor(bg_color.x, bg_color.y, bg_color.z, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    auto output = text_for(view);
+    redraws_pending = output != drawn_text ? SWAP_CHAIN_BUFFERS - 1 : std::max(redraws_pending - 1, 0);
+    ui_view->get_text_buffer()->clear();
+    ui_view->get_text_buffer()->insert_str(output);
+    ui_view->draw_statusbar();
+    drawn_text = std::move(output);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+std::string StatusBar::text_for(View *view) const {
     auto buf = view->get_text_buffer();
     auto fName = buf->meta_data.buf_name;
 
     if (fName.empty()) { fName = "*unnamed buffer*"; }
 
     auto output = fmt::format("{} - [{}, {}]", fName, buffer_cursor->line, buffer_cursor->col_pos);
-    ui_view->get_text_buffer()->clear();
-    ui_view->get_text_buffer()->insert_str(output);
-    ui_view->draw_statusbar();
-    glDisable(GL_SCISSOR_TEST);
+    if (auto progress = buf->meta_data.load_progress; progress) {
+        output += fmt::format(" - loading {}%", AS(*progress * 100.0f, int));
+    }
+    if (auto progress = buf->meta_data.save_progress; progress) {
+        output += fmt::format(" - saving {}%", AS(*progress * 100.0f, int));
+    }
+    if (view->search && view->match_index) {
+        auto index = view->match_index;
+        index->update(*buf, *view->search);
+        const auto &matches = index->matches();
+        if (matches.empty()) {
+            output += " - no matches";
+        } else {
+            const auto at = index->ordinal(AS(buf->cursor.pos, std::size_t));
+            output += fmt::format(" - match {}/{}{}", at, matches.size(), index->complete() ? "" : "+");
+        }
+    }
+    return output;
 }
+
+bool StatusBar::is_damaged(View *view) const { return redraws_pending > 0 || text_for(view) != drawn_text; }
+
+void StatusBar::damage() { redraws_pending = SWAP_CHAIN_BUFFERS; }
+
 void StatusBar::print_debug_info() const {
     auto output = fmt::format("[{}, {}]", buffer_cursor->line, buffer_cursor->col_pos);
     util::println("Text to display: '{}'", output);
@@ -5,6 +5,7 @@
 #pragma once
 #include <core/core.hpp>
 #include <core/math/vector.hpp>
+#include <string>
 
 class TextData;
 class BufferCursor;
@@ -19,8 +20,18 @@ struct StatusBar {
     Vec3f bg_color{0.25f, 0.25f, 0.27f};
     Vec3f font_color{0.9f, 0.8f, 0.6f};
     void draw(View *view);
+    /// What it says about the buffer of view
+    [[nodiscard]] std::string text_for(View *view) const;
+    /// Whether what it says about view isn't what it has drawn, in any of the buffers of the swap chain
+    [[nodiscard]] bool is_damaged(View *view) const;
+    /// For when it has moved, or been resized; draws it into every buffer of the swap chain again
+    void damage();
     void set_buffer_cursor(BufferCursor *cursor);
     static StatusBar *create(int width, int height, int x, int y);
     void print_debug_info() const;
+
+    std::string drawn_text{};
+    /// Buffers of the swap chain that drawn_text hasn't made it to yet, see SWAP_CHAIN_BUFFERS
+    int redraws_pending{0};
 };
 }
\ No newline at end of file
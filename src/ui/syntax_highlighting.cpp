@@ -3,16 +3,17 @@
 //
 
 #include "syntax_highlighting.hpp"
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <core/buffer/line_index.hpp>
+#include <core/core.hpp>
+#include <core/strops.hpp>
+#include <ui/grammar.hpp>
 #include <ui/render/font.hpp>
 #include <utils/utils.hpp>
 
-static Context lex_ctx = Context::Block;
-
-static TokenType last_lexed;
-static bool using_keyword_preceded = false;
-static bool using_namespace_found = false;
-
 #ifdef DEBUG
 std::string token_ident_to_string(TokenType type) {
     switch (type) {
@@ -48,244 +49,291 @@ std::string token_ident_to_string(TokenType type) {
 }
 #endif
 
-std::optional<Token> number_literal(std::string_view &text, std::size_t pos) {
-    auto sz = text.size();
-    auto begin = pos;
-
-    for (auto i = pos; i < sz; i++) {
-        if (text[i] == 'x' || text[i] == 'X') {
-            for (auto j = i + 1; j < sz; j++) {
-                if (not std::isxdigit(text[j])) {
-                    lex_ctx = Context::Free;
-                    last_lexed = TokenType::NumberLiteral;
-                    return Token{begin, j, TokenType::NumberLiteral};
-                }
-            }
-        }
+/// ----------------- CHARACTER CLASSES -----------------
 
-        if (not std::isdigit(text[i]) && not(text[i] == '.' || text[i] == 'f' || text[i] == 'l')) {
-            lex_ctx = Context::Free;
-            last_lexed = TokenType::NumberLiteral;
-            return Token{begin, i, TokenType::NumberLiteral};
-        }
+enum CharClass : std::uint8_t {
+    Space = 1 << 0,
+    Digit = 1 << 1,
+    /// What a name can begin with
+    NameBegin = 1 << 2,
+    /// What a number literal is made of, after its first digit; what the preprocessor considers a number, which covers
+    /// hex, suffixes & digit separators
+    NumberPart = 1 << 3,
+};
+
+/// One lookup per byte, instead of the locale aware std::isalpha & friends. Bytes outside of ASCII have no class
+constexpr auto char_classes = []() {
+    std::array<std::uint8_t, 256> table{};
+    for (auto ch : {' ', '\t', '\n', '\v', '\f', '\r'}) table[AS(ch, unsigned char)] |= Space;
+    for (auto ch = '0'; ch <= '9'; ch++) table[AS(ch, unsigned char)] |= Digit | NumberPart;
+    for (auto ch = 'a'; ch <= 'z'; ch++) {
+        table[AS(ch, unsigned char)] |= NameBegin | NumberPart;
+        table[AS(ch - 'a' + 'A', unsigned char)] |= NameBegin | NumberPart;
     }
-    return {};
+    table[AS('_', unsigned char)] |= NameBegin;
+    table[AS('.', unsigned char)] |= NumberPart;
+    table[AS('\'', unsigned char)] |= NumberPart;
+    return table;
+}();
+
+static bool in_class(char ch, CharClass cls) { return (char_classes[AS(ch, unsigned char)] & cls) != 0; }
+
+/// ----------------- KEYWORDS -----------------
+
+enum class KeywordKind : std::uint8_t {
+    None,
+    /// Not just qualifiers, but keywords that live in qualifier-ish space, meaning, their locality in the source code
+    /// is similar to that of a qualifier, such as "using", which always comes before a type, namespace or the like
+    Qualifier,
+    /// Words that are never a type, a function or a variable, whatever the context says
+    Reserved
+};
+
+struct KeywordEntry {
+    std::string_view word;
+    KeywordKind kind;
+};
+
+using namespace std::string_view_literals;
+// clang-format off
+constexpr std::array keywords{
+    KeywordEntry{"const"sv, KeywordKind::Qualifier},    KeywordEntry{"constexpr"sv, KeywordKind::Qualifier},
+    KeywordEntry{"consteval"sv, KeywordKind::Qualifier},KeywordEntry{"static"sv, KeywordKind::Qualifier},
+    KeywordEntry{"volatile"sv, KeywordKind::Qualifier}, KeywordEntry{"unsigned"sv, KeywordKind::Qualifier},
+    KeywordEntry{"using"sv, KeywordKind::Qualifier},
+    KeywordEntry{"return"sv, KeywordKind::Reserved},    KeywordEntry{"if"sv, KeywordKind::Reserved},
+    KeywordEntry{"else"sv, KeywordKind::Reserved},      KeywordEntry{"for"sv, KeywordKind::Reserved},
+    KeywordEntry{"while"sv, KeywordKind::Reserved},     KeywordEntry{"do"sv, KeywordKind::Reserved},
+    KeywordEntry{"switch"sv, KeywordKind::Reserved},    KeywordEntry{"case"sv, KeywordKind::Reserved},
+    KeywordEntry{"default"sv, KeywordKind::Reserved},   KeywordEntry{"break"sv, KeywordKind::Reserved},
+    KeywordEntry{"continue"sv, KeywordKind::Reserved},  KeywordEntry{"goto"sv, KeywordKind::Reserved},
+    KeywordEntry{"sizeof"sv, KeywordKind::Reserved},    KeywordEntry{"alignof"sv, KeywordKind::Reserved},
+    KeywordEntry{"decltype"sv, KeywordKind::Reserved},  KeywordEntry{"static_cast"sv, KeywordKind::Reserved},
+    KeywordEntry{"new"sv, KeywordKind::Reserved},       KeywordEntry{"delete"sv, KeywordKind::Reserved},
+    KeywordEntry{"throw"sv, KeywordKind::Reserved},     KeywordEntry{"try"sv, KeywordKind::Reserved},
+    KeywordEntry{"catch"sv, KeywordKind::Reserved},     KeywordEntry{"true"sv, KeywordKind::Reserved},
+    KeywordEntry{"false"sv, KeywordKind::Reserved},     KeywordEntry{"nullptr"sv, KeywordKind::Reserved},
+    KeywordEntry{"this"sv, KeywordKind::Reserved},      KeywordEntry{"noexcept"sv, KeywordKind::Reserved},
+    KeywordEntry{"public"sv, KeywordKind::Reserved},    KeywordEntry{"private"sv, KeywordKind::Reserved},
+    KeywordEntry{"protected"sv, KeywordKind::Reserved}, KeywordEntry{"static_assert"sv, KeywordKind::Reserved},
+};
+// clang-format on
+
+constexpr std::size_t KEYWORD_SLOTS = 128;
+static_assert(KEYWORD_SLOTS >= 2 * keywords.size() && std::has_single_bit(KEYWORD_SLOTS));
+
+/// Looks at the length and 3 of the characters only; which is enough to tell the keywords apart, given the right seed
+constexpr std::uint32_t keyword_hash(std::string_view word, std::uint32_t seed) {
+    auto h = seed ^ AS(word.size(), std::uint32_t);
+    for (auto ch : {word.front(), word[word.size() / 2], word.back()}) h = (h ^ AS(ch, unsigned char)) * 0x01000193u;
+    return h ^ (h >> 15u);
 }
 
-std::optional<Token> string_literal(std::string_view &text, std::size_t pos) {
-    auto sz = text.size();
-    auto begin = pos;
-    auto quotes = 2;
-    for (auto i = pos; i < sz; i++) {
-        if (text[i] == '"') quotes--;
-        if (text[i] == '"' && text[i - 1] != '\\' && quotes == 0) {
-            lex_ctx = Context::Free;
-            last_lexed = TokenType::StringLiteral;
-            return Token{begin, i + 1, TokenType::StringLiteral};
-        }
-        if (text[i] == '>' && last_lexed == TokenType::Macro) {
-            lex_ctx = Context::Block;
-            last_lexed = TokenType::Include;
-            std::string res{text.substr(begin, i - begin)};
-            return Token{begin, i + 1, TokenType::Include};
+/// The first seed that gives every keyword a slot of its own; found when compiling, and checked not to fail
+constexpr std::uint32_t keyword_seed = []() {
+    for (std::uint32_t seed = 1; seed < 100000; seed++) {
+        std::array<bool, KEYWORD_SLOTS> taken{};
+        auto collided = false;
+        for (const auto &kw : keywords) {
+            auto &slot = taken[keyword_hash(kw.word, seed) & (KEYWORD_SLOTS - 1)];
+            collided = collided || slot;
+            slot = true;
         }
+        if (not collided) return seed;
     }
-    return {};
+    return 0u;
+}();
+static_assert(keyword_seed != 0, "no perfect hash seed for the keywords, add slots");
+
+constexpr auto keyword_slots = []() {
+    std::array<KeywordEntry, KEYWORD_SLOTS> slots{};
+    for (const auto &kw : keywords) slots[keyword_hash(kw.word, keyword_seed) & (KEYWORD_SLOTS - 1)] = kw;
+    return slots;
+}();
+
+constexpr auto keyword_max_length =
+        std::max_element(keywords.begin(), keywords.end(), [](auto a, auto b) { return a.word.size() < b.word.size(); })
+                ->word.size();
+
+/// One hash and one compare, instead of comparing against every keyword
+static KeywordKind keyword_kind(std::string_view name) {
+    if (name.size() < 2 || name.size() > keyword_max_length) return KeywordKind::None;
+    const auto &slot = keyword_slots[keyword_hash(name, keyword_seed) & (KEYWORD_SLOTS - 1)];
+    return slot.word == name ? slot.kind : KeywordKind::None;
 }
 
-constexpr auto named_ch_ok = [](auto ch) { return std::isalpha(ch) || (ch == '_') || (std::isdigit(ch)); };
+/// Length of text, not counting its newline
+static std::size_t content_length(std::string_view text) {
+    return (not text.empty() && text.back() == '\n') ? text.size() - 1 : text.size();
+}
 
-// This doesn't just return true for qualifiers, but keywords that live in qualifier-ish space, meaning, their
-// locality in the text source code is similar to that of a qualifier, such as the keyword "using" which always comes before
-// a type, namespace or something like that
-static bool is_qualifier_ish(std::string_view token) {
-    return (token == "const" || token == "constexpr" || token == "consteval" || token == "static" ||
-            token == "volatile" || token == "unsigned" || token == "using");
+static Token number_literal(std::string_view text, std::size_t pos, LineLexState &state) {
+    auto i = pos;
+    while (i < text.size() && in_class(text[i], NumberPart)) i++;
+    state.ctx = Context::Free;
+    state.last_lexed = TokenType::NumberLiteral;
+    return Token{pos, i, TokenType::NumberLiteral};
 }
 
-std::optional<Token> named(std::string_view &text, std::size_t pos) {
-    auto sz = text.size();
-    auto begin = pos;
-    for (auto i = pos; i < sz - 1; i++) {
-        if (not named_ch_ok(text[i])) {
-            if (is_qualifier_ish(text.substr(begin, i - begin))) {
-                last_lexed = TokenType::Qualifier;
-                if (text.substr(begin, i - begin) == "using") using_keyword_preceded = true;
-                return Token{begin, i, last_lexed};
-            }
-            if (text[i] == '(') {
-                lex_ctx = Context::FunctionSignature;
-                last_lexed = TokenType::Function;
-                return Token{begin, i, TokenType::Function};
-            } else if (text[i] == ':' && text[i + 1] == ':') {
-                if (using_keyword_preceded) using_namespace_found = true;
-                last_lexed = TokenType::Namespace;
-                lex_ctx = Context::Type;
-                return Token{begin, i, TokenType::Namespace};
-            } else {
-                if (lex_ctx == Context::FunctionSignature) {
-                    if (last_lexed == TokenType::Function || last_lexed == TokenType::Parameter ||
-                        last_lexed == TokenType::Qualifier) {
-                        last_lexed = TokenType::ParameterType;
-                        return Token{begin, i, TokenType::ParameterType};
-                    } else {
-                        last_lexed = TokenType::Parameter;
-                        return Token{begin, i, TokenType::Parameter};
-                    }
-                } else if (lex_ctx == Context::Type) {
-                    auto l = (last_lexed == TokenType::Namespace) ? TokenType::Keyword : TokenType::Variable;
-                    lex_ctx = (last_lexed == TokenType::Namespace) ? Context::Type : Context::Free;
-                    if (using_namespace_found) {
-                        using_keyword_preceded = false;
-                        using_namespace_found = false;
-                        lex_ctx = Context::Free;
-                        l = TokenType::Keyword;
-                        last_lexed = l;
-                        return Token{begin, i, l};
-                    } else {
-                        last_lexed = l;
-                        return Token{begin, i, l};
-                    }
-                } else {
-                    lex_ctx = Context::Type;
-                    last_lexed = TokenType::Keyword;
-                    return Token{begin, i, TokenType::Keyword};
-                }
-            }
+/// String & character literals. One that isn't closed on its line, ends with it
+static Token string_literal(std::string_view text, std::size_t pos, LineLexState &state) {
+    const auto quote = text[pos];
+    auto end = content_length(text);
+    for (auto i = pos + 1; i < end; i++) {
+        if (text[i] == '\\') {
+            i++;
+        } else if (text[i] == quote) {
+            end = i + 1;
+            break;
         }
     }
-    return {};
+    state.ctx = Context::Free;
+    state.last_lexed = TokenType::StringLiteral;
+    return Token{pos, end, TokenType::StringLiteral};
 }
 
-std::optional<Token> line_comment(std::string_view &text, std::size_t pos) {
-    auto sz = text.size();
-    auto begin = pos;
-    for (auto i = pos; i < sz; i++) {
-        last_lexed = TokenType::Comment;
-        lex_ctx = Context::Block;
-        if (text[i] == '\n') { return Token{begin, i, TokenType::Comment}; }
-    }
-    return Token{begin, sz, TokenType::Comment};
+/// The <path> of an #include
+static std::optional<Token> include_path(std::string_view text, std::size_t pos, LineLexState &state) {
+    auto close = text.find('>', pos);
+    if (close == std::string_view::npos) return {};
+    state.ctx = Context::Block;
+    state.last_lexed = TokenType::Include;
+    return Token{pos, close + 1, TokenType::Include};
 }
 
-std::optional<Token> block_comment(std::string_view &text, std::size_t pos) {
-    auto sz = text.size();
-    auto begin = pos;
-    auto closing_delim_found = false;
-    for (auto i = pos; i < sz - 2; i++) {
-        last_lexed = TokenType::Comment;
-        lex_ctx = Context::Block;
-        if (text[i] == '*') closing_delim_found = true;
-        else if (text[i] == '/') {
-            if (closing_delim_found) {
-                return Token{begin, i + 1, TokenType::Comment};
-            } else {
-                closing_delim_found = false;
-            }
+static Token named(std::string_view text, std::size_t pos, LineLexState &state) {
+    const auto i = pos + str::span_identifier(text.data() + pos, text.size() - pos);
+    const auto name = text.substr(pos, i - pos);
+    const auto next = i < text.size() ? text[i] : '\0';
+    switch (keyword_kind(name)) {
+        case KeywordKind::Qualifier:
+            state.last_lexed = TokenType::Qualifier;
+            if (name == "using") state.using_keyword_preceded = true;
+            return Token{pos, i, state.last_lexed};
+        case KeywordKind::Reserved:
+            state.ctx = Context::Free;
+            state.last_lexed = TokenType::Keyword;
+            return Token{pos, i, state.last_lexed};
+        default:
+            break;
+    }
+    if (next == '(') {
+        state.ctx = Context::FunctionSignature;
+        state.last_lexed = TokenType::Function;
+    } else if (next == ':' && i + 1 < text.size() && text[i + 1] == ':') {
+        if (state.using_keyword_preceded) state.using_namespace_found = true;
+        state.last_lexed = TokenType::Namespace;
+        state.ctx = Context::Type;
+    } else if (state.ctx == Context::FunctionSignature) {
+        if (state.last_lexed == TokenType::Function || state.last_lexed == TokenType::Parameter ||
+            state.last_lexed == TokenType::Qualifier) {
+            state.last_lexed = TokenType::ParameterType;
+        } else {
+            state.last_lexed = TokenType::Parameter;
         }
+    } else if (state.ctx == Context::Type) {
+        const auto after_namespace = state.last_lexed == TokenType::Namespace;
+        state.ctx = after_namespace ? Context::Type : Context::Free;
+        state.last_lexed = after_namespace ? TokenType::Keyword : TokenType::Variable;
+        if (state.using_namespace_found) {
+            state.using_keyword_preceded = false;
+            state.using_namespace_found = false;
+            state.ctx = Context::Free;
+            state.last_lexed = TokenType::Keyword;
+        }
+    } else {
+        state.ctx = Context::Type;
+        state.last_lexed = TokenType::Keyword;
     }
-    return Token{begin, sz, TokenType::Comment};
+    return Token{pos, i, state.last_lexed};
+}
+
+/// From pos to the end of the line, or to the end of the block comment, if it ends on this line
+static Token block_comment(std::string_view text, std::size_t pos, std::size_t search_from, LineLexState &state) {
+    state.ctx = Context::Block;
+    state.last_lexed = TokenType::Comment;
+    const auto close = search_from + str::find_block_comment_end(text.data() + search_from, text.size() - search_from);
+    if (close < text.size()) {
+        state.in_block_comment = false;
+        return Token{pos, close + 2, TokenType::Comment};
+    }
+    state.in_block_comment = true;
+    return Token{pos, content_length(text), TokenType::Comment};
 }
 
-using namespace std::string_view_literals;
 constexpr auto keyword_include = "#include"sv;
-constexpr auto kw_inc_length = keyword_include.size();
-
-std::optional<Token> macro(std::string_view &text, std::size_t pos) {
-    static auto escape_character_found = false;
-    auto begin = pos;
-
-    auto scan_ahead = std::find_if(text.begin() + pos, text.end(), [](auto ch) {
-        if (ch == '\\') escape_character_found = true;
-        if (ch == '\n' && not escape_character_found) {
-            return true;
-        } else if (ch == '\n' && escape_character_found) {
-            escape_character_found = false;
-        }
-        return false;
-    });
-    auto distance = std::distance(text.begin() + pos, scan_ahead);
-    if (text.substr(pos, kw_inc_length) == keyword_include) {
-        std::string s{text.substr(pos, kw_inc_length)};
-        lex_ctx = Context::Macro;
-        last_lexed = TokenType::Macro;
-        return Token{begin, begin + kw_inc_length, last_lexed};
+
+static std::optional<Token> macro(std::string_view text, std::size_t pos, LineLexState &state) {
+    if (text.substr(pos, keyword_include.size()) == keyword_include) {
+        state.ctx = Context::Macro;
+        state.last_lexed = TokenType::Macro;
+        return Token{pos, pos + keyword_include.size(), TokenType::Macro};
     }
     return {};
 }
 
-std::vector<Token> tokenize(std::string_view text) {
-    // FN_MICRO_BENCH();
-    std::vector<Token> result;
-    std::vector<ColorFormatInfo> keywords_ranges;
-
-    auto sz = text.size();
-    // TODO: actually measure this. I *know* that if this is going to be thousands of elements long,
-    //  reserving space will help, even without having measured, it's simple to reason about; every time it runs out of space
-    //  the strategy for std::vector is to double it's size, so that becomes 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096
-    //  and every time, the new elements have to be copied to the new memory range. If the file had tens of thousands of elements,
-    //  this could get noticibly slower, by milliseconds, still, I should measure this
-    result.reserve(sz / 3);// if we guess that a token average length is 3 characters, we get this reserved number
-    if (sz < 2) return result;
-    for (auto i = 0u; i < sz - 2; i++) {
-        if (std::isspace(text[i])) continue;
-        if (text[i] == '/') {
-            if (text[i + 1] == '/') {
-                auto token = line_comment(text, i);
-                if (token) {
-                    result.push_back(*token);
-                    i = token->end;
-                }
-            } else if (text[i + 1] == '*') {
-                auto token = block_comment(text, i);
-                if (token) {
-                    result.push_back(*token);
-                    i = token->end;
-                }
-            }
-        } else if (std::isdigit(text[i])) {
-            auto token = number_literal(text, i);
-            if (token) {
-                result.push_back(*token);
-                i = token->end;
-            }
-        } else if (text[i] == '"') {
-            auto token = string_literal(text, i);
-            if (token) {
-                result.push_back(*token);
-                i = token->end;
-            }
-        } else if (text[i] == '<' && last_lexed == TokenType::Macro) {
-            auto token = string_literal(text, i);
-            if (token) {
-                result.push_back(*token);
-                i = token->end;
-            }
-        } else if (std::isalpha(text[i]) && last_lexed == TokenType::Namespace) {
-            auto token = named(text, i);
-            if (token) {
-                result.push_back(*token);
-                i = token->end;
+void lex_line(std::string_view line, std::size_t offset, LineLexState &state, std::vector<Token> &tokens) {
+    auto push = [&](Token token) {
+        if (token.end > token.begin) tokens.push_back(Token{token.begin + offset, token.end + offset, token.type});
+        return token.end;
+    };
+    const auto sz = line.size();
+    auto i = std::size_t{0};
+    if (state.in_block_comment) i = push(block_comment(line, 0, 0, state));
+    while (i < sz) {
+        const auto ch = line[i];
+        const auto next = i + 1 < sz ? line[i + 1] : '\0';
+        if (in_class(ch, Space)) {
+            // a newline, or one of the rarer kinds of space, is not a blank
+            i += std::max(str::span_blanks(line.data() + i, sz - i), std::size_t{1});
+        } else if (ch == '/' && next == '/') {
+            state.ctx = Context::Block;
+            state.last_lexed = TokenType::Comment;
+            i = push(Token{i, content_length(line), TokenType::Comment});
+            break;
+        } else if (ch == '/' && next == '*') {
+            i = push(block_comment(line, i, i + 2, state));
+        } else if (in_class(ch, Digit)) {
+            i = push(number_literal(line, i, state));
+        } else if (ch == '"' || ch == '\'') {
+            i = push(string_literal(line, i, state));
+        } else if (ch == '<' && state.last_lexed == TokenType::Macro) {
+            if (auto token = include_path(line, i, state); token) {
+                i = push(*token);
+            } else {
+                i++;
             }
-        } else if (std::isalpha(text[i])) {
-            auto token = named(text, i);
-            if (token) {
-                result.push_back(*token);
-                i = token->end;
+        } else if (in_class(ch, NameBegin)) {
+            i = push(named(line, i, state));
+        } else if (ch == '#') {
+            if (auto token = macro(line, i, state); token) {
+                i = push(*token);
+            } else {
+                i++;
             }
-        } else if (text[i] == '#') {
-            auto token = macro(text, i);
-            if (token) {
-                result.push_back(*token);
-                i = token->end;
+        } else {
+            if (ch == ')' && state.ctx == Context::FunctionSignature) {
+                state.ctx = Context::Block;
+            } else if (ch == ';') {
+                state.ctx = Context::Free;
+                state.last_lexed = TokenType::Statement;
             }
-        } else if (text[i] == ')' && lex_ctx == Context::FunctionSignature) {
-            lex_ctx = Context::Block;
-        } else if (text[i] == ';') {
-            lex_ctx = Context::Free;
-            last_lexed = TokenType::Statement;
+            i++;
         }
     }
+}
+
+std::vector<Token> tokenize(std::string_view text) {
+    MICRO_BENCH("tokenize");
+    std::vector<Token> result;
+    // if we guess that a token average length is 3 characters, we get this reserved number
+    result.reserve(text.size() / 3);
+    LineLexState state{};
+    for (std::size_t line_start = 0; line_start < text.size();) {
+        auto line_end = std::min(text.find('\n', line_start), text.size() - 1) + 1;
+        lex_line(text.substr(line_start, line_end - line_start), line_start, state, result);
+        line_start = line_end;
+    }
     return result;
 }
 
@@ -326,86 +374,9 @@ std::vector<ColorFormatInfo> format_tokens(const std::vector<Token> &tokens) {
 }
 
 std::vector<ColorFormatInfo> color_format_tokenize(std::string_view text) {
-    std::vector<ColorFormatInfo> result;
-    auto sz = text.size();
-    // TODO: actually measure this. I *know* that if this is going to be thousands of elements long,
-    //  reserving space will help, even without having measured, it's simple to reason about; every time it runs out of space
-    //  the strategy for std::vector is to double it's size, so that becomes 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096
-    //  and every time, the new elements have to be copied to the new memory range. If the file had tens of thousands of elements,
-    //  this could get noticibly slower, by milliseconds, still, I should measure this
-    result.reserve(sz / 3);// if we guess that a token average length is 3 characters, we get this reserved number
-    if (sz < 2) return result;
-    for (auto i = 0u; i < sz - 2; i++) {
-        if (std::isspace(text[i])) continue;
-        if (text[i] == '/') {
-            if (text[i + 1] == '/') {
-                auto token = line_comment(text, i);
-                if (token) {
-                    result.push_back(ColorFormatInfo{token->begin, token->end, LIGHT_GRAY});
-                    i = token->end;
-                }
-            } else if (text[i + 1] == '*') {
-                auto token = block_comment(text, i);
-                if (token) {
-                    result.push_back(ColorFormatInfo{token->begin, token->end, LIGHT_GRAY});
-                    i = token->end;
-                }
-            }
-        } else if (std::isdigit(text[i])) {
-            auto token = number_literal(text, i);
-            if (token) {
-                result.push_back(ColorFormatInfo{token->begin, token->end, BLUE});
-                i = token->end;
-            }
-        } else if (text[i] == '"') {
-            auto token = string_literal(text, i);
-            if (token) {
-                result.push_back(ColorFormatInfo{token->begin, token->end, DARKER_GREEN});
-                i = token->end;
-            }
-        } else if (text[i] == '<' && last_lexed == TokenType::Macro) {
-            auto token = string_literal(text, i);
-            if (token) {
-                result.push_back(ColorFormatInfo{token->begin, token->end, DARKER_GREEN});
-                i = token->end;
-            }
-        } else if (std::isalpha(text[i]) && last_lexed == TokenType::Namespace) {
-            auto token = named(text, i);
-            if (token) {
-                result.push_back(ColorFormatInfo{token->begin, token->end, {0.820f, 0.500f, 0.000f}});
-                i = token->end;
-            }
-        } else if (std::isalpha(text[i])) {
-            auto token = named(text, i);
-            if (token) {
-                switch (token->type) {
-                    case TokenType::Qualifier:
-                    case TokenType::Keyword:
-                    case TokenType::Namespace:
-                    case TokenType::ParameterType:
-                        result.push_back(ColorFormatInfo{token->begin, token->end, {0.820f, 0.500f, 0.000f}});
-                        break;
-                    default:
-                        result.push_back(ColorFormatInfo{token->begin, token->end, {1, 1, 1}});
-                        break;
-                }
-                i = token->end;
-            }
-        } else if (text[i] == '#') {
-            auto token = macro(text, i);
-            if (token) {
-                result.push_back(ColorFormatInfo{token->begin, token->end, YELLOW});
-                i = token->end;
-            }
-        } else if (text[i] == ')' && lex_ctx == Context::FunctionSignature) {
-            lex_ctx = Context::Block;
-        } else if (text[i] == ';') {
-            lex_ctx = Context::Free;
-            last_lexed = TokenType::Statement;
-        }
-    }
-    return result;
+    return format_tokens(tokenize(text));
 }
+
 std::vector<ColorFormatInfo> color_format_tokenize_range(const char *begin, std::size_t len, std::size_t offset_of) {
     auto res = color_format_tokenize(std::string_view{begin, len});
     for(auto& e : res) {
@@ -414,3 +385,90 @@ std::vector<ColorFormatInfo> color_format_tokenize_range(const char *begin, std:
     }
     return res;
 }
+
+/// ----------------- INCREMENTAL LEXER -----------------
+
+void IncrementalLexer::reset() {
+    line_count = 0;
+    states.assign(1, LineLexState{});
+    tail.clear();
+    tail_base = 0;
+}
+
+void IncrementalLexer::set_grammar(const Grammar *new_grammar) {
+    if (new_grammar == grammar) return;
+    grammar = new_grammar;
+    // the text is the same, but none of the states it was lexed into are
+    states.assign(1, LineLexState{});
+    tail.clear();
+    tail_base = 0;
+}
+
+void IncrementalLexer::text_changed(const LineIndex &lines, std::size_t begin, std::size_t end) {
+    const auto first_line = lines.line_of(begin);
+    const auto last_line = lines.line_of(std::min(end, lines.text_size()));
+    const auto lines_added = AS(lines.line_count(), i64) - AS(line_count, i64);
+    line_count = lines.line_count();
+
+    // the line after the last changed one, is this line, from before the change. From there and on, the lines are the
+    // same as they were, and so are the states they begin in, unless a change made them begin in another state
+    const auto unchanged_from = AS(last_line + 1, i64) - lines_added;
+    std::vector<LineLexState> kept{};
+    if (end != std::string::npos && unchanged_from >= 0) {
+        const auto from = AS(unchanged_from, std::size_t);
+        if (from < states.size()) {
+            // the old tail can't be added to these; it was only valid if the states converged where it begins
+            kept.assign(states.begin() + AS(from, i64), states.end());
+        } else if (from >= tail_base && from - tail_base < tail.size()) {
+            kept.assign(tail.begin() + AS(from - tail_base, i64), tail.end());
+        }
+    }
+    // the state the first changed line begins in, only depends on the lines before it
+    states.resize(std::min(states.size(), first_line + 1));
+    tail = std::move(kept);
+    tail_base = last_line + 1;
+}
+
+void IncrementalLexer::push_state(std::size_t line, const LineLexState &state) {
+    if (line != states.size()) return;
+    if (line >= tail_base && line - tail_base < tail.size()) {
+        if (tail[line - tail_base] == state) {
+            // converged, the rest of the states are what they were before the change
+            states.insert(states.end(), tail.begin() + AS(line - tail_base, i64), tail.end());
+            tail.clear();
+            return;
+        }
+    } else if (line >= tail_base) {
+        tail.clear();
+    }
+    states.push_back(state);
+}
+
+void IncrementalLexer::lex_up_to(std::string_view text, const LineIndex &lines, std::size_t line) {
+    line = std::min(line, line_count);
+    std::vector<Token> discarded{};
+    while (states.size() <= line) {
+        const auto lexed = states.size() - 1;
+        auto state = states.back();
+        auto begin = lines.line_begin(lexed);
+        discarded.clear();
+        grammar->lex_line(text.substr(begin, lines.line_begin(lexed + 1) - begin), begin, state, discarded);
+        push_state(lexed + 1, state);
+    }
+}
+
+std::vector<ColorFormatInfo> IncrementalLexer::color_format_lines(std::string_view text, const LineIndex &lines,
+                                                                  std::size_t first, std::size_t count) {
+    MICRO_BENCH("IncrementalLexer::color_format_lines");
+    if (not grammar) return {};
+    first = std::min(first, line_count);
+    lex_up_to(text, lines, first);
+    std::vector<Token> tokens{};
+    auto state = states[first];
+    for (auto line = first; line < std::min(first + count, line_count); line++) {
+        auto begin = lines.line_begin(line);
+        grammar->lex_line(text.substr(begin, lines.line_begin(line + 1) - begin), begin, state, tokens);
+        push_state(line + 1, state);
+    }
+    return format_tokens(tokens);
+}
@@ -3,6 +3,7 @@
 //
 
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <optional>
 #include <string_view>
@@ -46,16 +47,77 @@ enum class Context {
     Macro
 };
 
+/// Everything the lexer knows when it begins lexing a line, that it learned from the lines before it. Lexing a line
+/// from the same state always gives the same tokens, which is what lets IncrementalLexer keep the state each line
+/// begins in, and restart from any of them
+struct LineLexState {
+    Context ctx{Context::Block};
+    TokenType last_lexed{TokenType::Illegal};
+    bool using_keyword_preceded{false};
+    bool using_namespace_found{false};
+    bool in_block_comment{false};
+    /// A string that spans lines is open, 1 + which of GrammarSpec::long_strings it was opened by
+    std::uint8_t open_string{0};
+    bool operator==(const LineLexState &) const = default;
+};
+
 #ifdef DEBUG
 std::string token_ident_to_string(TokenType type);
 #endif
 
-/// TODO: these functions are going to take my custom data buffer. Once I write it. Gapbuffer is easy to implement and I've done it before, so
-///  that isn't really hard but it comes with it's own set of problems. Right now we'll just deal with std::string and string_views
+/// Edit buffers are GapBuffers now, which don't store their text contiguously. These functions still take string_views
+/// though; the renderer asks the buffer for a contiguous TextData::view_range of what is displayed and passes that in
 
+/// Lexes one line of C++ (with or without its newline), starting in state, which it leaves in the state the next line
+/// begins in. offset is added to the positions of the tokens. Other languages are lexed by their Grammar
+void lex_line(std::string_view line, std::size_t offset, LineLexState &state, std::vector<Token> &tokens);
+
+/// These lex text from the beginning, as if it was the start of a file
 std::vector<Token> tokenize(std::string_view text);
 std::vector<ColorFormatInfo> format_tokens(const std::vector<Token>& tokens);
 
 
 std::vector<ColorFormatInfo> color_format_tokenize(std::string_view text);
-std::vector<ColorFormatInfo> color_format_tokenize_range(const char* begin, std::size_t len, std::size_t offsetof);
\ No newline at end of file
+std::vector<ColorFormatInfo> color_format_tokenize_range(const char* begin, std::size_t len, std::size_t offsetof);
+
+class LineIndex;
+class Grammar;
+
+/**
+ * Keeps the lexer state each line of a text begins in, so that some of its lines can be lexed without lexing
+ * everything above them, and highlighting is right, wherever in the file they are (like inside a block comment that
+ * began above them).
+ *
+ * The states are only computed as far as they've been asked for. When the text changes, the states up to and
+ * including the first changed line are still valid. The states after the last changed line are kept too, moved by the
+ * number of lines added or removed, and are used again as soon as re-lexing from the change gets a state equal to one
+ * of them. So the cost of an edit is the number of lines whose state actually changed.
+ *
+ * Lines are lexed by the grammar of the text's language; with no grammar, there's nothing to color.
+ */
+class IncrementalLexer {
+public:
+    /// Tells the lexer [begin, end) of the text, as it is now, is what changed since it last saw it. An end of npos
+    /// means all of it did, which is also how to hand it a new text
+    void text_changed(const LineIndex &lines, std::size_t begin, std::size_t end);
+    /// Color information for lines [first, first + count) of text. Positions are offsets into text
+    std::vector<ColorFormatInfo> color_format_lines(std::string_view text, const LineIndex &lines, std::size_t first,
+                                                    std::size_t count);
+    void reset();
+    /// Re-lexes the text with grammar from now on, if it's not the one the lexer already has
+    void set_grammar(const Grammar *grammar);
+
+private:
+    const Grammar *grammar{nullptr};
+    std::size_t line_count{0};
+    /// states[line] is the state line begins in
+    std::vector<LineLexState> states{LineLexState{}};
+    /// States from before the latest changes, for the lines from tail_base and on, which may be valid again
+    std::vector<LineLexState> tail{};
+    std::size_t tail_base{0};
+
+    /// Lexes lines until the state line begins in is known
+    void lex_up_to(std::string_view text, const LineIndex &lines, std::size_t line);
+    /// Appends the state line begins in, when the state of the line before it is the last known one
+    void push_state(std::size_t line, const LineLexState &state);
+};
\ No newline at end of file
@@ -9,7 +9,9 @@
 #include <ui/managers/shader_library.hpp>
 #include <ui/managers/font_library.hpp>
 #include <core/commands/command_interpreter.hpp>
+#include <ui/highlight_worker.hpp>
 // Sys headers
+#include <algorithm>
 #include <utility>
 #include <vector>
 
@@ -38,8 +40,10 @@ std::unique_ptr<View> View::create_managed(TextData *data, const std::string &na
     v->y = y;
     v->font = FontLibrary::get_default_font();
     v->shader = ShaderLibrary::get_text_shader();
+    v->glyph_shader = ShaderLibrary::get_instanced_text_shader();
     v->lines_displayable = int_ceil(float(h) / float(v->font->get_row_advance())) - LINES_DISPLAYABLE_DIFF;
     v->vao = std::move(vao);
+    v->glyph_vao = GlyphVAO::make();
     v->data = data;
     v->vertexCapacity = reserveMemory / sizeof(TextVertex);
     v->cursor = ViewCursor::create_from(v);
@@ -83,11 +87,13 @@ void View::set_dimensions(int w, int h) {
     this->height = h;
     lines_displayable = int_ceil(float(h) / float(font->get_row_advance())) - LINES_DISPLAYABLE_DIFF;
     util::println("lines displayable updated to: {}", lines_displayable);
+    damage();
 }
 
 void View::anchor_at(int x, int y) {
     this->x = x;
     this->y = y;
+    damage();
 }
 SimpleFont *View::get_font() { return font; }
 TextData *View::get_text_buffer() const { return data; }
@@ -100,10 +106,11 @@ void CommandView::set_prefix(const std::string &prefix) {
 /// ----------------- VIEW DRAW METHODS -----------------
 
 void View::draw(bool isActive) {
-    // TODO: re-work the drawing function, so that, when the GFX state is "unclean", instead of re-creating the entire memory (which can be very, very large)
-    //  we only rebuild what is necessary, upload that to the GPU and then draw. Possibly, we should not even bother with the off-screen contents,
-    //  thus *only* care about the contents that currently can be displayed
+    MICRO_BENCH("View::draw");
+    // only the displayed lines are turned into glyph instances, and of those, only the ones that changed since the last
+    // draw are re-built, see LineGlyphCache. When only the cursor moved, only the cursor is uploaded
     using Pos = ui::core::ScreenPos;
+    const auto changed = drawn_state(isActive) != drawn || not data->is_pristine() || highlight_outdated();
     glEnable(GL_SCISSOR_TEST);
     // GL anchors x, y in the bottom left, with our orthographic view, we anchor from top left, thus we have to take y-h, instead of just taking y
     glScissor(x, y - height, this->width, this->height);
@@ -116,73 +123,97 @@ void View::draw(bool isActive) {
         glClearColor(r, g, b, 1.0f);
     }
     glClear(GL_COLOR_BUFFER_BIT);
-    vao->bind_all();
-    shader->use();
+    glyph_shader->use();
     font->t->bind();
-    // shader->set_projection(projection);
-    // shader->set_projection(projection);
-    shader->set_projection(mvp);
+    font->bind_glyph_table();
+    glyph_shader->set_projection(mvp);
 
     // cursor->set_projection(projection);
     cursor->set_projection(mvp);
 
-    auto text_size = data->size();
-
-    if (text_size * 6 > this->vertexCapacity) {
-        this->vao->reserve_gpu_size(text_size * 2 + 2);
-        this->vertexCapacity = (text_size * 6 * 2 + 2);
-    }
-
-    if (data->is_pristine()) {
-        vao->draw();
+    if (data->is_pristine() && line_cache.valid && not highlight_outdated()) {
+        glyph_vao->draw();
         cursor->draw();
     } else {
         // The top left corner of the view, in screen position
         const auto xpos = AS(x + View::TEXT_LENGTH_FROM_EDGE, int);
         const auto ypos = AS(y - font->get_row_advance(), int);
         const Pos p{xpos, ypos};
-        if(auto fCtxInfo = get_text_buffer()->file_context(); fCtxInfo.type == ContexTypes::CPPHeader || fCtxInfo.type == ContexTypes::CPPSource) {
+        if (data->file_context().language != Language::PlainText) {
             font->create_vertex_data_for_syntax(this, p);
         } else {
             font->create_vertex_data_no_highlighting(this, p);
         }
-
-        vao->flush_and_draw();
+        glyph_vao->draw();
         cursor->forced_draw();
     }
     glDisable(GL_SCISSOR_TEST);
+    // what changed is in this buffer now, the rest of the chain gets it in the frames to come
+    redraws_pending = changed ? SWAP_CHAIN_BUFFERS - 1 : std::max(redraws_pending - 1, 0);
+    drawn = drawn_state(isActive);
 }
 
-void View::forced_draw(bool isActive) {
-    glEnable(GL_SCISSOR_TEST);
-    glScissor(x, y - height, this->width, this->height);
-    auto[r,g,b] = bg_color;
-    if (isActive) {
-        glClearColor(r + 0.05, g + 0.05, b + 0.05, 1.0f);
-    } else {
-        glClearColor(r, g, b, 1.0f);
-    }
-    glClear(GL_COLOR_BUFFER_BIT);
-    vao->bind_all();
-    shader->use();
-    font->t->bind();
-    // shader->set_projection(projection);
-    shader->set_projection(mvp);
+bool View::highlight_outdated() const {
+    if (not line_cache.highlighted) return false;
+    auto snapshot = HighlightWorker::get_instance().latest(this);
+    return snapshot && snapshot->buffer_id == data->id && snapshot->revision != line_cache.highlight_revision;
+}
 
-    // cursor->set_projection(projection);
-    cursor->set_projection(mvp);
+View::DrawnState View::drawn_state(bool isActive) const {
+    return DrawnState{.buffer_id = data->id,
+                      .text_version = data->version(),
+                      .cursor_pos = data->cursor.pos,
+                      .mark_pos = data->mark_set ? data->mark.pos : -1,
+                      .top_line = cursor->views_top_line,
+                      .active = isActive};
+}
 
-    auto text_size = data->size();
-    if (text_size * 6 > this->vertexCapacity) {
-        this->vao->reserve_gpu_size(text_size * 2 + 2);
-        this->vertexCapacity = (text_size * 6 * 2 + 2);
+bool View::is_damaged(bool isActive) const {
+    return redraws_pending > 0 || drawn_state(isActive) != drawn || not data->is_pristine() || highlight_outdated();
+}
+
+void View::damage() { redraws_pending = SWAP_CHAIN_BUFFERS; }
+
+void View::set_search(Searcher *searcher, MatchIndex *index) {
+    search = searcher;
+    match_index = index;
+    match_cache.valid = false;
+    // the glyphs are the same, but the cursor, with the highlights of the matches, has to be placed again
+    line_cache.invalidate();
+    damage();
+}
+
+const std::vector<SearchMatch> &View::matches_on_screen() {
+    const auto top = cursor->views_top_line;
+    if (not search) {
+        match_cache.matches.clear();
+        return match_cache.matches;
+    }
+    if (match_cache.valid && match_cache.buffer_id == data->id && match_cache.text_version == data->version() &&
+        match_cache.top_line == top && match_cache.lines == lines_displayable) {
+        return match_cache.matches;
+    }
+    const auto begin = data->meta_data.line_begin(top);
+    const auto end = data->meta_data.line_begin(top + lines_displayable + 1);
+    if (match_index) match_index->update(*data, *search);
+    if (match_index && match_index->complete()) {
+        auto on_screen = match_index->in_range(begin, end);
+        match_cache.matches.assign(on_screen.begin(), on_screen.end());
+    } else {
+        match_cache.matches = search->find_all(*data, begin, end);
     }
+    match_cache.buffer_id = data->id;
+    match_cache.text_version = data->version();
+    match_cache.top_line = top;
+    match_cache.lines = lines_displayable;
+    match_cache.valid = true;
+    return match_cache.matches;
+}
 
-    font->create_vertex_data_in(vao.get(), this, AS(this->x + View::TEXT_LENGTH_FROM_EDGE, int),
-                                       this->y - font->get_row_advance());
-    vao->flush_and_draw();
-    this->cursor->forced_draw();
-    glDisable(GL_SCISSOR_TEST);
+void View::forced_draw(bool isActive) {
+    // re-builds all of the displayed lines, and the cursor, as the cached glyphs were placed for the old dimensions
+    line_cache.invalidate();
+    draw(isActive);
 }
 
 ViewCursor *View::get_cursor() { return cursor.get(); }
@@ -242,9 +273,10 @@ void View::draw_command_view(const std::string &prefix, std::optional<std::vecto
 }
 
 View *View::create(TextData *data, const std::string &name, int w, int h, int x, int y, ViewType type) {
+    // the text of an editor view is drawn through glyph_vao, which grows to what's displayed. vao is for the modal
+    // popup, which reserves for what it draws itself, so there's no need to reserve for all of data here
     auto reserveMemory_Quads =
             gpu_mem_required_for_quads<TextVertex>(1024);// reserve GPU memory for at least 1024 characters.
-    if (!data->empty()) { reserveMemory_Quads = gpu_mem_required_for_quads<TextVertex>(data->size() * 2); }
     auto vao = VAO::make(GL_ARRAY_BUFFER, reserveMemory_Quads);
     auto v = new View{};
     v->td_id = data->id;
@@ -256,7 +288,9 @@ View *View::create(TextData *data, const std::string &name, int w, int h, int x,
     v->font = FontLibrary::get_default_font();
     v->lines_displayable = int_ceil(float(h) / float(v->font->get_row_advance())) - LINES_DISPLAYABLE_DIFF;
     v->shader = ShaderLibrary::get_text_shader();
+    v->glyph_shader = ShaderLibrary::get_instanced_text_shader();
     v->vao = std::move(vao);
+    v->glyph_vao = GlyphVAO::make();
     v->data = data;
     v->vertexCapacity = reserveMemory_Quads / sizeof(TextVertex);
     v->cursor = ViewCursor::create_from(v);
@@ -265,12 +299,15 @@ View *View::create(TextData *data, const std::string &name, int w, int h, int x,
 }
 void View::set_font(SimpleFont *new_font) {
     font = new_font;
+    line_cache.clear();
     cursor->setup_dimensions(cursor->width, font->max_glyph_height + 4);
     lines_displayable = int_ceil(float(height) / float(font->get_row_advance())) - LINES_DISPLAYABLE_DIFF;
+    damage();
     forced_draw(true);
 }
 View::~View() {
     util::println("Destroying View {} and it's affiliated resources. TextBuffer id: {} - Name: {}", name, get_text_buffer()->id, get_text_buffer()->fileName());
+    HighlightWorker::get_instance().forget(this);
     if (not DataManager::get_instance().is_managed(data->id)) {
         DataManager::get_instance().print_all_managed();
         delete data;
@@ -280,7 +317,6 @@ View::~View() {
 void View::draw_modal_view(int selected, std::vector<TextDrawable>& drawables) {
     glEnable(GL_SCISSOR_TEST);
     glScissor(x, y - height, this->width, this->height);
-    auto[r,g,b] = bg_color;
 
     glClear(GL_COLOR_BUFFER_BIT);
     vao->bind_all();
@@ -308,6 +344,7 @@ void View::draw_modal_view(int selected, std::vector<TextDrawable>& drawables) {
 
 void View::set_projection(Matrix projection) {
     this->mvp = projection;
+    damage();
 }
 
 std::pair<std::string_view, std::string_view> View::debug_print_boundary_lines() {
@@ -317,18 +354,19 @@ std::pair<std::string_view, std::string_view> View::debug_print_boundary_lines()
     auto buf = get_text_buffer();
     auto total = buf->to_string_view();
 
-    auto top_line_idx = buf->meta_data.line_begins[top_line];
-    auto top_len = buf->meta_data.line_begins[top_line+1] - buf->meta_data.line_begins[top_line];
+    auto &md = buf->meta_data;
+    auto top_line_idx = md.line_begin(top_line);
+    auto top_len = md.line_index.line_length(top_line);
 
-    if(end_line < buf->meta_data.line_begins.size()) {
-        auto bot_line_idx = buf->meta_data.line_begins[end_line];
-        auto bot_len = buf->meta_data.line_begins[end_line+1] - buf->meta_data.line_begins[end_line];
+    if(AS(end_line, std::size_t) < md.line_count()) {
+        auto bot_line_idx = md.line_begin(end_line);
+        auto bot_len = md.line_index.line_length(end_line);
         std::string_view top{total.data() + top_line_idx, static_cast<size_t>(top_len)};
         std::string_view bot{total.data() + bot_line_idx, static_cast<size_t>(bot_len)};
         return {top, bot};
-    } else if(buf->meta_data.line_begins.size() > 1) {
-        auto bot_line_idx = buf->meta_data.line_begins.back();
-        auto bot_len = *buf->meta_data.line_begins.rbegin() - *(buf->meta_data.line_begins.rbegin() + 1);
+    } else if(md.line_count() > 1) {
+        auto bot_line_idx = md.line_begin(md.line_count() - 1);
+        auto bot_len = md.line_index.line_length(md.line_count() - 1);
         std::string_view top{total.data() + top_line_idx, static_cast<size_t>(top_len)};
         std::string_view bot{total.data() + bot_line_idx, static_cast<size_t>(bot_len)};
         return {top, bot};
@@ -337,7 +375,7 @@ std::pair<std::string_view, std::string_view> View::debug_print_boundary_lines()
     }
 }
 void View::scroll_to(int line) {
-    int linesInBuffer = get_text_buffer()->meta_data.line_begins.size();
+    int linesInBuffer = get_text_buffer()->meta_data.line_count();
     int maxScrollableTopLine = std::max(0, linesInBuffer - lines_displayable + (lines_displayable / 2));
     if(line < maxScrollableTopLine) {
         cursor->views_top_line = std::max(line, 0);
@@ -401,8 +439,11 @@ void CommandView::draw() {
     }
 
     glDisable(GL_SCISSOR_TEST);
+    redraws_pending = std::max(redraws_pending - 1, 0);
 }
 
+void CommandView::damage() { redraws_pending = SWAP_CHAIN_BUFFERS; }
+
 using namespace std::string_view_literals;
 void CommandView::draw_error_message() {
     assert(not last_message.empty());
@@ -421,6 +462,7 @@ void CommandView::draw_error_message(std::string &&msg) {
     auto color_cfg = to_option_vec(msg_color);
     last_message = std::move(msg);
     show_last_message = true;
+    damage();
     command_view->draw_command_view("error: ", color_cfg);
 }
 
@@ -430,6 +472,7 @@ void CommandView::draw_message(std::string &&msg) {
     auto color_cfg = to_option_vec(msg_color);
     last_message = std::move(msg);
     show_last_message = true;
+    damage();
     infoPrefix = "";
     command_view->draw_command_view("", color_cfg);
 }
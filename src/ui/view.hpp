@@ -8,6 +8,8 @@
 #include "cursors/view_cursor.hpp"
 #include "view_enums.hpp"
 #include <core/buffer/text_data.hpp>
+#include <core/search/match_index.hpp>
+#include <core/search/searcher.hpp>
 
 #include <core/math/vector.hpp>
 #include <core/math/matrix.hpp>
@@ -26,6 +28,14 @@ auto convert_to_gl_anchor(int item_top_y, int item_height) -> int;
 
 namespace ui {
 
+/**
+ * How many buffers a damaged view is drawn into, before what's on screen of it is up to date in all of them. GLFW can't
+ * tell us what a swap does to the back buffer, but with the swap chains the drivers we run on hand out, it's what was
+ * drawn into it, the last time it was the back buffer. So, instead of redrawing everything every frame, what's changed
+ * is drawn into every buffer of the chain, over the frames that follow, and what hasn't, isn't drawn at all
+ */
+constexpr auto SWAP_CHAIN_BUFFERS = 3;
+
 struct View {
     ~View();
     static constexpr auto TEXT_LENGTH_FROM_EDGE = 4u;
@@ -39,6 +49,12 @@ struct View {
     /// This forces the View to re-create all the vertex data, and update some of it's dimension info
     /// this becomes useful when we have resized the window, and/or the view, as suddenly, the amount of lines that can be displayed changes, etc
     void forced_draw(bool isActive = false);
+    /// The highlighter has published colors for this view, that the displayed lines weren't built with
+    [[nodiscard]] bool highlight_outdated() const;
+    /// Whether draw would show anything other than what was drawn, in any of the buffers of the swap chain
+    [[nodiscard]] bool is_damaged(bool isActive = false) const;
+    /// For changes that the view can't see for itself, like its dimensions or colors; draws it into every buffer again
+    void damage();
     void draw_command_view(const std::string &prefix, std::optional<std::vector<ColorizeTextRange>> colorInfo);
     void draw_statusbar();
     void draw_modal_view(int selected, std::vector<TextDrawable>& drawables);
@@ -57,6 +73,10 @@ struct View {
     int width{}, height{}, x{}, y{};
     int lines_displayable = -1;
     std::unique_ptr<VAO> vao{nullptr};// the graphical representation
+    /// Text of the view, one instance per glyph, drawn with glyph_shader. vao is for the status bar & command views
+    std::unique_ptr<GlyphVAO> glyph_vao{nullptr};
+    /// Glyphs of the displayed lines, so that draw only re-builds the lines that changed
+    LineGlyphCache line_cache{};
     Vec3f fg_color{1.0f, 1.0f, 1.0f};
     Vec3f bg_color{0.05f, 0.052f, 0.0742123f};
     Matrix mvp;
@@ -68,12 +88,46 @@ struct View {
 
     SimpleFont *font = nullptr;
     Shader *shader = nullptr;
+    Shader *glyph_shader = nullptr;
     std::size_t vertexCapacity{0};
     int scrolled = 0;
     int lines_scrolled = 0;
     Boxed<ViewCursor> cursor;
     ViewType type = ViewType::Text;
 
+    /// What the view showed, the last time it was drawn. What else there is to it, data->is_pristine() tells
+    struct DrawnState {
+        int buffer_id{-1};
+        std::uint64_t text_version{0};
+        i64 cursor_pos{0};
+        /// -1 when there's no mark
+        i64 mark_pos{-1};
+        int top_line{0};
+        bool active{false};
+        bool operator==(const DrawnState &) const = default;
+    };
+    [[nodiscard]] DrawnState drawn_state(bool isActive) const;
+
+    /// What's searched for, to highlight the matches on screen; nullptr when there's nothing to highlight. App's, as
+    /// is the index of the matches in the buffer
+    Searcher *search{nullptr};
+    MatchIndex *match_index{nullptr};
+    void set_search(Searcher *searcher, MatchIndex *index);
+    /// The matches of search on the lines on screen, looked up in match_index, or searched for when it doesn't have
+    /// all of them. Only again when the text, or what lines are on screen, has changed since the last time
+    const std::vector<SearchMatch> &matches_on_screen();
+    struct {
+        int buffer_id{-1};
+        std::uint64_t text_version{0};
+        int top_line{-1};
+        int lines{-1};
+        bool valid{false};
+        std::vector<SearchMatch> matches{};
+    } match_cache;
+    DrawnState drawn{};
+    /// Buffers of the swap chain that what's drawn hasn't made it to yet
+    int redraws_pending = SWAP_CHAIN_BUFFERS;
+
     std::pair<std::string_view, std::string_view> debug_print_boundary_lines();
 };
 
@@ -93,6 +147,11 @@ public:
     static Boxed<CommandView> create(const std::string &name, int width, int height, int x, int y);
     static CommandView *create_not_managed(const std::string &name, int width, int height, int x, int y);
     bool active;
+    /// What the command view shows is the command interpreter's, it can't tell when that changes; App damages it on
+    /// input, and so do the messages
+    void damage();
+    [[nodiscard]] bool is_damaged() const { return redraws_pending > 0; }
+    int redraws_pending = SWAP_CHAIN_BUFFERS;
 
     void draw_current();
     void draw_error_message(std::string &&msg);
@@ -0,0 +1,173 @@
+//
+// Created by 46769 on 2021-02-21.
+//
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include "utils.hpp"
+#include <fmt/format.h>
+#include <limits>
+#include <utility>
+
+namespace {
+constexpr auto NOT_A_WORKER = std::numeric_limits<std::size_t>::max();
+/// Index of the worker the calling thread is, or NOT_A_WORKER
+thread_local std::size_t current_worker = NOT_A_WORKER;
+} // namespace
+
+void JobHandle::cancel() {
+    if (state) state->cancelled = true;
+}
+
+bool JobHandle::cancelled() const { return state && state->cancelled.load(std::memory_order_relaxed); }
+
+bool JobHandle::finished() const { return not state || state->finished.load(); }
+
+void JobHandle::wait() const {
+    if (state) state->finished.wait(false);
+}
+
+void JobHandle::finish() {
+    state->finished = true;
+    state->finished.notify_all();
+}
+
+JobSystem &JobSystem::get_instance() {
+    static JobSystem js;
+    return js;
+}
+
+JobSystem::~JobSystem() { stop(); }
+
+void JobSystem::start(std::function<void()> on_completion) {
+    if (not workers.empty()) return;
+    notify = std::move(on_completion);
+    stopping = false;
+    // the main thread has a core of its own
+    const auto count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (auto i = 0u; i < count; ++i) workers.push_back(std::make_unique<Worker>());
+    for (auto i = 0u; i < count; ++i) {
+        workers[i]->thread = std::thread{[this, i]() { run(i); }};
+    }
+}
+
+void JobSystem::stop() {
+    {
+        std::lock_guard lock{sleep_mutex};
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+    for (auto &worker : workers) {
+        for (auto &queue : worker->queues) {
+            for (auto &task : queue) task.handle.finish();
+        }
+    }
+    workers.clear();
+    queued = 0;
+    for (auto node = completed.exchange(nullptr); node != nullptr;) delete std::exchange(node, node->next);
+}
+
+JobHandle JobSystem::submit(JobPriority priority, Job job) {
+    JobHandle handle{};
+    handle.state = std::make_shared<JobHandle::State>();
+    Task task{handle, std::move(job)};
+    if (workers.empty()) {
+        execute(task);
+        return handle;
+    }
+    auto index = current_worker != NOT_A_WORKER ? current_worker : next_worker++ % workers.size();
+    {
+        std::lock_guard lock{workers[index]->mutex};
+        workers[index]->queues[AS(priority, std::size_t)].push_back(std::move(task));
+    }
+    {
+        // counted under the lock the workers sleep on, so that none of them goes to sleep in between
+        std::lock_guard lock{sleep_mutex};
+        ++queued;
+    }
+    wake.notify_one();
+    return handle;
+}
+
+std::optional<JobSystem::Task> JobSystem::take(std::size_t index) {
+    auto take_from = [this](std::size_t worker, std::size_t priority, bool newest) -> std::optional<Task> {
+        std::lock_guard lock{workers[worker]->mutex};
+        auto &queue = workers[worker]->queues[priority];
+        if (queue.empty()) return {};
+        Task task{};
+        if (newest) {
+            task = std::move(queue.back());
+            queue.pop_back();
+        } else {
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        --queued;
+        return task;
+    };
+    for (auto priority = 0u; priority < AS(JobPriority::Count, std::size_t); ++priority) {
+        if (auto task = take_from(index, priority, true)) return task;
+        for (auto i = 1u; i < workers.size(); ++i) {
+            if (auto task = take_from((index + i) % workers.size(), priority, false)) return task;
+        }
+    }
+    return {};
+}
+
+void JobSystem::execute(Task &task) {
+    if (task.handle.cancelled()) {
+        task.handle.finish();
+        return;
+    }
+    auto completion = task.job(task.handle);
+    if (completion && not task.handle.cancelled()) push_completion(std::move(completion), task.handle);
+    task.handle.finish();
+}
+
+void JobSystem::push_completion(Completion &&completion, JobHandle handle) {
+    auto node = new Finished{std::move(completion), std::move(handle)};
+    node->next = completed.load(std::memory_order_relaxed);
+    while (not completed.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                               std::memory_order_relaxed)) {}
+    if (notify) notify();
+}
+
+std::size_t JobSystem::run_completions() {
+    auto node = completed.exchange(nullptr, std::memory_order_acquire);
+    if (node == nullptr) return 0;
+    MICRO_BENCH("JobSystem::run_completions");
+    // the stack has the latest on top
+    Finished *in_order = nullptr;
+    while (node != nullptr) {
+        auto next = node->next;
+        node->next = in_order;
+        in_order = node;
+        node = next;
+    }
+    std::size_t ran = 0;
+    for (auto it = in_order; it != nullptr;) {
+        if (not it->handle.cancelled()) {
+            it->completion();
+            ++ran;
+        }
+        delete std::exchange(it, it->next);
+    }
+    return ran;
+}
+
+void JobSystem::run(std::size_t index) {
+    current_worker = index;
+    prof::Profiler::get_instance().set_thread_name(fmt::format("job worker {}", index));
+    // checked before every job, so that once stopping, the ones still queued are dropped by stop(), not run
+    while (not stopping) {
+        if (auto task = take(index)) {
+            execute(*task);
+            continue;
+        }
+        std::unique_lock lock{sleep_mutex};
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+    }
+}
@@ -0,0 +1,119 @@
+//
+// Created by 46769 on 2021-02-21.
+//
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <core/core.hpp>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/// In the order that queued jobs are taken. High is what the user is waiting on to see, Low what nobody is
+enum class JobPriority : std::size_t { High, Normal, Low, Count };
+
+/// What a job, and whoever submitted it, share: whether it's been cancelled, and whether it's done
+class JobHandle {
+public:
+    JobHandle() = default;
+    /// A job that hasn't begun won't; one that has, stops when it next checks cancelled(), and what it hands back to
+    /// the main thread is dropped
+    void cancel();
+    [[nodiscard]] bool cancelled() const;
+    /// Whether the job has run, or was dropped, because it was cancelled before it began
+    [[nodiscard]] bool finished() const;
+    /// Blocks until finished(). Not from a job, as the one it waits for can be queued behind it
+    void wait() const;
+    [[nodiscard]] bool valid() const { return state != nullptr; }
+
+private:
+    friend class JobSystem;
+    struct State {
+        std::atomic_bool cancelled{false};
+        std::atomic_bool finished{false};
+    };
+    std::shared_ptr<State> state{};
+    void finish();
+};
+
+/**
+ * Work-stealing thread pool that the editor's subsystems share, for what would otherwise stall the main loop, or need
+ * a thread of its own (loading, saving & searching files). One worker per core, besides the main thread's.
+ *
+ * Every worker has a queue per priority. Jobs submitted from the main thread are spread over the workers, those that
+ * a job submits go to its own worker's queue. A worker takes the newest job of its own queue, and when that's empty,
+ * steals the oldest job of another worker's, so that the workers stay busy without contending over one queue, and
+ * a job that's split into more jobs, has them run on the worker that has what they need in its cache. A worker with
+ * nothing to do sleeps until a job is submitted, so an idle pool costs nothing.
+ *
+ * A job gets its JobHandle, to check for cancellation, and returns what's to be done with its results on the main
+ * thread. Those are pushed onto a lock-free stack that run_completions (the main loop) takes all of at once, in the
+ * order they were pushed.
+ */
+class JobSystem {
+public:
+    /// What a job hands back, that run_completions runs on the main thread. Empty when it has nothing to hand back
+    using Completion = std::function<void()>;
+    /// Should check handle.cancelled() every so often, if it's one that takes a while
+    using Job = std::function<Completion(const JobHandle &handle)>;
+
+    static JobSystem &get_instance();
+    ~JobSystem();
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    /// Starts the workers. on_completion is called from the worker that pushed a completion, to wake the main loop up
+    void start(std::function<void()> on_completion);
+    /// Drops the queued jobs & pending completions, and waits for the running jobs to finish. The handles of the dropped
+    /// jobs are finished, without the jobs having run
+    void stop();
+
+    /// Queues job. Before start, or after stop, job is run right away, on the calling thread
+    JobHandle submit(JobPriority priority, Job job);
+    /// Main thread. Runs the completions of the jobs finished since the last call, except those of cancelled jobs.
+    /// Returns how many were run
+    std::size_t run_completions();
+    [[nodiscard]] std::size_t worker_count() const { return workers.size(); }
+
+private:
+    JobSystem() = default;
+    struct Task {
+        JobHandle handle;
+        Job job;
+    };
+    struct Worker {
+        std::mutex mutex{};
+        std::array<std::deque<Task>, AS(JobPriority::Count, std::size_t)> queues{};
+        std::thread thread{};
+    };
+    /// A node of the completion stack
+    struct Finished {
+        Completion completion;
+        JobHandle handle;
+        Finished *next{nullptr};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers{};
+    /// Which worker the next job submitted from outside of the pool goes to
+    std::atomic<std::size_t> next_worker{0};
+    /// Jobs queued that no worker has taken yet; can be -1 for a moment, when a job is taken before it's counted
+    std::atomic<std::ptrdiff_t> queued{0};
+    std::mutex sleep_mutex{};
+    std::condition_variable wake{};
+    std::atomic_bool stopping{false};
+    std::atomic<Finished *> completed{nullptr};
+    std::function<void()> notify{};
+
+    void run(std::size_t index);
+    /// The next job for worker index: its own newest, or another worker's oldest, of the highest priority there is
+    std::optional<Task> take(std::size_t index);
+    void execute(Task &task);
+    void push_completion(Completion &&completion, JobHandle handle);
+};
@@ -0,0 +1,88 @@
+//
+// Created by 46769 on 2021-02-09.
+//
+
+#include "mapped_file.hpp"
+#include "utils.hpp"
+
+#ifdef WIN32
+#include <windows.h>
+
+std::unique_ptr<MappedFile> MappedFile::open(const fs::path &path) {
+    auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        util::println("Failed to open {} for mapping. Error: {}", path.string(), GetLastError());
+        return nullptr;
+    }
+    LARGE_INTEGER file_size;
+    if (not GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return nullptr;
+    }
+    auto mf = std::unique_ptr<MappedFile>(new MappedFile{});
+    mf->file_path = path;
+    mf->file_handle = file;
+    mf->size = static_cast<std::size_t>(file_size.QuadPart);
+    // mapping an empty file is an error on windows, an empty view is all we need anyway
+    if (mf->size == 0) return mf;
+
+    mf->mapping_handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mf->mapping_handle == nullptr) {
+        util::println("Failed to create file mapping for {}. Error: {}", path.string(), GetLastError());
+        return nullptr;
+    }
+    mf->data = static_cast<const char *>(MapViewOfFile(mf->mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (mf->data == nullptr) {
+        util::println("Failed to map view of {}. Error: {}", path.string(), GetLastError());
+        return nullptr;
+    }
+    return mf;
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+    if (file_handle != nullptr) CloseHandle(file_handle);
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<MappedFile> MappedFile::open(const fs::path &path) {
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        util::println("Failed to open {} for mapping", path.string());
+        return nullptr;
+    }
+    struct stat info {};
+    if (fstat(fd, &info) == -1) {
+        ::close(fd);
+        return nullptr;
+    }
+    auto mf = std::unique_ptr<MappedFile>(new MappedFile{});
+    mf->file_path = path;
+    mf->size = static_cast<std::size_t>(info.st_size);
+    if (mf->size > 0) {
+        auto addr = mmap(nullptr, mf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            util::println("Failed to map {}", path.string());
+            return nullptr;
+        }
+        // we mostly read front to back; let the kernel read ahead aggressively
+        madvise(addr, mf->size, MADV_SEQUENTIAL);
+        mf->data = static_cast<const char *>(addr);
+    }
+    // the mapping keeps the file alive, the descriptor isn't needed anymore
+    ::close(fd);
+    return mf;
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) munmap(const_cast<char *>(data), size);
+}
+#endif
@@ -0,0 +1,41 @@
+//
+// Created by 46769 on 2021-02-09.
+//
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+/**
+ * Read-only memory mapping of an entire file. Opening is O(1) regardless of file size, pages are read in by the OS
+ * when they're first touched, and never count against our own heap. The mapping lives as long as the MappedFile.
+ */
+class MappedFile {
+public:
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// Files this size or larger are mapped read-only instead of read into a buffer, see MappedBuffer
+    static constexpr std::uintmax_t LOAD_THRESHOLD = 32 * 1024 * 1024;
+
+    /// Returns nullptr if the file can't be opened or mapped
+    static std::unique_ptr<MappedFile> open(const fs::path &path);
+
+    [[nodiscard]] std::string_view view() const { return {data, size}; }
+    [[nodiscard]] const fs::path &path() const { return file_path; }
+
+private:
+    MappedFile() = default;
+    const char *data{nullptr};
+    std::size_t size{0};
+    fs::path file_path{};
+#ifdef WIN32
+    void *file_handle{nullptr};
+    void *mapping_handle{nullptr};
+#endif
+};
@@ -0,0 +1,166 @@
+//
+// Created by 46769 on 2021-02-16.
+//
+
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <numeric>
+
+namespace prof {
+
+/// Rings of threads that have exited are kept for the trace, but only this many of them; file loaders come & go
+static constexpr std::size_t EXITED_RINGS_KEPT = 8;
+
+static thread_local std::shared_ptr<EventRing> this_threads_ring = nullptr;
+/// A name given before the thread recorded anything, for when its ring is made
+static thread_local std::string this_threads_name{};
+
+EventRing::EventRing(std::uint32_t thread_id, std::string thread_name)
+    : thread_id(thread_id), thread_name(std::move(thread_name)), slots(std::make_unique<Slot[]>(CAPACITY)) {}
+
+std::vector<ZoneEvent> EventRing::copy() const {
+    const auto n = written.load(std::memory_order_acquire);
+    const auto first = n > CAPACITY ? n - CAPACITY : 0;
+    std::vector<ZoneEvent> result{};
+    result.reserve(n - first);
+    for (auto i = first; i < n; ++i) {
+        const auto &slot = slots[i & (CAPACITY - 1)];
+        // zone i is no longer there, when the owner is writing, or has written, a newer zone over it
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * i + 2) continue;
+        const auto event = slot.load();
+        // & it's not whole, when the owner began writing over it while it was read
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+        result.push_back(event);
+    }
+    return result;
+}
+
+float FrameHistory::max() const {
+    return count == 0 ? 0.0f : *std::max_element(ms.begin(), ms.begin() + static_cast<std::ptrdiff_t>(count));
+}
+
+float FrameHistory::average() const {
+    if (count == 0) return 0.0f;
+    return std::accumulate(ms.begin(), ms.begin() + static_cast<std::ptrdiff_t>(count), 0.0f) /
+           static_cast<float>(count);
+}
+
+Profiler &Profiler::get_instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+std::uint64_t Profiler::now_ns() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::steady_clock::now().time_since_epoch())
+                                              .count());
+}
+
+Profiler::Profiler() : epoch_ns(now_ns()) {}
+
+void Profiler::set_enabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+
+EventRing &Profiler::thread_ring() {
+    if (not this_threads_ring) {
+        static std::atomic<std::uint32_t> next_thread_id{1};
+        const auto id = next_thread_id++;
+        auto name = this_threads_name.empty() ? fmt::format("thread {}", id) : this_threads_name;
+        this_threads_ring = std::make_shared<EventRing>(id, std::move(name));
+
+        std::lock_guard lock{rings_mutex};
+        // the only owner left is us, when the thread has exited. Those are in the order they were made
+        auto exited = static_cast<std::size_t>(
+                std::count_if(rings.begin(), rings.end(), [](auto &ring) { return ring.use_count() == 1; }));
+        std::erase_if(rings, [&exited](auto &ring) {
+            if (ring.use_count() != 1 || exited <= EXITED_RINGS_KEPT) return false;
+            --exited;
+            return true;
+        });
+        rings.push_back(this_threads_ring);
+    }
+    return *this_threads_ring;
+}
+
+void Profiler::set_thread_name(std::string_view name) {
+    this_threads_name = name;
+    if (this_threads_ring) {
+        std::lock_guard lock{rings_mutex};
+        this_threads_ring->thread_name = name;
+    }
+}
+
+void Profiler::end_frame(std::uint64_t begin_ns, std::uint64_t end_ns) {
+    history.ms[history.next] = static_cast<float>(static_cast<double>(end_ns - begin_ns) / 1e6);
+    history.next = (history.next + 1) % FrameHistory::FRAMES;
+    history.count = std::min(history.count + 1, FrameHistory::FRAMES);
+
+    auto &stages = history.last_frame_stages;
+    stages.clear();
+    thread_ring().for_each_since(begin_ns, [&](const ZoneEvent &event) {
+        if (event.begin_ns < begin_ns) return;
+        const auto ms = static_cast<double>(event.end_ns - event.begin_ns) / 1e6;
+        auto stage = std::find_if(stages.begin(), stages.end(),
+                                  [&](auto &s) { return std::strcmp(s.name, event.name) == 0; });
+        if (stage != stages.end()) {
+            stage->ms += ms;
+        } else {
+            stages.push_back(StageTime{event.name, ms});
+        }
+    });
+    std::sort(stages.begin(), stages.end(), [](auto &a, auto &b) { return a.ms > b.ms; });
+}
+
+static std::string json_escaped(std::string_view str) {
+    std::string result{};
+    result.reserve(str.size());
+    for (auto c : str) {
+        if (c == '"' || c == '\\') result.push_back('\\');
+        result.push_back(c);
+    }
+    return result;
+}
+
+std::optional<std::size_t> Profiler::write_chrome_trace(const fs::path &path) const {
+    std::vector<std::pair<std::uint32_t, std::string>> threads{};
+    std::vector<std::pair<std::uint32_t, std::vector<ZoneEvent>>> events{};
+    {
+        std::lock_guard lock{rings_mutex};
+        for (const auto &ring : rings) {
+            threads.emplace_back(ring->thread_id, ring->thread_name);
+            events.emplace_back(ring->thread_id, ring->copy());
+        }
+    }
+
+    std::ofstream out{path, std::ios::binary};
+    if (not out) return {};
+    // "X" events are complete zones, with their duration; "M" is metadata, here the names of the threads. Times are in
+    // microseconds
+    out << R"({"displayTimeUnit":"ms","traceEvents":[)" << '\n';
+    std::size_t written = 0;
+    auto separator = "";
+    for (const auto &[tid, name] : threads) {
+        out << fmt::format(R"({}{{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})", separator,
+                           tid, json_escaped(name));
+        separator = ",\n";
+    }
+    for (const auto &[tid, zones] : events) {
+        for (const auto &zone : zones) {
+            const auto begin_us = static_cast<double>(zone.begin_ns - std::min(zone.begin_ns, epoch_ns)) / 1e3;
+            const auto duration_us = static_cast<double>(zone.end_ns - zone.begin_ns) / 1e3;
+            out << fmt::format(R"({}{{"name":"{}","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})", separator,
+                               json_escaped(zone.name), tid, begin_us, duration_us);
+            separator = ",\n";
+            ++written;
+        }
+    }
+    out << "\n]}\n";
+    if (not out) return {};
+    return written;
+}
+}// namespace prof
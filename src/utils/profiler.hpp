@@ -0,0 +1,161 @@
+//
+// Created by 46769 on 2021-02-16.
+//
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * Scoped zones, recorded into a ring per thread, for finding out where frame time goes. A zone is a name & the
+ * nanoseconds it began & ended at; Zone records one for the scope it lives in, see MICRO_BENCH in utils.hpp.
+ *
+ * Recording costs one relaxed load when the profiler is disabled, which it is until the "profile" command enables it,
+ * and the macros compile to nothing without INSTRUMENTATION. When enabled, a zone is two clock reads and a write into
+ * the thread's own ring, no locks. Rings keep the last EventRing::CAPACITY zones of their thread, which are written out
+ * as Chrome trace events (chrome://tracing, or ui.perfetto.dev) by write_chrome_trace.
+ */
+namespace prof {
+struct ZoneEvent {
+    /// Zone names are string literals, or anything else that lives as long as the program
+    const char *name;
+    std::uint64_t begin_ns;
+    std::uint64_t end_ns;
+};
+
+/// The zones of one thread. Only that thread pushes, any thread may copy. A slot is a seqlock: its sequence is odd
+/// while the owner writes it, so copy can tell a zone it read whole from one that was written over while it read it
+class EventRing {
+public:
+    static constexpr std::size_t CAPACITY = 1u << 14;
+
+    EventRing(std::uint32_t thread_id, std::string thread_name);
+
+    void push(const ZoneEvent &event) {
+        const auto n = written.load(std::memory_order_relaxed);
+        auto &slot = slots[n & (CAPACITY - 1)];
+        slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+        // the sequence turns odd before any of the fields change
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.begin_ns.store(event.begin_ns, std::memory_order_relaxed);
+        slot.end_ns.store(event.end_ns, std::memory_order_relaxed);
+        slot.sequence.store(2 * n + 2, std::memory_order_release);
+        written.store(n + 1, std::memory_order_release);
+    }
+    /// The zones still in the ring, oldest first. Those that the owning thread wrote over while they were copied are
+    /// left out
+    [[nodiscard]] std::vector<ZoneEvent> copy() const;
+    /// Calls fn with the zones of the owning thread that ended after since_ns, newest first. Only the owner may call it
+    template<typename Fn>
+    void for_each_since(std::uint64_t since_ns, Fn fn) const {
+        const auto n = written.load(std::memory_order_relaxed);
+        for (auto i = n; i > 0 && n - i < CAPACITY; --i) {
+            const auto event = slots[(i - 1) & (CAPACITY - 1)].load();
+            if (event.end_ns <= since_ns) break;
+            fn(event);
+        }
+    }
+
+    const std::uint32_t thread_id;
+    std::string thread_name;
+
+private:
+    struct Slot {
+        /// 2n + 1 while the owner writes its nth zone here, 2n + 2 once it's written
+        std::atomic<std::uint64_t> sequence{0};
+        std::atomic<const char *> name{nullptr};
+        std::atomic<std::uint64_t> begin_ns{0};
+        std::atomic<std::uint64_t> end_ns{0};
+
+        [[nodiscard]] ZoneEvent load() const {
+            return ZoneEvent{name.load(std::memory_order_relaxed), begin_ns.load(std::memory_order_relaxed),
+                             end_ns.load(std::memory_order_relaxed)};
+        }
+    };
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<std::uint64_t> written{0};
+};
+
+/// Time spent in each zone of a frame, on the thread that ran it
+struct StageTime {
+    const char *name;
+    double ms;
+};
+
+/// The frame times of the last FRAMES frames, & the stages of the last one. Written & read by the main thread only
+struct FrameHistory {
+    static constexpr std::size_t FRAMES = 240;
+    std::array<float, FRAMES> ms{};
+    /// Where the next frame time goes; ms[(next + FRAMES - 1) % FRAMES] is the last frame's
+    std::size_t next{0};
+    std::size_t count{0};
+    std::vector<StageTime> last_frame_stages{};
+
+    [[nodiscard]] float last() const { return count == 0 ? 0.0f : ms[(next + FRAMES - 1) % FRAMES]; }
+    [[nodiscard]] float max() const;
+    [[nodiscard]] float average() const;
+};
+
+class Profiler {
+public:
+    static Profiler &get_instance();
+    static std::uint64_t now_ns();
+
+    [[nodiscard]] bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+    void set_enabled(bool enable);
+
+    void record(const char *name, std::uint64_t begin_ns, std::uint64_t end_ns) {
+        thread_ring().push(ZoneEvent{name, begin_ns, end_ns});
+    }
+    /// What the calling thread is called in the trace. Threads that don't name themselves are "thread <id>"
+    void set_thread_name(std::string_view name);
+
+    /// Called by the main loop once a frame has been drawn; adds it to the history, along with the zones the calling
+    /// thread recorded since begin_ns
+    void end_frame(std::uint64_t begin_ns, std::uint64_t end_ns);
+    [[nodiscard]] const FrameHistory &frames() const { return history; }
+
+    /// Writes every ring out, as Chrome trace event JSON. Returns the number of events written, or nothing if the file
+    /// couldn't be written
+    std::optional<std::size_t> write_chrome_trace(const fs::path &path) const;
+
+private:
+    Profiler();
+    EventRing &thread_ring();
+
+    std::atomic<bool> enabled{false};
+    const std::uint64_t epoch_ns;
+    mutable std::mutex rings_mutex{};
+    /// Shared with the thread_local that each thread pushes through, so that a thread's zones can still be written out
+    /// after it has exited
+    std::vector<std::shared_ptr<EventRing>> rings{};
+    FrameHistory history{};
+};
+
+/// Records the scope it lives in as a zone, if the profiler was enabled when the scope was entered
+class Zone {
+public:
+    explicit Zone(const char *zone_name)
+        : name(zone_name), begin(Profiler::get_instance().is_enabled() ? Profiler::now_ns() : 0) {}
+    ~Zone() {
+        if (begin != 0) Profiler::get_instance().record(name, begin, Profiler::now_ns());
+    }
+    Zone(const Zone &) = delete;
+    Zone &operator=(const Zone &) = delete;
+
+private:
+    const char *name;
+    std::uint64_t begin;
+};
+}// namespace prof
@@ -20,19 +20,7 @@
 #endif
 
 #ifdef INSTRUMENTATION
-using namespace std::chrono_literals;
-using hiResClk = std::chrono::high_resolution_clock;
-using chronotp = std::chrono::high_resolution_clock::time_point;
-struct Timer {
-    explicit Timer(const std::string_view &timer_title);
-    ~Timer();
-
-    void stop();
-    void reset();
-
-    std::string_view benchmark_title;
-    chronotp begin, end;
-};
+#include <utils/profiler.hpp>
 #endif
 
 template <typename T, typename U>
@@ -62,17 +50,12 @@ constexpr auto to_option_vec(T t, Ts... ss) -> std::optional<std::vector<T>> {
  */
 #define PPCAT(A, B) PPCAT_NX(A, B)
 
+/// Records the rest of the scope as a zone of the profiler, see profiler.hpp. title must outlive the program, like a
+/// string literal does
 #ifdef INSTRUMENTATION
 #define MICRO_BENCH(title)                                                                                             \
-    Timer timer##__LINE__ { title }
-#define SECTION_MICRO_BENCH(title, section)                                                                            \
-    Timer timer##__LINE__ { ##title##section }
+    prof::Zone PPCAT(zone_, __LINE__) { title }
 #define FN_MICRO_BENCH() MICRO_BENCH(__PRETTY_FUNCTION__)
-#define PUSH_FN_SUBSECTION(sectionKey)                                                                                 \
-    std::string n = __PRETTY_FUNCTION__;                                                                               \
-    n.append(sectionKey);                                                                                              \
-    MICRO_BENCH(n)
-
 #else
 #define MICRO_BENCH(title)
 #define FN_MICRO_BENCH() MICRO_BENCH(__PRETTY_FUNCTION__)
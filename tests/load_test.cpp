@@ -0,0 +1,88 @@
+//
+// Created by 46769 on 2021-02-24.
+//
+
+// Regression tests of TextData::append_loaded: what's typed while a file is loading, against where it should end up,
+// for every backend. Exits with 1 if anything isn't where it should be, see ctest.
+
+#include <algorithm>
+#include <core/buffer/gap_buffer.hpp>
+#include <core/buffer/mapped_buffer.hpp>
+#include <core/buffer/std_string_buffer.hpp>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <string>
+
+static int failures = 0;
+
+static std::string text_of(const TextData &buffer) {
+    std::string text{};
+    for (auto chunk : buffer.chunks(0, buffer.size())) text.append(chunk);
+    return text;
+}
+
+static void check(std::string_view name, std::string_view what, const std::string &found, const std::string &expected) {
+    if (found == expected) return;
+    // the texts are the size of a file, only where they part is of interest
+    auto [differs, _] = std::mismatch(found.begin(), found.end(), expected.begin(), expected.end());
+    const auto at = AS(differs - found.begin(), std::size_t);
+    fmt::print("FAIL {}, {}: at {}, expected \"{}\", found \"{}\"\n", name, what, at, expected.substr(at, 20),
+               found.substr(at, 20));
+    ++failures;
+}
+
+static void type(TextData &buffer, std::string_view text) {
+    for (auto ch : text) buffer.insert(ch);
+}
+
+static void hand_over(TextData &buffer, std::string_view chunk) {
+    std::string_view parts[]{chunk};
+    buffer.append_loaded(chunk, LineIndex::line_lengths(parts));
+}
+
+/// Hands file over in three chunks, the way FileLoader::poll does, typing at the top & at the end in between
+static void check_loading(std::string_view name, TextData &buffer, std::string_view file) {
+    buffer.has_meta_data = true;
+    const auto third = file.size() / 3;
+    hand_over(buffer, file.substr(0, third));
+    type(buffer, "top ");
+    buffer.step_cursor_to(buffer.size());
+    type(buffer, "typed\nat the end");
+    hand_over(buffer, file.substr(third, third));
+    type(buffer, " & more");
+    hand_over(buffer, file.substr(2 * third));
+
+    const auto expected = fmt::format("top {}typed\nat the end & more", file);
+    check(name, "the text", text_of(buffer), expected);
+    check(name, "the line index", std::to_string(buffer.meta_data.line_count()),
+          std::to_string(std::count(expected.begin(), expected.end(), '\n') + 1));
+    // the cursor went along with what was typed
+    type(buffer, "!");
+    check(name, "typing after the load", text_of(buffer), expected + "!");
+    while (buffer.undo()) {}
+    check(name, "undoing everything typed", text_of(buffer), std::string{file});
+}
+
+int main() {
+    std::string file{};
+    for (auto i = 0; i < 100; ++i) file += fmt::format("line {} of the file\n", i);
+
+    check_loading("GapBuffer", *GapBuffer::make_handle(), file);
+    check_loading("StdStringBuffer", *StdStringBuffer::make_handle(), file);
+
+    // the chunks MappedBuffer gets are views into the mapping
+    const auto path = std::filesystem::temp_directory_path() / "cxgledit_load_test.txt";
+    std::ofstream{path, std::ios::binary} << file;
+    if (std::shared_ptr<MappedFile> mapping = MappedFile::open(path)) {
+        check_loading("MappedBuffer", *MappedBuffer::make_handle(mapping), mapping->view());
+    } else {
+        fmt::print("FAIL MappedBuffer: couldn't map {}\n", path.string());
+        ++failures;
+    }
+    std::error_code ec{};
+    std::filesystem::remove(path, ec);
+
+    if (failures == 0) fmt::print("all passed\n");
+    return failures == 0 ? 0 : 1;
+}
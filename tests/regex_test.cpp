@@ -0,0 +1,53 @@
+//
+// Created by 46769 on 2021-02-23.
+//
+
+// Regression tests of Regex: what a pattern matches in a text, against what it should. Exits with 1 if anything
+// doesn't match what it should, see ctest.
+
+#include <core/search/regex.hpp>
+#include <fmt/core.h>
+#include <optional>
+#include <string>
+#include <utility>
+
+static int failures = 0;
+
+/// Checks that the first match of pattern in text is [begin, end), or that there's none
+static void check(std::string_view pattern, bool ignore_case, std::string_view text,
+                  std::optional<std::pair<std::size_t, std::size_t>> expected) {
+    std::string error{};
+    auto regex = Regex::create(pattern, ignore_case, error);
+    if (not regex) {
+        fmt::print("FAIL {}: {}\n", pattern, error);
+        ++failures;
+        return;
+    }
+    Haystack haystack{{text}};
+    auto match = regex->find(haystack, 0, haystack.size());
+    std::optional<std::pair<std::size_t, std::size_t>> found{};
+    if (match) found = std::pair{match->begin, match->end};
+    if (found == expected) return;
+    fmt::print("FAIL {}{} in \"{}\": expected {}, found {}\n", pattern, ignore_case ? " (ignore case)" : "", text,
+               expected ? fmt::format("[{}, {})", expected->first, expected->second) : "nothing",
+               found ? fmt::format("[{}, {})", found->first, found->second) : "nothing");
+    ++failures;
+}
+
+int main() {
+    check("[a]", true, "xA", std::pair{1, 2});
+    check("[a-c]+", true, "xAbC", std::pair{1, 4});
+    // negated classes are folded before they're negated, so neither case of a letter in them matches
+    check("[^a]", false, "aA", std::pair{1, 2});
+    check("[^a]", true, "aA", std::nullopt);
+    check("[^a]", true, "aAb", std::pair{2, 3});
+    check("[^A]", true, "aAb", std::pair{2, 3});
+    check("[^a-z]", true, "HeLLo", std::nullopt);
+    check("[^a-z]+", true, "Hi, there", std::pair{2, 4});
+    check("[^aeiou]+", true, "AEIOUxyz", std::pair{5, 8});
+    check("x[^\\W]", true, "x.xY", std::pair{2, 4});
+    check("\\W", true, "ab_C-", std::pair{4, 5});
+    check("[^a]", true, std::string_view{"a\nA", 3}, std::pair{1, 2});
+    if (failures == 0) fmt::print("all passed\n");
+    return failures == 0 ? 0 : 1;
+}